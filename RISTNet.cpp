@@ -5,6 +5,9 @@
 #include "RISTNet.h"
 #include "RISTNetInternal.h"
 
+#include <algorithm>
+#include <charconv>
+
 //---------------------------------------------------------------------------------------------------------------------
 //
 //
@@ -58,6 +61,258 @@ bool RISTNetTools::buildRISTURL(const std::string &lIP, const std::string &lPort
     return true;
 }
 
+namespace {
+    // Ask the admission control and if needed the validator about a connecting client
+    template<typename Connection, typename Validate>
+    std::shared_ptr<Connection> admitConnection(RISTNetAdmission &rAdmission, const std::string &rIP, uint16_t lPort,
+                                                Validate &&rValidate) {
+        if (!rAdmission.enabled()) {
+            return rValidate(rIP, lPort);
+        }
+        std::shared_ptr<void> lCached;
+        switch (rAdmission.admit(rIP, lPort, lCached)) {
+            case RISTNetAdmission::Decision::kAccept:
+                return std::static_pointer_cast<Connection>(lCached);
+            case RISTNetAdmission::Decision::kReject:
+                return nullptr;
+            case RISTNetAdmission::Decision::kValidate:
+                break;
+        }
+        std::shared_ptr<Connection> lConnection = rValidate(rIP, lPort);
+        rAdmission.validated(rIP, lConnection);
+        return lConnection;
+    }
+
+    // The numeric URL parameters, in the order they are written
+    struct NumericParameter {
+        const char *mName;
+        std::optional<uint32_t> RISTNetURL::*mMember;
+        uint32_t mMin;
+        uint32_t mMax;
+    };
+
+    const NumericParameter kNumericParameters[] = {
+            {"ttl",                &RISTNetURL::mMulticastTTL,           1, 255},
+            {"buffer",             &RISTNetURL::mBuffer,                 1, UINT32_MAX},
+            {"buffer-min",         &RISTNetURL::mBufferMin,              1, UINT32_MAX},
+            {"buffer-max",         &RISTNetURL::mBufferMax,              1, UINT32_MAX},
+            {"rtt-min",            &RISTNetURL::mRTTMin,                 1, UINT32_MAX},
+            {"rtt-max",            &RISTNetURL::mRTTMax,                 1, UINT32_MAX},
+            {"reorder-buffer",     &RISTNetURL::mReorderBuffer,          0, UINT32_MAX},
+            {"min-retries",        &RISTNetURL::mMinRetries,             0, UINT32_MAX},
+            {"max-retries",        &RISTNetURL::mMaxRetries,             0, UINT32_MAX},
+            {"bandwidth",          &RISTNetURL::mBandwidth,              1, UINT32_MAX},
+            {"return-bandwidth",   &RISTNetURL::mReturnBandwidth,        1, UINT32_MAX},
+            {"congestion-control", &RISTNetURL::mCongestionControl,      0, 2},
+            {"weight",             &RISTNetURL::mWeight,                 0, UINT32_MAX},
+            {"session-timeout",    &RISTNetURL::mSessionTimeout,         1, UINT32_MAX},
+            {"keepalive-interval", &RISTNetURL::mKeepAliveInterval,      1, UINT32_MAX},
+            {"virt-dst-port",      &RISTNetURL::mVirtualDestinationPort, 1, UINT16_MAX},
+            {"aes-type",           &RISTNetURL::mAESType,                128, 256},
+            {"key-rotation",       &RISTNetURL::mKeyRotation,            1, UINT32_MAX},
+    };
+
+    // The string URL parameters, in the order they are written after the numeric ones
+    const std::pair<const char *, std::string RISTNetURL::*> kStringParameters[] = {
+            {"miface", &RISTNetURL::mMulticastInterface},
+            {"cname",  &RISTNetURL::mCNAME},
+            {"secret", &RISTNetURL::mSecret},
+    };
+
+    // Characters that would break the URL syntax
+    bool isURLSafe(const std::string &rValue) {
+        return std::none_of(rValue.begin(), rValue.end(), [](char lChar) {
+            return lChar == '&' || lChar == '=' || lChar == '?' || lChar == '#' || lChar == ' ' || lChar == '/';
+        });
+    }
+}
+
+bool RISTNetURL::isMulticast() const {
+    in_addr lV4{};
+    if (inet_pton(AF_INET, mHost.c_str(), &lV4) == 1) {
+        return (ntohl(lV4.s_addr) >> 28) == 0xe; // 224.0.0.0/4
+    }
+    in6_addr lV6{};
+    if (inet_pton(AF_INET6, mHost.c_str(), &lV6) == 1) {
+        return lV6.s6_addr[0] == 0xff; // ff00::/8
+    }
+    return false;
+}
+
+bool RISTNetTools::validateRISTURL(const RISTNetURL &rParts) {
+    if (!isIPv4(rParts.mHost) && !isIPv6(rParts.mHost)) {
+        LOGGER(true, LOGG_ERROR, "Provided IP-Address not valid: " << rParts.mHost)
+        return false;
+    }
+    if (!rParts.mPort) {
+        LOGGER(true, LOGG_ERROR, "Provided Port number not valid.")
+        return false;
+    }
+    for (auto &rParameter: kNumericParameters) {
+        auto &rValue = rParts.*rParameter.mMember;
+        if (rValue && (*rValue < rParameter.mMin || *rValue > rParameter.mMax)) {
+            LOGGER(true, LOGG_ERROR, "URL parameter " << rParameter.mName << " out of range: " << *rValue)
+            return false;
+        }
+    }
+    for (auto &rParameter: kStringParameters) {
+        auto &rValue = rParts.*rParameter.second;
+        if (!isURLSafe(rValue) || rValue.size() >= RIST_MAX_STRING_SHORT) {
+            LOGGER(true, LOGG_ERROR, "URL parameter " << rParameter.first << " not valid: " << rValue)
+            return false;
+        }
+    }
+    if ((!rParts.mMulticastInterface.empty() || rParts.mMulticastTTL) && !rParts.isMulticast()) {
+        LOGGER(true, LOGG_ERROR, "miface and ttl require a multicast group, got: " << rParts.mHost)
+        return false;
+    }
+    if (rParts.mBuffer && (rParts.mBufferMin || rParts.mBufferMax)) {
+        LOGGER(true, LOGG_ERROR, "buffer can not be combined with buffer-min / buffer-max.")
+        return false;
+    }
+    if (rParts.mBufferMin && rParts.mBufferMax && *rParts.mBufferMin > *rParts.mBufferMax) {
+        LOGGER(true, LOGG_ERROR, "buffer-min is larger than buffer-max.")
+        return false;
+    }
+    if (rParts.mRTTMin && rParts.mRTTMax && *rParts.mRTTMin > *rParts.mRTTMax) {
+        LOGGER(true, LOGG_ERROR, "rtt-min is larger than rtt-max.")
+        return false;
+    }
+    if (rParts.mMinRetries && rParts.mMaxRetries && *rParts.mMinRetries > *rParts.mMaxRetries) {
+        LOGGER(true, LOGG_ERROR, "min-retries is larger than max-retries.")
+        return false;
+    }
+    if (rParts.mAESType && *rParts.mAESType != 128 && *rParts.mAESType != 256) {
+        LOGGER(true, LOGG_ERROR, "aes-type must be 128 or 256.")
+        return false;
+    }
+    if ((rParts.mAESType || rParts.mKeyRotation) && rParts.mSecret.empty()) {
+        LOGGER(true, LOGG_ERROR, "aes-type and key-rotation require a secret.")
+        return false;
+    }
+    return true;
+}
+
+bool RISTNetTools::buildRISTURL(const RISTNetURL &rParts, std::string &rURL) {
+    if (!validateRISTURL(rParts)) {
+        return false;
+    }
+    bool lIPv6 = !isIPv4(rParts.mHost);
+    std::string lRistURL = lIPv6 ? "rist6://" : "rist://";
+    if (rParts.mListen) {
+        lRistURL += "@";
+    }
+    lRistURL += lIPv6 ? "[" + rParts.mHost + "]" : rParts.mHost;
+    lRistURL += ":" + std::to_string(rParts.mPort);
+
+    char lSeparator = '?';
+    for (auto &rParameter: kNumericParameters) {
+        auto &rValue = rParts.*rParameter.mMember;
+        if (rValue) {
+            lRistURL += lSeparator + std::string(rParameter.mName) + "=" + std::to_string(*rValue);
+            lSeparator = '&';
+        }
+    }
+    for (auto &rParameter: kStringParameters) {
+        auto &rValue = rParts.*rParameter.second;
+        if (!rValue.empty()) {
+            lRistURL += lSeparator + std::string(rParameter.first) + "=" + rValue;
+            lSeparator = '&';
+        }
+    }
+    rURL = lRistURL;
+    return true;
+}
+
+bool RISTNetTools::parseRISTURL(const std::string &rURL, RISTNetURL &rParts) {
+    RISTNetURL lParts;
+    std::string lRest;
+    if (rURL.rfind("rist://", 0) == 0) {
+        lRest = rURL.substr(7);
+    } else if (rURL.rfind("rist6://", 0) == 0) {
+        lRest = rURL.substr(8);
+    } else {
+        LOGGER(true, LOGG_ERROR, "Not a RIST URL: " << rURL)
+        return false;
+    }
+
+    auto lQuery = lRest.find('?');
+    std::string lAddress = lRest.substr(0, lQuery);
+    if (!lAddress.empty() && lAddress[0] == '@') {
+        lParts.mListen = true;
+        lAddress.erase(0, 1);
+    }
+    size_t lPortStart;
+    if (!lAddress.empty() && lAddress[0] == '[') {
+        auto lEnd = lAddress.find(']');
+        if (lEnd == std::string::npos || lAddress.compare(lEnd + 1, 1, ":") != 0) {
+            LOGGER(true, LOGG_ERROR, "Malformed IPv6 address: " << rURL)
+            return false;
+        }
+        lParts.mHost = lAddress.substr(1, lEnd - 1);
+        lPortStart = lEnd + 2;
+    } else {
+        auto lColon = lAddress.rfind(':');
+        if (lColon == std::string::npos) {
+            LOGGER(true, LOGG_ERROR, "Port missing: " << rURL)
+            return false;
+        }
+        lParts.mHost = lAddress.substr(0, lColon);
+        lPortStart = lColon + 1;
+    }
+    uint32_t lPort = 0;
+    auto lPortEnd = lAddress.data() + lAddress.size();
+    auto lPortResult = std::from_chars(lAddress.data() + lPortStart, lPortEnd, lPort);
+    if (lPortResult.ec != std::errc() || lPortResult.ptr != lPortEnd || lPort > UINT16_MAX) {
+        LOGGER(true, LOGG_ERROR, "Provided Port number not valid: " << rURL)
+        return false;
+    }
+    lParts.mPort = (uint16_t) lPort;
+
+    std::stringstream lParameters(lQuery == std::string::npos ? "" : lRest.substr(lQuery + 1));
+    std::string lParameter;
+    while (std::getline(lParameters, lParameter, '&')) {
+        auto lEqual = lParameter.find('=');
+        if (lEqual == std::string::npos) {
+            LOGGER(true, LOGG_ERROR, "URL parameter without value: " << lParameter)
+            return false;
+        }
+        std::string lName = lParameter.substr(0, lEqual);
+        std::string lValue = lParameter.substr(lEqual + 1);
+        bool lKnown = false;
+        for (auto &rNumeric: kNumericParameters) {
+            if (lName == rNumeric.mName) {
+                uint32_t lNumber = 0;
+                auto lResult = std::from_chars(lValue.data(), lValue.data() + lValue.size(), lNumber);
+                if (lValue.empty() || lResult.ec != std::errc() || lResult.ptr != lValue.data() + lValue.size()) {
+                    LOGGER(true, LOGG_ERROR, "URL parameter " << lName << " is not a number: " << lValue)
+                    return false;
+                }
+                lParts.*rNumeric.mMember = lNumber;
+                lKnown = true;
+                break;
+            }
+        }
+        for (auto &rString: kStringParameters) {
+            if (lName == rString.first) {
+                lParts.*rString.second = lValue;
+                lKnown = true;
+                break;
+            }
+        }
+        if (!lKnown) {
+            LOGGER(true, LOGG_ERROR, "Unknown URL parameter: " << lName)
+            return false;
+        }
+    }
+
+    if (!validateRISTURL(lParts)) {
+        return false;
+    }
+    rParts = lParts;
+    return true;
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 //
 //
@@ -76,12 +331,15 @@ RISTNetReceiver::RISTNetReceiver() {
 }
 
 RISTNetReceiver::~RISTNetReceiver() {
+    mTeardown.stop();
     if (mRistContext) {
         int lStatus = rist_destroy(mRistContext);
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_receiver_destroy failure")
         }
     }
+    mAdmission.stop();
+    closeQueues();
     LOGGER(false, LOGG_NOTIFY, "RISTNetReceiver destruct")
 }
 
@@ -106,31 +364,157 @@ int RISTNetReceiver::dataFromClientStub(const uint8_t *pBuf, size_t lSize,
 
 int RISTNetReceiver::receiveData(void *pArg, rist_data_block *pDataBlock) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
-    std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-
-    auto netObj = lWeakSelf->mClientListReceiver.find(pDataBlock->peer);
-    if (netObj != lWeakSelf->mClientListReceiver.end()) {
-        auto netCon = netObj->second;
-        return lWeakSelf->networkDataCallback((const uint8_t *) pDataBlock->payload, pDataBlock->payload_len, netCon, pDataBlock->peer, pDataBlock->flow_id);
+    lWeakSelf->mThreadBinder.bindCurrentThread("data");
+    std::unique_lock<std::mutex> lLock(lWeakSelf->mClientListMtx);
+
+    Client *pClient = lWeakSelf->mClientListReceiver.find(pDataBlock->peer);
+    if (pClient) {
+        pClient->mState->mFlowId = pDataBlock->flow_id;
+        auto netCon = pClient->mConnection;
+        const uint8_t *lPayload = (const uint8_t *) pDataBlock->payload;
+        size_t lPayloadSize = pDataBlock->payload_len;
+        uint16_t lFlowId = pDataBlock->flow_id;
+        if (lWeakSelf->mChecksum && !RISTNetCRC32C::verifyTrailer(lPayload, lPayloadSize, lPayloadSize)) {
+            LOGGER(true, LOGG_ERROR, "Checksum mismatch. Data is lost")
+            pClient->mState->mChecksumErrors++;
+            return 0;
+        }
+        if (lWeakSelf->mFEC) {
+            RISTNetFECDecoder &rDecoder = *pClient->mState->mFEC;
+            if (lFlowId == lWeakSelf->mFECFlowId) {
+                if (!rDecoder.addParity(lPayload, lPayloadSize)) {
+                    LOGGER(true, LOGG_ERROR, "Malformed FEC parity packet.")
+                }
+                // Delivered from the decoder. Only this thread adds packets to it, but a disconnect while
+                // delivering released the lock destroys it. A decoder created since has recovered nothing
+                RISTNetFECDecoder *pDecoder = &rDecoder;
+                size_t lRecovered = rDecoder.recoveredCount();
+                for (size_t i = 0; i < lRecovered; i++) {
+                    if (!lLock.owns_lock()) {
+                        lLock.lock();
+                        pClient = lWeakSelf->mClientListReceiver.find(pDataBlock->peer);
+                        if (!pClient || pClient->mState->mFEC.get() != pDecoder || i >= pDecoder->recoveredCount()) {
+                            break;
+                        }
+                    }
+                    lWeakSelf->deliverData(lLock, pDecoder->recoveredData(i), pDecoder->recoveredSize(i),
+                                           pDecoder->recoveredFlowId(i), pDataBlock->peer, netCon);
+                }
+                return 0;
+            }
+            if (lPayloadSize < RISTNetFEC::kSequenceTrailerSize) {
+                LOGGER(true, LOGG_ERROR, "Malformed FEC sequence trailer. Data is lost")
+                return 0;
+            }
+            lPayloadSize -= RISTNetFEC::kSequenceTrailerSize;
+            if (!rDecoder.addMedia(lPayload, lPayloadSize, lFlowId, RISTNetFEC::readSequence(lPayload + lPayloadSize))) {
+                return 0; // Already recovered and delivered
+            }
+        }
+        return lWeakSelf->deliverData(lLock, lPayload, lPayloadSize, lFlowId, pDataBlock->peer, netCon);
     } else {
         LOGGER(true, LOGG_ERROR, "receivesendDataData mClientListReceiver <-> peer mismatch.")
     }
     return -1;
 }
 
+int RISTNetReceiver::deliverData(std::unique_lock<std::mutex> &rLock, const uint8_t *pData, size_t lSize,
+                                 uint16_t lFlowId, rist_peer *pPeer, std::shared_ptr<NetworkConnection> &rConnection) {
+    size_t lPayloadSize = lSize;
+    if (mLatencyProbe) {
+        RISTNetLatencyProbe::Clock lClock;
+        uint64_t lTimestamp = 0;
+        if (!RISTNetLatencyProbe::readTrailer(pData, lSize, lPayloadSize, lClock, lTimestamp)) {
+            LOGGER(true, LOGG_ERROR, "Malformed latency probe trailer. Data is lost")
+            return 0;
+        }
+        if (lClock != RISTNetLatencyProbe::Clock::kNone) {
+            recordLatency(pPeer, lClock, lTimestamp);
+        }
+    }
+    RISTNetBufferPool::Buffer lDecompressed;
+    if (mCompression) {
+        RISTNetLZ4::Format lFormat;
+        int lDecompressedSize = -1;
+        if (RISTNetLZ4::readTrailer(pData, lPayloadSize, lFormat, lPayloadSize)) {
+            lDecompressedSize = (int) lPayloadSize;
+            if (lFormat != RISTNetLZ4::Format::kRaw) {
+                lDecompressed = mPayloadPool.acquire();
+                lDecompressedSize = mDecompressor.decompress(pData, lPayloadSize, lFormat, lDecompressed.data(),
+                                                             lDecompressed.size());
+                pData = lDecompressed.data();
+            }
+        }
+        if (lDecompressedSize < 0) {
+            LOGGER(true, LOGG_ERROR, "Decompression failed. Data is lost")
+            if (Client *pClient = mClientListReceiver.find(pPeer)) {
+                pClient->mState->mDecompressionErrors++;
+            }
+            return 0;
+        }
+        lPayloadSize = lDecompressedSize;
+    }
+    RISTNetBufferPool::Buffer lRestored;
+    if (mNullPackets) {
+        size_t lNullPackets = 0;
+        size_t lRestoredSize = 0;
+        bool lValid = RISTNetNullPackets::readTrailer(pData, lPayloadSize, lRestoredSize, lNullPackets);
+        if (lValid && lNullPackets) {
+            lRestored = mPayloadPool.acquire();
+            lRestoredSize = RISTNetNullPackets::restore(pData, lPayloadSize, lRestored.data(), lRestored.size());
+            lValid = lRestoredSize != 0;
+            pData = lRestored.data();
+        }
+        if (!lValid || lNullPackets) {
+            Client *pClient = mClientListReceiver.find(pPeer);
+            if (!lValid) {
+                LOGGER(true, LOGG_ERROR, "Malformed null packet trailer. Data is lost")
+                if (pClient) {
+                    pClient->mState->mNullPacketErrors++;
+                }
+                return 0;
+            }
+            if (pClient) {
+                pClient->mState->mNullPacketsRestored += lNullPackets;
+            }
+        }
+        lPayloadSize = lRestoredSize;
+    }
+    if (mTSAnalyzer) {
+        Client *pClient = mClientListReceiver.find(pPeer);
+        if (pClient && pClient->mState->mTSAnalyzer) {
+            pClient->mState->mTSAnalyzer->analyze(pData, lPayloadSize, RISTNetTSAnalyzer::now());
+        }
+    }
+    if (mPacketQueue) {
+        // The push might resume the consumer inline
+        rLock.unlock();
+        if (!mPacketQueue->push(pData, lPayloadSize, lFlowId, pPeer, rConnection)) {
+            LOGGER(true, LOGG_WARN, "Packet queue full. Data is lost")
+        }
+        return 0;
+    }
+    return networkDataCallback(pData, lPayloadSize, rConnection, pPeer, lFlowId);
+}
+
 int RISTNetReceiver::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
+    lWeakSelf->mThreadBinder.bindCurrentThread("oob");
     if (lWeakSelf->networkOOBDataCallback) {  //This is a optional callback
         if (lWeakSelf->mClientListReceiver.empty()) {
-            auto lEmptyContext = std::make_shared<NetworkConnection>(); //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
-            lEmptyContext->mObject.reset();
+            // A callback that kept the connection owns it, later blocks get a fresh one
+            if (lWeakSelf->mEmptyConnection.use_count() > 1) {
+                lWeakSelf->mEmptyConnection = std::make_shared<NetworkConnection>();
+            }
+            auto lEmptyContext = lWeakSelf->mEmptyConnection; //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
+            lEmptyContext->mObject.reset(); //Cleared if an earlier callback set it
             lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, lEmptyContext, pOOBBlock->peer);
             return 0;
         }
         std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-        auto netObj = lWeakSelf->mClientListReceiver.find(pOOBBlock->peer);
-        if (netObj != lWeakSelf->mClientListReceiver.end()) {
-            auto netCon = netObj->second;
+        Client *pClient = lWeakSelf->mClientListReceiver.find(pOOBBlock->peer);
+        if (pClient) {
+            auto netCon = pClient->mConnection;
             lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, netCon, pOOBBlock->peer);
             return 0;
         }
@@ -141,11 +525,36 @@ int RISTNetReceiver::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock)
 
 int RISTNetReceiver::clientConnect(void *pArg, const char* pConnectingIP, uint16_t lConnectingPort, const char* pIP, uint16_t lPort, rist_peer *pPeer) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
-    auto lNetObj = lWeakSelf->validateConnectionCallback(std::string(pConnectingIP), lConnectingPort);
+    lWeakSelf->mThreadBinder.bindCurrentThread("auth");
+    std::string lIP(pConnectingIP);
+    auto lNetObj = admitConnection<NetworkConnection>(lWeakSelf->mAdmission, lIP, lConnectingPort,
+                                                      lWeakSelf->validateConnectionCallback);
     if (lNetObj) {
-        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-
-        lWeakSelf->mClientListReceiver[pPeer] = lNetObj;
+        size_t lReserved = lWeakSelf->mRecoveryBufferSize + lWeakSelf->mConnectionMemory;
+        if (!lWeakSelf->mMemory.reserve(lReserved)) {
+            LOGGER(true, LOGG_ERROR, "Memory budget exceeded, rejecting connection from: " << lIP)
+            return -1;
+        }
+        if (lWeakSelf->mAdmission.enabled()) {
+            lWeakSelf->mAdmission.connected(pPeer, lIP);
+        }
+        {
+            std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+
+            Client &rClient = lWeakSelf->mClientListReceiver[pPeer];
+            rClient.mConnection = lNetObj;
+            rClient.mState = std::make_unique<ConnectionState>();
+            rClient.mReserved = lReserved;
+            if (lWeakSelf->mFEC) {
+                rClient.mState->mFEC = std::make_unique<RISTNetFECDecoder>(RIST_MAX_PACKET_SIZE);
+            }
+            if (lWeakSelf->mTSAnalyzer) {
+                rClient.mState->mTSAnalyzer = std::make_unique<RISTNetTSAnalyzer>();
+            }
+        }
+        if (lWeakSelf->mConnectionQueue) {
+            lWeakSelf->mConnectionQueue->push({pPeer, lNetObj, true});
+        }
         return 0; // Accept the connection
     }
     return -1; // Reject the connection
@@ -153,34 +562,162 @@ int RISTNetReceiver::clientConnect(void *pArg, const char* pConnectingIP, uint16
 
 int RISTNetReceiver::clientDisconnect(void *pArg, rist_peer *pPeer) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
-    // TODO: closeAllClientConnections/closeClientConnection already holds this lock se we are stuck here. See STAR-255.
-    std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-    if (lWeakSelf->mClientListReceiver.empty()) {
-        return 0;
+    lWeakSelf->mThreadBinder.bindCurrentThread("auth");
+    lWeakSelf->mAdmission.disconnected(pPeer);
+    std::shared_ptr<NetworkConnection> lNetCon;
+    size_t lReserved;
+    {
+        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+        Client *pClient = lWeakSelf->mClientListReceiver.find(pPeer);
+        if (!pClient) {
+            // Peers closed by closeClientConnection are already removed
+            if (!lWeakSelf->mClosingPeers.find(pPeer)) {
+                LOGGER(true, LOGG_ERROR, "RISTNetReceiver::clientDisconnect unknown peer")
+            }
+            return 0;
+        }
+        lNetCon = std::move(pClient->mConnection);
+        lReserved = pClient->mReserved;
+        lWeakSelf->mClientListReceiver.erase(pPeer);
     }
+    lWeakSelf->mMemory.release(lReserved);
+    lWeakSelf->notifyDisconnected(pPeer, lNetCon);
+    return 0;
+}
 
-    auto netObj = lWeakSelf->mClientListReceiver.find(pPeer);
-    if (netObj == lWeakSelf->mClientListReceiver.end()) {
-        LOGGER(true, LOGG_ERROR, "RISTNetReceiver::clientDisconnect unknown peer")
-        return 0;
+void RISTNetReceiver::notifyDisconnected(rist_peer *pPeer, const std::shared_ptr<NetworkConnection> &rConnection) {
+    if (clientDisconnectedCallback) {
+        clientDisconnectedCallback(rConnection, *pPeer);
     }
-
-    if (lWeakSelf->clientDisconnectedCallback) {
-        lWeakSelf->clientDisconnectedCallback(netObj->second, *pPeer);
+    // The push might resume the consumer inline
+    if (mConnectionQueue) {
+        mConnectionQueue->push({pPeer, rConnection, false});
     }
+}
 
-    lWeakSelf->mClientListReceiver.erase(pPeer);
-    return 0;
+void RISTNetReceiver::teardownPeers(std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers) {
+    mThreadBinder.bindCurrentThread("teardown");
+    for (auto &rPeer: lPeers) {
+        // Before the peer is destroyed, the callback gets a reference to it
+        notifyDisconnected(rPeer.first, rPeer.second);
+        if (rist_peer_destroy(mRistContext, rPeer.first)) {
+            LOGGER(true, LOGG_ERROR, "rist_receiver_peer_destroy failed: ")
+        }
+    }
+    std::lock_guard<std::mutex> lLock(mClientListMtx);
+    for (auto &rPeer: lPeers) {
+        mClosingPeers.erase(rPeer.first);
+    }
 }
 
 int RISTNetReceiver::gotStatistics(void *pArg, const rist_stats *stats) {
     RISTNetReceiver *lWeakSelf = static_cast<RISTNetReceiver*>(pArg);
+    lWeakSelf->mThreadBinder.bindCurrentThread("statistics");
+    if (stats->stats_type == RIST_STATS_RECEIVER_FLOW) {
+        const rist_stats_receiver_flow &rFlow = stats->stats.receiver_flow;
+        {
+            // Forget the flows gone for a while
+            std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+            auto lNow = std::chrono::steady_clock::now();
+            for (auto lIterator = lWeakSelf->mFlowRTT.begin(); lIterator != lWeakSelf->mFlowRTT.end();) {
+                if (lNow - lIterator->second.second > std::chrono::milliseconds(10 * kStatisticsInterval)) {
+                    lIterator = lWeakSelf->mFlowRTT.erase(lIterator);
+                } else {
+                    ++lIterator;
+                }
+            }
+            lWeakSelf->mFlowRTT[rFlow.flow_id] = {rFlow.rtt, lNow};
+        }
+        lWeakSelf->updateRecovery(rFlow);
+    }
     if (lWeakSelf->statisticsCallback) {
         lWeakSelf->statisticsCallback(*stats);
     }
+    if (lWeakSelf->connectionStatisticsCallback) {
+        std::vector<std::pair<rist_peer *, ConnectionStatistics>> lConnectionStatistics;
+        {
+            std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+            for (auto &rClient: lWeakSelf->mClientListReceiver) {
+                ConnectionStatistics lStatistics;
+                lWeakSelf->fillConnectionStatistics(*rClient.second.mState, lStatistics);
+                lConnectionStatistics.emplace_back(rClient.first, lStatistics);
+            }
+        }
+        for (auto &rStatistics: lConnectionStatistics) {
+            lWeakSelf->connectionStatisticsCallback(rStatistics.first, rStatistics.second);
+        }
+    }
     return rist_stats_free(stats);
 }
 
+void RISTNetReceiver::updateRecovery(const rist_stats_receiver_flow &rFlow) {
+    RISTNetRecoveryWindow lWindow;
+    {
+        std::lock_guard<std::mutex> lLock(mRecoveryMtx);
+        if (!mRecovery) {
+            return;
+        }
+        // Every flow reports once per interval, the controller sums them up. The spacing is in us
+        if (!mRecovery->addFlow(rFlow.flow_id, rFlow.rtt, rFlow.received, rFlow.missing,
+                                (uint32_t) std::min<uint64_t>(rFlow.max_inter_packet_spacing / 1000, UINT32_MAX))) {
+            return;
+        }
+        lWindow = mRecovery->window();
+    }
+    LOGGER(true, LOGG_NOTIFY, "Recovery window: length " << lWindow.mLengthMin << "-" << lWindow.mLengthMax
+                              << " ms, RTT " << lWindow.mRTTMin << "-" << lWindow.mRTTMax << " ms.")
+    if (recoveryWindowCallback) {
+        recoveryWindowCallback(lWindow);
+    }
+}
+
+void RISTNetReceiver::recordLatency(rist_peer *pPeer, RISTNetLatencyProbe::Clock lClock, uint64_t lTimestamp) {
+    Client *pClient = mClientListReceiver.find(pPeer);
+    if (!pClient) {
+        return;
+    }
+    int64_t lTransit = (int64_t) (RISTNetLatencyProbe::now(lClock) - lTimestamp);
+    ConnectionState &rState = *pClient->mState;
+    rState.mMinTransit = std::min(rState.mMinTransit, lTransit);
+    if (lTransit < 0) {
+        rState.mNegativeTransits++;
+        lTransit = 0;
+    }
+    rState.mLatency.recordValue((uint64_t) lTransit);
+}
+
+void RISTNetReceiver::fillConnectionStatistics(const ConnectionState &rState,
+                                               ConnectionStatistics &rStatistics) const {
+    rStatistics.mLatencySamples = rState.mLatency.totalCount();
+    rStatistics.mLatencyMin = rState.mLatency.minValue();
+    rStatistics.mLatencyMax = rState.mLatency.maxValue();
+    rStatistics.mLatencyP50 = rState.mLatency.valueAtPercentile(50.0);
+    rStatistics.mLatencyP99 = rState.mLatency.valueAtPercentile(99.0);
+    rStatistics.mLatencyP999 = rState.mLatency.valueAtPercentile(99.9);
+    rStatistics.mNegativeTransits = rState.mNegativeTransits;
+    if (rState.mFEC) {
+        rStatistics.mFECParityPackets = rState.mFEC->parityPackets();
+        rStatistics.mFECRecovered = rState.mFEC->recoveredPackets();
+        rStatistics.mFECDuplicates = rState.mFEC->duplicatePackets();
+    }
+    rStatistics.mChecksumErrors = rState.mChecksumErrors;
+    rStatistics.mDecompressionErrors = rState.mDecompressionErrors;
+    rStatistics.mNullPacketsRestored = rState.mNullPacketsRestored;
+    rStatistics.mNullPacketErrors = rState.mNullPacketErrors;
+    if (rState.mTSAnalyzer) {
+        rState.mTSAnalyzer->statistics(rStatistics.mTS);
+    }
+    // Assume a symmetric path, the one way delay is then RTT / 2. The RTT of the connection's flow, or of the only
+    // flow if librist reports it under another flow_id
+    auto lFlow = mFlowRTT.find(rState.mFlowId);
+    if (lFlow == mFlowRTT.end() && mFlowRTT.size() == 1) {
+        lFlow = mFlowRTT.begin();
+    }
+    if (rStatistics.mLatencySamples && lFlow != mFlowRTT.end()) {
+        rStatistics.mClockOffset = rState.mMinTransit - (int64_t) lFlow->second.first * 1000 / 2;
+    }
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 // RISTNetReceiver  --  Callbacks --- End
 //---------------------------------------------------------------------------------------------------------------------
@@ -190,44 +727,147 @@ void RISTNetReceiver::getActiveClients(
     std::lock_guard<std::mutex> lLock(mClientListMtx);
 
     if (lFunction) {
-        lFunction(mClientListReceiver);
+        std::map<rist_peer *, std::shared_ptr<NetworkConnection>> lClients;
+        for (auto &rClient: mClientListReceiver) {
+            lClients.emplace(rClient.first, rClient.second.mConnection);
+        }
+        lFunction(lClients);
     }
 }
 
-bool RISTNetReceiver::closeClientConnection(rist_peer *lPeer) {
+bool RISTNetReceiver::getConnectionStatistics(rist_peer *pPeer, ConnectionStatistics &rStatistics) {
     std::lock_guard<std::mutex> lLock(mClientListMtx);
-    auto netObj = mClientListReceiver.find(lPeer);
-    if (netObj == mClientListReceiver.end()) {
-        LOGGER(true, LOGG_ERROR, "Could not find peer")
+    Client *pClient = mClientListReceiver.find(pPeer);
+    if (!pClient) {
         return false;
     }
-    mClientListReceiver.erase(lPeer);
-    int lStatus = rist_peer_destroy(mRistContext, lPeer);
-    if (lStatus) {
-        LOGGER(true, LOGG_ERROR, "rist_receiver_peer_destroy failed: ")
-        return false;
+    fillConnectionStatistics(*pClient->mState, rStatistics);
+    return true;
+}
+
+RISTNetAdmissionStatistics RISTNetReceiver::getAdmissionStatistics() {
+    return mAdmission.statistics();
+}
+
+RISTNetMemoryUsage RISTNetReceiver::getMemoryUsage() {
+    RISTNetMemoryUsage lUsage;
+    if (mPacketQueue) {
+        lUsage.mQueues += mPacketQueue->memoryUsage();
+    }
+    lUsage.mQueues += mPayloadPool.memoryUsage();
+    std::lock_guard<std::mutex> lLock(mClientListMtx);
+    lUsage.mConnections = mClientListReceiver.capacity() * sizeof(RISTNetPeerTable<Client>::Entry);
+    for (auto &rClient: mClientListReceiver) {
+        lUsage.mRecoveryBuffers += rClient.second.mReserved - mConnectionMemory;
+        lUsage.mConnections += sizeof(NetworkConnection) + sizeof(ConnectionState) +
+                               RISTNetLatencyHistogram::kMemoryUsage;
+        if (rClient.second.mState->mFEC) {
+            lUsage.mConnections += sizeof(RISTNetFECDecoder) + rClient.second.mState->mFEC->memoryUsage();
+        }
+        if (rClient.second.mState->mTSAnalyzer) {
+            lUsage.mConnections += sizeof(RISTNetTSAnalyzer) + RISTNetTSAnalyzer::memoryUsage();
+        }
+    }
+    return lUsage;
+}
+
+RISTNetRecoveryWindow RISTNetReceiver::getRecoveryWindow() {
+    std::lock_guard<std::mutex> lLock(mRecoveryMtx);
+    if (mRecovery) {
+        return mRecovery->window();
     }
+    RISTNetRecoveryWindow lWindow;
+    lWindow.mLengthMin = mRistPeerConfig.recovery_length_min;
+    lWindow.mLengthMax = mRistPeerConfig.recovery_length_max;
+    lWindow.mRTTMin = mRistPeerConfig.recovery_rtt_min;
+    lWindow.mRTTMax = mRistPeerConfig.recovery_rtt_max;
+    return lWindow;
+}
+
+RISTNetMemoryUsage RISTNetReceiver::estimateMemory(const RISTNetReceiverSettings &rSettings, size_t lConnections) {
+    RISTNetMemoryUsage lUsage;
+    lUsage.mRecoveryBuffers = lConnections * RISTNetMemory::recoveryBufferSize(
+            rSettings.mPeerConfig.recovery_maxbitrate, rSettings.mPeerConfig.recovery_length_max);
+    lUsage.mQueues = queueMemory(rSettings);
+    lUsage.mConnections = lConnections * connectionMemory(rSettings.mFEC, rSettings.mTSAnalyzer);
+    return lUsage;
+}
+
+size_t RISTNetReceiver::queueMemory(const RISTNetReceiverSettings &rSettings) {
+    size_t lBytes = rSettings.mReceiveQueueDepth * RIST_MAX_PACKET_SIZE;
+    if (rSettings.mCompression || rSettings.mNullPackets) {
+        lBytes += kPayloadPooled * RIST_MAX_PACKET_SIZE;
+    }
+    return lBytes;
+}
+
+size_t RISTNetReceiver::connectionMemory(bool lFEC, bool lTSAnalyzer) {
+    // The client table is at most 3/4 full
+    size_t lBytes = 2 * sizeof(RISTNetPeerTable<Client>::Entry) + sizeof(NetworkConnection) +
+                    sizeof(ConnectionState) + RISTNetLatencyHistogram::kMemoryUsage;
+    if (lFEC) {
+        lBytes += sizeof(RISTNetFECDecoder) + RISTNetFECDecoder::maxMemoryUsage(RIST_MAX_PACKET_SIZE);
+    }
+    if (lTSAnalyzer) {
+        lBytes += sizeof(RISTNetTSAnalyzer) + RISTNetTSAnalyzer::memoryUsage();
+    }
+    return lBytes;
+}
+
+bool RISTNetReceiver::closeClientConnection(rist_peer *lPeer) {
+    std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers;
+    size_t lReserved;
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        Client *pClient = mClientListReceiver.find(lPeer);
+        if (!pClient) {
+            LOGGER(true, LOGG_ERROR, "Could not find peer")
+            return false;
+        }
+        lPeers.emplace_back(lPeer, std::move(pClient->mConnection));
+        lReserved = pClient->mReserved;
+        mClientListReceiver.erase(lPeer);
+        mClosingPeers[lPeer] = true;
+    }
+    mMemory.release(lReserved);
+    mAdmission.disconnected(lPeer);
+    mTeardown.post([this, lPeers = std::move(lPeers)]() mutable { teardownPeers(std::move(lPeers)); });
     return true;
 }
 
 void RISTNetReceiver::closeAllClientConnections() {
-    std::lock_guard<std::mutex> lLock(mClientListMtx);
-    for (auto &rPeer: mClientListReceiver) {
-        rist_peer *lPeer = rPeer.first;
-        int lStatus = rist_peer_destroy(mRistContext, lPeer);
-        if (lStatus) {
-            LOGGER(true, LOGG_ERROR, "rist_receiver_peer_destroy failed: ")
+    std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers;
+    size_t lReserved = 0;
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        lPeers.reserve(mClientListReceiver.size());
+        for (auto &rClient: mClientListReceiver) {
+            lPeers.emplace_back(rClient.first, std::move(rClient.second.mConnection));
+            lReserved += rClient.second.mReserved;
+            mClosingPeers[rClient.first] = true;
         }
+        mClientListReceiver.clear();
+    }
+    mMemory.release(lReserved);
+    mAdmission.disconnectedAll();
+    if (!lPeers.empty()) {
+        mTeardown.post([this, lPeers = std::move(lPeers)]() mutable { teardownPeers(std::move(lPeers)); });
     }
-    mClientListReceiver.clear();
 }
 
 bool RISTNetReceiver::destroyReceiver() {
     if (mRistContext) {
+        // The peers being closed must be destroyed before the context
+        mTeardown.drain();
         int lStatus = rist_destroy(mRistContext);
         mRistContext = nullptr;
+        mAdmission.stop();
+        closeQueues();
         std::lock_guard<std::mutex> lLock(mClientListMtx);
         mClientListReceiver.clear();
+        mClosingPeers.clear();
+        mFlowRTT.clear();
+        mMemory.releaseAll();
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_receiver_destroy fail.")
             return false;
@@ -247,6 +887,33 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
     }
 
     int lStatus;
+    mLatencyProbe = rSettings.mLatencyProbe;
+    mFEC = rSettings.mFEC;
+    mFECFlowId = rSettings.mFECFlowId;
+    mChecksum = rSettings.mChecksum;
+    mCompression = rSettings.mCompression;
+    mTSAnalyzer = rSettings.mTSAnalyzer;
+    mNullPackets = rSettings.mNullPackets;
+    mDecompressor.setDictionary(rSettings.mCompressionDictionary);
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        mClientListReceiver.reserve(rSettings.mExpectedClients);
+    }
+    mThreadBinder.configure(rSettings.mThreadSettings);
+    if (!mAdmission.configure(rSettings.mAdmission, [this](const std::string &rIP, uint16_t lPort) {
+        mThreadBinder.bindCurrentThread("admission");
+        return std::shared_ptr<void>(validateConnectionCallback(rIP, lPort));
+    })) {
+        return false;
+    }
+    mExecutor = rSettings.mExecutor;
+    if (rSettings.mReceiveQueueDepth) {
+        mPacketQueue = std::make_shared<PacketQueue>(rSettings.mReceiveQueueDepth, RIST_MAX_PACKET_SIZE);
+        mConnectionQueue = std::make_shared<RISTNetAwaitQueue<ConnectionEvent>>(kConnectionQueueDepth);
+    } else {
+        mPacketQueue.reset();
+        mConnectionQueue.reset();
+    }
 
     // Default log settings
     rist_logging_settings* lSettingsPtr = rSettings.mLogSetting.get();
@@ -263,6 +930,14 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
         LOGGER(true, LOGG_ERROR, "rist_receiver_create fail.")
         return false;
     }
+
+    size_t lRecoveryBufferSize = 0;
+    mRecoveryBufferSize = 0;
+    mConnectionMemory = connectionMemory(mFEC, mTSAnalyzer);
+    if (!mMemory.reserve(queueMemory(rSettings))) {
+        destroyReceiver();
+        return false;
+    }
     for (auto &rURL: rURLList) {
         int keysize = 0;
         if (!rSettings.mPSK.empty()) {
@@ -302,6 +977,19 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
             return false;
         }
 
+        // Every connection gets a recovery buffer, reserved when it connects. Check one fits (clamping it if
+        // allowed) now, the URL might have changed the buffer
+        uint32_t lLength = mRistPeerConfig.recovery_length_max;
+        size_t lRecoveryBuffer = 0;
+        if (!mMemory.reserveRecoveryBuffer(mRistPeerConfig.recovery_maxbitrate, mRistPeerConfig.recovery_length_min,
+                                           lLength, lRecoveryBuffer)) {
+            destroyReceiver();
+            return false;
+        }
+        mMemory.release(lRecoveryBuffer);
+        mRistPeerConfig.recovery_length_max = lLength;
+        lRecoveryBufferSize = std::max(lRecoveryBufferSize, lRecoveryBuffer);
+
         rist_peer *peer;
         lStatus =  rist_peer_create(mRistContext, &peer, &mRistPeerConfig);
         if (lStatus) {
@@ -310,6 +998,20 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
             return false;
         }
     }
+    mRecoveryBufferSize = lRecoveryBufferSize;
+
+    {
+        std::lock_guard<std::mutex> lLock(mRecoveryMtx);
+        mRecovery.reset();
+        if (rSettings.mRecovery.mEnabled) {
+            RISTNetRecoveryWindow lWindow;
+            lWindow.mLengthMin = mRistPeerConfig.recovery_length_min;
+            lWindow.mLengthMax = mRistPeerConfig.recovery_length_max;
+            lWindow.mRTTMin = mRistPeerConfig.recovery_rtt_min;
+            lWindow.mRTTMax = mRistPeerConfig.recovery_rtt_max;
+            mRecovery = std::make_unique<RISTNetRecoveryController>(rSettings.mRecovery, lWindow);
+        }
+    }
 
     if (rSettings.mMaxjitter) {
         lStatus = rist_jitter_max_set(mRistContext, rSettings.mMaxjitter);
@@ -341,7 +1043,7 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
         return false;
     }
 
-    lStatus = rist_stats_callback_set(mRistContext, 1000, gotStatistics, this);
+    lStatus = rist_stats_callback_set(mRistContext, kStatisticsInterval, gotStatistics, this);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_stats_callback_set fail.")
         destroyReceiver();
@@ -377,6 +1079,32 @@ bool RISTNetReceiver::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t
     return true;
 }
 
+RISTNetPopAwaiter<RISTNetReceiver::PacketQueue> RISTNetReceiver::nextPacket() {
+    return {mPacketQueue, mExecutor.get()};
+}
+
+RISTNetPopAwaiter<RISTNetAwaitQueue<RISTNetReceiver::ConnectionEvent>> RISTNetReceiver::nextConnection() {
+    return {mConnectionQueue, mExecutor.get()};
+}
+
+uint64_t RISTNetReceiver::getQueueDropped() {
+    return mPacketQueue ? mPacketQueue->dropped() : 0;
+}
+
+void RISTNetReceiver::closeQueues() {
+    // Resumes the waiting coroutines with an empty result, queued items can still be consumed
+    if (mPacketQueue) {
+        mPacketQueue->close();
+    }
+    if (mConnectionQueue) {
+        mConnectionQueue->close();
+    }
+}
+
+void RISTNetReceiver::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    mThreadBinder.getDiagnostics(rThreads);
+}
+
 void RISTNetReceiver::getVersion(uint32_t &rCppWrapper, uint32_t &rRistMajor, uint32_t &rRistMinor) {
     rCppWrapper = CPP_WRAPPER_VERSION;
     rRistMajor = LIBRIST_API_VERSION_MAJOR;
@@ -398,12 +1126,16 @@ RISTNetSender::RISTNetSender() {
 }
 
 RISTNetSender::~RISTNetSender() {
+    stopSendQueue();
+    mTeardown.stop();
     if (mRistContext) {
         int lStatus = rist_destroy(mRistContext);
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_sender_destroy fail.")
         }
     }
+    mAdmission.stop();
+    mWritable.close();
     LOGGER(false, LOGG_NOTIFY, "RISTNetClient destruct.")
 }
 
@@ -421,17 +1153,22 @@ std::shared_ptr<RISTNetSender::NetworkConnection> RISTNetSender::validateConnect
 
 int RISTNetSender::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock) {
     RISTNetSender *lWeakSelf = (RISTNetSender *) pArg;
+    lWeakSelf->mThreadBinder.bindCurrentThread("oob");
     if (lWeakSelf->networkOOBDataCallback) {  //This is a optional callback
         if (lWeakSelf->mClientListSender.empty()) {
-            auto lEmptyContext = std::make_shared<NetworkConnection>(); //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
-            lEmptyContext->mObject.reset();
+            // A callback that kept the connection owns it, later blocks get a fresh one
+            if (lWeakSelf->mEmptyConnection.use_count() > 1) {
+                lWeakSelf->mEmptyConnection = std::make_shared<NetworkConnection>();
+            }
+            auto lEmptyContext = lWeakSelf->mEmptyConnection; //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
+            lEmptyContext->mObject.reset(); //Cleared if an earlier callback set it
             lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, lEmptyContext, pOOBBlock->peer);
             return 0;
         }
         std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-        auto netObj = lWeakSelf->mClientListSender.find(pOOBBlock->peer);
-        if (netObj != lWeakSelf->mClientListSender.end()) {
-            auto netCon = netObj->second;
+        auto pConnection = lWeakSelf->mClientListSender.find(pOOBBlock->peer);
+        if (pConnection) {
+            auto netCon = *pConnection;
             lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, netCon, pOOBBlock->peer);
             return 0;
         }
@@ -441,10 +1178,23 @@ int RISTNetSender::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock) {
 
 int RISTNetSender::clientConnect(void *pArg, const char* pConnectingIP, uint16_t lConnectingPort, const char* pIP, uint16_t lPort, rist_peer *pPeer) {
     RISTNetSender *lWeakSelf = (RISTNetSender *) pArg;
-    auto lNetObj = lWeakSelf->validateConnectionCallback(std::string(pConnectingIP), lConnectingPort);
+    lWeakSelf->mThreadBinder.bindCurrentThread("auth");
+    std::string lIP(pConnectingIP);
+    auto lNetObj = admitConnection<NetworkConnection>(lWeakSelf->mAdmission, lIP, lConnectingPort,
+                                                      lWeakSelf->validateConnectionCallback);
     if (lNetObj) {
-        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-        lWeakSelf->mClientListSender[pPeer] = lNetObj;
+        if (!lWeakSelf->mMemory.reserve(lWeakSelf->mConnectionMemory)) {
+            LOGGER(true, LOGG_ERROR, "Memory budget exceeded, rejecting connection from: " << lIP)
+            return -1;
+        }
+        if (lWeakSelf->mAdmission.enabled()) {
+            lWeakSelf->mAdmission.connected(pPeer, lIP);
+        }
+        {
+            std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+            lWeakSelf->mClientListSender[pPeer] = lNetObj;
+        }
+        lWeakSelf->updateWritable();
         return 0; // Accept the connection
     }
     return -1; // Reject the connection
@@ -452,27 +1202,51 @@ int RISTNetSender::clientConnect(void *pArg, const char* pConnectingIP, uint16_t
 
 int RISTNetSender::clientDisconnect(void *pArg, rist_peer *pPeer) {
     RISTNetSender *lWeakSelf = (RISTNetSender *) pArg;
-    std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-    if (lWeakSelf->mClientListSender.empty()) {
-        return 0;
-    }
+    lWeakSelf->mThreadBinder.bindCurrentThread("auth");
+    lWeakSelf->mAdmission.disconnected(pPeer);
+    std::shared_ptr<NetworkConnection> lNetCon;
+    {
+        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
 
-    auto netObj = lWeakSelf->mClientListSender.find(pPeer);
-    if (netObj == lWeakSelf->mClientListSender.end()) {
-        LOGGER(true, LOGG_ERROR, "RISTNetSender::clientDisconnect unknown peer")
-        return 0;
+        auto pConnection = lWeakSelf->mClientListSender.find(pPeer);
+        if (!pConnection) {
+            // Peers closed by closeClientConnection are already removed
+            if (!lWeakSelf->mClosingPeers.find(pPeer)) {
+                LOGGER(true, LOGG_ERROR, "RISTNetSender::clientDisconnect unknown peer")
+            }
+            return 0;
+        }
+        lNetCon = std::move(*pConnection);
+        lWeakSelf->mClientListSender.erase(pPeer);
     }
-
+    lWeakSelf->mMemory.release(lWeakSelf->mConnectionMemory);
+    lWeakSelf->updateWritable();
     if (lWeakSelf->clientDisconnectedCallback) {
-        lWeakSelf->clientDisconnectedCallback(netObj->second, *pPeer);
+        lWeakSelf->clientDisconnectedCallback(lNetCon, *pPeer);
     }
-
-    lWeakSelf->mClientListSender.erase(pPeer);
     return 0;
 }
 
+void RISTNetSender::teardownPeers(std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers) {
+    mThreadBinder.bindCurrentThread("teardown");
+    for (auto &rPeer: lPeers) {
+        // Before the peer is destroyed, the callback gets a reference to it
+        if (clientDisconnectedCallback) {
+            clientDisconnectedCallback(rPeer.second, *rPeer.first);
+        }
+        if (rist_peer_destroy(mRistContext, rPeer.first)) {
+            LOGGER(true, LOGG_ERROR, "rist_sender_peer_destroy failed: ")
+        }
+    }
+    std::lock_guard<std::mutex> lLock(mClientListMtx);
+    for (auto &rPeer: lPeers) {
+        mClosingPeers.erase(rPeer.first);
+    }
+}
+
 int RISTNetSender::gotStatistics(void *pArg, const rist_stats *stats) {
     RISTNetSender *lWeakSelf = static_cast<RISTNetSender*>(pArg);
+    lWeakSelf->mThreadBinder.bindCurrentThread("statistics");
     if (lWeakSelf->statisticsCallback) {
         lWeakSelf->statisticsCallback(*stats);
     }
@@ -487,44 +1261,123 @@ void RISTNetSender::getActiveClients(
         const std::function<void(std::map<rist_peer *, std::shared_ptr<NetworkConnection>> &)> lFunction) {
     std::lock_guard<std::mutex> lLock(mClientListMtx);
     if (lFunction) {
-        lFunction(mClientListSender);
+        std::map<rist_peer *, std::shared_ptr<NetworkConnection>> lClients;
+        for (auto &rClient: mClientListSender) {
+            lClients.emplace(rClient.first, rClient.second);
+        }
+        lFunction(lClients);
     }
 }
 
-bool RISTNetSender::closeClientConnection(rist_peer *lPeer) {
+RISTNetAdmissionStatistics RISTNetSender::getAdmissionStatistics() {
+    return mAdmission.statistics();
+}
+
+RISTNetMemoryUsage RISTNetSender::getMemoryUsage() {
+    RISTNetMemoryUsage lUsage;
+    lUsage.mRecoveryBuffers = mRistContext ? mRecoveryBufferSize : 0;
+    lUsage.mQueues = mSendBuffer.capacity() + mParityBuffer.capacity() + mStripBuffer.capacity() +
+                     mFECEncoder.memoryUsage() + mCompressedFlows.capacity() / 8;
+    {
+        std::lock_guard<std::mutex> lLock(mSendQueueMtx);
+        lUsage.mQueues += mSendQueue.capacity() * sizeof(QueuedPacket);
+        for (auto &rSlot: mSendQueue) {
+            lUsage.mQueues += rSlot.mData.capacity();
+        }
+    }
     std::lock_guard<std::mutex> lLock(mClientListMtx);
-    auto netObj = mClientListSender.find(lPeer);
-    if (netObj == mClientListSender.end()) {
-        LOGGER(true, LOGG_ERROR, "Could not find peer")
-        return false;
+    lUsage.mConnections = mClientListSender.capacity() * sizeof(RISTNetPeerTable<std::shared_ptr<NetworkConnection>>::Entry) +
+                          mClientListSender.size() * sizeof(NetworkConnection);
+    return lUsage;
+}
+
+RISTNetMemoryUsage RISTNetSender::estimateMemory(const RISTNetSenderSettings &rSettings, size_t lConnections) {
+    RISTNetMemoryUsage lUsage;
+    lUsage.mRecoveryBuffers = RISTNetMemory::recoveryBufferSize(rSettings.mPeerConfig.recovery_maxbitrate,
+                                                                rSettings.mPeerConfig.recovery_length_max);
+    lUsage.mQueues = queueMemory(rSettings);
+    lUsage.mConnections = lConnections * connectionMemory();
+    return lUsage;
+}
+
+size_t RISTNetSender::queueMemory(const RISTNetSenderSettings &rSettings) {
+    size_t lBytes = rSettings.mSendQueueDepth * (sizeof(QueuedPacket) + RIST_MAX_PACKET_SIZE);
+    bool lFEC = rSettings.mFECColumns != 0;
+    bool lCompression = !rSettings.mCompressedFlowIds.empty();
+    if (rSettings.mLatencyProbeInterval || lFEC || rSettings.mChecksum || lCompression || rSettings.mStripNullPackets) {
+        lBytes += RIST_MAX_PACKET_SIZE;
     }
-    mClientListSender.erase(lPeer);
-    int lStatus = rist_peer_destroy(mRistContext, lPeer);
-    if (lStatus) {
-        LOGGER(true, LOGG_ERROR, "rist_sender_peer_destroy failed: ")
-        return false;
+    if (rSettings.mStripNullPackets && lCompression) {
+        lBytes += RIST_MAX_PACKET_SIZE;
+    }
+    if (lFEC) {
+        lBytes += (rSettings.mFECColumns + 1) * (RISTNetFEC::kParityHeaderSize + RIST_MAX_PACKET_SIZE);
+        if (rSettings.mChecksum) {
+            lBytes += RISTNetFEC::kParityHeaderSize + RIST_MAX_PACKET_SIZE + RISTNetCRC32C::kTrailerSize;
+        }
+    }
+    // The compressed flow bitmap is allocated for every sender
+    lBytes += (UINT16_MAX + 1) / 8;
+    return lBytes;
+}
+
+size_t RISTNetSender::connectionMemory() {
+    // The client table is at most 3/4 full
+    return 2 * sizeof(RISTNetPeerTable<std::shared_ptr<NetworkConnection>>::Entry) + sizeof(NetworkConnection);
+}
+
+bool RISTNetSender::closeClientConnection(rist_peer *lPeer) {
+    std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers;
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        auto pConnection = mClientListSender.find(lPeer);
+        if (!pConnection) {
+            LOGGER(true, LOGG_ERROR, "Could not find peer")
+            return false;
+        }
+        lPeers.emplace_back(lPeer, std::move(*pConnection));
+        mClientListSender.erase(lPeer);
+        mClosingPeers[lPeer] = true;
     }
+    mMemory.release(mConnectionMemory);
+    mAdmission.disconnected(lPeer);
+    updateWritable();
+    mTeardown.post([this, lPeers = std::move(lPeers)]() mutable { teardownPeers(std::move(lPeers)); });
     return true;
 }
 
 void RISTNetSender::closeAllClientConnections() {
-    std::lock_guard<std::mutex> lLock(mClientListMtx);
-    for (auto &rPeer: mClientListSender) {
-        rist_peer *pPeer = rPeer.first;
-        int status = rist_peer_destroy(mRistContext, pPeer);
-        if (status) {
-            LOGGER(true, LOGG_ERROR, "rist_sender_peer_destroy failed: ")
+    std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers;
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        lPeers.reserve(mClientListSender.size());
+        for (auto &rClient: mClientListSender) {
+            lPeers.emplace_back(rClient.first, std::move(rClient.second));
+            mClosingPeers[rClient.first] = true;
         }
+        mClientListSender.clear();
+    }
+    mMemory.release(lPeers.size() * mConnectionMemory);
+    mAdmission.disconnectedAll();
+    updateWritable();
+    if (!lPeers.empty()) {
+        mTeardown.post([this, lPeers = std::move(lPeers)]() mutable { teardownPeers(std::move(lPeers)); });
     }
-    mClientListSender.clear();
 }
 
 bool RISTNetSender::destroySender() {
     if (mRistContext) {
+        stopSendQueue();
+        // The peers being closed must be destroyed before the context
+        mTeardown.drain();
         int lStatus = rist_destroy(mRistContext);
         mRistContext = nullptr;
+        mAdmission.stop();
+        mWritable.close();
         std::lock_guard<std::mutex> lLock(mClientListMtx);
         mClientListSender.clear();
+        mClosingPeers.clear();
+        mMemory.releaseAll();
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_sender_destroy fail.")
             return false;
@@ -535,6 +1388,43 @@ bool RISTNetSender::destroySender() {
     return true;
 }
 
+bool RISTNetSender::configurePayload(const RISTNetSenderSettings &rSettings) {
+    mFEC = rSettings.mFECColumns != 0;
+    mFECFlowId = rSettings.mFECFlowId;
+    if (mFEC && !mFECEncoder.configure(rSettings.mFECColumns, rSettings.mFECRows, rSettings.mFECRowParity,
+                                       RIST_MAX_PACKET_SIZE)) {
+        return false;
+    }
+    mParityPackets = 0;
+    mParityWriteErrors = 0;
+    mChecksum = rSettings.mChecksum;
+    mCompression = !rSettings.mCompressedFlowIds.empty();
+    mCompressedFlows.assign(UINT16_MAX + 1, false);
+    for (auto lFlowId: rSettings.mCompressedFlowIds) {
+        mCompressedFlows[lFlowId] = true;
+    }
+    mCompressor.setDictionary(rSettings.mCompressionDictionary);
+    mCompressor.setAcceleration(rSettings.mCompressionAcceleration);
+    mStripNullPackets = rSettings.mStripNullPackets;
+    mStripBuffer.clear();
+    if (mStripNullPackets && mCompression) {
+        mStripBuffer.resize(RIST_MAX_PACKET_SIZE);
+    }
+    mNullPacketsRemoved = 0;
+    mNullTrailerBytes = 0;
+    if (mFEC && mChecksum) {
+        mParityBuffer.resize(RISTNetFEC::kParityHeaderSize + RIST_MAX_PACKET_SIZE + RISTNetCRC32C::kTrailerSize);
+    }
+    mLatencyProbeInterval = rSettings.mLatencyProbeInterval;
+    mLatencyProbeClock = rSettings.mLatencyProbeClock;
+    mLatencyProbeCounter = 0;
+    mPreparePayload = mLatencyProbeInterval || mFEC || mChecksum || mCompression || mStripNullPackets;
+    if (mPreparePayload) {
+        mSendBuffer.resize(RIST_MAX_PACKET_SIZE);
+    }
+    return true;
+}
+
 bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerList,
                                RISTNetSenderSettings &rSettings) {
 
@@ -543,7 +1433,40 @@ bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerLi
         return false;
     }
 
+    if (!configurePayload(rSettings)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        mClientListSender.reserve(rSettings.mExpectedClients);
+    }
+
     int lStatus;
+    mThreadBinder.configure(rSettings.mThreadSettings);
+    if (!mAdmission.configure(rSettings.mAdmission, [this](const std::string &rIP, uint16_t lPort) {
+        mThreadBinder.bindCurrentThread("admission");
+        return std::shared_ptr<void>(validateConnectionCallback(rIP, lPort));
+    })) {
+        return false;
+    }
+    mExecutor = rSettings.mExecutor;
+    mListenMode = false;
+    mSendQueue.clear();
+    if (rSettings.mSendQueueDepth) {
+        mSendQueue.resize(rSettings.mSendQueueDepth);
+        for (auto &rSlot: mSendQueue) {
+            rSlot.mData.resize(RIST_MAX_PACKET_SIZE);
+        }
+        mSendQueuePolicy = rSettings.mSendQueuePolicy;
+        mSendQueueHighWatermark = rSettings.mSendQueueHighWatermark ? rSettings.mSendQueueHighWatermark :
+                                  std::max(rSettings.mSendQueueDepth * 3 / 4, (size_t) 1);
+        mSendQueueLowWatermark = rSettings.mSendQueueLowWatermark ? rSettings.mSendQueueLowWatermark :
+                                 rSettings.mSendQueueDepth / 4;
+        mSendQueueHighWatermark = std::min(mSendQueueHighWatermark, rSettings.mSendQueueDepth);
+        mSendQueueLowWatermark = std::min(mSendQueueLowWatermark, mSendQueueHighWatermark - 1);
+        mSendQueueStatistics = SendQueueStatistics();
+    }
+
     // Default log settings
     rist_logging_settings* lSettingsPtr = rSettings.mLogSetting.get();
     lStatus = rist_logging_set(&lSettingsPtr, rSettings.mLogLevel, nullptr, nullptr, nullptr, stderr);
@@ -558,9 +1481,19 @@ bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerLi
         LOGGER(true, LOGG_ERROR, "rist_sender_create fail.")
         return false;
     }
+
+    mRecoveryBufferSize = 0;
+    mConnectionMemory = connectionMemory();
+    if (!mMemory.reserve(queueMemory(rSettings))) {
+        destroySender();
+        return false;
+    }
     for (auto &rPeerInfo: rPeerList) {
 
         auto peerURL = std::get<0>(rPeerInfo);
+        if (peerURL.find("://@") != std::string::npos) {
+            mListenMode = true;
+        }
 
         int keysize = 0;
         if (!rSettings.mPSK.empty()) {
@@ -600,6 +1533,18 @@ bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerLi
             return false;
         }
 
+        // The peers share one recovery buffer as long as the longest of theirs, keep the largest reservation
+        uint32_t lLength = mRistPeerConfig.recovery_length_max;
+        size_t lRecoveryBuffer = 0;
+        if (!mMemory.reserveRecoveryBuffer(mRistPeerConfig.recovery_maxbitrate, mRistPeerConfig.recovery_length_min,
+                                           lLength, lRecoveryBuffer)) {
+            destroySender();
+            return false;
+        }
+        mRistPeerConfig.recovery_length_max = lLength;
+        mMemory.release(std::min(lRecoveryBuffer, mRecoveryBufferSize));
+        mRecoveryBufferSize = std::max(mRecoveryBufferSize, lRecoveryBuffer);
+
         rist_peer *peer;
         lStatus =  rist_peer_create(mRistContext, &peer, &mRistPeerConfig);
         if (lStatus) {
@@ -645,6 +1590,12 @@ bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerLi
         destroySender();
         return false;
     }
+    updateWritable();
+
+    if (!mSendQueue.empty()) {
+        mSendQueueRunning = true;
+        mSendThread = std::thread(&RISTNetSender::sendQueueWorker, this);
+    }
 
     return true;
 }
@@ -655,6 +1606,98 @@ bool RISTNetSender::sendData(const uint8_t *pData, size_t lSize, uint16_t lConne
         return false;
     }
 
+    if (mFEC && lConnectionID == mFECFlowId) {
+        LOGGER(true, LOGG_ERROR, "The connection ID " << lConnectionID << " is used by the FEC.")
+        return false;
+    }
+
+    if (!mSendQueue.empty()) {
+        return queueData(pData, lSize, lConnectionID);
+    }
+
+    if (mPreparePayload) {
+        size_t lPayloadSize = 0;
+        if (!preparePayload(pData, lSize, lConnectionID, mSendBuffer.data(), mSendBuffer.size(), lPayloadSize)) {
+            return false;
+        }
+        return writeProtected(mSendBuffer.data(), lPayloadSize, lConnectionID, true);
+    }
+    return writeData(pData, lSize, lConnectionID, true);
+}
+
+size_t RISTNetSender::sendDataBatch(const DataBlock *pBlocks, size_t lCount) {
+    if (!mRistContext) {
+        LOGGER(true, LOGG_ERROR, "RISTNetSender not initialised.")
+        return 0;
+    }
+
+    if (!mSendQueue.empty()) {
+        return queueBatch(pBlocks, lCount);
+    }
+
+    size_t lSent = 0;
+    for (size_t i = 0; i < lCount; i++) {
+        lSent += sendData(pBlocks[i].mData, pBlocks[i].mSize, pBlocks[i].mConnectionID) ? 1 : 0;
+    }
+    return lSent;
+}
+
+bool RISTNetSender::payloadFits(size_t lSize, size_t lDstCapacity) const {
+    size_t lTrailerSize = mLatencyProbeInterval ? RISTNetLatencyProbe::kMaxTrailerSize : 0;
+    lTrailerSize += mStripNullPackets ? RISTNetNullPackets::trailerSize(lSize) : 0;
+    lTrailerSize += mCompression ? RISTNetLZ4::kTrailerSize : 0;
+    // Room for the FEC sequence number and the checksum added by writeProtected
+    lTrailerSize += mFEC ? RISTNetFEC::kSequenceTrailerSize : 0;
+    lTrailerSize += mChecksum ? RISTNetCRC32C::kTrailerSize : 0;
+    if (mFEC) {
+        // The parity packet is the parity header plus the longest payload protected, it must fit in a packet too
+        lDstCapacity = std::min(lDstCapacity, (size_t) RIST_MAX_PACKET_SIZE - RISTNetFEC::kParityHeaderSize +
+                                              RISTNetFEC::kSequenceTrailerSize);
+    }
+    return lSize + lTrailerSize <= lDstCapacity;
+}
+
+bool RISTNetSender::preparePayload(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, uint8_t *pDst,
+                                   size_t lDstCapacity, size_t &rPayloadSize) {
+    if (!payloadFits(lSize, lDstCapacity)) {
+        LOGGER(true, LOGG_ERROR, "Payload too large, " << lSize << " bytes.")
+        return false;
+    }
+    if (mStripNullPackets) {
+        // Compressed from mStripBuffer, otherwise removed in place
+        uint8_t *pStripped = mCompression ? mStripBuffer.data() : pDst;
+        size_t lStripCapacity = mCompression ? mStripBuffer.size() : lDstCapacity;
+        size_t lNullPackets = 0;
+        size_t lStrippedSize = RISTNetNullPackets::strip(pData, lSize, pStripped, lStripCapacity, lNullPackets);
+        if (!lStrippedSize) {
+            LOGGER(true, LOGG_ERROR, "Null packet trailer does not fit, " << lSize << " bytes.")
+            return false;
+        }
+        mNullPacketsRemoved += lNullPackets;
+        mNullTrailerBytes += lStrippedSize + lNullPackets * RISTNetTSAnalyzer::kPacketSize - lSize;
+        pData = pStripped;
+        lSize = lStrippedSize;
+    }
+    if (mCompression) {
+        rPayloadSize = mCompressor.compress(pData, lSize, pDst, lDstCapacity, mCompressedFlows[lConnectionID]);
+    } else if (pData == pDst) {
+        rPayloadSize = lSize;
+    } else {
+        memcpy(pDst, pData, lSize);
+        rPayloadSize = lSize;
+    }
+    if (mLatencyProbeInterval) {
+        auto lClock = RISTNetLatencyProbe::Clock::kNone;
+        if (++mLatencyProbeCounter >= mLatencyProbeInterval) {
+            mLatencyProbeCounter = 0;
+            lClock = mLatencyProbeClock;
+        }
+        rPayloadSize += RISTNetLatencyProbe::writeTrailer(pDst + rPayloadSize, lClock);
+    }
+    return true;
+}
+
+bool RISTNetSender::writeData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, bool lDestroyOnError) {
     rist_data_block myRISTDataBlock = {nullptr};
     myRISTDataBlock.payload = pData;
     myRISTDataBlock.payload_len = lSize;
@@ -663,7 +1706,9 @@ bool RISTNetSender::sendData(const uint8_t *pData, size_t lSize, uint16_t lConne
     int lStatus = rist_sender_data_write(mRistContext, &myRISTDataBlock);
     if (lStatus < 0) {
         LOGGER(true, LOGG_ERROR, "rist_client_write failed.")
-        destroySender();
+        if (lDestroyOnError) {
+            destroySender();
+        }
         return false;
     }
 
@@ -675,6 +1720,196 @@ bool RISTNetSender::sendData(const uint8_t *pData, size_t lSize, uint16_t lConne
     return true;
 }
 
+bool RISTNetSender::writeProtected(uint8_t *pData, size_t lSize, uint16_t lConnectionID, bool lDestroyOnError) {
+    if (mFEC) {
+        uint16_t lSequence = mFECEncoder.addPacket(pData, lSize, lConnectionID);
+        RISTNetFEC::writeSequence(pData + lSize, lSequence);
+        lSize += RISTNetFEC::kSequenceTrailerSize;
+    }
+    if (mChecksum) {
+        lSize += RISTNetCRC32C::writeTrailer(pData, lSize);
+    }
+    bool lSent = writeData(pData, lSize, lConnectionID, lDestroyOnError);
+    if (!mFEC || !mRistContext) {
+        return lSent;
+    }
+    // A lost parity packet only weakens the protection, the result is the one of the data
+    for (size_t i = 0; i < mFECEncoder.readyParityCount(); i++) {
+        const uint8_t *lParity = mFECEncoder.readyParityData(i);
+        size_t lParitySize = mFECEncoder.readyParitySize(i);
+        if (mChecksum) {
+            memcpy(mParityBuffer.data(), lParity, lParitySize);
+            lParitySize += RISTNetCRC32C::writeTrailer(mParityBuffer.data(), lParitySize);
+            lParity = mParityBuffer.data();
+        }
+        if (writeData(lParity, lParitySize, mFECFlowId, false)) {
+            mParityPackets++;
+        } else {
+            mParityWriteErrors++;
+        }
+    }
+    return lSent;
+}
+
+bool RISTNetSender::queueData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID) {
+    DataBlock lBlock;
+    lBlock.mData = pData;
+    lBlock.mSize = lSize;
+    lBlock.mConnectionID = lConnectionID;
+    return queueBatch(&lBlock, 1) == 1;
+}
+
+size_t RISTNetSender::queueBatch(const DataBlock *pBlocks, size_t lCount) {
+    bool lCrossedHigh = false;
+    size_t lAccepted = 0;
+    size_t lQueued;
+    {
+        std::unique_lock<std::mutex> lLock(mSendQueueMtx);
+        for (size_t i = 0; i < lCount; i++) {
+            const DataBlock &rBlock = pBlocks[i];
+            if (mFEC && rBlock.mConnectionID == mFECFlowId) {
+                LOGGER(true, LOGG_ERROR, "The connection ID " << rBlock.mConnectionID << " is used by the FEC.")
+                continue;
+            }
+            // Checked here, the caller is not told about a payload the sender thread fails to prepare
+            if (!payloadFits(rBlock.mSize, RIST_MAX_PACKET_SIZE)) {
+                LOGGER(true, LOGG_ERROR, "Payload too large, " << rBlock.mSize << " bytes.")
+                continue;
+            }
+            if (mSendQueueCount == mSendQueue.size()) {
+                if (mSendQueuePolicy == QueuePolicy::kDropNewest) {
+                    mSendQueueStatistics.mDropped++;
+                    continue;
+                } else if (mSendQueuePolicy == QueuePolicy::kDropOldest) {
+                    mSendQueueHead = (mSendQueueHead + 1) % mSendQueue.size();
+                    mSendQueueCount--;
+                    mSendQueueStatistics.mDropped++;
+                } else {
+                    // The sender thread has not been woken for the blocks queued so far
+                    mSendQueueNotEmpty.notify_one();
+                    mSendQueueNotFull.wait(lLock, [&]() {
+                        return !mSendQueueRunning || mSendQueueCount < mSendQueue.size();
+                    });
+                }
+            }
+            if (!mSendQueueRunning) {
+                mSendQueueStatistics.mDropped += lCount - i;
+                break;
+            }
+            // Only copied under the lock, the sender thread prepares the payload
+            QueuedPacket &rSlot = mSendQueue[(mSendQueueHead + mSendQueueCount) % mSendQueue.size()];
+            memcpy(rSlot.mData.data(), rBlock.mData, rBlock.mSize);
+            rSlot.mSize = rBlock.mSize;
+            rSlot.mFlowId = rBlock.mConnectionID;
+            mSendQueueCount++;
+            lAccepted++;
+            mSendQueueStatistics.mMaxQueued = std::max(mSendQueueStatistics.mMaxQueued, mSendQueueCount);
+            if (!mAboveHighWatermark && mSendQueueCount >= mSendQueueHighWatermark) {
+                mAboveHighWatermark = true;
+                mSendQueueStatistics.mHighWatermarkEvents++;
+                lCrossedHigh = true;
+            }
+        }
+        lQueued = mSendQueueCount;
+    }
+    if (lAccepted) {
+        mSendQueueNotEmpty.notify_one();
+    }
+
+    if (lCrossedHigh) {
+        updateWritable();
+        if (sendQueueWatermarkCallback) {
+            sendQueueWatermarkCallback(true, lQueued);
+        }
+    }
+    return lAccepted;
+}
+
+void RISTNetSender::sendQueueWorker() {
+    mThreadBinder.bindCurrentThread("send");
+    // Swapped with the queue slots so the data can be written without holding the lock
+    std::vector<uint8_t> lBuffer(RIST_MAX_PACKET_SIZE);
+    while (true) {
+        size_t lSize;
+        uint16_t lFlowId;
+        size_t lQueued;
+        bool lCrossedLow = false;
+        {
+            std::unique_lock<std::mutex> lLock(mSendQueueMtx);
+            mSendQueueNotEmpty.wait(lLock, [&]() { return !mSendQueueRunning || mSendQueueCount; });
+            if (!mSendQueueRunning) {
+                break;
+            }
+            QueuedPacket &rSlot = mSendQueue[mSendQueueHead];
+            std::swap(lBuffer, rSlot.mData);
+            lSize = rSlot.mSize;
+            lFlowId = rSlot.mFlowId;
+            mSendQueueHead = (mSendQueueHead + 1) % mSendQueue.size();
+            mSendQueueCount--;
+            if (mAboveHighWatermark && mSendQueueCount <= mSendQueueLowWatermark) {
+                mAboveHighWatermark = false;
+                lCrossedLow = true;
+            }
+            lQueued = mSendQueueCount;
+        }
+        mSendQueueNotFull.notify_one();
+
+        if (lCrossedLow) {
+            updateWritable();
+            if (sendQueueWatermarkCallback) {
+                sendQueueWatermarkCallback(false, lQueued);
+            }
+        }
+
+        bool lSent;
+        if (mPreparePayload) {
+            size_t lPayloadSize = 0;
+            lSent = preparePayload(lBuffer.data(), lSize, lFlowId, mSendBuffer.data(), mSendBuffer.size(), lPayloadSize) &&
+                    writeProtected(mSendBuffer.data(), lPayloadSize, lFlowId, false);
+        } else {
+            lSent = writeData(lBuffer.data(), lSize, lFlowId, false);
+        }
+        if (!lSent) {
+            std::lock_guard<std::mutex> lLock(mSendQueueMtx);
+            mSendQueueStatistics.mWriteErrors++;
+        }
+    }
+}
+
+void RISTNetSender::stopSendQueue() {
+    {
+        std::lock_guard<std::mutex> lLock(mSendQueueMtx);
+        mSendQueueRunning = false;
+    }
+    mSendQueueNotEmpty.notify_all();
+    mSendQueueNotFull.notify_all();
+    if (mSendThread.joinable()) {
+        mSendThread.join();
+    }
+    std::lock_guard<std::mutex> lLock(mSendQueueMtx);
+    mSendQueueStatistics.mDropped += mSendQueueCount;
+    mSendQueueCount = 0;
+    mSendQueueHead = 0;
+    mAboveHighWatermark = false;
+}
+
+void RISTNetSender::getSendQueueStatistics(SendQueueStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mSendQueueMtx);
+    rStatistics = mSendQueueStatistics;
+    rStatistics.mQueued = mSendQueueCount;
+}
+
+void RISTNetSender::getNullPacketStatistics(NullPacketStatistics &rStatistics) {
+    rStatistics.mNullPackets = mNullPacketsRemoved;
+    rStatistics.mBytesSaved = rStatistics.mNullPackets * RISTNetTSAnalyzer::kPacketSize;
+    rStatistics.mTrailerBytes = mNullTrailerBytes;
+}
+
+void RISTNetSender::getFECStatistics(FECStatistics &rStatistics) {
+    rStatistics.mParityPackets = mParityPackets;
+    rStatistics.mParityWriteErrors = mParityWriteErrors;
+}
+
 bool RISTNetSender::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
     if (!mRistContext) {
         LOGGER(true, LOGG_ERROR, "RISTNetSender not initialised.")
@@ -695,6 +1930,25 @@ bool RISTNetSender::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t l
     return true;
 }
 
+RISTNetSignalAwaiter RISTNetSender::writable() {
+    return {mWritable, mExecutor.get()};
+}
+
+void RISTNetSender::updateWritable() {
+    // A listening sender drops the data until a receiver connects, a full send queue drops or blocks
+    bool lWritable;
+    {
+        std::lock_guard<std::mutex> lLock(mClientListMtx);
+        lWritable = mRistContext && (!mListenMode || !mClientListSender.empty()) && !mAboveHighWatermark;
+    }
+    // Waiting coroutines might be resumed inline, so no lock may be held here
+    mWritable.set(lWritable);
+}
+
+void RISTNetSender::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    mThreadBinder.getDiagnostics(rThreads);
+}
+
 void RISTNetSender::getVersion(uint32_t &rCppWrapper, uint32_t &rRistMajor, uint32_t &rRistMinor) {
     rCppWrapper = CPP_WRAPPER_VERSION;
     rRistMajor = LIBRIST_API_VERSION_MAJOR;
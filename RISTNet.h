@@ -15,6 +15,18 @@
 
 #include "librist.h"
 #include "version.h"
+#include "RISTNetLatency.h"
+#include "RISTNetThreads.h"
+#include "RISTNetAwait.h"
+#include "RISTNetFEC.h"
+#include "RISTNetChecksum.h"
+#include "RISTNetCompression.h"
+#include "RISTNetPeerTable.h"
+#include "RISTNetAdmission.h"
+#include "RISTNetMemory.h"
+#include "RISTNetRecovery.h"
+#include "RISTNetTSAnalyzer.h"
+#include "RISTNetNullPackets.h"
 #include <string.h>
 #include <any>
 #include <tuple>
@@ -23,8 +35,13 @@
 #include <memory>
 #include <atomic>
 #include <map>
+#include <set>
+#include <optional>
 #include <functional>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 
 #ifdef WIN32
 #include <Winsock2.h>
@@ -36,6 +53,55 @@
 
 
 
+/**
+ * \class RISTNetURL
+ *
+ * \brief
+ *
+ * The parts of a librist URL, rist[6]://[@]host:port?parameters. Parameters not set are left out of the
+ * URL and librist uses its defaults. Times are in milliseconds and bandwidths in kbit/s.
+ *
+ */
+struct RISTNetURL {
+    std::string mHost;                                  // IPv4 or IPv6 address, unicast or multicast group
+    uint16_t mPort = 0;
+    bool mListen = false;                               // Listen (@), for a multicast receiver: join the group
+
+    // Multicast
+    std::string mMulticastInterface;                    // miface, the interface joining / sending to the group
+    std::optional<uint32_t> mMulticastTTL;              // ttl, 1 - 255
+
+    // Recovery buffer
+    std::optional<uint32_t> mBuffer;                    // buffer, sets both buffer-min and buffer-max
+    std::optional<uint32_t> mBufferMin;                 // buffer-min
+    std::optional<uint32_t> mBufferMax;                 // buffer-max
+    std::optional<uint32_t> mRTTMin;                    // rtt-min
+    std::optional<uint32_t> mRTTMax;                    // rtt-max
+    std::optional<uint32_t> mReorderBuffer;             // reorder-buffer
+    std::optional<uint32_t> mMinRetries;                // min-retries
+    std::optional<uint32_t> mMaxRetries;                // max-retries
+
+    // Bandwidth and load balancing
+    std::optional<uint32_t> mBandwidth;                 // bandwidth, max bitrate of the data and retransmissions
+    std::optional<uint32_t> mReturnBandwidth;           // return-bandwidth, max bitrate of the return channel
+    std::optional<uint32_t> mCongestionControl;         // congestion-control, 0 = off, 1 = normal, 2 = aggressive
+    std::optional<uint32_t> mWeight;                    // weight, 0 duplicates the data to all peers
+
+    // Session
+    std::string mCNAME;                                 // cname
+    std::optional<uint32_t> mSessionTimeout;            // session-timeout
+    std::optional<uint32_t> mKeepAliveInterval;         // keepalive-interval
+    std::optional<uint32_t> mVirtualDestinationPort;    // virt-dst-port
+
+    // Encryption
+    std::string mSecret;                                // secret, the PSK
+    std::optional<uint32_t> mAESType;                   // aes-type, 128 or 256
+    std::optional<uint32_t> mKeyRotation;               // key-rotation, packets between key changes
+
+    /// true if mHost is a multicast group
+    bool isMulticast() const;
+};
+
 /**
  * \class RISTNetTools
  *
@@ -48,6 +114,16 @@ class RISTNetTools {
 public:
     /// Build the librist url based on name/ip, port and if it's a listen or not peer
     static bool buildRISTURL(const std::string &lIP, const std::string &lPort, std::string &rURL, bool lListen);
+
+    /// Validate the parts and build the librist url
+    static bool buildRISTURL(const RISTNetURL &rParts, std::string &rURL);
+
+    /// Parse and validate a librist url. Unknown parameters are an error
+    static bool parseRISTURL(const std::string &rURL, RISTNetURL &rParts);
+
+    /// Check the parts are valid and consistent
+    static bool validateRISTURL(const RISTNetURL &rParts);
+
 private:
 
     /// This class cannot be instantiated
@@ -119,9 +195,80 @@ public:
     int mSessionTimeout = 5000;
     int mKeepAliveInterval = 10000;
     int mMaxjitter = 0;
+    // Strip and evaluate the latency probe trailer. Must be enabled if the sender sets mLatencyProbeInterval
+    bool mLatencyProbe = false;
+    // CPU placement and scheduling of the librist threads calling the receiver
+    RISTNetThreadSettings mThreadSettings;
+    // Deliver the data to nextPacket() instead of networkDataCallback. Packets buffered, 0 = use the callback
+    size_t mReceiveQueueDepth = 0;
+    // Executor resuming the coroutines awaiting the receiver, nullptr resumes them on the librist thread
+    std::shared_ptr<RISTNetExecutor> mExecutor;
+    // Recover lost packets using the FEC parity packets. Must be enabled if the sender sets mFECColumns.
+    // A recovered packet is delivered when its parity packet arrives, after the packets following it in the
+    // matrix, a TS consumer sees it out of order
+    bool mFEC = false;
+    // The flow_id carrying the parity packets, must match the sender
+    uint16_t mFECFlowId = RISTNetFEC::kDefaultFlowId;
+    // Verify and strip the CRC32C trailer, corrupted packets are dropped. Must match the sender
+    bool mChecksum = false;
+    // Strip the compression trailer and decompress. Must be enabled if the sender sets mCompressedFlowIds
+    bool mCompression = false;
+    // Dictionary the sender compresses with, must be the same as the sender's
+    std::vector<uint8_t> mCompressionDictionary;
+    // Number of connected clients the client table is preallocated for (listen mode)
+    size_t mExpectedClients = 0;
+    // Rate limits, connection limits and caching applied before validateConnectionCallback (listen mode)
+    RISTNetAdmissionSettings mAdmission;
+    // Size recovery_length and recovery_rtt from the measured RTT and loss, see recoveryWindowCallback
+    RISTNetRecoverySettings mRecovery;
+    // Analyze the MPEG transport stream of every connection, see ConnectionStatistics::mTS
+    bool mTSAnalyzer = false;
+    // Put back the null packets removed by the sender. Must match the sender's mStripNullPackets
+    bool mNullPackets = false;
 
   };
 
+  /**
+   * \class ConnectionStatistics
+   *
+   * \brief
+   *
+   * Statistics kept by the wrapper per connected peer. All latency values are in microseconds.
+   *
+   */
+  struct ConnectionStatistics {
+    uint64_t mLatencySamples = 0;   // Number of latency probes received
+    uint64_t mLatencyMin = 0;
+    uint64_t mLatencyMax = 0;
+    uint64_t mLatencyP50 = 0;
+    uint64_t mLatencyP99 = 0;
+    uint64_t mLatencyP999 = 0;
+    uint64_t mNegativeTransits = 0; // Probes arriving 'before' they were sent (clock offset), counted as 0
+    int64_t mClockOffset = 0;       // Estimated sender to receiver clock offset: min transit - RTT/2, 0 without RTT
+    uint64_t mFECParityPackets = 0; // FEC parity packets received
+    uint64_t mFECRecovered = 0;     // Packets rebuilt from the parity packets
+    uint64_t mFECDuplicates = 0;    // Packets received after they were rebuilt, not delivered again
+    uint64_t mChecksumErrors = 0;   // Packets dropped because the CRC32C did not match
+    uint64_t mDecompressionErrors = 0; // Packets dropped because they could not be decompressed
+    uint64_t mNullPacketsRestored = 0; // Null packets put back
+    uint64_t mNullPacketErrors = 0; // Packets dropped because the null packet trailer was malformed
+    RISTNetTSStatistics mTS;        // Transport stream health, if mTSAnalyzer is enabled
+  };
+
+  /// Packet queue used by the awaitable interface
+  using PacketQueue = RISTNetPacketQueue<rist_peer, NetworkConnection>;
+
+  /// A packet returned by nextPacket(). The buffer is given back to the receiver when the Packet is destroyed
+  using Packet = PacketQueue::Packet;
+
+  /// A connection or disconnection returned by nextConnection()
+  struct ConnectionEvent {
+    rist_peer *mPeer = nullptr;
+    std::shared_ptr<NetworkConnection> mConnection;
+    bool mConnected = false;
+    explicit operator bool() const { return mPeer != nullptr; }
+  };
+
   /// Constructor
   RISTNetReceiver();
 
@@ -143,7 +290,7 @@ public:
   /**
    * @brief Map of all active connections
    *
-   * Get a map of all connected clients
+   * Get a map of all connected clients. The map is a copy, the connections are not changed by changing the map
    *
    * @param function getting the map of active clients (normally a lambda).
    */
@@ -152,8 +299,10 @@ public:
   /**
    * @brief Close a client connection
    *
-   * Closes a client connection.
+   * Closes a client connection. The client is removed from the list at once, clientDisconnectedCallback
+   * is called and the librist peer destroyed later on a separate thread.
    *
+   * @return false if the peer is not connected
    */
   bool closeClientConnection(rist_peer *);
 
@@ -179,6 +328,84 @@ public:
    */
   bool sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize);
 
+  /**
+   * @brief Await the next packet
+   *
+   * Requires mReceiveQueueDepth in the settings. Only one coroutine may await packets at a time.
+   * Usage: auto lPacket = co_await receiver.nextPacket();
+   *
+   * @return an awaitable giving a Packet, the Packet is empty if the receiver is destroyed or not queueing.
+   */
+  RISTNetPopAwaiter<PacketQueue> nextPacket();
+
+  /**
+   * @brief Await the next connection event
+   *
+   * Requires mReceiveQueueDepth in the settings. Only one coroutine may await connection events at a time.
+   *
+   * @return an awaitable giving a ConnectionEvent, the event is empty if the receiver is destroyed.
+   */
+  RISTNetPopAwaiter<RISTNetAwaitQueue<ConnectionEvent>> nextConnection();
+
+  /**
+   * @brief Packets dropped because the packet queue was full
+   */
+  uint64_t getQueueDropped();
+
+  /**
+   * @brief Get the wrapper statistics of a connection
+   *
+   * @param the peer
+   * @param the statistics
+   * @return true if the peer is connected
+   */
+  bool getConnectionStatistics(rist_peer *pPeer, ConnectionStatistics &rStatistics);
+
+  /**
+   * @brief Admission statistics
+   *
+   * @return the counters of the admission decisions
+   */
+  RISTNetAdmissionStatistics getAdmissionStatistics();
+
+  /**
+   * @brief Memory held by the receiver
+   *
+   * The recovery buffers are the estimate for every connected client, the rest is measured.
+   *
+   * @return the memory held now
+   */
+  RISTNetMemoryUsage getMemoryUsage();
+
+  /**
+   * @brief Estimate the memory a receiver needs
+   *
+   * The recovery buffers are allocated per connection, as long as recovery_length_max at recovery_maxbitrate.
+   *
+   * @param the receiver settings
+   * @param the number of connected clients
+   * @return the estimated memory
+   */
+  static RISTNetMemoryUsage estimateMemory(const RISTNetReceiverSettings &rSettings, size_t lConnections);
+
+  /**
+   * @brief Recovery window
+   *
+   * The recovery window the controller calls for when mRecovery is enabled, the configured one otherwise.
+   *
+   * @return recovery_length_min/max and recovery_rtt_min/max in ms
+   */
+  RISTNetRecoveryWindow getRecoveryWindow();
+
+  /**
+   * @brief Thread diagnostics
+   *
+   * Get the threads the thread settings have been applied to and the result.
+   *
+   * @param the list of threads
+   */
+  void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
   /**
    * @brief Destroys the receiver
    *
@@ -229,6 +456,8 @@ public:
    * You can attach any object to the NetworkConnection and the NetworkConnection object
    * will manage your objects lifecycle. Meaning it will release it when the connection
    * is terminated.
+   * With mAdmission.mValidationThreads set it is called on a worker thread, with mAdmission.mCacheTime
+   * set the object returned might be given to several connections from the same IP.
    *
    * @param function validating the connection.
    * @return a NetworkConnection object or nullptr for rejecting.
@@ -242,6 +471,19 @@ public:
   /// Callback for statistics, called once every second
   std::function<void(const rist_stats& statistics)> statisticsCallback = nullptr;
 
+  /// Callback for the wrapper statistics, called once every second for every connection (__NULLABLE)
+  std::function<void(rist_peer *pPeer, const ConnectionStatistics& statistics)> connectionStatisticsCallback = nullptr;
+
+  /**
+   * @brief Recovery window changed
+   *
+   * Called from the statistics thread when mRecovery is enabled and the measured RTT, loss and loss bursts call
+   * for another recovery window. librist can not change the window of a running peer, apply it to the peers
+   * created next. (__NULLABLE)
+   *
+   */
+  std::function<void(const RISTNetRecoveryWindow &rWindow)> recoveryWindowCallback = nullptr;
+
   // Delete copy and move constructors and assign operators
   RISTNetReceiver(RISTNetReceiver const &) = delete;             // Copy construct
   RISTNetReceiver(RISTNetReceiver &&) = delete;                  // Move construct
@@ -250,7 +492,26 @@ public:
 
 private:
 
+  // Drives the librist callbacks without a librist context, see test/RISTNetTestAccess.h
+  friend class RISTNetTestAccess;
+
+  // Wrapper state kept per connection
+  struct ConnectionState {
+    RISTNetLatencyHistogram mLatency;
+    uint64_t mNegativeTransits = 0;
+    int64_t mMinTransit = INT64_MAX;
+    std::unique_ptr<RISTNetFECDecoder> mFEC;
+    uint64_t mChecksumErrors = 0;
+    uint64_t mDecompressionErrors = 0;
+    uint64_t mNullPacketsRestored = 0;
+    uint64_t mNullPacketErrors = 0;
+    std::unique_ptr<RISTNetTSAnalyzer> mTSAnalyzer;
+    uint32_t mFlowId = 0; // The flow of the last data block
+  };
+
   std::shared_ptr<NetworkConnection> validateConnectionStub(std::string lIPAddress, uint16_t lPort);
+
+  void fillConnectionStatistics(const ConnectionState &rState, ConnectionStatistics &rStatistics) const;
   int dataFromClientStub(const uint8_t *pBuf, size_t lSize, std::shared_ptr<NetworkConnection> &rConnection);
 
   // Private method receiving the data from librist C-API
@@ -265,9 +526,41 @@ private:
   // Private method called when a client disconnects
   static int clientDisconnect(void *pArg, rist_peer *pPeer);
 
+  // Call clientDisconnectedCallback and queue the disconnection event, must be called without mClientListMtx held
+  void notifyDisconnected(rist_peer *pPeer, const std::shared_ptr<NetworkConnection> &rConnection);
+
+  // Notify and destroy peers removed from the client list, runs on mTeardown
+  void teardownPeers(std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers);
+
+  // Feed the recovery controller, called from the statistics thread
+  void updateRecovery(const rist_stats_receiver_flow &rFlow);
+
+  // Strip the latency probe, decompress, put back the null packets and hand the data to the application. rLock is held on entry and might be released
+  int deliverData(std::unique_lock<std::mutex> &rLock, const uint8_t *pData, size_t lSize, uint16_t lFlowId,
+                  rist_peer *pPeer, std::shared_ptr<NetworkConnection> &rConnection);
+
   // Private method called when a statistics are delivered
   static int gotStatistics(void *pArg, const rist_stats *stats);
 
+  // Record a latency probe, must be called with mClientListMtx held
+  void recordLatency(rist_peer *pPeer, RISTNetLatencyProbe::Clock lClock, uint64_t lTimestamp);
+
+  // Close the queues of the awaitable interface
+  void closeQueues();
+
+  // Memory accounted for the queues and for each connection
+  static size_t queueMemory(const RISTNetReceiverSettings &rSettings);
+  static size_t connectionMemory(bool lFEC, bool lTSAnalyzer);
+
+  // Number of connection events buffered for nextConnection()
+  static constexpr size_t kConnectionQueueDepth = 256;
+
+  // Free buffers kept for decompressed and restored payloads
+  static constexpr size_t kPayloadPooled = 8;
+
+  // The interval librist delivers the statistics in (ms)
+  static constexpr uint32_t kStatisticsInterval = 1000;
+
   // The context of a RIST receiver
   rist_ctx *mRistContext = nullptr;
 
@@ -277,11 +570,72 @@ private:
   // The mutex protecting the list. since the list can be accessed from both librist and the C++ layer
   std::mutex mClientListMtx;
 
+  // A connected client and its wrapper state
+  struct Client {
+    std::shared_ptr<NetworkConnection> mConnection;
+    std::unique_ptr<ConnectionState> mState;
+    size_t mReserved = 0; // Memory reserved in the budget, the recovery buffer size might change meanwhile
+  };
+
   // The list of connected clients
-  std::map<rist_peer *, std::shared_ptr<NetworkConnection>> mClientListReceiver;
+  RISTNetPeerTable<Client> mClientListReceiver;
+
+  // Handed to networkOOBDataCallback while no client is connected. Reused, unless a callback kept it
+  std::shared_ptr<NetworkConnection> mEmptyConnection = std::make_shared<NetworkConnection>();
+
+  // Latency probe trailer enabled
+  bool mLatencyProbe = false;
+
+  // FEC enabled and the flow_id of the parity packets
+  bool mFEC = false;
+  uint16_t mFECFlowId = RISTNetFEC::kDefaultFlowId;
+
+  // CRC32C trailer enabled
+  bool mChecksum = false;
+
+  // Transport stream analysis enabled
+  bool mTSAnalyzer = false;
+
+  // Null packet trailer enabled
+  bool mNullPackets = false;
+
+  // Compression trailer enabled, the decompressor and the buffers decompressed (or null packets restored) to
+  bool mCompression = false;
+  RISTNetLZ4 mDecompressor;
+  RISTNetBufferPool mPayloadPool{RIST_MAX_PACKET_SIZE, kPayloadPooled};
+
+  // The last RTT (ms) librist reported for every flow and when, used for the clock offset estimation.
+  // Protected by mClientListMtx
+  std::map<uint32_t, std::pair<uint32_t, std::chrono::steady_clock::time_point>> mFlowRTT;
+
+  // The awaitable interface
+  std::shared_ptr<PacketQueue> mPacketQueue;
+  std::shared_ptr<RISTNetAwaitQueue<ConnectionEvent>> mConnectionQueue;
+  std::shared_ptr<RISTNetExecutor> mExecutor;
 
   std::unique_ptr<rist_logging_settings, decltype(&free)> mLoggingScope{nullptr, &free};
 
+  // Applies the thread settings to the librist threads
+  RISTNetThreadBinder mThreadBinder;
+
+  // Admission control of connecting clients
+  RISTNetAdmission mAdmission;
+
+  // Peers removed from the client list and not yet destroyed, protected by mClientListMtx
+  RISTNetPeerTable<bool> mClosingPeers;
+
+  // Destroys the closed peers without holding mClientListMtx
+  RISTNetDeferredExecutor mTeardown;
+
+  // Memory reserved in the global budget. Every connection reserves a recovery buffer and its state
+  RISTNetMemoryAccount mMemory;
+  size_t mRecoveryBufferSize = 0;
+  size_t mConnectionMemory = 0;
+
+  // The adaptive recovery window, nullptr if disabled. mRecoveryMtx protects the controller
+  std::mutex mRecoveryMtx;
+  std::unique_ptr<RISTNetRecoveryController> mRecovery;
+
 };
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -317,6 +671,13 @@ public:
         std::any mObject = nullptr; //Contains your object
     };
 
+  /// What sendData does when the send queue is full
+  enum class QueuePolicy {
+    kDropNewest, // The data passed to sendData is dropped and sendData returns false
+    kDropOldest, // The oldest queued data is dropped to make room
+    kBlock       // sendData waits for room in the queue
+  };
+
   struct RISTNetSenderSettings {
       RISTNetSenderSettings() {
           mPeerConfig.version = RIST_PEER_CONFIG_VERSION;
@@ -345,8 +706,89 @@ public:
     uint32_t mSessionTimeout = 5000;
     uint32_t mKeepAliveInterval = 10000;
     int mMaxJitter = 0;
+    // Timestamp every n:th packet for latency measurement, 0 disables probing. The receiver must set mLatencyProbe
+    uint32_t mLatencyProbeInterval = 0;
+    // Clock used for the probe timestamps, use kRealtime between hosts and kMonotonic on the same host
+    RISTNetLatencyProbe::Clock mLatencyProbeClock = RISTNetLatencyProbe::Clock::kRealtime;
+    // CPU placement and scheduling of the librist threads calling the sender
+    RISTNetThreadSettings mThreadSettings;
+    // Executor resuming the coroutines awaiting the sender, nullptr resumes them on the librist thread
+    std::shared_ptr<RISTNetExecutor> mExecutor;
+    // Queue the data in sendData and write it to librist from a sender thread. Packets queued, 0 = write directly
+    size_t mSendQueueDepth = 0;
+    QueuePolicy mSendQueuePolicy = QueuePolicy::kDropNewest;
+    // sendQueueWatermarkCallback is called when the queue reaches the high and then drains to the low watermark.
+    // 0 = 3/4 and 1/4 of mSendQueueDepth
+    size_t mSendQueueHighWatermark = 0;
+    size_t mSendQueueLowWatermark = 0;
+    // Row/column XOR FEC matrix, L columns x D rows (L, D <= 20, L x D <= 100). 0 columns disables FEC.
+    // The receiver must set mFEC
+    uint8_t mFECColumns = 0;
+    uint8_t mFECRows = 0;
+    // Send row parity packets as well as column parity packets (2D FEC)
+    bool mFECRowParity = true;
+    // The flow_id carrying the parity packets, must not be used for data
+    uint16_t mFECFlowId = RISTNetFEC::kDefaultFlowId;
+    // Append a CRC32C of every payload (including the parity packets). The receiver must set mChecksum
+    bool mChecksum = false;
+    // LZ4 compress the data sent with these connection IDs (flow_id). If not empty the receiver must set mCompression
+    std::set<uint16_t> mCompressedFlowIds;
+    // Optional dictionary (up to 64 KiB of typical data) improving the compression of small payloads.
+    // The receiver must use the same dictionary
+    std::vector<uint8_t> mCompressionDictionary;
+    // LZ4 acceleration, higher is faster with less compression
+    int mCompressionAcceleration = 1;
+    // Remove the MPEG-TS null packets before sending, the receiver puts them back. The receiver must set mNullPackets
+    bool mStripNullPackets = false;
+    // Number of connected clients the client table is preallocated for (listen mode)
+    size_t mExpectedClients = 0;
+    // Rate limits, connection limits and caching applied before validateConnectionCallback (listen mode)
+    RISTNetAdmissionSettings mAdmission;
    };
 
+  /**
+   * \class SendQueueStatistics
+   *
+   * \brief
+   *
+   * Statistics of the send queue.
+   *
+   */
+  struct SendQueueStatistics {
+    size_t mQueued = 0;                 // Packets in the queue now
+    size_t mMaxQueued = 0;              // The most packets queued at any time
+    uint64_t mDropped = 0;              // Packets dropped by the queue policy or at destruction
+    uint64_t mWriteErrors = 0;          // Packets librist did not accept
+    uint64_t mHighWatermarkEvents = 0;  // Times the queue reached the high watermark
+  };
+
+  /**
+   * \class NullPacketStatistics
+   *
+   * \brief
+   *
+   * Statistics of the null packet removal. The link saves mBytesSaved - mTrailerBytes.
+   *
+   */
+  struct NullPacketStatistics {
+    uint64_t mNullPackets = 0;          // Null packets removed
+    uint64_t mBytesSaved = 0;           // Bytes of the null packets removed
+    uint64_t mTrailerBytes = 0;         // Bytes of the trailers signalling their positions
+  };
+
+  /**
+   * \class FECStatistics
+   *
+   * \brief
+   *
+   * Statistics of the parity packets sent.
+   *
+   */
+  struct FECStatistics {
+    uint64_t mParityPackets = 0;        // Parity packets written
+    uint64_t mParityWriteErrors = 0;    // Parity packets librist did not accept, the packets they cover are unprotected
+  };
+
   /// Constructor
   RISTNetSender();
 
@@ -373,7 +815,7 @@ public:
   /**
    * @brief Map of all active connections
    *
-   * Get a map of all connected clients
+   * Get a map of all connected clients. The map is a copy, the connections are not changed by changing the map
    *
    * @param function getting the map of active clients (normally a lambda).
    */
@@ -382,8 +824,10 @@ public:
   /**
    * @brief Close a client connection
    *
-   * Closes a client connection.
+   * Closes a client connection. The client is removed from the list at once, clientDisconnectedCallback
+   * is called and the librist peer destroyed later on a separate thread.
    *
+   * @return false if the peer is not connected
    */
   bool closeClientConnection(rist_peer *);
 
@@ -399,14 +843,87 @@ public:
    * @brief Send data
    *
    * Sends data to the connected peers
+   * If mSendQueueDepth is set the data is queued and written by the sender thread. Write errors
+   * are then counted in the send queue statistics and do not destroy the sender.
+   * Without the queue a write error destroys the sender. Call it from one thread at a time, several threads
+   * send through a RISTNetSendFrontEnd.
    *
    * @param pointer to the data
    * @param length of the data
    * @param a optional uint16_t value sent to the receiver
+   * @return false if the data was not sent (or queued)
    *
    */
   bool sendData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID=0);
 
+  /// Data passed to sendDataBatch
+  struct DataBlock {
+    const uint8_t *mData = nullptr;
+    size_t mSize = 0;
+    uint16_t mConnectionID = 0;
+  };
+
+  /**
+   * @brief Send a batch of data
+   *
+   * Same as sendData for each block. With mSendQueueDepth set the queue is locked once to copy the blocks in and
+   * the sender thread woken once for the whole batch.
+   *
+   * @param pointer to the blocks
+   * @param number of blocks
+   * @return the number of blocks sent (or queued)
+   *
+   */
+  size_t sendDataBatch(const DataBlock *pBlocks, size_t lCount);
+
+  /**
+   * @brief Send queue statistics
+   *
+   * @param the statistics
+   */
+  void getSendQueueStatistics(SendQueueStatistics &rStatistics);
+
+  /**
+   * @brief Null packet statistics
+   *
+   * @param the statistics, all 0 unless mStripNullPackets is set
+   */
+  void getNullPacketStatistics(NullPacketStatistics &rStatistics);
+
+  /**
+   * @brief FEC statistics
+   *
+   * @param the statistics, all 0 unless mFECColumns is set
+   */
+  void getFECStatistics(FECStatistics &rStatistics);
+
+  /**
+   * @brief Admission statistics
+   *
+   * @return the counters of the admission decisions
+   */
+  RISTNetAdmissionStatistics getAdmissionStatistics();
+
+  /**
+   * @brief Memory held by the sender
+   *
+   * The recovery buffer is the estimate, the rest is measured.
+   *
+   * @return the memory held now
+   */
+  RISTNetMemoryUsage getMemoryUsage();
+
+  /**
+   * @brief Estimate the memory a sender needs
+   *
+   * librist keeps one recovery buffer per sender, as long as recovery_length_max at recovery_maxbitrate.
+   *
+   * @param the sender settings
+   * @param the number of connected clients
+   * @return the estimated memory
+   */
+  static RISTNetMemoryUsage estimateMemory(const RISTNetSenderSettings &rSettings, size_t lConnections);
+
   /**
   * @brief Send OOB data (Currently not working in librist)
   *
@@ -420,6 +937,25 @@ public:
   */
   bool sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize);
 
+  /**
+   * @brief Thread diagnostics
+   *
+   * Get the threads the thread settings have been applied to and the result.
+   *
+   * @param the list of threads
+   */
+  void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+  /**
+   * @brief Await the sender being writable
+   *
+   * The sender is writable once initialised and, if listening, when at least one receiver is connected.
+   * Usage: if (co_await sender.writable()) { sender.sendData(...); }
+   *
+   * @return an awaitable giving true when writable and false if the sender is destroyed.
+   */
+  RISTNetSignalAwaiter writable();
+
   /**
    * @brief Destroys the sender
    *
@@ -457,6 +993,8 @@ public:
    * You can attach any object to the NetworkConnection and the NetworkConnection object
    * will manage your objects lifecycle. Meaning it will release it when the connection
    * is terminated.
+   * With mAdmission.mValidationThreads set it is called on a worker thread, with mAdmission.mCacheTime
+   * set the object returned might be given to several connections from the same IP.
    *
    * @param function validating the connection.
    * @return a NetworkConnection object or nullptr for rejecting.
@@ -470,6 +1008,14 @@ public:
   /// Callback for statistics, called once every second
   std::function<void(const rist_stats& statistics)> statisticsCallback = nullptr;
 
+  /**
+   * @brief Send queue watermark callback (__NULLABLE)
+   *
+   * Called with lHigh=true when the send queue reaches the high watermark and with lHigh=false when it
+   * has drained to the low watermark. Called from the thread calling sendData or the sender thread.
+   */
+  std::function<void(bool lHigh, size_t lQueued)> sendQueueWatermarkCallback = nullptr;
+
   // Delete copy and move constructors and assign operators
   RISTNetSender(RISTNetSender const &) = delete;             // Copy construct
   RISTNetSender(RISTNetSender &&) = delete;                  // Move construct
@@ -478,6 +1024,10 @@ public:
 
 private:
 
+  // Drives the librist callbacks and the payload preparation without a librist context, see
+  // test/RISTNetTestAccess.h
+  friend class RISTNetTestAccess;
+
   std::shared_ptr<NetworkConnection> validateConnectionStub(const std::string &ipAddress, uint16_t port);
   void dataFromClientStub(const uint8_t *pBuf, size_t lSize, std::shared_ptr<NetworkConnection> &rConnection);
 
@@ -490,9 +1040,48 @@ private:
   // Private method called when a client disconnects
   static int clientDisconnect(void *pArg, rist_peer *pPeer);
 
+  // Notify and destroy peers removed from the client list, runs on mTeardown
+  void teardownPeers(std::vector<std::pair<rist_peer *, std::shared_ptr<NetworkConnection>>> lPeers);
+
   // Private method called when statistics are delivered
   static int gotStatistics(void *pArg, const rist_stats *stats);
 
+  // Update the writable state, must be called without mClientListMtx held
+  void updateWritable();
+
+  // Set up the FEC, the trailers and the buffers they are prepared in
+  bool configurePayload(const RISTNetSenderSettings &rSettings);
+
+  // The payload with the trailers added by preparePayload and writeProtected fits lDstCapacity
+  bool payloadFits(size_t lSize, size_t lDstCapacity) const;
+
+  // Remove the null packets, compress and add the trailers to the payload. Returns false if the result does not fit lDstCapacity
+  bool preparePayload(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, uint8_t *pDst, size_t lDstCapacity,
+                      size_t &rPayloadSize);
+
+  // Write a payload to librist
+  bool writeData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, bool lDestroyOnError);
+
+  // Add the FEC sequence number and the checksum (pData must have room for them), write the payload and the
+  // completed parity packets
+  bool writeProtected(uint8_t *pData, size_t lSize, uint16_t lConnectionID, bool lDestroyOnError);
+
+  // Queue the data for the sender thread
+  bool queueData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID);
+
+  // Queue the blocks for the sender thread. Returns the number of blocks queued
+  size_t queueBatch(const DataBlock *pBlocks, size_t lCount);
+
+  // The sender thread
+  void sendQueueWorker();
+
+  // Stop the sender thread and drop the queued data
+  void stopSendQueue();
+
+  // Memory accounted for the queues and for each connection
+  static size_t queueMemory(const RISTNetSenderSettings &rSettings);
+  static size_t connectionMemory();
+
   // The context of a RIST sender
   rist_ctx *mRistContext = nullptr;
 
@@ -503,10 +1092,90 @@ private:
   std::mutex mClientListMtx;
 
   // The list of connected clients
-  std::map<rist_peer *, std::shared_ptr<NetworkConnection>> mClientListSender;
+  RISTNetPeerTable<std::shared_ptr<NetworkConnection>> mClientListSender;
+
+  // Handed to networkOOBDataCallback while no client is connected. Reused, unless a callback kept it
+  std::shared_ptr<NetworkConnection> mEmptyConnection = std::make_shared<NetworkConnection>();
+
+  // The awaitable interface
+  RISTNetAwaitSignal mWritable;
+  std::shared_ptr<RISTNetExecutor> mExecutor;
+
+  // At least one of the peers is listening for receivers
+  bool mListenMode = false;
+
+  // Latency probe settings
+  uint32_t mLatencyProbeInterval = 0;
+  RISTNetLatencyProbe::Clock mLatencyProbeClock = RISTNetLatencyProbe::Clock::kRealtime;
+  uint32_t mLatencyProbeCounter = 0;
+
+  // FEC settings and state, used by the thread writing to librist
+  bool mFEC = false;
+  uint16_t mFECFlowId = RISTNetFEC::kDefaultFlowId;
+  RISTNetFECEncoder mFECEncoder;
+  std::atomic<uint64_t> mParityPackets{0};
+  std::atomic<uint64_t> mParityWriteErrors{0};
+
+  // CRC32C trailer enabled, and the buffer the parity packets are copied to for the trailer
+  bool mChecksum = false;
+  std::vector<uint8_t> mParityBuffer;
+
+  // Compression enabled and the flows compressed, indexed by the connection ID
+  bool mCompression = false;
+  std::vector<bool> mCompressedFlows;
+  RISTNetLZ4 mCompressor;
+
+  // Null packet removal enabled, the buffer the packets are removed in before compression and the counters
+  bool mStripNullPackets = false;
+  std::vector<uint8_t> mStripBuffer;
+  std::atomic<uint64_t> mNullPacketsRemoved{0};
+  std::atomic<uint64_t> mNullTrailerBytes{0};
+
+  // Any trailer is used, the payload is prepared in a buffer before it is written
+  bool mPreparePayload = false;
+
+  // Scratch buffer used when the payload is extended with trailers, by the sender thread in queued mode
+  std::vector<uint8_t> mSendBuffer;
+
+  // The send queue
+  struct QueuedPacket {
+    std::vector<uint8_t> mData;
+    size_t mSize = 0;
+    uint16_t mFlowId = 0;
+  };
+  std::mutex mSendQueueMtx;
+  std::condition_variable mSendQueueNotEmpty;
+  std::condition_variable mSendQueueNotFull;
+  std::vector<QueuedPacket> mSendQueue;
+  size_t mSendQueueHead = 0;
+  size_t mSendQueueCount = 0;
+  bool mSendQueueRunning = false;
+  QueuePolicy mSendQueuePolicy = QueuePolicy::kDropNewest;
+  size_t mSendQueueHighWatermark = 0;
+  size_t mSendQueueLowWatermark = 0;
+  std::atomic<bool> mAboveHighWatermark{false};
+  SendQueueStatistics mSendQueueStatistics;
+  std::thread mSendThread;
 
   std::unique_ptr<rist_logging_settings, decltype(&free)> mLoggingScope{nullptr, &free};
 
+  // Applies the thread settings to the librist threads
+  RISTNetThreadBinder mThreadBinder;
+
+  // Admission control of connecting clients
+  RISTNetAdmission mAdmission;
+
+  // Peers removed from the client list and not yet destroyed, protected by mClientListMtx
+  RISTNetPeerTable<bool> mClosingPeers;
+
+  // Destroys the closed peers without holding mClientListMtx
+  RISTNetDeferredExecutor mTeardown;
+
+  // Memory reserved in the global budget. The recovery buffer is shared by the peers
+  RISTNetMemoryAccount mMemory;
+  size_t mRecoveryBufferSize = 0;
+  size_t mConnectionMemory = 0;
+
 };
 
 #endif //CPPRISTWRAPPER__RISTNET_H
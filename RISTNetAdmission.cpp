@@ -0,0 +1,208 @@
+//
+// Connection admission control used by the RIST C++ wrapper.
+//
+
+#include "RISTNetAdmission.h"
+#include "RISTNetInternal.h"
+
+#include <algorithm>
+
+RISTNetAdmission::~RISTNetAdmission() {
+    stop();
+}
+
+bool RISTNetAdmission::configure(const RISTNetAdmissionSettings &rSettings, Validator pValidator) {
+    stop();
+    if (rSettings.mValidationThreads && !rSettings.mCacheTime) {
+        LOGGER(true, LOGG_ERROR, "Admission validation threads require mCacheTime.")
+        return false;
+    }
+    if (rSettings.mConnectRate < 0) {
+        LOGGER(true, LOGG_ERROR, "Admission connect rate not valid.")
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mSettings = rSettings;
+    mSettings.mConnectBurst = std::max<uint32_t>(mSettings.mConnectBurst, 1);
+    mEnabled = !rSettings.isDefault();
+    mValidator = std::move(pValidator);
+    mStatistics = RISTNetAdmissionStatistics();
+    for (uint32_t i = 0; i < mSettings.mValidationThreads; i++) {
+        mThreads.emplace_back(&RISTNetAdmission::validationWorker, this);
+    }
+    return true;
+}
+
+void RISTNetAdmission::stop() {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStopping = true;
+    }
+    mQueueCondition.notify_all();
+    for (auto &rThread: mThreads) {
+        rThread.join();
+    }
+    mThreads.clear();
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mStopping = false;
+    mEnabled = false;
+    mQueue.clear();
+    mSources.clear();
+    mPeers.clear();
+}
+
+RISTNetAdmission::Decision RISTNetAdmission::admit(const std::string &rIP, uint16_t lPort,
+                                                   std::shared_ptr<void> &rObject) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    auto lNow = Clock::now();
+    if (mSources.size() >= mSettings.mMaxTrackedIPs) {
+        forgetIdleSources(lNow);
+    }
+    auto lSource = mSources.try_emplace(rIP);
+    SourceState &rState = lSource.first->second;
+    if (lSource.second) {
+        rState.mTokens = mSettings.mConnectBurst;
+        rState.mRefilled = lNow;
+    }
+
+    if (mSettings.mConnectRate > 0) {
+        double lElapsed = std::chrono::duration<double>(lNow - rState.mRefilled).count();
+        rState.mTokens = std::min<double>(mSettings.mConnectBurst, rState.mTokens + lElapsed * mSettings.mConnectRate);
+        rState.mRefilled = lNow;
+        if (rState.mTokens < 1) {
+            mStatistics.mRejectedRate++;
+            return Decision::kReject;
+        }
+        rState.mTokens -= 1;
+    }
+
+    if ((mSettings.mMaxConnectionsPerIP && rState.mConnections >= mSettings.mMaxConnectionsPerIP) ||
+        (mSettings.mMaxConnections && mPeers.size() >= mSettings.mMaxConnections)) {
+        mStatistics.mRejectedLimit++;
+        return Decision::kReject;
+    }
+
+    if (rState.mCached) {
+        if (lNow < rState.mCacheExpires) {
+            mStatistics.mCacheHits++;
+            if (rState.mCachedObject) {
+                rObject = rState.mCachedObject;
+                return Decision::kAccept;
+            }
+            mStatistics.mRejectedCached++;
+            return Decision::kReject;
+        }
+        rState.mCached = false;
+        rState.mCachedObject.reset();
+    }
+
+    if (!mThreads.empty()) {
+        if (!rState.mValidating) {
+            rState.mValidating = true;
+            mQueue.emplace_back(rIP, lPort);
+            mQueueCondition.notify_one();
+        }
+        mStatistics.mDeferred++;
+        return Decision::kReject;
+    }
+    return Decision::kValidate;
+}
+
+void RISTNetAdmission::validated(const std::string &rIP, const std::shared_ptr<void> &rObject) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    if (!rObject) {
+        mStatistics.mRejectedValidator++;
+    }
+    auto lSource = mSources.find(rIP);
+    if (lSource != mSources.end()) {
+        storeResult(lSource->second, rObject, Clock::now());
+    }
+}
+
+void RISTNetAdmission::connected(rist_peer *pPeer, const std::string &rIP) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    auto lSource = mSources.try_emplace(rIP);
+    if (lSource.second) {
+        lSource.first->second.mTokens = mSettings.mConnectBurst;
+        lSource.first->second.mRefilled = Clock::now();
+    }
+    lSource.first->second.mConnections++;
+    mPeers[pPeer] = rIP;
+    mStatistics.mAccepted++;
+}
+
+void RISTNetAdmission::disconnected(rist_peer *pPeer) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    std::string *pIP = mPeers.find(pPeer);
+    if (!pIP) {
+        return;
+    }
+    auto lSource = mSources.find(*pIP);
+    if (lSource != mSources.end() && lSource->second.mConnections) {
+        lSource->second.mConnections--;
+    }
+    mPeers.erase(pPeer);
+}
+
+void RISTNetAdmission::disconnectedAll() {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    for (auto &rSource: mSources) {
+        rSource.second.mConnections = 0;
+    }
+    mPeers.clear();
+}
+
+RISTNetAdmissionStatistics RISTNetAdmission::statistics() {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    RISTNetAdmissionStatistics lStatistics = mStatistics;
+    lStatistics.mConnections = mPeers.size();
+    return lStatistics;
+}
+
+void RISTNetAdmission::validationWorker() {
+    std::unique_lock<std::mutex> lLock(mMtx);
+    while (true) {
+        mQueueCondition.wait(lLock, [this] { return mStopping || !mQueue.empty(); });
+        if (mStopping) {
+            return;
+        }
+        auto lRequest = std::move(mQueue.front());
+        mQueue.pop_front();
+        lLock.unlock();
+        auto lObject = mValidator(lRequest.first, lRequest.second);
+        lLock.lock();
+        if (!lObject) {
+            mStatistics.mRejectedValidator++;
+        }
+        auto lSource = mSources.find(lRequest.first);
+        if (lSource != mSources.end()) {
+            lSource->second.mValidating = false;
+            storeResult(lSource->second, lObject, Clock::now());
+        }
+    }
+}
+
+void RISTNetAdmission::storeResult(SourceState &rState, const std::shared_ptr<void> &rObject,
+                                   Clock::time_point lNow) {
+    if (!mSettings.mCacheTime) {
+        return;
+    }
+    rState.mCached = true;
+    rState.mCacheExpires = lNow + std::chrono::milliseconds(mSettings.mCacheTime);
+    rState.mCachedObject = rObject;
+}
+
+void RISTNetAdmission::forgetIdleSources(Clock::time_point lNow) {
+    for (auto lSource = mSources.begin(); lSource != mSources.end();) {
+        SourceState &rState = lSource->second;
+        double lElapsed = std::chrono::duration<double>(lNow - rState.mRefilled).count();
+        bool lBucketFull = mSettings.mConnectRate <= 0 ||
+                           rState.mTokens + lElapsed * mSettings.mConnectRate >= mSettings.mConnectBurst;
+        bool lCached = rState.mCached && lNow < rState.mCacheExpires;
+        if (!rState.mConnections && !rState.mValidating && !lCached && lBucketFull) {
+            lSource = mSources.erase(lSource);
+        } else {
+            ++lSource;
+        }
+    }
+}
@@ -0,0 +1,154 @@
+//
+// Connection admission control used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETADMISSION_H
+#define CPPRISTWRAPPER__RISTNETADMISSION_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "RISTNetPeerTable.h"
+
+/**
+ * \class RISTNetAdmissionSettings
+ *
+ * \brief
+ *
+ * Limits applied to connecting clients before validateConnectionCallback is called.
+ * The default values disable admission control.
+ *
+ */
+struct RISTNetAdmissionSettings {
+    double mConnectRate = 0;              // Connection attempts per second per source IP, 0 = unlimited
+    uint32_t mConnectBurst = 1;           // Connection attempts a source IP may make at once
+    uint32_t mMaxConnectionsPerIP = 0;    // Connected clients per source IP, 0 = unlimited
+    uint32_t mMaxConnections = 0;         // Connected clients in total, 0 = unlimited
+    uint32_t mCacheTime = 0;              // Remember the validation result of a source IP (ms), 0 = not cached
+    // Validate on this many worker threads instead of the librist thread. A client that is not in the cache
+    // is rejected while being validated and admitted from the cache when it reconnects. Requires mCacheTime
+    uint32_t mValidationThreads = 0;
+    size_t mMaxTrackedIPs = 65536;        // Idle source IPs are forgotten when more are tracked
+
+    bool isDefault() const {
+        return mConnectRate == 0 && mMaxConnectionsPerIP == 0 && mMaxConnections == 0 && mCacheTime == 0 &&
+               mValidationThreads == 0;
+    }
+};
+
+/**
+ * \class RISTNetAdmissionStatistics
+ *
+ * \brief
+ *
+ * Counters of the admission decisions.
+ *
+ */
+struct RISTNetAdmissionStatistics {
+    uint64_t mAccepted = 0;           // Connections admitted (validated or from the cache)
+    uint64_t mCacheHits = 0;          // Decisions taken from the cache
+    uint64_t mRejectedRate = 0;       // Rejected by the connection rate limit
+    uint64_t mRejectedLimit = 0;      // Rejected by mMaxConnectionsPerIP or mMaxConnections
+    uint64_t mRejectedCached = 0;     // Rejected because the validator rejected the IP recently
+    uint64_t mRejectedValidator = 0;  // Rejected by the validator
+    uint64_t mDeferred = 0;           // Rejected while validating on a worker thread
+    size_t mConnections = 0;          // Clients connected now
+};
+
+/**
+ * \class RISTNetAdmission
+ *
+ * \brief
+ *
+ * Per source IP token buckets, connection limits and a cache of validation results, evaluated in O(1)
+ * before the (possibly slow) validator is called. With validation threads the validator never runs on
+ * the librist thread.
+ *
+ * The validated objects are handled as std::shared_ptr<void>, the owner casts them back.
+ *
+ */
+class RISTNetAdmission {
+public:
+    using Validator = std::function<std::shared_ptr<void>(const std::string &rIP, uint16_t lPort)>;
+
+    enum class Decision {
+        kAccept,   // Admitted, rObject is the cached object
+        kReject,
+        kValidate  // Call the validator and report the result with validated()
+    };
+
+    ~RISTNetAdmission();
+
+    /// Apply the settings and start the validation threads. pValidator is called by the threads
+    bool configure(const RISTNetAdmissionSettings &rSettings, Validator pValidator);
+
+    /// Stop the validation threads and forget all state
+    void stop();
+
+    bool enabled() const { return mEnabled; }
+
+    /// Decide about a connecting client
+    Decision admit(const std::string &rIP, uint16_t lPort, std::shared_ptr<void> &rObject);
+
+    /// Report the result of a kValidate decision, nullptr if rejected
+    void validated(const std::string &rIP, const std::shared_ptr<void> &rObject);
+
+    /// Track an admitted client for the connection limits
+    void connected(rist_peer *pPeer, const std::string &rIP);
+
+    /// Forget a client. Unknown peers are ignored
+    void disconnected(rist_peer *pPeer);
+
+    /// Forget all clients
+    void disconnectedAll();
+
+    RISTNetAdmissionStatistics statistics();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct SourceState {
+        double mTokens = 0;
+        Clock::time_point mRefilled;
+        uint32_t mConnections = 0;
+        bool mValidating = false;
+        bool mCached = false;
+        Clock::time_point mCacheExpires;
+        std::shared_ptr<void> mCachedObject;
+    };
+
+    void validationWorker();
+    void storeResult(SourceState &rState, const std::shared_ptr<void> &rObject, Clock::time_point lNow);
+    void forgetIdleSources(Clock::time_point lNow);
+
+    std::mutex mMtx;
+    RISTNetAdmissionSettings mSettings;
+    bool mEnabled = false;
+    Validator mValidator;
+    std::unordered_map<std::string, SourceState> mSources;
+    RISTNetPeerTable<std::string> mPeers;
+    RISTNetAdmissionStatistics mStatistics;
+
+    // Validation queue (IP, port) and the threads serving it
+    std::condition_variable mQueueCondition;
+    std::deque<std::pair<std::string, uint16_t>> mQueue;
+    std::vector<std::thread> mThreads;
+    bool mStopping = false;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETADMISSION_H
@@ -0,0 +1,58 @@
+//
+// Awaitable building blocks used by the RIST C++ wrapper.
+//
+
+#include "RISTNetAwait.h"
+
+void RISTNetExecutor::post(void *pHandle, ResumeFunction pResume) {
+    bool lWasEmpty;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        lWasEmpty = mReady.empty();
+        mReady.push_back({pHandle, pResume});
+    }
+    // Only the first coroutine of a batch needs to wake the executor
+    if (lWasEmpty) {
+        mCondition.notify_one();
+    }
+}
+
+size_t RISTNetExecutor::poll() {
+    std::vector<Ready> lBatch;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        std::swap(lBatch, mReady);
+    }
+    for (auto &rReady: lBatch) {
+        rReady.mResume(rReady.mHandle);
+    }
+    return lBatch.size();
+}
+
+void RISTNetExecutor::run() {
+    std::vector<Ready> lBatch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lLock(mMtx);
+            mCondition.wait(lLock, [&]() { return mStop || !mReady.empty(); });
+            if (mStop) {
+                mStop = false;
+                return;
+            }
+            // Keep the capacity of both vectors, the batch is handed back to the producers
+            std::swap(lBatch, mReady);
+        }
+        for (auto &rReady: lBatch) {
+            rReady.mResume(rReady.mHandle);
+        }
+        lBatch.clear();
+    }
+}
+
+void RISTNetExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStop = true;
+    }
+    mCondition.notify_all();
+}
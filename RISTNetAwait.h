@@ -0,0 +1,476 @@
+//
+// Awaitable building blocks used by the RIST C++ wrapper.
+//
+// The library itself is built as C++17. The awaiter types only need a coroutine handle in
+// await_suspend, which is a template, so co_await can be used from any C++20 translation unit.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETAWAIT_H
+#define CPPRISTWRAPPER__RISTNETAWAIT_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+/**
+ * \class RISTNetExecutor
+ *
+ * \brief
+ *
+ * A minimal executor resuming suspended coroutines on the thread(s) calling run() or poll().
+ * Coroutines made ready by the librist threads are collected and resumed in batches,
+ * so one executor thread can serve many channels.
+ *
+ */
+class RISTNetExecutor {
+public:
+    using ResumeFunction = void (*)(void *pHandle);
+
+    /// Queue a coroutine for resumption, thread safe
+    void post(void *pHandle, ResumeFunction pResume);
+
+    /// Resume all coroutines ready now, returns the number resumed
+    size_t poll();
+
+    /// Resume coroutines as they get ready until stop() is called
+    void run();
+
+    /// Make run() return
+    void stop();
+
+private:
+    struct Ready {
+        void *mHandle;
+        ResumeFunction mResume;
+    };
+    std::mutex mMtx;
+    std::condition_variable mCondition;
+    std::vector<Ready> mReady;
+    bool mStop = false;
+};
+
+/**
+ * \class RISTNetWaiter
+ *
+ * \brief
+ *
+ * A suspended coroutine and where to resume it. Without executor the coroutine is resumed on the
+ * thread making it ready, normally a librist thread.
+ *
+ */
+struct RISTNetWaiter {
+    void *mHandle = nullptr;
+    RISTNetExecutor::ResumeFunction mResume = nullptr;
+    RISTNetExecutor *mExecutor = nullptr;
+
+    template<typename Handle>
+    static RISTNetWaiter make(Handle lHandle, RISTNetExecutor *pExecutor) {
+        RISTNetWaiter lWaiter;
+        lWaiter.mHandle = lHandle.address();
+        lWaiter.mResume = [](void *pHandle) { Handle::from_address(pHandle).resume(); };
+        lWaiter.mExecutor = pExecutor;
+        return lWaiter;
+    }
+
+    explicit operator bool() const { return mHandle != nullptr; }
+
+    void resume() const {
+        if (mExecutor) {
+            mExecutor->post(mHandle, mResume);
+        } else {
+            mResume(mHandle);
+        }
+    }
+};
+
+/**
+ * \class RISTNetAwaitQueue
+ *
+ * \brief
+ *
+ * A bounded single consumer queue of T. push() never blocks, it fails when the queue is full.
+ *
+ */
+template<typename T>
+class RISTNetAwaitQueue {
+public:
+    using Item = T;
+
+    explicit RISTNetAwaitQueue(size_t lCapacity) : mItems(lCapacity ? lCapacity : 1) {}
+
+    bool push(T &&rItem) {
+        RISTNetWaiter lWaiter;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            if (mClosed || mCount == mItems.size()) {
+                return false;
+            }
+            mItems[(mHead + mCount) % mItems.size()] = std::move(rItem);
+            mCount++;
+            std::swap(lWaiter, mWaiter);
+        }
+        if (lWaiter) {
+            lWaiter.resume();
+        }
+        return true;
+    }
+
+    bool tryPop(T &rItem) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        return popLocked(rItem);
+    }
+
+    /// Register the waiter unless an item is available. Returns false if the coroutine should not suspend.
+    bool suspend(T &rItem, const RISTNetWaiter &rWaiter) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (popLocked(rItem) || mClosed) {
+            return false;
+        }
+        mWaiter = rWaiter;
+        return true;
+    }
+
+    /// Reject new items and resume the waiting consumer
+    void close() {
+        RISTNetWaiter lWaiter;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            mClosed = true;
+            std::swap(lWaiter, mWaiter);
+        }
+        if (lWaiter) {
+            lWaiter.resume();
+        }
+    }
+
+private:
+    bool popLocked(T &rItem) {
+        if (!mCount) {
+            return false;
+        }
+        rItem = std::move(mItems[mHead]);
+        mItems[mHead] = T();
+        mHead = (mHead + 1) % mItems.size();
+        mCount--;
+        return true;
+    }
+
+    std::mutex mMtx;
+    std::vector<T> mItems;
+    size_t mHead = 0;
+    size_t mCount = 0;
+    bool mClosed = false;
+    RISTNetWaiter mWaiter;
+};
+
+/**
+ * \class RISTNetPacketQueue
+ *
+ * \brief
+ *
+ * A bounded single consumer queue of received packets backed by a fixed pool of buffers.
+ * A buffer is returned to the pool when the consumer drops the Packet, so packets held by the
+ * consumer count against the capacity. No memory is allocated after construction.
+ *
+ */
+template<typename Peer, typename Connection>
+class RISTNetPacketQueue : public std::enable_shared_from_this<RISTNetPacketQueue<Peer, Connection>> {
+public:
+    class Packet {
+    public:
+        Packet() = default;
+        Packet(Packet &&rOther) noexcept { *this = std::move(rOther); }
+        Packet &operator=(Packet &&rOther) noexcept {
+            if (this != &rOther) {
+                release();
+                mQueue = std::move(rOther.mQueue);
+                mIndex = rOther.mIndex;
+                mSize = rOther.mSize;
+                mFlowId = rOther.mFlowId;
+                mPeer = rOther.mPeer;
+                mConnection = std::move(rOther.mConnection);
+            }
+            return *this;
+        }
+        Packet(const Packet &) = delete;
+        Packet &operator=(const Packet &) = delete;
+        ~Packet() { release(); }
+
+        /// false if the receiver was destroyed while waiting
+        explicit operator bool() const { return mQueue != nullptr; }
+        const uint8_t *data() const { return mQueue->mBuffers[mIndex].data(); }
+        size_t size() const { return mSize; }
+        uint16_t flowId() const { return mFlowId; }
+        Peer *peer() const { return mPeer; }
+        std::shared_ptr<Connection> &connection() { return mConnection; }
+
+    private:
+        friend class RISTNetPacketQueue;
+        void release() {
+            if (mQueue) {
+                mQueue->releaseBuffer(mIndex);
+                mQueue.reset();
+                mConnection.reset();
+            }
+        }
+        std::shared_ptr<RISTNetPacketQueue> mQueue;
+        uint32_t mIndex = 0;
+        size_t mSize = 0;
+        uint16_t mFlowId = 0;
+        Peer *mPeer = nullptr;
+        std::shared_ptr<Connection> mConnection;
+    };
+
+    using Item = Packet;
+
+    RISTNetPacketQueue(size_t lCapacity, size_t lMaxPacketSize) :
+            mBuffers(lCapacity ? lCapacity : 1), mEntries(mBuffers.size()) {
+        mFree.reserve(mBuffers.size());
+        for (uint32_t i = 0; i < mBuffers.size(); i++) {
+            mBuffers[i].resize(lMaxPacketSize);
+            mFree.push_back(i);
+        }
+        mMaxPacketSize = lMaxPacketSize;
+    }
+
+    /// Copy a packet into the queue. Fails (the packet is dropped) when all buffers are in use.
+    bool push(const uint8_t *pData, size_t lSize, uint16_t lFlowId, Peer *pPeer,
+              const std::shared_ptr<Connection> &rConnection) {
+        RISTNetWaiter lWaiter;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            if (mClosed || mFree.empty() || lSize > mMaxPacketSize) {
+                mDropped++;
+                return false;
+            }
+            uint32_t lIndex = mFree.back();
+            mFree.pop_back();
+            std::memcpy(mBuffers[lIndex].data(), pData, lSize);
+            Entry &rEntry = mEntries[(mHead + mCount) % mEntries.size()];
+            rEntry.mIndex = lIndex;
+            rEntry.mSize = lSize;
+            rEntry.mFlowId = lFlowId;
+            rEntry.mPeer = pPeer;
+            rEntry.mConnection = rConnection;
+            mCount++;
+            std::swap(lWaiter, mWaiter);
+        }
+        if (lWaiter) {
+            lWaiter.resume();
+        }
+        return true;
+    }
+
+    bool tryPop(Packet &rPacket) {
+        // Releasing gives the buffer back under the lock
+        rPacket.release();
+        std::lock_guard<std::mutex> lLock(mMtx);
+        return popLocked(rPacket);
+    }
+
+    bool suspend(Packet &rPacket, const RISTNetWaiter &rWaiter) {
+        rPacket.release();
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (popLocked(rPacket) || mClosed) {
+            return false;
+        }
+        mWaiter = rWaiter;
+        return true;
+    }
+
+    void close() {
+        RISTNetWaiter lWaiter;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            mClosed = true;
+            std::swap(lWaiter, mWaiter);
+        }
+        if (lWaiter) {
+            lWaiter.resume();
+        }
+    }
+
+    /// Packets dropped since the queue was full
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        return mDropped;
+    }
+
+    /// Bytes held by the packet buffers, allocated by the constructor
+    size_t memoryUsage() const {
+        return mBuffers.size() * (mMaxPacketSize + sizeof(std::vector<uint8_t>) + sizeof(uint32_t) + sizeof(Entry));
+    }
+
+private:
+    struct Entry {
+        uint32_t mIndex = 0;
+        size_t mSize = 0;
+        uint16_t mFlowId = 0;
+        Peer *mPeer = nullptr;
+        std::shared_ptr<Connection> mConnection;
+    };
+
+    bool popLocked(Packet &rPacket) {
+        if (!mCount) {
+            return false;
+        }
+        Entry &rEntry = mEntries[mHead];
+        rPacket.mQueue = this->shared_from_this();
+        rPacket.mIndex = rEntry.mIndex;
+        rPacket.mSize = rEntry.mSize;
+        rPacket.mFlowId = rEntry.mFlowId;
+        rPacket.mPeer = rEntry.mPeer;
+        rPacket.mConnection = std::move(rEntry.mConnection);
+        mHead = (mHead + 1) % mEntries.size();
+        mCount--;
+        return true;
+    }
+
+    void releaseBuffer(uint32_t lIndex) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mFree.push_back(lIndex);
+    }
+
+    std::mutex mMtx;
+    std::vector<std::vector<uint8_t>> mBuffers;
+    std::vector<uint32_t> mFree;
+    std::vector<Entry> mEntries;
+    size_t mHead = 0;
+    size_t mCount = 0;
+    size_t mMaxPacketSize = 0;
+    uint64_t mDropped = 0;
+    bool mClosed = false;
+    RISTNetWaiter mWaiter;
+};
+
+/**
+ * \class RISTNetPopAwaiter
+ *
+ * \brief
+ *
+ * co_await yields the next item of a RISTNetAwaitQueue or RISTNetPacketQueue.
+ * A default constructed (empty) item is returned if the queue is closed.
+ *
+ */
+template<typename Queue>
+class RISTNetPopAwaiter {
+public:
+    RISTNetPopAwaiter(std::shared_ptr<Queue> lQueue, RISTNetExecutor *pExecutor) :
+            mQueue(std::move(lQueue)), mExecutor(pExecutor) {}
+
+    bool await_ready() { return !mQueue || mQueue->tryPop(mItem); }
+
+    template<typename Handle>
+    bool await_suspend(Handle lHandle) {
+        return mQueue->suspend(mItem, RISTNetWaiter::make(lHandle, mExecutor));
+    }
+
+    typename Queue::Item await_resume() {
+        if (mQueue && !mItem) {
+            mQueue->tryPop(mItem);
+        }
+        return std::move(mItem);
+    }
+
+private:
+    std::shared_ptr<Queue> mQueue;
+    RISTNetExecutor *mExecutor;
+    typename Queue::Item mItem;
+};
+
+/**
+ * \class RISTNetAwaitSignal
+ *
+ * \brief
+ *
+ * A level triggered state. Coroutines awaiting it are resumed when the state becomes true
+ * or when the signal is closed.
+ *
+ */
+class RISTNetAwaitSignal {
+public:
+    void set(bool lState) {
+        std::vector<RISTNetWaiter> lWaiters;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            mState = lState;
+            if (lState) {
+                std::swap(lWaiters, mWaiters);
+            }
+        }
+        for (auto &rWaiter: lWaiters) {
+            rWaiter.resume();
+        }
+    }
+
+    void close() {
+        std::vector<RISTNetWaiter> lWaiters;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            mState = false;
+            std::swap(lWaiters, mWaiters);
+        }
+        for (auto &rWaiter: lWaiters) {
+            rWaiter.resume();
+        }
+    }
+
+    bool state() {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        return mState;
+    }
+
+    /// Register the waiter unless the state is true. Returns false if the coroutine should not suspend.
+    bool suspend(const RISTNetWaiter &rWaiter) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (mState) {
+            return false;
+        }
+        mWaiters.push_back(rWaiter);
+        return true;
+    }
+
+private:
+    std::mutex mMtx;
+    bool mState = false;
+    std::vector<RISTNetWaiter> mWaiters;
+};
+
+/**
+ * \class RISTNetSignalAwaiter
+ *
+ * \brief
+ *
+ * co_await yields the state of a RISTNetAwaitSignal once it is true or closed.
+ *
+ */
+class RISTNetSignalAwaiter {
+public:
+    RISTNetSignalAwaiter(RISTNetAwaitSignal &rSignal, RISTNetExecutor *pExecutor) :
+            mSignal(rSignal), mExecutor(pExecutor) {}
+
+    bool await_ready() { return mSignal.state(); }
+
+    template<typename Handle>
+    bool await_suspend(Handle lHandle) {
+        return mSignal.suspend(RISTNetWaiter::make(lHandle, mExecutor));
+    }
+
+    bool await_resume() { return mSignal.state(); }
+
+private:
+    RISTNetAwaitSignal &mSignal;
+    RISTNetExecutor *mExecutor;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETAWAIT_H
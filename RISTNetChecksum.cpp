@@ -0,0 +1,195 @@
+//
+// Payload integrity checksums used by the RIST C++ wrapper.
+//
+
+#include "RISTNetChecksum.h"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RISTNET_CRC_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define RISTNET_CRC_ARMV8 1
+#include <arm_acle.h>
+#endif
+
+namespace {
+    constexpr uint32_t kPolynomial = 0x82F63B78; // Reflected Castagnoli polynomial
+
+    struct SlicingTables {
+        uint32_t mTable[8][256] = {};
+
+        constexpr SlicingTables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t lCRC = i;
+                for (int j = 0; j < 8; j++) {
+                    lCRC = (lCRC >> 1) ^ (lCRC & 1 ? kPolynomial : 0);
+                }
+                mTable[0][i] = lCRC;
+            }
+            for (uint32_t i = 0; i < 256; i++) {
+                for (int j = 1; j < 8; j++) {
+                    mTable[j][i] = (mTable[j - 1][i] >> 8) ^ mTable[0][mTable[j - 1][i] & 0xff];
+                }
+            }
+        }
+    };
+
+    constexpr SlicingTables kTables;
+
+    uint32_t crcSoftware(uint32_t lCRC, const uint8_t *pData, size_t lSize) {
+        auto &rT = kTables.mTable;
+        while (lSize >= 8) {
+            uint32_t lLow;
+            uint32_t lHigh;
+            memcpy(&lLow, pData, 4);
+            memcpy(&lHigh, pData + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            lLow = __builtin_bswap32(lLow);
+            lHigh = __builtin_bswap32(lHigh);
+#endif
+            lLow ^= lCRC;
+            lCRC = rT[7][lLow & 0xff] ^ rT[6][(lLow >> 8) & 0xff] ^ rT[5][(lLow >> 16) & 0xff] ^ rT[4][lLow >> 24] ^
+                   rT[3][lHigh & 0xff] ^ rT[2][(lHigh >> 8) & 0xff] ^ rT[1][(lHigh >> 16) & 0xff] ^ rT[0][lHigh >> 24];
+            pData += 8;
+            lSize -= 8;
+        }
+        while (lSize--) {
+            lCRC = (lCRC >> 8) ^ rT[0][(lCRC ^ *pData++) & 0xff];
+        }
+        return lCRC;
+    }
+
+#ifdef RISTNET_CRC_SSE42
+    __attribute__((target("sse4.2")))
+    uint32_t crcSSE42(uint32_t lCRC, const uint8_t *pData, size_t lSize) {
+#if defined(__x86_64__)
+        uint64_t lCRC64 = lCRC;
+        while (lSize >= 8) {
+            uint64_t lWord;
+            memcpy(&lWord, pData, 8);
+            lCRC64 = _mm_crc32_u64(lCRC64, lWord);
+            pData += 8;
+            lSize -= 8;
+        }
+        lCRC = (uint32_t) lCRC64;
+#endif
+        while (lSize >= 4) {
+            uint32_t lWord;
+            memcpy(&lWord, pData, 4);
+            lCRC = _mm_crc32_u32(lCRC, lWord);
+            pData += 4;
+            lSize -= 4;
+        }
+        while (lSize--) {
+            lCRC = _mm_crc32_u8(lCRC, *pData++);
+        }
+        return lCRC;
+    }
+#endif
+
+#ifdef RISTNET_CRC_ARMV8
+    uint32_t crcARMv8(uint32_t lCRC, const uint8_t *pData, size_t lSize) {
+        while (lSize >= 8) {
+            uint64_t lWord;
+            memcpy(&lWord, pData, 8);
+            lCRC = __crc32cd(lCRC, lWord);
+            pData += 8;
+            lSize -= 8;
+        }
+        while (lSize--) {
+            lCRC = __crc32cb(lCRC, *pData++);
+        }
+        return lCRC;
+    }
+#endif
+
+    using CRCFunction = uint32_t (*)(uint32_t, const uint8_t *, size_t);
+
+    CRCFunction functionOf(RISTNetCRC32C::Implementation lImplementation) {
+        switch (lImplementation) {
+#ifdef RISTNET_CRC_SSE42
+            case RISTNetCRC32C::Implementation::kSSE42:
+                return crcSSE42;
+#endif
+#ifdef RISTNET_CRC_ARMV8
+            case RISTNetCRC32C::Implementation::kARMv8:
+                return crcARMv8;
+#endif
+            default:
+                return crcSoftware;
+        }
+    }
+}
+
+bool RISTNetCRC32C::isSupported(Implementation lImplementation) {
+    switch (lImplementation) {
+        case Implementation::kSoftware:
+            return true;
+        case Implementation::kSSE42:
+#ifdef RISTNET_CRC_SSE42
+            return __builtin_cpu_supports("sse4.2");
+#else
+            return false;
+#endif
+        case Implementation::kARMv8:
+#ifdef RISTNET_CRC_ARMV8
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+RISTNetCRC32C::Implementation RISTNetCRC32C::selectedImplementation() {
+    static const Implementation lImplementation = isSupported(Implementation::kSSE42) ? Implementation::kSSE42 :
+                                                  isSupported(Implementation::kARMv8) ? Implementation::kARMv8 :
+                                                  Implementation::kSoftware;
+    return lImplementation;
+}
+
+const char *RISTNetCRC32C::implementationName(Implementation lImplementation) {
+    switch (lImplementation) {
+        case Implementation::kSoftware:
+            return "slicing-by-8";
+        case Implementation::kSSE42:
+            return "sse4.2";
+        case Implementation::kARMv8:
+            return "armv8";
+    }
+    return "unknown";
+}
+
+uint32_t RISTNetCRC32C::compute(const uint8_t *pData, size_t lSize) {
+    static const CRCFunction lFunction = functionOf(selectedImplementation());
+    return ~lFunction(~0u, pData, lSize);
+}
+
+uint32_t RISTNetCRC32C::compute(const uint8_t *pData, size_t lSize, Implementation lImplementation) {
+    return ~functionOf(lImplementation)(~0u, pData, lSize);
+}
+
+size_t RISTNetCRC32C::writeTrailer(uint8_t *pData, size_t lSize) {
+    uint32_t lCRC = compute(pData, lSize);
+    uint8_t *lTrailer = pData + lSize;
+    lTrailer[0] = (uint8_t) (lCRC >> 24);
+    lTrailer[1] = (uint8_t) (lCRC >> 16);
+    lTrailer[2] = (uint8_t) (lCRC >> 8);
+    lTrailer[3] = (uint8_t) lCRC;
+    return kTrailerSize;
+}
+
+bool RISTNetCRC32C::verifyTrailer(const uint8_t *pData, size_t lSize, size_t &rPayloadSize) {
+    if (lSize < kTrailerSize) {
+        return false;
+    }
+    rPayloadSize = lSize - kTrailerSize;
+    const uint8_t *lTrailer = pData + rPayloadSize;
+    uint32_t lExpected = ((uint32_t) lTrailer[0] << 24) | ((uint32_t) lTrailer[1] << 16) |
+                         ((uint32_t) lTrailer[2] << 8) | lTrailer[3];
+    return compute(pData, rPayloadSize) == lExpected;
+}
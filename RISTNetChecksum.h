@@ -0,0 +1,60 @@
+//
+// Payload integrity checksums used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETCHECKSUM_H
+#define CPPRISTWRAPPER__RISTNETCHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * \class RISTNetCRC32C
+ *
+ * \brief
+ *
+ * CRC32C (Castagnoli) computed with the SSE4.2 or ARMv8 CRC instructions when available and
+ * slicing-by-8 tables otherwise.
+ *
+ * The checksum trailer is the big endian CRC32C of the payload, appended after all other trailers.
+ *
+ */
+class RISTNetCRC32C {
+public:
+    enum class Implementation {
+        kSoftware,  // Slicing-by-8
+        kSSE42,
+        kARMv8
+    };
+
+    static constexpr size_t kTrailerSize = 4;
+
+    /// The CRC32C of the data using the selected implementation
+    static uint32_t compute(const uint8_t *pData, size_t lSize);
+
+    /// The CRC32C of the data using the given implementation. The implementation must be supported
+    static uint32_t compute(const uint8_t *pData, size_t lSize, Implementation lImplementation);
+
+    /// The implementation used by compute
+    static Implementation selectedImplementation();
+
+    /// true if the CPU supports the implementation
+    static bool isSupported(Implementation lImplementation);
+
+    /// The name of the implementation, e.g. "sse4.2"
+    static const char *implementationName(Implementation lImplementation);
+
+    /// Append the checksum of the lSize bytes at pData to pData. Returns kTrailerSize
+    static size_t writeTrailer(uint8_t *pData, size_t lSize);
+
+    /// Verify the checksum trailer. rPayloadSize is the size without the trailer. Returns false on mismatch
+    static bool verifyTrailer(const uint8_t *pData, size_t lSize, size_t &rPayloadSize);
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCHECKSUM_H
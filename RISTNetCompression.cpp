@@ -0,0 +1,140 @@
+//
+// LZ4 payload compression used by the RIST C++ wrapper.
+//
+
+#include "RISTNetCompression.h"
+
+#include <cstring>
+#include <algorithm>
+
+// LZ4_attach_dictionary, lz4.c is compiled into the library
+#define LZ4_STATIC_LINKING_ONLY
+#include "lz4.h"
+
+namespace {
+    // LZ4 only references the last 64 KiB
+    constexpr size_t kMaxDictionarySize = 64 * 1024;
+}
+
+RISTNetBufferPool::Buffer &RISTNetBufferPool::Buffer::operator=(Buffer &&rOther) noexcept {
+    if (this != &rOther) {
+        release();
+        mPool = rOther.mPool;
+        mData = std::move(rOther.mData);
+        rOther.mPool = nullptr;
+    }
+    return *this;
+}
+
+void RISTNetBufferPool::Buffer::release() {
+    if (!mPool) {
+        return;
+    }
+    std::lock_guard<std::mutex> lLock(mPool->mMtx);
+    if (mPool->mFree.size() < mPool->mMaxPooled) {
+        mPool->mFree.push_back(std::move(mData));
+    }
+    mPool = nullptr;
+}
+
+RISTNetBufferPool::RISTNetBufferPool(size_t lBufferSize, size_t lMaxPooled) : mBufferSize(lBufferSize),
+                                                                              mMaxPooled(lMaxPooled) {
+    mFree.reserve(mMaxPooled);
+}
+
+size_t RISTNetBufferPool::memoryUsage() {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    size_t lBytes = 0;
+    for (auto &rBuffer: mFree) {
+        lBytes += rBuffer.capacity();
+    }
+    return lBytes;
+}
+
+RISTNetBufferPool::Buffer RISTNetBufferPool::acquire() {
+    Buffer lBuffer;
+    lBuffer.mPool = this;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mFree.empty()) {
+            lBuffer.mData = std::move(mFree.back());
+            mFree.pop_back();
+            return lBuffer;
+        }
+    }
+    lBuffer.mData.resize(mBufferSize);
+    return lBuffer;
+}
+
+RISTNetLZ4::RISTNetLZ4() : mStream(LZ4_createStream()) {
+}
+
+RISTNetLZ4::~RISTNetLZ4() {
+    LZ4_freeStream(mStream);
+    if (mDictionaryStream) {
+        LZ4_freeStream(mDictionaryStream);
+    }
+}
+
+void RISTNetLZ4::setDictionary(const std::vector<uint8_t> &rDictionary) {
+    size_t lSize = std::min(rDictionary.size(), kMaxDictionarySize);
+    mDictionary.assign(rDictionary.end() - lSize, rDictionary.end());
+    if (mDictionary.empty()) {
+        if (mDictionaryStream) {
+            LZ4_freeStream(mDictionaryStream);
+            mDictionaryStream = nullptr;
+        }
+        return;
+    }
+    if (!mDictionaryStream) {
+        mDictionaryStream = LZ4_createStream();
+    }
+    LZ4_loadDict(mDictionaryStream, (const char *) mDictionary.data(), (int) mDictionary.size());
+}
+
+size_t RISTNetLZ4::compress(const uint8_t *pSrc, size_t lSize, uint8_t *pDst, size_t lDstCapacity, bool lCompress) {
+    if (lSize + kTrailerSize > lDstCapacity) {
+        return 0;
+    }
+    if (lCompress && lSize > 1) {
+        // Every payload is a block of its own, referencing the dictionary if there is one
+        LZ4_resetStream_fast(mStream);
+        if (mDictionaryStream) {
+            LZ4_attach_dictionary(mStream, mDictionaryStream);
+        }
+        // Only worth it if the payload gets smaller
+        int lCompressed = LZ4_compress_fast_continue(mStream, (const char *) pSrc, (char *) pDst, (int) lSize,
+                                                     (int) lSize - 1, mAcceleration);
+        if (lCompressed > 0) {
+            pDst[lCompressed] = (uint8_t) (mDictionaryStream ? Format::kLZ4Dictionary : Format::kLZ4);
+            return lCompressed + kTrailerSize;
+        }
+    }
+    memcpy(pDst, pSrc, lSize);
+    pDst[lSize] = (uint8_t) Format::kRaw;
+    return lSize + kTrailerSize;
+}
+
+bool RISTNetLZ4::readTrailer(const uint8_t *pSrc, size_t lSize, Format &rFormat, size_t &rPayloadSize) {
+    if (lSize < kTrailerSize || pSrc[lSize - 1] > (uint8_t) Format::kLZ4Dictionary) {
+        return false;
+    }
+    rFormat = (Format) pSrc[lSize - 1];
+    rPayloadSize = lSize - kTrailerSize;
+    return true;
+}
+
+int RISTNetLZ4::decompress(const uint8_t *pSrc, size_t lSize, Format lFormat, uint8_t *pDst,
+                           size_t lDstCapacity) const {
+    if (lFormat == Format::kLZ4Dictionary) {
+        if (mDictionary.empty()) {
+            return -1;
+        }
+        return LZ4_decompress_safe_usingDict((const char *) pSrc, (char *) pDst, (int) lSize, (int) lDstCapacity,
+                                             (const char *) mDictionary.data(), (int) mDictionary.size());
+    }
+    if (lFormat == Format::kLZ4) {
+        return LZ4_decompress_safe((const char *) pSrc, (char *) pDst, (int) lSize, (int) lDstCapacity);
+    }
+    return -1;
+}
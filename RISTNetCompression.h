@@ -0,0 +1,122 @@
+//
+// LZ4 payload compression used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETCOMPRESSION_H
+#define CPPRISTWRAPPER__RISTNETCOMPRESSION_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+
+union LZ4_stream_u;
+
+/**
+ * \class RISTNetBufferPool
+ *
+ * \brief
+ *
+ * A pool of equally sized buffers. A Buffer is given back to the pool when destroyed, the pool must outlive its buffers.
+ *
+ */
+class RISTNetBufferPool {
+public:
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer &&rOther) noexcept : mPool(rOther.mPool), mData(std::move(rOther.mData)) { rOther.mPool = nullptr; }
+        Buffer &operator=(Buffer &&rOther) noexcept;
+        ~Buffer() { release(); }
+
+        uint8_t *data() { return mData.data(); }
+        size_t size() const { return mData.size(); }
+
+    private:
+        friend class RISTNetBufferPool;
+        void release();
+
+        RISTNetBufferPool *mPool = nullptr;
+        std::vector<uint8_t> mData;
+    };
+
+    /// lMaxPooled is the number of free buffers kept, more buffers can be in use at the same time
+    explicit RISTNetBufferPool(size_t lBufferSize, size_t lMaxPooled = 8);
+
+    /// Get a buffer, allocates only if the pool is empty
+    Buffer acquire();
+
+    size_t bufferSize() const { return mBufferSize; }
+
+    /// Bytes held by the free buffers
+    size_t memoryUsage();
+
+    /// The most bytes the free buffers hold
+    size_t maxMemoryUsage() const { return mBufferSize * mMaxPooled; }
+
+private:
+    std::mutex mMtx;
+    size_t mBufferSize;
+    size_t mMaxPooled;
+    std::vector<std::vector<uint8_t>> mFree;
+};
+
+/**
+ * \class RISTNetLZ4
+ *
+ * \brief
+ *
+ * LZ4 block compression of single payloads. Every payload gets a one byte trailer telling if and how it
+ * is compressed, payloads that do not get smaller are sent as they are. The compression state is reused
+ * between payloads and an optional dictionary shared by the sender and receiver improves the ratio of small payloads.
+ *
+ * compress() is not thread safe, decompress() is.
+ *
+ */
+class RISTNetLZ4 {
+public:
+    enum class Format : uint8_t {
+        kRaw = 0,
+        kLZ4 = 1,
+        kLZ4Dictionary = 2
+    };
+
+    static constexpr size_t kTrailerSize = 1;
+
+    RISTNetLZ4();
+    ~RISTNetLZ4();
+
+    /// Set the dictionary (at most 64 KiB are used), empty for none. Must be the same on both ends
+    void setDictionary(const std::vector<uint8_t> &rDictionary);
+
+    /// Higher values compress faster and less, 1 is the default of LZ4
+    void setAcceleration(int lAcceleration) { mAcceleration = lAcceleration < 1 ? 1 : lAcceleration; }
+
+    /// Write pSrc compressed, or as is if lCompress is false or it does not get smaller, followed by the trailer.
+    /// Returns the size written, 0 if it does not fit lDstCapacity
+    size_t compress(const uint8_t *pSrc, size_t lSize, uint8_t *pDst, size_t lDstCapacity, bool lCompress);
+
+    /// Read the trailer. rPayloadSize is the size without the trailer. Returns false if malformed
+    static bool readTrailer(const uint8_t *pSrc, size_t lSize, Format &rFormat, size_t &rPayloadSize);
+
+    /// Decompress a compressed (not kRaw) payload without trailer. Returns the decompressed size, -1 on error
+    int decompress(const uint8_t *pSrc, size_t lSize, Format lFormat, uint8_t *pDst, size_t lDstCapacity) const;
+
+    RISTNetLZ4(RISTNetLZ4 const &) = delete;
+    RISTNetLZ4 &operator=(RISTNetLZ4 const &) = delete;
+
+private:
+    LZ4_stream_u *mStream = nullptr;
+    // The dictionary loaded once, attached to mStream for every payload
+    LZ4_stream_u *mDictionaryStream = nullptr;
+    std::vector<uint8_t> mDictionary;
+    int mAcceleration = 1;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCOMPRESSION_H
@@ -0,0 +1,363 @@
+//
+// UDP and multicast egress fed by a RISTNetReceiver.
+//
+
+#include "RISTNetEgress.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+// sendmmsg and UDP GSO are Linux only, elsewhere the datagrams are sent one by one
+#ifdef __linux__
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#endif
+
+namespace {
+#ifdef __linux__
+    // Kernel limits of a UDP_SEGMENT send: segments and payload of the super-datagram
+    constexpr size_t kMaxSegments = 64;
+    constexpr size_t kMaxSegmentedBytes = 65000;
+    constexpr size_t kControlSize = CMSG_SPACE(sizeof(uint16_t));
+#endif
+
+    bool toAddress(const std::string &rIP, uint16_t lPort, sockaddr_storage &rAddress, socklen_t &rLength) {
+        memset(&rAddress, 0, sizeof(rAddress));
+        auto *pV4 = (sockaddr_in *) &rAddress;
+        if (inet_pton(AF_INET, rIP.c_str(), &pV4->sin_addr) == 1) {
+            pV4->sin_family = AF_INET;
+            pV4->sin_port = htons(lPort);
+            rLength = sizeof(sockaddr_in);
+            return true;
+        }
+        auto *pV6 = (sockaddr_in6 *) &rAddress;
+        if (inet_pton(AF_INET6, rIP.c_str(), &pV6->sin6_addr) == 1) {
+            pV6->sin6_family = AF_INET6;
+            pV6->sin6_port = htons(lPort);
+            rLength = sizeof(sockaddr_in6);
+            return true;
+        }
+        return false;
+    }
+}
+
+RISTNetUDPEgress::~RISTNetUDPEgress() {
+    stop();
+}
+
+bool RISTNetUDPEgress::start(const RISTNetUDPEgressSettings &rSettings) {
+    stop();
+    if (rSettings.mDestinations.empty() || !rSettings.mQueueDepth || !rSettings.mBatchSize ||
+        !rSettings.mMaxDatagramSize) {
+        LOGGER(true, LOGG_ERROR, "UDP egress: no destinations, queue depth, batch size or datagram size.")
+        return false;
+    }
+    mSettings = rSettings;
+    mSettings.mBatchSize = std::min(mSettings.mBatchSize, mSettings.mQueueDepth);
+    mDestinations.resize(mSettings.mDestinations.size());
+    for (size_t i = 0; i < mDestinations.size(); i++) {
+        if (!openDestination(mSettings.mDestinations[i], mDestinations[i])) {
+            stop();
+            return false;
+        }
+        mRoutes[mSettings.mDestinations[i].mConnectionID].push_back(i);
+        mDestinations[i].mPending.reserve(mSettings.mBatchSize);
+    }
+
+    mBuffers.assign(mSettings.mQueueDepth * mSettings.mMaxDatagramSize, 0);
+    mSlots.assign(mSettings.mQueueDepth, Slot());
+#ifdef __linux__
+    mMessages.assign(mSettings.mBatchSize, mmsghdr());
+    mVectors.assign(mSettings.mBatchSize, iovec());
+    mControl.assign((mSettings.mBatchSize * kControlSize + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    mMessageStart.assign(mSettings.mBatchSize, 0);
+#endif
+    mStatistics = RISTNetUDPEgressStatistics();
+    mStatistics.mDestinations.resize(mDestinations.size());
+    mThreadInfo.clear();
+    mHead = 0;
+    mCount = 0;
+    mRunning = true;
+    mThread = std::thread(&RISTNetUDPEgress::egressWorker, this);
+    return true;
+}
+
+bool RISTNetUDPEgress::openDestination(const RISTNetUDPDestination &rSettings, Destination &rDestination) {
+    if (!toAddress(rSettings.mAddress, rSettings.mPort, rDestination.mAddress, rDestination.mAddressLength)) {
+        LOGGER(true, LOGG_ERROR, "UDP egress address not valid: " << rSettings.mAddress)
+        return false;
+    }
+    int lFamily = rDestination.mAddress.ss_family;
+    rDestination.mSocket = socket(lFamily, SOCK_DGRAM, 0);
+    if (rDestination.mSocket < 0) {
+        LOGGER(true, LOGG_ERROR, "UDP egress socket failed: " << strerror(errno))
+        return false;
+    }
+    int lSocket = rDestination.mSocket;
+    if (mSettings.mSendBufferSize) {
+        setsockopt(lSocket, SOL_SOCKET, SO_SNDBUF, &mSettings.mSendBufferSize, sizeof(mSettings.mSendBufferSize));
+    }
+
+    bool lFailed = false;
+    if (lFamily == AF_INET) {
+        if (!rSettings.mInterface.empty()) {
+            in_addr lInterface{};
+            lFailed |= inet_pton(AF_INET, rSettings.mInterface.c_str(), &lInterface) != 1 ||
+                       setsockopt(lSocket, IPPROTO_IP, IP_MULTICAST_IF, &lInterface, sizeof(lInterface));
+        }
+        if (rSettings.mTTL >= 0) {
+            lFailed |= setsockopt(lSocket, IPPROTO_IP, IP_MULTICAST_TTL, &rSettings.mTTL,
+                                  sizeof(rSettings.mTTL)) != 0;
+        }
+    } else {
+        if (!rSettings.mInterface.empty()) {
+            unsigned int lInterface = if_nametoindex(rSettings.mInterface.c_str());
+            lFailed |= !lInterface ||
+                       setsockopt(lSocket, IPPROTO_IPV6, IPV6_MULTICAST_IF, &lInterface, sizeof(lInterface));
+        }
+        if (rSettings.mTTL >= 0) {
+            lFailed |= setsockopt(lSocket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &rSettings.mTTL,
+                                  sizeof(rSettings.mTTL)) != 0;
+        }
+    }
+    if (lFailed) {
+        LOGGER(true, LOGG_ERROR, "UDP egress multicast options failed: " << rSettings.mAddress << " "
+                                 << rSettings.mInterface)
+        return false;
+    }
+
+#ifdef __linux__
+    if (mSettings.mGSO) {
+        // The option is known if the kernel supports UDP GSO
+        int lSegment = 0;
+        socklen_t lLength = sizeof(lSegment);
+        rDestination.mGSO = !getsockopt(lSocket, SOL_UDP, UDP_SEGMENT, &lSegment, &lLength);
+    }
+#endif
+    return true;
+}
+
+void RISTNetUDPEgress::stop() {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mRunning = false;
+    }
+    mNotEmpty.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    std::lock_guard<std::mutex> lLock(mMtx);
+    for (auto &rDestination: mDestinations) {
+        if (rDestination.mSocket >= 0) {
+            close(rDestination.mSocket);
+        }
+    }
+    mDestinations.clear();
+    mRoutes.clear();
+}
+
+bool RISTNetUDPEgress::send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID) {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mRunning) {
+            return false;
+        }
+        if (mRoutes.find(lConnectionID) == mRoutes.end()) {
+            mStatistics.mUnrouted++;
+            return false;
+        }
+        if (lSize > mSettings.mMaxDatagramSize) {
+            mStatistics.mOversize++;
+            return false;
+        }
+        if (mCount == mSlots.size()) {
+            mStatistics.mDropped++;
+            return false;
+        }
+        size_t lSlot = (mHead + mCount) % mSlots.size();
+        memcpy(mBuffers.data() + lSlot * mSettings.mMaxDatagramSize, pData, lSize);
+        mSlots[lSlot].mSize = lSize;
+        mSlots[lSlot].mConnectionID = lConnectionID;
+        mCount++;
+        mStatistics.mQueued++;
+    }
+    mNotEmpty.notify_one();
+    return true;
+}
+
+void RISTNetUDPEgress::attach(RISTNetReceiver &rReceiver) {
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &, rist_peer *,
+                                           uint16_t lConnectionID) {
+        send(pBuf, lSize, lConnectionID);
+        return 0;
+    };
+}
+
+void RISTNetUDPEgress::getStatistics(RISTNetUDPEgressStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics = mStatistics;
+}
+
+void RISTNetUDPEgress::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rThreads = mThreadInfo;
+}
+
+void RISTNetUDPEgress::egressWorker() {
+    if (!mSettings.mThreadSettings.isDefault()) {
+        RISTNetThreadInfo lInfo;
+        RISTNetThreadBinder::applyToCurrentThread(mSettings.mThreadSettings, lInfo);
+        lInfo.mRole = "egress";
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mThreadInfo.push_back(lInfo);
+    }
+
+    while (true) {
+        size_t lHead;
+        size_t lCount;
+        {
+            std::unique_lock<std::mutex> lLock(mMtx);
+            mNotEmpty.wait(lLock, [&]() { return !mRunning || mCount; });
+            if (!mRunning) {
+                break;
+            }
+            lHead = mHead;
+            lCount = std::min(mCount, mSettings.mBatchSize);
+        }
+
+        // The slots taken are not written by send() until they are released below
+        for (size_t i = 0; i < lCount; i++) {
+            size_t lSlot = (lHead + i) % mSlots.size();
+            for (size_t lDestination: mRoutes.at(mSlots[lSlot].mConnectionID)) {
+                mDestinations[lDestination].mPending.push_back(lSlot);
+            }
+        }
+        for (size_t i = 0; i < mDestinations.size(); i++) {
+            if (!mDestinations[i].mPending.empty()) {
+                sendPending(i);
+            }
+        }
+
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mHead = (mHead + lCount) % mSlots.size();
+        mCount -= lCount;
+        for (size_t i = 0; i < mDestinations.size(); i++) {
+            auto &rRound = mDestinations[i].mRound;
+            auto &rTotal = mStatistics.mDestinations[i];
+            rTotal.mDatagrams += rRound.mDatagrams;
+            rTotal.mBytes += rRound.mBytes;
+            rTotal.mSyscalls += rRound.mSyscalls;
+            rTotal.mErrors += rRound.mErrors;
+            rTotal.mGSO = mDestinations[i].mGSO;
+            rRound = RISTNetUDPEgressStatistics::Destination();
+        }
+    }
+}
+
+void RISTNetUDPEgress::sendPending(size_t lIndex) {
+    Destination &rDestination = mDestinations[lIndex];
+    std::vector<size_t> &rPending = rDestination.mPending;
+#ifdef __linux__
+
+    // One message per datagram, or with GSO per run of equal sized datagrams (the last one may be shorter)
+    size_t lMessages = 0;
+    size_t lVectors = 0;
+    size_t i = 0;
+    while (i < rPending.size()) {
+        mmsghdr &rMessage = mMessages[lMessages];
+        memset(&rMessage, 0, sizeof(rMessage));
+        rMessage.msg_hdr.msg_name = &rDestination.mAddress;
+        rMessage.msg_hdr.msg_namelen = rDestination.mAddressLength;
+        rMessage.msg_hdr.msg_iov = &mVectors[lVectors];
+        mMessageStart[lMessages] = i;
+
+        size_t lSegmentSize = mSlots[rPending[i]].mSize;
+        size_t lBytes = 0;
+        size_t lSegments = 0;
+        while (i < rPending.size()) {
+            size_t lSize = mSlots[rPending[i]].mSize;
+            if (lSegments && (!rDestination.mGSO || lSize > lSegmentSize || lSegments == kMaxSegments ||
+                              lBytes + lSize > kMaxSegmentedBytes)) {
+                break;
+            }
+            mVectors[lVectors].iov_base = mBuffers.data() + rPending[i] * mSettings.mMaxDatagramSize;
+            mVectors[lVectors].iov_len = lSize;
+            lVectors++;
+            lBytes += lSize;
+            lSegments++;
+            i++;
+            if (lSize < lSegmentSize) {
+                break;
+            }
+        }
+        rMessage.msg_hdr.msg_iovlen = lSegments;
+        if (lSegments > 1) {
+            rMessage.msg_hdr.msg_control = (uint8_t *) mControl.data() + lMessages * kControlSize;
+            rMessage.msg_hdr.msg_controllen = kControlSize;
+            cmsghdr *pControl = CMSG_FIRSTHDR(&rMessage.msg_hdr);
+            pControl->cmsg_level = SOL_UDP;
+            pControl->cmsg_type = UDP_SEGMENT;
+            pControl->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t lGSOSize = (uint16_t) lSegmentSize;
+            memcpy(CMSG_DATA(pControl), &lGSOSize, sizeof(lGSOSize));
+        }
+        lMessages++;
+    }
+
+    auto &rRound = rDestination.mRound;
+    size_t lSent = 0;
+    while (lSent < lMessages) {
+        int lResult = sendmmsg(rDestination.mSocket, &mMessages[lSent], (unsigned int) (lMessages - lSent), 0);
+        rRound.mSyscalls++;
+        if (lResult < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (rDestination.mGSO && mMessages[lSent].msg_hdr.msg_iovlen > 1) {
+                // The route (device, MTU) does not take GSO, send the rest one datagram at a time
+                LOGGER(true, LOGG_WARN, "UDP egress: GSO failed, disabled: " << strerror(errno))
+                rDestination.mGSO = false;
+                rPending.erase(rPending.begin(), rPending.begin() + (ptrdiff_t) mMessageStart[lSent]);
+                sendPending(lIndex);
+                return;
+            }
+            rRound.mErrors += mMessages[lSent].msg_hdr.msg_iovlen;
+            lSent++;
+            continue;
+        }
+        for (int m = 0; m < lResult; m++) {
+            rRound.mDatagrams += mMessages[lSent + m].msg_hdr.msg_iovlen;
+            rRound.mBytes += mMessages[lSent + m].msg_len;
+        }
+        lSent += lResult;
+    }
+#else
+    auto &rRound = rDestination.mRound;
+    for (size_t lSlot: rPending) {
+        size_t lSize = mSlots[lSlot].mSize;
+        ssize_t lResult;
+        do {
+            lResult = sendto(rDestination.mSocket, mBuffers.data() + lSlot * mSettings.mMaxDatagramSize, lSize, 0,
+                             (const sockaddr *) &rDestination.mAddress, rDestination.mAddressLength);
+            rRound.mSyscalls++;
+        } while (lResult < 0 && errno == EINTR);
+        if (lResult < 0) {
+            rRound.mErrors++;
+            continue;
+        }
+        rRound.mDatagrams++;
+        rRound.mBytes += lSize;
+    }
+#endif
+    rPending.clear();
+}
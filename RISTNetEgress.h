@@ -0,0 +1,166 @@
+//
+// UDP and multicast egress fed by a RISTNetReceiver.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETEGRESS_H
+#define CPPRISTWRAPPER__RISTNETEGRESS_H
+
+#include "RISTNet.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include <sys/socket.h>
+
+/**
+ * \class RISTNetUDPDestination
+ *
+ * \brief
+ *
+ * Where RISTNetUDPEgress sends the data of a connection ID (flow_id). A connection ID may have several.
+ *
+ */
+struct RISTNetUDPDestination {
+    std::string mAddress;            // Unicast address or multicast group
+    uint16_t mPort = 0;
+    uint16_t mConnectionID = 0;      // The connection ID sent to this destination
+    std::string mInterface;          // Multicast: IPv4 address or IPv6 interface name to send from, empty = default
+    int mTTL = -1;                   // Multicast TTL / hop limit, -1 = system default
+};
+
+/**
+ * \class RISTNetUDPEgressSettings
+ *
+ * \brief
+ *
+ * Settings of RISTNetUDPEgress.
+ *
+ */
+struct RISTNetUDPEgressSettings {
+    std::vector<RISTNetUDPDestination> mDestinations;
+    size_t mQueueDepth = 4096;           // Datagrams buffered for the egress thread, more are dropped
+    size_t mMaxDatagramSize = 1500;      // Longer data is dropped
+    size_t mBatchSize = 256;             // Datagrams taken from the queue per round
+    bool mGSO = true;                    // Merge equal sized datagrams with UDP_SEGMENT where the kernel supports it
+    int mSendBufferSize = 4 * 1024 * 1024; // SO_SNDBUF, 0 = system default
+    RISTNetThreadSettings mThreadSettings; // CPU placement and scheduling of the egress thread
+};
+
+/**
+ * \class RISTNetUDPEgressStatistics
+ *
+ * \brief
+ *
+ * Counters of RISTNetUDPEgress, mDestinations in the order of the settings.
+ *
+ */
+struct RISTNetUDPEgressStatistics {
+    struct Destination {
+        uint64_t mDatagrams = 0;     // Datagrams sent
+        uint64_t mBytes = 0;
+        uint64_t mSyscalls = 0;      // sendmmsg (sendto off Linux) calls
+        uint64_t mErrors = 0;        // Datagrams that could not be sent
+        bool mGSO = false;           // UDP_SEGMENT in use
+    };
+    uint64_t mQueued = 0;            // Datagrams accepted by send()
+    uint64_t mDropped = 0;           // Datagrams dropped because the queue was full
+    uint64_t mOversize = 0;          // Datagrams longer than mMaxDatagramSize
+    uint64_t mUnrouted = 0;          // Datagrams of a connection ID without destination
+    std::vector<Destination> mDestinations;
+};
+
+/**
+ * \class RISTNetUDPEgress
+ *
+ * \brief
+ *
+ * Sends the data received by a RISTNetReceiver to UDP or multicast destinations, the reverse of
+ * RISTNetUDPIngest. send() copies the data into a queue allocated at start and never blocks. The egress thread
+ * sends what is queued a batch at a time with sendmmsg, per destination. With GSO the datagrams of a batch are
+ * merged into UDP_SEGMENT super-datagrams, the kernel splits them up again (Linux 4.18+). Without sendmmsg
+ * (not Linux) every datagram is sent with sendto.
+ *
+ */
+class RISTNetUDPEgress {
+public:
+    ~RISTNetUDPEgress();
+
+    /// Open the destinations and start the egress thread. Returns false, with nothing started, on failure
+    bool start(const RISTNetUDPEgressSettings &rSettings);
+
+    void stop();
+
+    /// Queue a datagram for the destinations of lConnectionID. Returns false if it was dropped
+    bool send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID);
+
+    /// Set networkDataCallback of the receiver to send(). The receiver must not outlive the egress
+    void attach(RISTNetReceiver &rReceiver);
+
+    void getStatistics(RISTNetUDPEgressStatistics &rStatistics);
+
+    /// The egress thread, if thread settings were given
+    void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+    RISTNetUDPEgress() = default;
+    RISTNetUDPEgress(RISTNetUDPEgress const &) = delete;
+    RISTNetUDPEgress &operator=(RISTNetUDPEgress const &) = delete;
+
+private:
+    struct Slot {
+        size_t mSize = 0;
+        uint16_t mConnectionID = 0;
+    };
+
+    struct Destination {
+        int mSocket = -1;
+        sockaddr_storage mAddress{};
+        socklen_t mAddressLength = 0;
+        bool mGSO = false;
+        // Used by the egress thread: the slots to send and the counters of this round
+        std::vector<size_t> mPending;
+        RISTNetUDPEgressStatistics::Destination mRound;
+    };
+
+    bool openDestination(const RISTNetUDPDestination &rSettings, Destination &rDestination);
+    void egressWorker();
+    void sendPending(size_t lIndex);
+
+    RISTNetUDPEgressSettings mSettings;
+    std::vector<Destination> mDestinations;
+    // Destinations of every connection ID, not changed while running
+    std::unordered_map<uint16_t, std::vector<size_t>> mRoutes;
+
+    // The queue. The slots between mHead and mHead + mCount belong to the egress thread
+    std::mutex mMtx;
+    std::condition_variable mNotEmpty;
+    std::vector<uint8_t> mBuffers;
+    std::vector<Slot> mSlots;
+    size_t mHead = 0;
+    size_t mCount = 0;
+    bool mRunning = false;
+    std::thread mThread;
+
+#ifdef __linux__
+    // sendmmsg arguments, set up at start and used by the egress thread
+    std::vector<mmsghdr> mMessages;
+    std::vector<iovec> mVectors;
+    std::vector<uint64_t> mControl;
+    std::vector<size_t> mMessageStart;  // The first pending slot of every message
+#endif
+
+    RISTNetUDPEgressStatistics mStatistics;
+    std::vector<RISTNetThreadInfo> mThreadInfo;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETEGRESS_H
@@ -0,0 +1,370 @@
+//
+// Row/column XOR forward error correction used by the RIST C++ wrapper.
+//
+
+#include "RISTNetFEC.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RISTNET_XOR_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define RISTNET_XOR_NEON 1
+#include <arm_neon.h>
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+// XOR kernels
+//---------------------------------------------------------------------------------------------------------------------
+
+namespace {
+    void xorScalar(uint8_t *pDst, const uint8_t *pSrc, size_t lSize) {
+        size_t i = 0;
+        for (; i + 8 <= lSize; i += 8) {
+            uint64_t lDst;
+            uint64_t lSrc;
+            memcpy(&lDst, pDst + i, 8);
+            memcpy(&lSrc, pSrc + i, 8);
+            lDst ^= lSrc;
+            memcpy(pDst + i, &lDst, 8);
+        }
+        for (; i < lSize; i++) {
+            pDst[i] ^= pSrc[i];
+        }
+    }
+
+#ifdef RISTNET_XOR_AVX2
+    __attribute__((target("avx2")))
+    void xorAVX2(uint8_t *pDst, const uint8_t *pSrc, size_t lSize) {
+        size_t i = 0;
+        for (; i + 64 <= lSize; i += 64) {
+            __m256i lDst0 = _mm256_loadu_si256((const __m256i *) (pDst + i));
+            __m256i lDst1 = _mm256_loadu_si256((const __m256i *) (pDst + i + 32));
+            __m256i lSrc0 = _mm256_loadu_si256((const __m256i *) (pSrc + i));
+            __m256i lSrc1 = _mm256_loadu_si256((const __m256i *) (pSrc + i + 32));
+            _mm256_storeu_si256((__m256i *) (pDst + i), _mm256_xor_si256(lDst0, lSrc0));
+            _mm256_storeu_si256((__m256i *) (pDst + i + 32), _mm256_xor_si256(lDst1, lSrc1));
+        }
+        for (; i + 32 <= lSize; i += 32) {
+            __m256i lDst = _mm256_loadu_si256((const __m256i *) (pDst + i));
+            __m256i lSrc = _mm256_loadu_si256((const __m256i *) (pSrc + i));
+            _mm256_storeu_si256((__m256i *) (pDst + i), _mm256_xor_si256(lDst, lSrc));
+        }
+        xorScalar(pDst + i, pSrc + i, lSize - i);
+    }
+#endif
+
+#ifdef RISTNET_XOR_NEON
+    void xorNEON(uint8_t *pDst, const uint8_t *pSrc, size_t lSize) {
+        size_t i = 0;
+        for (; i + 16 <= lSize; i += 16) {
+            vst1q_u8(pDst + i, veorq_u8(vld1q_u8(pDst + i), vld1q_u8(pSrc + i)));
+        }
+        xorScalar(pDst + i, pSrc + i, lSize - i);
+    }
+#endif
+
+    using XORFunction = void (*)(uint8_t *, const uint8_t *, size_t);
+
+    XORFunction functionOf(RISTNetXOR::Kernel lKernel) {
+        switch (lKernel) {
+#ifdef RISTNET_XOR_AVX2
+            case RISTNetXOR::Kernel::kAVX2:
+                return xorAVX2;
+#endif
+#ifdef RISTNET_XOR_NEON
+            case RISTNetXOR::Kernel::kNEON:
+                return xorNEON;
+#endif
+            default:
+                return xorScalar;
+        }
+    }
+}
+
+bool RISTNetXOR::isSupported(Kernel lKernel) {
+    switch (lKernel) {
+        case Kernel::kScalar:
+            return true;
+        case Kernel::kAVX2:
+#ifdef RISTNET_XOR_AVX2
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        case Kernel::kNEON:
+#ifdef RISTNET_XOR_NEON
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+RISTNetXOR::Kernel RISTNetXOR::selectedKernel() {
+    static const Kernel lKernel = isSupported(Kernel::kAVX2) ? Kernel::kAVX2 :
+                                  isSupported(Kernel::kNEON) ? Kernel::kNEON : Kernel::kScalar;
+    return lKernel;
+}
+
+const char *RISTNetXOR::kernelName(Kernel lKernel) {
+    switch (lKernel) {
+        case Kernel::kScalar:
+            return "scalar";
+        case Kernel::kAVX2:
+            return "avx2";
+        case Kernel::kNEON:
+            return "neon";
+    }
+    return "unknown";
+}
+
+void RISTNetXOR::xorInto(uint8_t *pDst, const uint8_t *pSrc, size_t lSize) {
+    static const XORFunction lFunction = functionOf(selectedKernel());
+    lFunction(pDst, pSrc, lSize);
+}
+
+void RISTNetXOR::xorInto(uint8_t *pDst, const uint8_t *pSrc, size_t lSize, Kernel lKernel) {
+    functionOf(lKernel)(pDst, pSrc, lSize);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// FEC
+//---------------------------------------------------------------------------------------------------------------------
+
+bool RISTNetFEC::isValidMatrix(uint8_t lColumns, uint8_t lRows) {
+    return lColumns >= 1 && lColumns <= kMaxColumns && lRows >= 1 && lRows <= kMaxRows &&
+           (size_t) lColumns * lRows <= kMaxMatrixSize;
+}
+
+bool RISTNetFECEncoder::configure(uint8_t lColumns, uint8_t lRows, bool lRowParity, size_t lMaxPayloadSize) {
+    if (!RISTNetFEC::isValidMatrix(lColumns, lRows)) {
+        LOGGER(true, LOGG_ERROR, "FEC matrix " << unsigned(lColumns) << "x" << unsigned(lRows) << " not valid.")
+        return false;
+    }
+    mColumns = lColumns;
+    mRows = lRows;
+    mRowParity = lRowParity;
+    mSequence = 0;
+    mMatrixIndex = 0;
+    mReadyCount = 0;
+    mParity.clear();
+    mParity.resize(mColumns + 1);
+    for (auto &rParity: mParity) {
+        rParity.mData.assign(RISTNetFEC::kParityHeaderSize + lMaxPayloadSize, 0);
+    }
+    return true;
+}
+
+size_t RISTNetFECEncoder::readyParitySize(size_t lIndex) const {
+    return RISTNetFEC::kParityHeaderSize + mParity[mReady[lIndex]].mMaxSize;
+}
+
+size_t RISTNetFECEncoder::memoryUsage() const {
+    size_t lBytes = mParity.capacity() * sizeof(Parity);
+    for (auto &rParity: mParity) {
+        lBytes += rParity.mData.capacity();
+    }
+    return lBytes;
+}
+
+void RISTNetFECEncoder::add(Parity &rParity, const uint8_t *pData, size_t lSize, uint16_t lFlowId) {
+    if (rParity.mComplete) {
+        memset(rParity.mData.data() + RISTNetFEC::kParityHeaderSize, 0, rParity.mMaxSize);
+        rParity.mMaxSize = 0;
+        rParity.mLengthRecovery = 0;
+        rParity.mFlowIdRecovery = 0;
+        rParity.mComplete = false;
+    }
+    RISTNetXOR::xorInto(rParity.mData.data() + RISTNetFEC::kParityHeaderSize, pData, lSize);
+    rParity.mMaxSize = std::max(rParity.mMaxSize, lSize);
+    rParity.mLengthRecovery ^= (uint16_t) lSize;
+    rParity.mFlowIdRecovery ^= lFlowId;
+}
+
+void RISTNetFECEncoder::complete(size_t lParity, RISTNetFEC::ParityType lType, uint16_t lFirstSequence) {
+    Parity &rParity = mParity[lParity];
+    uint8_t *lHeader = rParity.mData.data();
+    lHeader[0] = (uint8_t) lType;
+    lHeader[1] = mColumns;
+    lHeader[2] = mRows;
+    lHeader[3] = 0;
+    RISTNetFEC::writeSequence(lHeader + 4, lFirstSequence);
+    RISTNetFEC::writeSequence(lHeader + 6, rParity.mLengthRecovery);
+    RISTNetFEC::writeSequence(lHeader + 8, rParity.mFlowIdRecovery);
+    rParity.mComplete = true;
+    mReady[mReadyCount++] = lParity;
+}
+
+uint16_t RISTNetFECEncoder::addPacket(const uint8_t *pData, size_t lSize, uint16_t lFlowId) {
+    uint16_t lSequence = mSequence++;
+    size_t lColumn = mMatrixIndex % mColumns;
+    size_t lRow = mMatrixIndex / mColumns;
+    mReadyCount = 0;
+
+    add(mParity[lColumn], pData, lSize, lFlowId);
+    if (mRowParity) {
+        add(mParity[mColumns], pData, lSize, lFlowId);
+        if (lColumn == mColumns - 1u) {
+            complete(mColumns, RISTNetFEC::ParityType::kRow, (uint16_t) (lSequence - (mColumns - 1)));
+        }
+    }
+    if (lRow == mRows - 1u) {
+        complete(lColumn, RISTNetFEC::ParityType::kColumn, (uint16_t) (lSequence - (mRows - 1) * mColumns));
+    }
+    mMatrixIndex = (mMatrixIndex + 1) % ((size_t) mColumns * mRows);
+    return lSequence;
+}
+
+RISTNetFECDecoder::RISTNetFECDecoder(size_t lMaxPayloadSize)
+        : mMaxPayloadSize(lMaxPayloadSize),
+          mMediaData(new uint8_t[kWindowSize * lMaxPayloadSize]),
+          mWindow(kWindowSize),
+          mPendingData(new uint8_t[kMaxPendingParity * (RISTNetFEC::kParityHeaderSize + lMaxPayloadSize)]),
+          mPending(kMaxPendingParity) {
+}
+
+size_t RISTNetFECDecoder::maxMemoryUsage(size_t lMaxPayloadSize) {
+    return kWindowSize * (sizeof(Media) + lMaxPayloadSize) +
+           kMaxPendingParity * (sizeof(Pending) + RISTNetFEC::kParityHeaderSize + lMaxPayloadSize);
+}
+
+bool RISTNetFECDecoder::addMedia(const uint8_t *pData, size_t lSize, uint16_t lFlowId, uint16_t lSequence) {
+    Media &rSlot = slot(lSequence);
+    if (rSlot.mValid && rSlot.mSequence == lSequence) {
+        mDuplicatePackets++;
+        return false;
+    }
+    mRecoveredCount = 0;
+    if (lSize > mMaxPayloadSize) {
+        rSlot.mValid = false;
+        return true;
+    }
+    memcpy(data(lSequence), pData, lSize);
+    rSlot.mSize = lSize;
+    rSlot.mFlowId = lFlowId;
+    rSlot.mSequence = lSequence;
+    rSlot.mValid = true;
+    return true;
+}
+
+bool RISTNetFECDecoder::addParity(const uint8_t *pData, size_t lSize) {
+    mRecoveredCount = 0;
+    if (lSize < RISTNetFEC::kParityHeaderSize || pData[0] > (uint8_t) RISTNetFEC::ParityType::kRow ||
+        !RISTNetFEC::isValidMatrix(pData[1], pData[2])) {
+        return false;
+    }
+    mParityPackets++;
+
+    Result lResult = tryRecover(pData, lSize);
+    if (lResult == Result::kPending) {
+        keepParity(pData, lSize);
+        return true;
+    }
+
+    // Every recovered packet might complete a parity packet kept earlier
+    while (lResult == Result::kRecovered) {
+        lResult = Result::kDone;
+        for (size_t i = 0; i < mPending.size(); i++) {
+            Pending &rPending = mPending[i];
+            if (!rPending.mValid) {
+                continue;
+            }
+            Result lPendingResult = tryRecover(pendingData(i), rPending.mSize);
+            if (lPendingResult != Result::kPending) {
+                rPending.mValid = false;
+                lResult = lPendingResult;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void RISTNetFECDecoder::keepParity(const uint8_t *pData, size_t lSize) {
+    if (lSize > RISTNetFEC::kParityHeaderSize + mMaxPayloadSize) {
+        return;
+    }
+    size_t lIndex = 0;
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (!mPending[i].mValid) {
+            lIndex = i;
+            break;
+        }
+        if (mPending[i].mAge < mPending[lIndex].mAge) {
+            lIndex = i;
+        }
+    }
+    memcpy(pendingData(lIndex), pData, lSize);
+    mPending[lIndex].mSize = lSize;
+    mPending[lIndex].mAge = mPendingAge++;
+    mPending[lIndex].mValid = true;
+}
+
+RISTNetFECDecoder::Result RISTNetFECDecoder::tryRecover(const uint8_t *pParity, size_t lSize) {
+    bool lRow = pParity[0] == (uint8_t) RISTNetFEC::ParityType::kRow;
+    uint8_t lColumns = pParity[1];
+    uint8_t lRows = pParity[2];
+    uint16_t lFirst = RISTNetFEC::readSequence(pParity + 4);
+    size_t lCount = lRow ? lColumns : lRows;
+    uint16_t lStep = lRow ? 1 : lColumns;
+
+    uint16_t lMissing = 0;
+    size_t lMissingCount = 0;
+    for (size_t i = 0; i < lCount; i++) {
+        uint16_t lSequence = (uint16_t) (lFirst + i * lStep);
+        if (!isPresent(lSequence)) {
+            lMissing = lSequence;
+            lMissingCount++;
+        }
+    }
+    if (lMissingCount == 0) {
+        return Result::kDone;
+    }
+    if (lMissingCount > 1) {
+        return Result::kPending;
+    }
+
+    size_t lParitySize = lSize - RISTNetFEC::kParityHeaderSize;
+    if (lParitySize > mMaxPayloadSize) {
+        LOGGER(true, LOGG_ERROR, "FEC parity longer than the packets kept.")
+        return Result::kDone;
+    }
+    uint16_t lLength = RISTNetFEC::readSequence(pParity + 6);
+    uint16_t lFlowId = RISTNetFEC::readSequence(pParity + 8);
+    Media &rMissing = slot(lMissing);
+    uint8_t *pMissing = data(lMissing);
+    rMissing.mValid = false;
+    memcpy(pMissing, pParity + RISTNetFEC::kParityHeaderSize, lParitySize);
+    for (size_t i = 0; i < lCount; i++) {
+        uint16_t lSequence = (uint16_t) (lFirst + i * lStep);
+        if (lSequence == lMissing) {
+            continue;
+        }
+        const Media &rMedia = slot(lSequence);
+        if (rMedia.mSize > lParitySize) {
+            LOGGER(true, LOGG_ERROR, "FEC parity shorter than the protected packets.")
+            return Result::kDone;
+        }
+        RISTNetXOR::xorInto(pMissing, data(lSequence), rMedia.mSize);
+        lLength ^= (uint16_t) rMedia.mSize;
+        lFlowId ^= rMedia.mFlowId;
+    }
+    if (lLength > lParitySize) {
+        LOGGER(true, LOGG_ERROR, "FEC recovered length not valid.")
+        return Result::kDone;
+    }
+    rMissing.mSize = lLength;
+    rMissing.mFlowId = lFlowId;
+    rMissing.mSequence = lMissing;
+    rMissing.mValid = true;
+    mRecoveredPackets++;
+    mRecovered[mRecoveredCount++] = lMissing;
+    return Result::kRecovered;
+}
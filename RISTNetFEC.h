@@ -0,0 +1,250 @@
+//
+// Row/column XOR forward error correction used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETFEC_H
+#define CPPRISTWRAPPER__RISTNETFEC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+/**
+ * \class RISTNetXOR
+ *
+ * \brief
+ *
+ * XOR kernels used by the FEC. The fastest kernel supported by the CPU is selected at startup.
+ *
+ */
+class RISTNetXOR {
+public:
+    enum class Kernel {
+        kScalar,
+        kAVX2,
+        kNEON
+    };
+
+    /// pDst[i] ^= pSrc[i] for lSize bytes using the selected kernel
+    static void xorInto(uint8_t *pDst, const uint8_t *pSrc, size_t lSize);
+
+    /// pDst[i] ^= pSrc[i] for lSize bytes using the given kernel. The kernel must be supported
+    static void xorInto(uint8_t *pDst, const uint8_t *pSrc, size_t lSize, Kernel lKernel);
+
+    /// The kernel used by xorInto
+    static Kernel selectedKernel();
+
+    /// true if the CPU supports the kernel
+    static bool isSupported(Kernel lKernel);
+
+    /// The name of the kernel, e.g. "avx2"
+    static const char *kernelName(Kernel lKernel);
+};
+
+/**
+ * \class RISTNetFEC
+ *
+ * \brief
+ *
+ * Wire format shared by the FEC encoder and decoder. SMPTE 2022-1 style, packets are arranged in a matrix
+ * of L columns and D rows. Every column (D packets, L apart) and optionally every row (L consecutive packets)
+ * is protected by one parity packet.
+ *
+ * Media packets get a 16-bit big endian sequence number trailer. Parity packets are sent on their own flow_id and
+ * start with a header:
+ *   0     type, 0 = column, 1 = row
+ *   1     L
+ *   2     D
+ *   3     reserved
+ *   4-5   sequence number of the first protected packet
+ *   6-7   XOR of the lengths of the protected packets
+ *   8-9   XOR of the flow_ids of the protected packets
+ * followed by the XOR of the protected packets zero padded to the longest of them.
+ *
+ */
+class RISTNetFEC {
+public:
+    static constexpr uint16_t kDefaultFlowId = 0xFEC0;
+    static constexpr size_t kSequenceTrailerSize = 2;
+    static constexpr size_t kParityHeaderSize = 10;
+    static constexpr uint8_t kMaxColumns = 20;
+    static constexpr uint8_t kMaxRows = 20;
+    static constexpr size_t kMaxMatrixSize = 100; // L x D
+
+    enum class ParityType : uint8_t {
+        kColumn = 0,
+        kRow = 1
+    };
+
+    /// true if the matrix is valid
+    static bool isValidMatrix(uint8_t lColumns, uint8_t lRows);
+
+    static void writeSequence(uint8_t *pDst, uint16_t lSequence) {
+        pDst[0] = (uint8_t) (lSequence >> 8);
+        pDst[1] = (uint8_t) lSequence;
+    }
+
+    static uint16_t readSequence(const uint8_t *pSrc) {
+        return (uint16_t) ((pSrc[0] << 8) | pSrc[1]);
+    }
+};
+
+/**
+ * \class RISTNetFECEncoder
+ *
+ * \brief
+ *
+ * Generates the parity packets for the media packets sent. All memory is allocated by configure().
+ *
+ */
+class RISTNetFECEncoder {
+public:
+    /// Set the matrix. lRowParity adds row parity packets (2D FEC). Returns false if the matrix is not valid
+    bool configure(uint8_t lColumns, uint8_t lRows, bool lRowParity, size_t lMaxPayloadSize);
+
+    /// Protect a media packet of at most lMaxPayloadSize bytes. Returns the sequence number for its trailer
+    uint16_t addPacket(const uint8_t *pData, size_t lSize, uint16_t lFlowId);
+
+    /// Number of parity packets completed by the last addPacket (0 - 2)
+    size_t readyParityCount() const { return mReadyCount; }
+
+    /// A completed parity packet, valid until the next addPacket
+    const uint8_t *readyParityData(size_t lIndex) const { return mParity[mReady[lIndex]].mData.data(); }
+    size_t readyParitySize(size_t lIndex) const;
+
+    /// Bytes held by the parity buffers
+    size_t memoryUsage() const;
+
+private:
+    struct Parity {
+        std::vector<uint8_t> mData; // Header followed by the XOR of the payloads
+        size_t mMaxSize = 0;        // The longest payload added
+        uint16_t mLengthRecovery = 0;
+        uint16_t mFlowIdRecovery = 0;
+        bool mComplete = false;     // Sent, cleared by the next add
+    };
+
+    void add(Parity &rParity, const uint8_t *pData, size_t lSize, uint16_t lFlowId);
+    void complete(size_t lParity, RISTNetFEC::ParityType lType, uint16_t lFirstSequence);
+
+    uint8_t mColumns = 0;
+    uint8_t mRows = 0;
+    bool mRowParity = false;
+    uint16_t mSequence = 0;
+    size_t mMatrixIndex = 0;
+    // mColumns column parities followed by the row parity
+    std::vector<Parity> mParity;
+    size_t mReady[2] = {};
+    size_t mReadyCount = 0;
+};
+
+/**
+ * \class RISTNetFECDecoder
+ *
+ * \brief
+ *
+ * Keeps the latest media packets of a connection and rebuilds lost packets from the parity packets.
+ * A parity packet missing more than one packet is kept and retried when another packet is recovered,
+ * this allows 2D FEC to recover bursts. All memory is allocated by the constructor.
+ *
+ * A packet is rebuilt when its parity packet arrives, after the media packets following it in the matrix.
+ * Recovered packets are therefore out of order.
+ *
+ */
+class RISTNetFECDecoder {
+public:
+    /// Media packets longer than lMaxPayloadSize are not kept, the parity packets protecting them are useless
+    explicit RISTNetFECDecoder(size_t lMaxPayloadSize);
+
+    /// Add a received media packet (without the sequence trailer). Returns false if the packet was already recovered
+    bool addMedia(const uint8_t *pData, size_t lSize, uint16_t lFlowId, uint16_t lSequence);
+
+    /// Add a received parity packet. Returns false if the parity packet is malformed
+    bool addParity(const uint8_t *pData, size_t lSize);
+
+    /// Number of packets recovered by the last addParity, in the order they were rebuilt
+    size_t recoveredCount() const { return mRecoveredCount; }
+
+    /// A recovered packet, valid until the next addMedia or addParity
+    const uint8_t *recoveredData(size_t lIndex) const { return data(mRecovered[lIndex]); }
+    size_t recoveredSize(size_t lIndex) const { return slot(mRecovered[lIndex]).mSize; }
+    uint16_t recoveredFlowId(size_t lIndex) const { return slot(mRecovered[lIndex]).mFlowId; }
+
+    uint64_t parityPackets() const { return mParityPackets; }
+    uint64_t recoveredPackets() const { return mRecoveredPackets; }
+    uint64_t duplicatePackets() const { return mDuplicatePackets; }
+
+    /// Bytes held by the packets kept
+    size_t memoryUsage() const { return maxMemoryUsage(mMaxPayloadSize); }
+
+    /// The bytes a decoder holds for payloads of at most lMaxPayloadSize bytes
+    static size_t maxMemoryUsage(size_t lMaxPayloadSize);
+
+    RISTNetFECDecoder(RISTNetFECDecoder const &) = delete;
+    RISTNetFECDecoder &operator=(RISTNetFECDecoder const &) = delete;
+
+private:
+    // Twice the largest matrix, rounded up to a power of two
+    static constexpr size_t kWindowSize = 256;
+    // Parity packets kept for later recovery
+    static constexpr size_t kMaxPendingParity = 2 * (RISTNetFEC::kMaxColumns + 1);
+
+    struct Media {
+        size_t mSize = 0;
+        uint16_t mFlowId = 0;
+        uint16_t mSequence = 0;
+        bool mValid = false;
+    };
+
+    struct Pending {
+        size_t mSize = 0;
+        uint64_t mAge = 0;  // Order the parity packets were kept in, the oldest is replaced first
+        bool mValid = false;
+    };
+
+    const Media &slot(uint16_t lSequence) const { return mWindow[lSequence & (kWindowSize - 1)]; }
+    Media &slot(uint16_t lSequence) { return mWindow[lSequence & (kWindowSize - 1)]; }
+    const uint8_t *data(uint16_t lSequence) const {
+        return mMediaData.get() + (lSequence & (kWindowSize - 1)) * mMaxPayloadSize;
+    }
+    uint8_t *data(uint16_t lSequence) { return mMediaData.get() + (lSequence & (kWindowSize - 1)) * mMaxPayloadSize; }
+    uint8_t *pendingData(size_t lIndex) {
+        return mPendingData.get() + lIndex * (RISTNetFEC::kParityHeaderSize + mMaxPayloadSize);
+    }
+    bool isPresent(uint16_t lSequence) { auto &rSlot = slot(lSequence); return rSlot.mValid && rSlot.mSequence == lSequence; }
+
+    enum class Result {
+        kDone,      // Nothing was missing or the parity is useless
+        kRecovered, // A packet was recovered
+        kPending    // More than one packet is missing, keep the parity
+    };
+
+    // Try to recover one packet using a validated parity packet
+    Result tryRecover(const uint8_t *pParity, size_t lSize);
+
+    // Keep a parity packet, replacing the oldest one kept if there is no room
+    void keepParity(const uint8_t *pData, size_t lSize);
+
+    size_t mMaxPayloadSize;
+    // The payloads are not initialised, the pages of the slots never used are never touched
+    std::unique_ptr<uint8_t[]> mMediaData;
+    std::vector<Media> mWindow;
+    std::unique_ptr<uint8_t[]> mPendingData;
+    std::vector<Pending> mPending;
+    uint64_t mPendingAge = 0;
+    // Every addParity recovers at most one packet per parity packet it holds
+    uint16_t mRecovered[kMaxPendingParity + 1] = {};
+    size_t mRecoveredCount = 0;
+    uint64_t mParityPackets = 0;
+    uint64_t mRecoveredPackets = 0;
+    uint64_t mDuplicatePackets = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETFEC_H
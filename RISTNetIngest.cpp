@@ -0,0 +1,326 @@
+//
+// UDP and multicast ingest feeding a RISTNetSender.
+//
+
+#include "RISTNetIngest.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// recvmmsg is Linux only, elsewhere start() fails
+#ifdef __linux__
+namespace {
+    // Longest poll wait, bounds the time stop() waits for the ingest threads
+    constexpr int kPollTimeout = 100; // ms
+    // Room for the SO_RXQ_OVFL counter in the control data of every datagram
+    constexpr size_t kControlSize = CMSG_SPACE(sizeof(uint32_t));
+
+    bool toAddress(const std::string &rIP, uint16_t lPort, sockaddr_storage &rAddress, socklen_t &rLength) {
+        memset(&rAddress, 0, sizeof(rAddress));
+        auto *pV4 = (sockaddr_in *) &rAddress;
+        if (inet_pton(AF_INET, rIP.c_str(), &pV4->sin_addr) == 1) {
+            pV4->sin_family = AF_INET;
+            pV4->sin_port = htons(lPort);
+            rLength = sizeof(sockaddr_in);
+            return true;
+        }
+        auto *pV6 = (sockaddr_in6 *) &rAddress;
+        if (inet_pton(AF_INET6, rIP.c_str(), &pV6->sin6_addr) == 1) {
+            pV6->sin6_family = AF_INET6;
+            pV6->sin6_port = htons(lPort);
+            rLength = sizeof(sockaddr_in6);
+            return true;
+        }
+        return false;
+    }
+
+    bool isMulticast(const sockaddr_storage &rAddress) {
+        if (rAddress.ss_family == AF_INET) {
+            return IN_MULTICAST(ntohl(((const sockaddr_in *) &rAddress)->sin_addr.s_addr));
+        }
+        return IN6_IS_ADDR_MULTICAST(&((const sockaddr_in6 *) &rAddress)->sin6_addr);
+    }
+
+    bool joinGroup(int lSocket, const sockaddr_storage &rGroup, const RISTNetUDPSource &rSource) {
+        if (rGroup.ss_family == AF_INET) {
+            in_addr lInterface{};
+            lInterface.s_addr = htonl(INADDR_ANY);
+            if (!rSource.mInterface.empty() && inet_pton(AF_INET, rSource.mInterface.c_str(), &lInterface) != 1) {
+                LOGGER(true, LOGG_ERROR, "Multicast interface not valid: " << rSource.mInterface)
+                return false;
+            }
+            if (rSource.mSourceAddress.empty()) {
+                ip_mreq lRequest{};
+                lRequest.imr_multiaddr = ((const sockaddr_in *) &rGroup)->sin_addr;
+                lRequest.imr_interface = lInterface;
+                return !setsockopt(lSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &lRequest, sizeof(lRequest));
+            }
+            ip_mreq_source lRequest{};
+            lRequest.imr_multiaddr = ((const sockaddr_in *) &rGroup)->sin_addr;
+            lRequest.imr_interface = lInterface;
+            if (inet_pton(AF_INET, rSource.mSourceAddress.c_str(), &lRequest.imr_sourceaddr) != 1) {
+                LOGGER(true, LOGG_ERROR, "Multicast source not valid: " << rSource.mSourceAddress)
+                return false;
+            }
+            return !setsockopt(lSocket, IPPROTO_IP, IP_ADD_SOURCE_MEMBERSHIP, &lRequest, sizeof(lRequest));
+        }
+
+        uint32_t lInterface = 0;
+        if (!rSource.mInterface.empty()) {
+            lInterface = if_nametoindex(rSource.mInterface.c_str());
+            if (!lInterface) {
+                LOGGER(true, LOGG_ERROR, "Multicast interface not found: " << rSource.mInterface)
+                return false;
+            }
+        }
+        if (rSource.mSourceAddress.empty()) {
+            group_req lRequest{};
+            lRequest.gr_interface = lInterface;
+            memcpy(&lRequest.gr_group, &rGroup, sizeof(sockaddr_in6));
+            return !setsockopt(lSocket, IPPROTO_IPV6, MCAST_JOIN_GROUP, &lRequest, sizeof(lRequest));
+        }
+        group_source_req lRequest{};
+        lRequest.gsr_interface = lInterface;
+        memcpy(&lRequest.gsr_group, &rGroup, sizeof(sockaddr_in6));
+        sockaddr_storage lSource{};
+        socklen_t lSourceLength;
+        if (!toAddress(rSource.mSourceAddress, 0, lSource, lSourceLength) || lSource.ss_family != AF_INET6) {
+            LOGGER(true, LOGG_ERROR, "Multicast source not valid: " << rSource.mSourceAddress)
+            return false;
+        }
+        memcpy(&lRequest.gsr_source, &lSource, sizeof(sockaddr_in6));
+        return !setsockopt(lSocket, IPPROTO_IPV6, MCAST_JOIN_SOURCE_GROUP, &lRequest, sizeof(lRequest));
+    }
+}
+#endif
+
+RISTNetUDPIngest::~RISTNetUDPIngest() {
+    stop();
+}
+
+bool RISTNetUDPIngest::start(RISTNetSender &rSender, const RISTNetUDPIngestSettings &rSettings) {
+    stop();
+#ifdef __linux__
+    if (rSettings.mSources.empty() || !rSettings.mBatchSize || !rSettings.mMaxDatagramSize) {
+        LOGGER(true, LOGG_ERROR, "UDP ingest: no sources, batch size or datagram size.")
+        return false;
+    }
+    mSender = &rSender;
+    mSettings = rSettings;
+    for (auto &rSourceSettings: mSettings.mSources) {
+        auto lSource = std::make_unique<Source>();
+        lSource->mSettings = rSourceSettings;
+        if (!openSource(*lSource)) {
+            if (lSource->mSocket >= 0) {
+                close(lSource->mSocket);
+            }
+            stop();
+            return false;
+        }
+        mSources.push_back(std::move(lSource));
+    }
+    mRunning = true;
+    for (auto &rSource: mSources) {
+        rSource->mThread = std::thread(&RISTNetUDPIngest::ingestWorker, this, std::ref(*rSource));
+    }
+    return true;
+#else
+    (void) rSender;
+    (void) rSettings;
+    LOGGER(true, LOGG_ERROR, "UDP ingest needs recvmmsg, only available on Linux.")
+    return false;
+#endif
+}
+
+#ifdef __linux__
+bool RISTNetUDPIngest::openSource(Source &rSource) {
+    const RISTNetUDPSource &rSettings = rSource.mSettings;
+    sockaddr_storage lAddress{};
+    socklen_t lLength;
+    if (!toAddress(rSettings.mAddress, rSettings.mPort, lAddress, lLength)) {
+        LOGGER(true, LOGG_ERROR, "UDP ingest address not valid: " << rSettings.mAddress)
+        return false;
+    }
+    rSource.mSocket = socket(lAddress.ss_family, SOCK_DGRAM, 0);
+    if (rSource.mSocket < 0) {
+        LOGGER(true, LOGG_ERROR, "UDP ingest socket failed: " << strerror(errno))
+        return false;
+    }
+    int lFlags = fcntl(rSource.mSocket, F_GETFL, 0);
+    fcntl(rSource.mSocket, F_SETFL, lFlags | O_NONBLOCK);
+    if (mSettings.mReceiveBufferSize) {
+        setsockopt(rSource.mSocket, SOL_SOCKET, SO_RCVBUF, &mSettings.mReceiveBufferSize,
+                   sizeof(mSettings.mReceiveBufferSize));
+    }
+#ifdef SO_RXQ_OVFL
+    int lOne = 1;
+    if (setsockopt(rSource.mSocket, SOL_SOCKET, SO_RXQ_OVFL, &lOne, sizeof(lOne))) {
+        LOGGER(true, LOGG_WARN, "UDP ingest: SO_RXQ_OVFL not supported, socket drops are not counted.")
+    }
+#endif
+#ifdef SO_BUSY_POLL
+    if (mSettings.mBusyPollMicros &&
+        setsockopt(rSource.mSocket, SOL_SOCKET, SO_BUSY_POLL, &mSettings.mBusyPollMicros,
+                   sizeof(mSettings.mBusyPollMicros))) {
+        LOGGER(true, LOGG_WARN, "UDP ingest: SO_BUSY_POLL failed: " << strerror(errno))
+    }
+#endif
+
+    bool lMulticast = isMulticast(lAddress);
+    if (lMulticast) {
+        // Other processes may read the same group
+        int lReuse = 1;
+        setsockopt(rSource.mSocket, SOL_SOCKET, SO_REUSEADDR, &lReuse, sizeof(lReuse));
+    }
+    if (bind(rSource.mSocket, (sockaddr *) &lAddress, lLength)) {
+        LOGGER(true, LOGG_ERROR, "UDP ingest bind failed: " << rSettings.mAddress << ":" << rSettings.mPort << " "
+                                 << strerror(errno))
+        return false;
+    }
+    if (lMulticast && !joinGroup(rSource.mSocket, lAddress, rSettings)) {
+        LOGGER(true, LOGG_ERROR, "UDP ingest could not join " << rSettings.mAddress << ": " << strerror(errno))
+        return false;
+    }
+
+    sockaddr_storage lBound{};
+    socklen_t lBoundLength = sizeof(lBound);
+    getsockname(rSource.mSocket, (sockaddr *) &lBound, &lBoundLength);
+    rSource.mPort = ntohs(lBound.ss_family == AF_INET ? ((sockaddr_in *) &lBound)->sin_port :
+                          ((sockaddr_in6 *) &lBound)->sin6_port);
+    return true;
+}
+#endif
+
+void RISTNetUDPIngest::stop() {
+    mRunning = false;
+    for (auto &rSource: mSources) {
+        if (rSource->mThread.joinable()) {
+            rSource->mThread.join();
+        }
+        close(rSource->mSocket);
+    }
+    mSources.clear();
+}
+
+uint16_t RISTNetUDPIngest::port(size_t lIndex) const {
+    return lIndex < mSources.size() ? mSources[lIndex]->mPort : 0;
+}
+
+bool RISTNetUDPIngest::getStatistics(size_t lIndex, RISTNetUDPIngestStatistics &rStatistics) {
+    if (lIndex >= mSources.size()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(mSources[lIndex]->mMtx);
+    rStatistics = mSources[lIndex]->mStatistics;
+    return true;
+}
+
+void RISTNetUDPIngest::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    rThreads.clear();
+    for (auto &rSource: mSources) {
+        std::lock_guard<std::mutex> lLock(rSource->mMtx);
+        rThreads.insert(rThreads.end(), rSource->mThreadInfo.begin(), rSource->mThreadInfo.end());
+    }
+}
+
+#ifdef __linux__
+void RISTNetUDPIngest::ingestWorker(Source &rSource) {
+    if (!rSource.mSettings.mThreadSettings.isDefault()) {
+        RISTNetThreadInfo lInfo;
+        RISTNetThreadBinder::applyToCurrentThread(rSource.mSettings.mThreadSettings, lInfo);
+        lInfo.mRole = "ingest";
+        std::lock_guard<std::mutex> lLock(rSource.mMtx);
+        rSource.mThreadInfo.push_back(lInfo);
+    }
+
+    // Everything recvmmsg needs is set up once, the datagram buffers are reused for every batch
+    const size_t lBatchSize = mSettings.mBatchSize;
+    const size_t lDatagramSize = mSettings.mMaxDatagramSize;
+    std::vector<uint8_t> lBuffers(lBatchSize * lDatagramSize);
+    std::vector<uint64_t> lControl((lBatchSize * kControlSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    std::vector<iovec> lVectors(lBatchSize);
+    std::vector<mmsghdr> lMessages(lBatchSize);
+    std::vector<RISTNetSender::DataBlock> lBlocks(lBatchSize);
+    for (size_t i = 0; i < lBatchSize; i++) {
+        lVectors[i].iov_base = lBuffers.data() + i * lDatagramSize;
+        lVectors[i].iov_len = lDatagramSize;
+        lMessages[i].msg_hdr.msg_iov = &lVectors[i];
+        lMessages[i].msg_hdr.msg_iovlen = 1;
+        lMessages[i].msg_hdr.msg_control = (uint8_t *) lControl.data() + i * kControlSize;
+    }
+
+    pollfd lPoll{rSource.mSocket, POLLIN, 0};
+    uint32_t lLastOverflow = 0;
+    while (mRunning) {
+        for (auto &rMessage: lMessages) {
+            rMessage.msg_hdr.msg_controllen = kControlSize;
+            rMessage.msg_hdr.msg_flags = 0;
+        }
+        int lReceived = recvmmsg(rSource.mSocket, lMessages.data(), (unsigned int) lBatchSize, MSG_DONTWAIT,
+                                 nullptr);
+        if (lReceived <= 0) {
+            if (lReceived < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::lock_guard<std::mutex> lLock(rSource.mMtx);
+                rSource.mStatistics.mReceiveErrors++;
+            }
+            if (!mSettings.mBusyPoll) {
+                poll(&lPoll, 1, kPollTimeout);
+            }
+            continue;
+        }
+
+        size_t lCount = 0;
+        size_t lBytes = 0;
+        uint64_t lTruncated = 0;
+        uint64_t lSocketDrops = 0;
+        for (int i = 0; i < lReceived; i++) {
+            msghdr &rHeader = lMessages[i].msg_hdr;
+#ifdef SO_RXQ_OVFL
+            for (cmsghdr *pControl = CMSG_FIRSTHDR(&rHeader); pControl; pControl = CMSG_NXTHDR(&rHeader, pControl)) {
+                if (pControl->cmsg_level == SOL_SOCKET && pControl->cmsg_type == SO_RXQ_OVFL) {
+                    // The drops of the socket so far, wrapping
+                    uint32_t lOverflow;
+                    memcpy(&lOverflow, CMSG_DATA(pControl), sizeof(lOverflow));
+                    lSocketDrops += (uint32_t) (lOverflow - lLastOverflow);
+                    lLastOverflow = lOverflow;
+                }
+            }
+#endif
+            if (rHeader.msg_flags & MSG_TRUNC) {
+                lTruncated++;
+                continue;
+            }
+            RISTNetSender::DataBlock &rBlock = lBlocks[lCount++];
+            rBlock.mData = (const uint8_t *) lVectors[i].iov_base;
+            rBlock.mSize = lMessages[i].msg_len;
+            rBlock.mConnectionID = rSource.mSettings.mConnectionID;
+            lBytes += lMessages[i].msg_len;
+        }
+        size_t lSent = 0;
+        if (lCount) {
+            // The sources share the sender, it is called from one thread at a time
+            std::lock_guard<std::mutex> lSendLock(mSendMtx);
+            lSent = mSender->sendDataBatch(lBlocks.data(), lCount);
+        }
+
+        std::lock_guard<std::mutex> lLock(rSource.mMtx);
+        RISTNetUDPIngestStatistics &rStatistics = rSource.mStatistics;
+        rStatistics.mDatagrams += lReceived;
+        rStatistics.mBytes += lBytes;
+        rStatistics.mBatches++;
+        rStatistics.mTruncated += lTruncated;
+        rStatistics.mSocketDrops += lSocketDrops;
+        rStatistics.mForwardDrops += lCount - lSent;
+    }
+}
+#endif
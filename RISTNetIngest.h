@@ -0,0 +1,131 @@
+//
+// UDP and multicast ingest feeding a RISTNetSender.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETINGEST_H
+#define CPPRISTWRAPPER__RISTNETINGEST_H
+
+#include "RISTNet.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+/**
+ * \class RISTNetUDPSource
+ *
+ * \brief
+ *
+ * A UDP socket read by RISTNetUDPIngest. A multicast group is joined when mAddress is one.
+ *
+ */
+struct RISTNetUDPSource {
+    std::string mAddress = "0.0.0.0";   // The unicast address or the multicast group to bind to
+    uint16_t mPort = 0;                  // 0 = any free port, see RISTNetUDPIngest::port()
+    std::string mInterface;              // Multicast: IPv4 address or IPv6 interface name to join on, empty = any
+    std::string mSourceAddress;          // Multicast: only receive from this source (SSM), empty = any
+    uint16_t mConnectionID = 0;          // The connection ID the datagrams are sent with
+    RISTNetThreadSettings mThreadSettings; // CPU placement and scheduling of the thread reading the socket
+};
+
+/**
+ * \class RISTNetUDPIngestSettings
+ *
+ * \brief
+ *
+ * Settings of RISTNetUDPIngest.
+ *
+ */
+struct RISTNetUDPIngestSettings {
+    std::vector<RISTNetUDPSource> mSources;
+    size_t mBatchSize = 64;              // Datagrams read per recvmmsg call and passed to sendDataBatch
+    size_t mMaxDatagramSize = 1500;      // Longer datagrams are truncated by the socket and dropped
+    int mReceiveBufferSize = 8 * 1024 * 1024; // SO_RCVBUF, 0 = system default
+    bool mBusyPoll = false;              // Spin on the socket instead of sleeping in poll(), takes a CPU per source
+    int mBusyPollMicros = 0;             // SO_BUSY_POLL, the kernel polls the NIC queue while reading, 0 = off
+};
+
+/**
+ * \class RISTNetUDPIngestStatistics
+ *
+ * \brief
+ *
+ * Counters of one source of RISTNetUDPIngest.
+ *
+ */
+struct RISTNetUDPIngestStatistics {
+    uint64_t mDatagrams = 0;       // Datagrams read
+    uint64_t mBytes = 0;           // Bytes read
+    uint64_t mBatches = 0;         // recvmmsg calls returning data, mDatagrams / mBatches is the batch fill
+    uint64_t mSocketDrops = 0;     // Datagrams dropped by the socket because the receive buffer was full
+    uint64_t mTruncated = 0;       // Datagrams longer than mMaxDatagramSize, dropped
+    uint64_t mForwardDrops = 0;    // Datagrams the sender did not accept (queue full, not initialised)
+    uint64_t mReceiveErrors = 0;   // recvmmsg failures
+};
+
+/**
+ * \class RISTNetUDPIngest
+ *
+ * \brief
+ *
+ * Reads UDP or multicast sources and sends the datagrams with a RISTNetSender, one datagram per packet.
+ * Every source has a socket and a thread reading it with recvmmsg into buffers allocated at start, a batch
+ * at a time, and passing the batch to RISTNetSender::sendDataBatch. The sources take turns calling the sender,
+ * nothing else may send with it meanwhile unless it has a send queue. The sender must outlive the ingest.
+ * Socket drops are counted using SO_RXQ_OVFL. Linux only, start() fails elsewhere.
+ *
+ */
+class RISTNetUDPIngest {
+public:
+    ~RISTNetUDPIngest();
+
+    /// Open the sources and start reading. Returns false, with nothing started, if a source can not be opened
+    bool start(RISTNetSender &rSender, const RISTNetUDPIngestSettings &rSettings);
+
+    void stop();
+
+    /// The port source lIndex is bound to
+    uint16_t port(size_t lIndex) const;
+
+    /// Statistics of source lIndex. Returns false if there is no such source
+    bool getStatistics(size_t lIndex, RISTNetUDPIngestStatistics &rStatistics);
+
+    /// The threads reading the sources, if thread settings were given
+    void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+    RISTNetUDPIngest() = default;
+    RISTNetUDPIngest(RISTNetUDPIngest const &) = delete;
+    RISTNetUDPIngest &operator=(RISTNetUDPIngest const &) = delete;
+
+private:
+    struct Source {
+        RISTNetUDPSource mSettings;
+        int mSocket = -1;
+        uint16_t mPort = 0;
+        std::thread mThread;
+        std::mutex mMtx;
+        RISTNetUDPIngestStatistics mStatistics;
+        std::vector<RISTNetThreadInfo> mThreadInfo;
+    };
+
+    bool openSource(Source &rSource);
+    void ingestWorker(Source &rSource);
+
+    RISTNetSender *mSender = nullptr;
+    std::mutex mSendMtx; // Held by a source thread calling the sender
+    RISTNetUDPIngestSettings mSettings;
+    std::vector<std::unique_ptr<Source>> mSources;
+    std::atomic<bool> mRunning{false};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETINGEST_H
@@ -0,0 +1,132 @@
+//
+// Latency probes and histogram used by the RIST C++ wrapper.
+//
+
+#include "RISTNetLatency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetLatencyHistogram
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetLatencyHistogram::RISTNetLatencyHistogram() :
+        mCounts(kBucketCount, 0) {
+}
+
+size_t RISTNetLatencyHistogram::indexForValue(uint64_t lValue) {
+    if (lValue < kSubBucketCount) {
+        return (size_t) lValue;
+    }
+    uint32_t lMsb = 63 - __builtin_clzll(lValue);
+    uint32_t lShift = lMsb - kSubBucketBits;
+    uint64_t lSubBucket = (lValue >> lShift) - kSubBucketCount;
+    return (size_t) ((lShift + 1) * kSubBucketCount + lSubBucket);
+}
+
+uint64_t RISTNetLatencyHistogram::valueForIndex(size_t lIndex) {
+    size_t lBucket = lIndex / kSubBucketCount;
+    uint64_t lSubBucket = lIndex % kSubBucketCount;
+    if (lBucket == 0) {
+        return lSubBucket;
+    }
+    uint32_t lShift = (uint32_t) lBucket - 1;
+    uint64_t lLower = (lSubBucket + kSubBucketCount) << lShift;
+    // Report the middle of the bucket
+    return lLower + ((uint64_t(1) << lShift) >> 1);
+}
+
+void RISTNetLatencyHistogram::recordValue(uint64_t lValue) {
+    lValue = std::min(lValue, kMaxValue);
+    mCounts[indexForValue(lValue)]++;
+    mTotalCount++;
+    mTotalSum += lValue;
+    mMinValue = std::min(mMinValue, lValue);
+    mMaxValue = std::max(mMaxValue, lValue);
+}
+
+void RISTNetLatencyHistogram::reset() {
+    std::fill(mCounts.begin(), mCounts.end(), 0);
+    mTotalCount = 0;
+    mTotalSum = 0;
+    mMinValue = UINT64_MAX;
+    mMaxValue = 0;
+}
+
+uint64_t RISTNetLatencyHistogram::valueAtPercentile(double lPercentile) const {
+    if (!mTotalCount) {
+        return 0;
+    }
+    lPercentile = std::min(std::max(lPercentile, 0.0), 100.0);
+    auto lTarget = (uint64_t) std::ceil(lPercentile / 100.0 * (double) mTotalCount);
+    lTarget = std::max(lTarget, (uint64_t) 1);
+    uint64_t lCumulative = 0;
+    for (size_t i = 0; i < mCounts.size(); i++) {
+        lCumulative += mCounts[i];
+        if (lCumulative >= lTarget) {
+            return std::min(std::max(valueForIndex(i), mMinValue), mMaxValue);
+        }
+    }
+    return mMaxValue;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetLatencyProbe
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+uint64_t RISTNetLatencyProbe::now(Clock lClock) {
+    if (lClock == Clock::kRealtime) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t RISTNetLatencyProbe::writeTrailer(uint8_t *pDst, Clock lClock) {
+    if (lClock == Clock::kNone) {
+        pDst[0] = (uint8_t) Clock::kNone;
+        return 1;
+    }
+    uint64_t lTimestamp = now(lClock);
+    for (int i = 0; i < 8; i++) {
+        pDst[i] = (uint8_t) (lTimestamp >> (56 - i * 8));
+    }
+    pDst[8] = (uint8_t) lClock;
+    return kMaxTrailerSize;
+}
+
+bool RISTNetLatencyProbe::readTrailer(const uint8_t *pBuf, size_t lSize, size_t &rPayloadSize, Clock &rClock,
+                                      uint64_t &rTimestamp) {
+    if (lSize < 1) {
+        return false;
+    }
+    uint8_t lFlag = pBuf[lSize - 1];
+    if (lFlag == (uint8_t) Clock::kNone) {
+        rClock = Clock::kNone;
+        rPayloadSize = lSize - 1;
+        return true;
+    }
+    if ((lFlag != (uint8_t) Clock::kMonotonic && lFlag != (uint8_t) Clock::kRealtime) || lSize < kMaxTrailerSize) {
+        return false;
+    }
+    const uint8_t *lTs = pBuf + lSize - kMaxTrailerSize;
+    uint64_t lTimestamp = 0;
+    for (int i = 0; i < 8; i++) {
+        lTimestamp = (lTimestamp << 8) | lTs[i];
+    }
+    rClock = (Clock) lFlag;
+    rTimestamp = lTimestamp;
+    rPayloadSize = lSize - kMaxTrailerSize;
+    return true;
+}
@@ -0,0 +1,101 @@
+//
+// Latency probes and histogram used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETLATENCY_H
+#define CPPRISTWRAPPER__RISTNETLATENCY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * \class RISTNetLatencyHistogram
+ *
+ * \brief
+ *
+ * A fixed size log-linear (HDR style) histogram of microsecond values.
+ * Values below 2^kSubBucketBits are stored exactly, larger values with a relative error below 1%.
+ * All memory is allocated in the constructor, recording a value never allocates.
+ *
+ */
+class RISTNetLatencyHistogram {
+public:
+    static constexpr uint32_t kSubBucketBits = 7;
+    static constexpr uint32_t kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr uint32_t kMaxValueBits = 36; // ~19 hours in microseconds
+    static constexpr uint64_t kMaxValue = (uint64_t(1) << kMaxValueBits) - 1;
+    static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+    // Bytes held by a histogram
+    static constexpr size_t kMemoryUsage = kBucketCount * sizeof(uint64_t);
+
+    RISTNetLatencyHistogram();
+
+    /// Record a value, values larger than kMaxValue are clamped
+    void recordValue(uint64_t lValue);
+
+    /// Clear all recorded values
+    void reset();
+
+    /// Value at the given percentile (0.0 - 100.0), 0 if empty
+    uint64_t valueAtPercentile(double lPercentile) const;
+
+    uint64_t totalCount() const { return mTotalCount; }
+    uint64_t minValue() const { return mTotalCount ? mMinValue : 0; }
+    uint64_t maxValue() const { return mMaxValue; }
+    double meanValue() const { return mTotalCount ? (double) mTotalSum / (double) mTotalCount : 0.0; }
+
+private:
+    static size_t indexForValue(uint64_t lValue);
+    static uint64_t valueForIndex(size_t lIndex);
+
+    std::vector<uint64_t> mCounts;
+    uint64_t mTotalCount = 0;
+    uint64_t mTotalSum = 0;
+    uint64_t mMinValue = UINT64_MAX;
+    uint64_t mMaxValue = 0;
+};
+
+/**
+ * \class RISTNetLatencyProbe
+ *
+ * \brief
+ *
+ * Encodes and decodes the latency probe trailer appended to every payload when probing is enabled.
+ *
+ * The trailer is one flag byte at the very end of the payload. If the flag signals a probe the
+ * flag byte is preceded by a big endian 64-bit timestamp in microseconds from the clock named by the flag.
+ *
+ */
+class RISTNetLatencyProbe {
+public:
+    enum class Clock : uint8_t {
+        kNone = 0,      // No timestamp in this packet
+        kMonotonic = 1, // std::chrono::steady_clock, only comparable on the same host
+        kRealtime = 2   // std::chrono::system_clock, comparable between NTP/PTP synced hosts
+    };
+
+    static constexpr size_t kMaxTrailerSize = sizeof(uint64_t) + 1;
+
+    /// Current time in microseconds for the given clock
+    static uint64_t now(Clock lClock);
+
+    /// Write the trailer to pDst (room for kMaxTrailerSize bytes) and return the number of bytes written
+    static size_t writeTrailer(uint8_t *pDst, Clock lClock);
+
+    /// Parse the trailer at the end of pBuf. Returns false if the trailer is malformed.
+    /// rPayloadSize is set to the size of the payload without the trailer.
+    static bool readTrailer(const uint8_t *pBuf, size_t lSize, size_t &rPayloadSize, Clock &rClock, uint64_t &rTimestamp);
+
+private:
+    /// This class cannot be instantiated
+    RISTNetLatencyProbe() = default;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETLATENCY_H
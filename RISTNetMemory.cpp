@@ -0,0 +1,117 @@
+//
+// Memory accounting and the global memory budget used by the RIST C++ wrapper.
+//
+
+#include "RISTNetMemory.h"
+#include "RISTNetInternal.h"
+
+#include <algorithm>
+
+std::atomic<size_t> RISTNetMemory::mLimit{0};
+std::atomic<RISTNetMemory::Policy> RISTNetMemory::mPolicy{RISTNetMemory::Policy::kReject};
+std::atomic<size_t> RISTNetMemory::mUsed{0};
+
+size_t RISTNetMemory::recoveryBufferSize(uint32_t lBitrate, uint32_t lLength) {
+    // kbit/s x ms = bit
+    uint64_t lPayload = (uint64_t) lBitrate * lLength / 8;
+    uint64_t lPackets = (lPayload + kTypicalPayloadSize - 1) / kTypicalPayloadSize;
+    return (size_t) (lPayload + lPackets * kPacketOverhead);
+}
+
+uint32_t RISTNetMemory::recoveryLengthFitting(uint32_t lBitrate, size_t lBytes) {
+    if (!lBitrate) {
+        return UINT32_MAX;
+    }
+    // Inverse of recoveryBufferSize, rounded down
+    uint64_t lPayload = (uint64_t) lBytes * kTypicalPayloadSize / (kTypicalPayloadSize + kPacketOverhead);
+    uint64_t lLength = lPayload * 8 / lBitrate;
+    while (lLength && recoveryBufferSize(lBitrate, (uint32_t) std::min<uint64_t>(lLength, UINT32_MAX)) > lBytes) {
+        lLength--;
+    }
+    return (uint32_t) std::min<uint64_t>(lLength, UINT32_MAX);
+}
+
+void RISTNetMemory::setLimit(size_t lLimit, Policy lPolicy) {
+    mLimit = lLimit;
+    mPolicy = lPolicy;
+}
+
+size_t RISTNetMemory::available() {
+    size_t lLimit = mLimit;
+    if (!lLimit) {
+        return SIZE_MAX;
+    }
+    size_t lUsed = mUsed;
+    return lUsed < lLimit ? lLimit - lUsed : 0;
+}
+
+bool RISTNetMemory::reserve(size_t lBytes) {
+    size_t lUsed = mUsed;
+    do {
+        size_t lLimit = mLimit;
+        if (lLimit && (lUsed > lLimit || lBytes > lLimit - lUsed)) {
+            return false;
+        }
+    } while (!mUsed.compare_exchange_weak(lUsed, lUsed + lBytes));
+    return true;
+}
+
+void RISTNetMemory::release(size_t lBytes) {
+    mUsed -= lBytes;
+}
+
+bool RISTNetMemoryAccount::reserve(size_t lBytes) {
+    if (!RISTNetMemory::reserve(lBytes)) {
+        LOGGER(true, LOGG_ERROR, "Memory budget exceeded: " << lBytes << " bytes requested, "
+                                 << RISTNetMemory::available() << " bytes available.")
+        return false;
+    }
+    mReserved += lBytes;
+    return true;
+}
+
+bool RISTNetMemoryAccount::reserveRecoveryBuffer(uint32_t lBitrate, uint32_t lMinLength, uint32_t &rLength,
+                                                 size_t &rReserved) {
+    size_t lBytes = RISTNetMemory::recoveryBufferSize(lBitrate, rLength);
+    if (RISTNetMemory::reserve(lBytes)) {
+        mReserved += lBytes;
+        rReserved = lBytes;
+        return true;
+    }
+    if (RISTNetMemory::policy() == RISTNetMemory::Policy::kClamp) {
+        // Other senders and receivers might reserve meanwhile, retry until it fits or is too short
+        while (true) {
+            uint32_t lLength = std::min(rLength, RISTNetMemory::recoveryLengthFitting(lBitrate,
+                                                                                      RISTNetMemory::available()));
+            if (lLength < lMinLength || !lLength) {
+                break;
+            }
+            lBytes = RISTNetMemory::recoveryBufferSize(lBitrate, lLength);
+            if (RISTNetMemory::reserve(lBytes)) {
+                LOGGER(true, LOGG_WARN, "Memory budget: recovery buffer clamped from " << rLength << " to "
+                                        << lLength << " ms.")
+                mReserved += lBytes;
+                rReserved = lBytes;
+                rLength = lLength;
+                return true;
+            }
+        }
+    }
+    LOGGER(true, LOGG_ERROR, "Memory budget exceeded: recovery buffer of " << rLength << " ms at " << lBitrate
+                             << " kbit/s needs " << RISTNetMemory::recoveryBufferSize(lBitrate, rLength)
+                             << " bytes, " << RISTNetMemory::available() << " bytes available.")
+    return false;
+}
+
+void RISTNetMemoryAccount::release(size_t lBytes) {
+    size_t lReserved = mReserved;
+    size_t lReleased;
+    do {
+        lReleased = std::min(lBytes, lReserved);
+    } while (!mReserved.compare_exchange_weak(lReserved, lReserved - lReleased));
+    RISTNetMemory::release(lReleased);
+}
+
+void RISTNetMemoryAccount::releaseAll() {
+    RISTNetMemory::release(mReserved.exchange(0));
+}
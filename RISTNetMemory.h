@@ -0,0 +1,123 @@
+//
+// Memory accounting and the global memory budget used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETMEMORY_H
+#define CPPRISTWRAPPER__RISTNETMEMORY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+/**
+ * \class RISTNetMemoryUsage
+ *
+ * \brief
+ *
+ * Memory held by a sender or receiver in bytes. The recovery buffers are held by librist and can not be
+ * measured, they are always the estimate for the recovery_maxbitrate and recovery_length_max in use.
+ *
+ */
+struct RISTNetMemoryUsage {
+    size_t mRecoveryBuffers = 0;  // librist recovery buffers
+    size_t mQueues = 0;           // Send and receive queues, FEC matrices and scratch buffers of the wrapper
+    size_t mConnections = 0;      // The client table and the state kept per connection
+
+    size_t total() const { return mRecoveryBuffers + mQueues + mConnections; }
+};
+
+/**
+ * \class RISTNetMemory
+ *
+ * \brief
+ *
+ * The global memory budget shared by all senders and receivers of the process. Every sender and receiver
+ * accounts the memory it estimates to hold, whether a limit is set or not, so used() is the estimate for the
+ * whole process. With a limit, initSender/initReceiver and the peer creation are rejected (or the recovery
+ * buffer is clamped) when the limit would be exceeded.
+ *
+ */
+class RISTNetMemory {
+public:
+    enum class Policy {
+        kReject, // Fail initSender/initReceiver and reject connections exceeding the limit
+        kClamp   // Shorten recovery_length_max (not below recovery_length_min) to fit, then reject
+    };
+
+    // librist buffer and packet header overhead added to every payload in a recovery buffer (estimate)
+    static constexpr size_t kPacketOverhead = 96;
+    // The payload size the recovery buffer estimate assumes, a MPEG-TS payload of 7 x 188 bytes
+    static constexpr size_t kTypicalPayloadSize = 1316;
+
+    /// Estimated size of a recovery buffer holding lLength ms at lBitrate kbit/s
+    static size_t recoveryBufferSize(uint32_t lBitrate, uint32_t lLength);
+
+    /// The longest recovery buffer (ms) at lBitrate kbit/s fitting lBytes
+    static uint32_t recoveryLengthFitting(uint32_t lBitrate, size_t lBytes);
+
+    /// Set the global limit in bytes, 0 = unlimited
+    static void setLimit(size_t lLimit, Policy lPolicy = Policy::kReject);
+
+    static size_t limit() { return mLimit; }
+    static Policy policy() { return mPolicy; }
+
+    /// Bytes accounted by all senders and receivers
+    static size_t used() { return mUsed; }
+
+    /// Bytes left under the limit, SIZE_MAX if unlimited
+    static size_t available();
+
+private:
+    friend class RISTNetMemoryAccount;
+
+    static bool reserve(size_t lBytes);
+    static void release(size_t lBytes);
+
+    static std::atomic<size_t> mLimit;
+    static std::atomic<Policy> mPolicy;
+    static std::atomic<size_t> mUsed;
+
+    /// This class cannot be instantiated
+    RISTNetMemory() = default;
+};
+
+/**
+ * \class RISTNetMemoryAccount
+ *
+ * \brief
+ *
+ * The memory one sender or receiver has reserved in the global budget. Everything still reserved is
+ * released when the account is destroyed.
+ *
+ */
+class RISTNetMemoryAccount {
+public:
+    ~RISTNetMemoryAccount() { releaseAll(); }
+
+    /// Reserve lBytes. Returns false, reserving nothing, if the limit would be exceeded
+    bool reserve(size_t lBytes);
+
+    /// Reserve a recovery buffer of rLength ms at lBitrate kbit/s. With Policy::kClamp rLength is shortened,
+    /// not below lMinLength, to fit. rReserved gets the bytes reserved. Returns false if it does not fit
+    bool reserveRecoveryBuffer(uint32_t lBitrate, uint32_t lMinLength, uint32_t &rLength, size_t &rReserved);
+
+    void release(size_t lBytes);
+    void releaseAll();
+
+    size_t reserved() const { return mReserved; }
+
+    RISTNetMemoryAccount() = default;
+    RISTNetMemoryAccount(RISTNetMemoryAccount const &) = delete;
+    RISTNetMemoryAccount &operator=(RISTNetMemoryAccount const &) = delete;
+
+private:
+    std::atomic<size_t> mReserved{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETMEMORY_H
@@ -0,0 +1,321 @@
+//
+// Framed, batched messages and requests over the OOB channel of the RIST C++ wrapper.
+//
+
+#include "RISTNetMessaging.h"
+#include "RISTNetInternal.h"
+
+#include <algorithm>
+
+namespace {
+    constexpr uint8_t kBlockMagic = 'M';
+    constexpr uint8_t kBlockVersion = 1;
+    // Buffers of sent blocks kept for the next batches
+    constexpr size_t kMaxSpareBuffers = 16;
+}
+
+RISTNetMessenger::~RISTNetMessenger() {
+    stop();
+}
+
+void RISTNetMessenger::attach(RISTNetSender &rSender) {
+    rSender.networkOOBDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                            std::shared_ptr<RISTNetSender::NetworkConnection> &,
+                                            rist_peer *pPeer) {
+        receive(pPeer, pBuf, lSize);
+    };
+    mSend = [&rSender](rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
+        return rSender.sendOOBData(pPeer, pData, lSize);
+    };
+}
+
+void RISTNetMessenger::attach(RISTNetReceiver &rReceiver) {
+    rReceiver.networkOOBDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                              std::shared_ptr<RISTNetReceiver::NetworkConnection> &,
+                                              rist_peer *pPeer) {
+        receive(pPeer, pBuf, lSize);
+    };
+    mSend = [&rReceiver](rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
+        return rReceiver.sendOOBData(pPeer, pData, lSize);
+    };
+}
+
+void RISTNetMessenger::setSendFunction(SendFunction pSend) {
+    mSend = std::move(pSend);
+}
+
+bool RISTNetMessenger::start(const RISTNetMessengerSettings &rSettings) {
+    stop();
+    if (!mSend || rSettings.mMaxBlockSize <= kBlockHeaderSize + kMessageHeaderSize ||
+        rSettings.mMaxBlockSize > RIST_MAX_PACKET_SIZE || rSettings.mBatchWindow.count() < 0) {
+        LOGGER(true, LOGG_ERROR, "Messenger: not attached or block size or batch window not valid.")
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mSettings = rSettings;
+    mRunning = true;
+    mThread = std::thread(&RISTNetMessenger::messengerWorker, this);
+    return true;
+}
+
+void RISTNetMessenger::stop() {
+    std::vector<Block> lBlocks;
+    std::vector<ResponseFunction> lStopped;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mRunning) {
+            return;
+        }
+        mRunning = false;
+        while (!mBatches.empty()) {
+            takeBatch(mBatches.back(), lBlocks);
+        }
+        for (auto &rRequest: mRequests) {
+            lStopped.push_back(std::move(rRequest.second.mResponse));
+        }
+        mRequests.clear();
+    }
+    mWake.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    sendBlocks(lBlocks);
+    for (auto &rResponse: lStopped) {
+        rResponse(Status::kStopped, nullptr);
+    }
+}
+
+bool RISTNetMessenger::send(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize) {
+    return enqueue(pPeer, kMessage, lType, 0, pData, lSize);
+}
+
+bool RISTNetMessenger::request(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize,
+                               std::chrono::milliseconds lTimeout, ResponseFunction pResponse) {
+    uint32_t lRequestID;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mRunning) {
+            LOGGER(true, LOGG_ERROR, "Messenger not started.")
+            return false;
+        }
+        lRequestID = mNextRequestID++;
+        if (!mNextRequestID) {
+            mNextRequestID = 1;
+        }
+        Request &rRequest = mRequests[lRequestID];
+        rRequest.mPeer = pPeer;
+        rRequest.mDeadline = Clock::now() + lTimeout;
+        rRequest.mResponse = std::move(pResponse);
+    }
+    mWake.notify_one();
+    if (!enqueue(pPeer, kRequest, lType, lRequestID, pData, lSize)) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mRequests.erase(lRequestID);
+        return false;
+    }
+    return true;
+}
+
+bool RISTNetMessenger::respond(const RISTNetMessage &rRequest, uint16_t lType, const uint8_t *pData, size_t lSize) {
+    if (!rRequest.mRequestID) {
+        LOGGER(true, LOGG_ERROR, "Messenger: the message is not a request.")
+        return false;
+    }
+    return enqueue(rRequest.mPeer, kResponse, lType, rRequest.mRequestID, pData, lSize);
+}
+
+void RISTNetMessenger::flush() {
+    std::vector<Block> lBlocks;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        while (!mBatches.empty()) {
+            takeBatch(mBatches.back(), lBlocks);
+        }
+    }
+    sendBlocks(lBlocks);
+}
+
+bool RISTNetMessenger::enqueue(rist_peer *pPeer, Kind lKind, uint16_t lType, uint32_t lRequestID,
+                               const uint8_t *pData, size_t lSize) {
+    std::vector<Block> lBlocks;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mRunning) {
+            LOGGER(true, LOGG_ERROR, "Messenger not started.")
+            return false;
+        }
+        size_t lFramedSize = kMessageHeaderSize + lSize;
+        if (kBlockHeaderSize + lFramedSize > mSettings.mMaxBlockSize) {
+            LOGGER(true, LOGG_ERROR, "Messenger: message too large, " << lSize << " bytes.")
+            mStatistics.mOversize++;
+            return false;
+        }
+        auto lBatch = std::find_if(mBatches.begin(), mBatches.end(),
+                                   [&](const Batch &rBatch) { return rBatch.mPeer == pPeer; });
+        if (lBatch != mBatches.end() && lBatch->mData.size() + lFramedSize > mSettings.mMaxBlockSize) {
+            takeBatch(*lBatch, lBlocks);
+            lBatch = mBatches.end();
+        }
+        if (lBatch == mBatches.end()) {
+            Batch lNew;
+            lNew.mPeer = pPeer;
+            if (!mSpareBuffers.empty()) {
+                lNew.mData = std::move(mSpareBuffers.back());
+                mSpareBuffers.pop_back();
+            }
+            lNew.mData.reserve(mSettings.mMaxBlockSize);
+            lNew.mData.assign({kBlockMagic, kBlockVersion});
+            lNew.mDeadline = Clock::now() + mSettings.mBatchWindow;
+            mBatches.push_back(std::move(lNew));
+            lBatch = mBatches.end() - 1;
+            // The thread might sleep past the new deadline
+            mWake.notify_one();
+        }
+        uint8_t lHeader[kMessageHeaderSize] = {lKind, (uint8_t) (lType >> 8), (uint8_t) lType,
+                                               (uint8_t) (lRequestID >> 24), (uint8_t) (lRequestID >> 16),
+                                               (uint8_t) (lRequestID >> 8), (uint8_t) lRequestID,
+                                               (uint8_t) (lSize >> 8), (uint8_t) lSize};
+        lBatch->mData.insert(lBatch->mData.end(), lHeader, lHeader + kMessageHeaderSize);
+        lBatch->mData.insert(lBatch->mData.end(), pData, pData + lSize);
+        lBatch->mMessages++;
+        if (!mSettings.mBatchWindow.count()) {
+            takeBatch(*lBatch, lBlocks);
+        }
+    }
+    sendBlocks(lBlocks);
+    return true;
+}
+
+void RISTNetMessenger::takeBatch(Batch &rBatch, std::vector<Block> &rBlocks) {
+    Block lBlock;
+    lBlock.mPeer = rBatch.mPeer;
+    lBlock.mData = std::move(rBatch.mData);
+    lBlock.mMessages = rBatch.mMessages;
+    rBlocks.push_back(std::move(lBlock));
+    std::swap(rBatch, mBatches.back());
+    mBatches.pop_back();
+}
+
+void RISTNetMessenger::sendBlocks(std::vector<Block> &rBlocks) {
+    for (auto &rBlock: rBlocks) {
+        bool lSent = mSend(rBlock.mPeer, rBlock.mData.data(), rBlock.mData.size());
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (lSent) {
+            mStatistics.mBlocksSent++;
+            mStatistics.mMessagesSent += rBlock.mMessages;
+        } else {
+            mStatistics.mSendErrors++;
+        }
+        if (mSpareBuffers.size() < kMaxSpareBuffers) {
+            rBlock.mData.clear();
+            mSpareBuffers.push_back(std::move(rBlock.mData));
+        }
+    }
+}
+
+void RISTNetMessenger::receive(rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
+    // Checked as a whole first, a truncated block delivers nothing
+    size_t lCount = 0;
+    bool lValid = lSize >= kBlockHeaderSize && pData[0] == kBlockMagic && pData[1] == kBlockVersion;
+    for (size_t lOffset = kBlockHeaderSize; lValid && lOffset < lSize; lCount++) {
+        if (lSize - lOffset < kMessageHeaderSize || pData[lOffset] > kResponse) {
+            lValid = false;
+            break;
+        }
+        size_t lLength = ((size_t) pData[lOffset + 7] << 8) | pData[lOffset + 8];
+        lOffset += kMessageHeaderSize;
+        lValid = lSize - lOffset >= lLength;
+        lOffset += lLength;
+    }
+    if (!lValid) {
+        LOGGER(true, LOGG_ERROR, "Messenger: malformed OOB block.")
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStatistics.mMalformedBlocks++;
+        return;
+    }
+
+    std::vector<RISTNetMessage> lMessages;
+    lMessages.reserve(lCount);
+    std::vector<std::pair<ResponseFunction, RISTNetMessage>> lResponses;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStatistics.mBlocksReceived++;
+        mStatistics.mMessagesReceived += lCount;
+        for (size_t lOffset = kBlockHeaderSize; lOffset < lSize;) {
+            const uint8_t *pHeader = pData + lOffset;
+            RISTNetMessage lMessage;
+            lMessage.mPeer = pPeer;
+            lMessage.mType = (uint16_t) ((pHeader[1] << 8) | pHeader[2]);
+            lMessage.mRequestID = ((uint32_t) pHeader[3] << 24) | ((uint32_t) pHeader[4] << 16) |
+                                  ((uint32_t) pHeader[5] << 8) | pHeader[6];
+            lMessage.mSize = ((size_t) pHeader[7] << 8) | pHeader[8];
+            lMessage.mData = pHeader + kMessageHeaderSize;
+            lOffset += kMessageHeaderSize + lMessage.mSize;
+            if (pHeader[0] == kMessage) {
+                lMessage.mRequestID = 0;
+            }
+            if (pHeader[0] != kResponse) {
+                lMessages.push_back(lMessage);
+                continue;
+            }
+            auto lRequest = mRequests.find(lMessage.mRequestID);
+            if (lRequest == mRequests.end() || lRequest->second.mPeer != pPeer) {
+                // The request ID alone is only unique per messenger, another peer might reuse it
+                mStatistics.mUnmatchedResponses++;
+                continue;
+            }
+            lResponses.emplace_back(std::move(lRequest->second.mResponse), lMessage);
+            mRequests.erase(lRequest);
+        }
+    }
+    for (auto &rResponse: lResponses) {
+        rResponse.first(Status::kResponse, &rResponse.second);
+    }
+    if (!lMessages.empty() && messageCallback) {
+        messageCallback(lMessages.data(), lMessages.size());
+    }
+}
+
+void RISTNetMessenger::getStatistics(RISTNetMessengerStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics = mStatistics;
+}
+
+void RISTNetMessenger::messengerWorker() {
+    std::unique_lock<std::mutex> lLock(mMtx);
+    while (mRunning) {
+        Clock::time_point lNow = Clock::now();
+        Clock::time_point lNext = lNow + std::chrono::seconds(1);
+        std::vector<Block> lBlocks;
+        for (size_t i = 0; i < mBatches.size();) {
+            if (mBatches[i].mDeadline <= lNow) {
+                // Swapped with the last batch, i is looked at again
+                takeBatch(mBatches[i], lBlocks);
+            } else {
+                lNext = std::min(lNext, mBatches[i].mDeadline);
+                i++;
+            }
+        }
+        std::vector<ResponseFunction> lTimedOut;
+        for (auto lRequest = mRequests.begin(); lRequest != mRequests.end();) {
+            if (lRequest->second.mDeadline <= lNow) {
+                lTimedOut.push_back(std::move(lRequest->second.mResponse));
+                lRequest = mRequests.erase(lRequest);
+                mStatistics.mTimeouts++;
+            } else {
+                lNext = std::min(lNext, lRequest->second.mDeadline);
+                ++lRequest;
+            }
+        }
+        if (lBlocks.empty() && lTimedOut.empty()) {
+            mWake.wait_until(lLock, lNext);
+            continue;
+        }
+        lLock.unlock();
+        sendBlocks(lBlocks);
+        for (auto &rResponse: lTimedOut) {
+            rResponse(Status::kTimeout, nullptr);
+        }
+        lLock.lock();
+    }
+}
@@ -0,0 +1,205 @@
+//
+// Framed, batched messages and requests over the OOB channel of the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETMESSAGING_H
+#define CPPRISTWRAPPER__RISTNETMESSAGING_H
+
+#include "RISTNet.h"
+
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/**
+ * \class RISTNetMessengerSettings
+ *
+ * \brief
+ *
+ * Settings of RISTNetMessenger.
+ *
+ */
+struct RISTNetMessengerSettings {
+    size_t mMaxBlockSize = 1316;                    // Bytes of an OOB block, messages are batched up to it
+    std::chrono::microseconds mBatchWindow{1000};   // How long a message waits for more to the peer, 0 = send at once
+};
+
+/**
+ * \class RISTNetMessage
+ *
+ * \brief
+ *
+ * A message received by RISTNetMessenger. The data is valid during the callback only.
+ *
+ */
+struct RISTNetMessage {
+    rist_peer *mPeer = nullptr;
+    uint16_t mType = 0;
+    uint32_t mRequestID = 0;         // Not 0 if the sender expects a response, see RISTNetMessenger::respond
+    const uint8_t *mData = nullptr;
+    size_t mSize = 0;
+};
+
+/**
+ * \class RISTNetMessengerStatistics
+ *
+ * \brief
+ *
+ * Counters of RISTNetMessenger.
+ *
+ */
+struct RISTNetMessengerStatistics {
+    uint64_t mMessagesSent = 0;      // Messages, requests and responses sent
+    uint64_t mBlocksSent = 0;        // OOB blocks they were sent in
+    uint64_t mSendErrors = 0;        // Blocks the OOB send failed for
+    uint64_t mOversize = 0;          // Messages rejected since they do not fit in a block
+    uint64_t mMessagesReceived = 0;
+    uint64_t mBlocksReceived = 0;
+    uint64_t mMalformedBlocks = 0;   // Blocks dropped since they were not messenger blocks or were truncated
+    uint64_t mTimeouts = 0;          // Requests without response in time
+    uint64_t mUnmatchedResponses = 0; // Responses to requests timed out, never sent or sent to another peer
+};
+
+/**
+ * \class RISTNetMessenger
+ *
+ * \brief
+ *
+ * Messages on top of sendOOBData and networkOOBDataCallback. Small messages to the same peer sent within
+ * mBatchWindow are coalesced into one OOB block, the receiving messenger calls messageCallback once per block with
+ * all its messages. Every message has a type chosen by the application. A request gets a response from the peer's
+ * messageCallback through respond(), or a timeout. OOB blocks are neither retransmitted nor ordered, neither are
+ * the messages.
+ *
+ * Block: 'M' 1, then per message: kind (1 byte), type (2), request ID (4), length (2), data. Big endian.
+ *
+ */
+class RISTNetMessenger {
+public:
+    enum class Status {
+        kResponse,
+        kTimeout,
+        kStopped
+    };
+
+    using SendFunction = std::function<bool(rist_peer *pPeer, const uint8_t *pData, size_t lSize)>;
+    /// The response is nullptr unless the status is kResponse
+    using ResponseFunction = std::function<void(Status lStatus, const RISTNetMessage *pResponse)>;
+
+    static constexpr size_t kBlockHeaderSize = 2;
+    static constexpr size_t kMessageHeaderSize = 9;
+
+    ~RISTNetMessenger();
+
+    /// Send with sendOOBData of the sender and set its networkOOBDataCallback to receive(). Before start(). The
+    /// sender must not outlive the messenger
+    void attach(RISTNetSender &rSender);
+
+    /// Send with sendOOBData of the receiver and set its networkOOBDataCallback to receive(). Before start(). The
+    /// receiver must not outlive the messenger
+    void attach(RISTNetReceiver &rReceiver);
+
+    /// Send the blocks with pSend instead, before start()
+    void setSendFunction(SendFunction pSend);
+
+    /// Start the thread sending the batches and timing out the requests
+    bool start(const RISTNetMessengerSettings &rSettings = RISTNetMessengerSettings());
+
+    /// Send what is batched and stop. Requests waiting for a response get kStopped
+    void stop();
+
+    /// Send a message to the peer. Returns false if the messenger is not started or the message too large
+    bool send(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize);
+
+    /// Send a request to the peer, pResponse is called once with the response, a timeout or kStopped. It is
+    /// called from the thread receiving the response or the messenger thread, never from request()
+    bool request(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize,
+                 std::chrono::milliseconds lTimeout, ResponseFunction pResponse);
+
+    /// Respond to a received request
+    bool respond(const RISTNetMessage &rRequest, uint16_t lType, const uint8_t *pData, size_t lSize);
+
+    /// Send what is batched now
+    void flush();
+
+    /// Handle a received OOB block
+    void receive(rist_peer *pPeer, const uint8_t *pData, size_t lSize);
+
+    void getStatistics(RISTNetMessengerStatistics &rStatistics);
+
+    /**
+     * @brief Message callback
+     *
+     * Called once per received block with its messages, requests included. Responses go to the ResponseFunction
+     * of the request instead.
+     */
+    std::function<void(const RISTNetMessage *pMessages, size_t lCount)> messageCallback = nullptr;
+
+    RISTNetMessenger() = default;
+    RISTNetMessenger(RISTNetMessenger const &) = delete;
+    RISTNetMessenger &operator=(RISTNetMessenger const &) = delete;
+
+private:
+    enum Kind : uint8_t {
+        kMessage = 0,
+        kRequest = 1,
+        kResponse = 2
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // The messages waiting for more to the same peer
+    struct Batch {
+        rist_peer *mPeer = nullptr;
+        std::vector<uint8_t> mData;
+        size_t mMessages = 0;
+        Clock::time_point mDeadline;
+    };
+
+    struct Request {
+        rist_peer *mPeer = nullptr; // Only a response of this peer is taken
+        Clock::time_point mDeadline;
+        ResponseFunction mResponse;
+    };
+
+    struct Block {
+        rist_peer *mPeer = nullptr;
+        std::vector<uint8_t> mData;
+        size_t mMessages = 0;
+    };
+
+    bool enqueue(rist_peer *pPeer, Kind lKind, uint16_t lType, uint32_t lRequestID, const uint8_t *pData,
+                 size_t lSize);
+    void takeBatch(Batch &rBatch, std::vector<Block> &rBlocks);
+    void sendBlocks(std::vector<Block> &rBlocks);
+    void messengerWorker();
+
+    RISTNetMessengerSettings mSettings;
+    SendFunction mSend;
+
+    std::mutex mMtx;
+    std::condition_variable mWake;
+    bool mRunning = false;
+    std::thread mThread;
+    // One batch per peer, few peers expected
+    std::vector<Batch> mBatches;
+    // Block buffers sent, kept for the next batches
+    std::vector<std::vector<uint8_t>> mSpareBuffers;
+    std::unordered_map<uint32_t, Request> mRequests;
+    uint32_t mNextRequestID = 1;
+
+    RISTNetMessengerStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETMESSAGING_H
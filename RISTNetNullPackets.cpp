@@ -0,0 +1,127 @@
+//
+// Null packet removal and reinsertion used by the RIST C++ wrapper.
+//
+
+#include "RISTNetNullPackets.h"
+#include "RISTNetTSAnalyzer.h"
+
+#include <cstring>
+
+namespace {
+    constexpr size_t kPacketSize = RISTNetTSAnalyzer::kPacketSize;
+
+    bool isNullPacket(const uint8_t *pPacket) {
+        return (pPacket[1] & 0x1f) == 0x1f && pPacket[2] == 0xff;
+    }
+
+    // The number of packets if the payload is whole TS packets, otherwise 0
+    size_t packetCount(const uint8_t *pSrc, size_t lSize) {
+        size_t lPackets = lSize / kPacketSize;
+        if (!lPackets || lSize % kPacketSize || lPackets > RISTNetNullPackets::kMaxPackets) {
+            return 0;
+        }
+        for (size_t i = 0; i < lPackets; i++) {
+            if (pSrc[i * kPacketSize] != RISTNetTSAnalyzer::kSyncByte) {
+                return 0;
+            }
+        }
+        return lPackets;
+    }
+}
+
+size_t RISTNetNullPackets::trailerSize(size_t lSize) {
+    size_t lPackets = lSize / kPacketSize;
+    if (lSize % kPacketSize || lPackets > kMaxPackets) {
+        return 1;
+    }
+    return 1 + (lPackets + 7) / 8;
+}
+
+size_t RISTNetNullPackets::strip(const uint8_t *pSrc, size_t lSize, uint8_t *pDst, size_t lDstCapacity,
+                                 size_t &rNullPackets) {
+    rNullPackets = 0;
+    size_t lPackets = packetCount(pSrc, lSize);
+    size_t lBitmapSize = (lPackets + 7) / 8;
+    if (lSize + lBitmapSize + 1 > lDstCapacity) {
+        return 0;
+    }
+    if (!lPackets) {
+        memcpy(pDst, pSrc, lSize);
+        pDst[lSize] = 0;
+        return lSize + 1;
+    }
+    uint8_t lBitmap[(kMaxPackets + 7) / 8] = {};
+    size_t lWritten = 0;
+    // Copy the runs of packets between the null packets
+    size_t lRunStart = 0;
+    for (size_t i = 0; i < lPackets; i++) {
+        if (!isNullPacket(pSrc + i * kPacketSize)) {
+            continue;
+        }
+        lBitmap[i / 8] |= (uint8_t) (1 << (i % 8));
+        rNullPackets++;
+        memcpy(pDst + lWritten, pSrc + lRunStart * kPacketSize, (i - lRunStart) * kPacketSize);
+        lWritten += (i - lRunStart) * kPacketSize;
+        lRunStart = i + 1;
+    }
+    memcpy(pDst + lWritten, pSrc + lRunStart * kPacketSize, (lPackets - lRunStart) * kPacketSize);
+    lWritten += (lPackets - lRunStart) * kPacketSize;
+    memcpy(pDst + lWritten, lBitmap, lBitmapSize);
+    lWritten += lBitmapSize;
+    pDst[lWritten++] = (uint8_t) lPackets;
+    return lWritten;
+}
+
+bool RISTNetNullPackets::readTrailer(const uint8_t *pSrc, size_t lSize, size_t &rPayloadSize, size_t &rNullPackets) {
+    if (!lSize) {
+        return false;
+    }
+    size_t lPackets = pSrc[lSize - 1];
+    size_t lBitmapSize = (lPackets + 7) / 8;
+    if (lSize < 1 + lBitmapSize) {
+        return false;
+    }
+    rPayloadSize = lSize - 1 - lBitmapSize;
+    rNullPackets = 0;
+    const uint8_t *pBitmap = pSrc + rPayloadSize;
+    for (size_t i = 0; i < lBitmapSize; i++) {
+        rNullPackets += __builtin_popcount(pBitmap[i]);
+    }
+    if (lPackets && (rNullPackets > lPackets || rPayloadSize != (lPackets - rNullPackets) * kPacketSize)) {
+        return false;
+    }
+    return true;
+}
+
+size_t RISTNetNullPackets::restore(const uint8_t *pSrc, size_t lSize, uint8_t *pDst, size_t lDstCapacity) {
+    size_t lPayloadSize;
+    size_t lNullPackets;
+    if (!readTrailer(pSrc, lSize, lPayloadSize, lNullPackets)) {
+        return 0;
+    }
+    size_t lPackets = pSrc[lSize - 1];
+    size_t lRestoredSize = lPackets ? lPackets * kPacketSize : lPayloadSize;
+    if (lRestoredSize > lDstCapacity) {
+        return 0;
+    }
+    if (!lPackets) {
+        memcpy(pDst, pSrc, lPayloadSize);
+        return lPayloadSize;
+    }
+    const uint8_t *pBitmap = pSrc + lPayloadSize;
+    size_t lRead = 0;
+    for (size_t i = 0; i < lPackets; i++) {
+        uint8_t *pPacket = pDst + i * kPacketSize;
+        if (pBitmap[i / 8] & (1 << (i % 8))) {
+            pPacket[0] = RISTNetTSAnalyzer::kSyncByte;
+            pPacket[1] = 0x1f;
+            pPacket[2] = 0xff;
+            pPacket[3] = 0x10;
+            memset(pPacket + 4, 0xff, kPacketSize - 4);
+        } else {
+            memcpy(pPacket, pSrc + lRead, kPacketSize);
+            lRead += kPacketSize;
+        }
+    }
+    return lRestoredSize;
+}
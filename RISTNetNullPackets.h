@@ -0,0 +1,50 @@
+//
+// Null packet removal and reinsertion used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETNULLPACKETS_H
+#define CPPRISTWRAPPER__RISTNETNULLPACKETS_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * \class RISTNetNullPackets
+ *
+ * \brief
+ *
+ * Removes the MPEG-TS null packets (PID 0x1FFF) from a payload and puts them back at the same offsets.
+ *
+ * The trailer is a bitmap of the null packets, one bit per packet (LSB first), followed by one byte with the number
+ * of packets in the payload. Payloads that are not whole 188 byte packets, or have more than kMaxPackets, are sent
+ * as they are with a 0 byte trailer. The null packets put back are 0x47 1F FF 10 followed by 0xFF, the continuity
+ * counter and the payload of null packets carry no information.
+ *
+ */
+class RISTNetNullPackets {
+public:
+    static constexpr size_t kMaxPackets = 255;
+
+    /// The most bytes the trailer adds to a payload of lSize bytes
+    static size_t trailerSize(size_t lSize);
+
+    /// Write pSrc without the null packets followed by the trailer. rNullPackets is the number removed.
+    /// Returns the size written, 0 if it does not fit lDstCapacity
+    static size_t strip(const uint8_t *pSrc, size_t lSize, uint8_t *pDst, size_t lDstCapacity, size_t &rNullPackets);
+
+    /// Read the trailer. rPayloadSize is the size without the trailer, rNullPackets the number to put back.
+    /// Returns false if malformed
+    static bool readTrailer(const uint8_t *pSrc, size_t lSize, size_t &rPayloadSize, size_t &rNullPackets);
+
+    /// Write the payload (with trailer) with the null packets put back. Returns the size written, 0 if it is
+    /// malformed or does not fit lDstCapacity
+    static size_t restore(const uint8_t *pSrc, size_t lSize, uint8_t *pDst, size_t lDstCapacity);
+};
+
+#endif //CPPRISTWRAPPER__RISTNETNULLPACKETS_H
@@ -0,0 +1,198 @@
+//
+// Peer lookup table used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETPEERTABLE_H
+#define CPPRISTWRAPPER__RISTNETPEERTABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+struct rist_peer;
+
+/**
+ * \class RISTNetPeerTable
+ *
+ * \brief
+ *
+ * An open addressing hash table keyed by the librist peer pointer. The entries are stored in one
+ * array (linear probing, backward shift deletion) so a lookup is a hash and usually one cache line,
+ * instead of the pointer chasing of a std::map. A nullptr key marks a free slot.
+ *
+ * Inserting might rehash and erasing moves entries, both invalidate pointers and iterators to entries.
+ * Not thread safe.
+ *
+ */
+template<typename T>
+class RISTNetPeerTable {
+public:
+    using Entry = std::pair<rist_peer *, T>;
+
+    template<typename EntryType>
+    class Iterator {
+    public:
+        Iterator(EntryType *pSlot, EntryType *pEnd) : mSlot(pSlot), mEnd(pEnd) { skipFree(); }
+
+        EntryType &operator*() const { return *mSlot; }
+        EntryType *operator->() const { return mSlot; }
+        Iterator &operator++() {
+            mSlot++;
+            skipFree();
+            return *this;
+        }
+        bool operator==(const Iterator &rOther) const { return mSlot == rOther.mSlot; }
+        bool operator!=(const Iterator &rOther) const { return mSlot != rOther.mSlot; }
+
+    private:
+        void skipFree() {
+            while (mSlot != mEnd && !mSlot->first) {
+                mSlot++;
+            }
+        }
+
+        EntryType *mSlot;
+        EntryType *mEnd;
+    };
+
+    using iterator = Iterator<Entry>;
+    using const_iterator = Iterator<const Entry>;
+
+    /// lPeers is the number of peers to make room for without rehashing
+    explicit RISTNetPeerTable(size_t lPeers = 0) { reserve(lPeers); }
+
+    /// Make room for lPeers peers without rehashing
+    void reserve(size_t lPeers) {
+        size_t lCapacity = kMinCapacity;
+        while (lCapacity * kMaxLoadNumerator < lPeers * kMaxLoadDenominator) {
+            lCapacity *= 2;
+        }
+        if (lCapacity > mSlots.size()) {
+            rehash(lCapacity);
+        }
+    }
+
+    /// The entry of the peer, nullptr if not found
+    T *find(rist_peer *pPeer) {
+        size_t lSlot = slotOf(pPeer);
+        return lSlot == kNotFound ? nullptr : &mSlots[lSlot].second;
+    }
+
+    const T *find(rist_peer *pPeer) const {
+        return const_cast<RISTNetPeerTable *>(this)->find(pPeer);
+    }
+
+    /// The entry of the peer, a default constructed entry is inserted if not found. pPeer must not be nullptr
+    T &operator[](rist_peer *pPeer) {
+        if (T *pEntry = find(pPeer)) {
+            return *pEntry;
+        }
+        if ((mSize + 1) * kMaxLoadDenominator > mSlots.size() * kMaxLoadNumerator) {
+            rehash(mSlots.size() * 2);
+        }
+        size_t i = home(pPeer);
+        while (mSlots[i].first) {
+            i = (i + 1) & mMask;
+        }
+        mSlots[i].first = pPeer;
+        mSize++;
+        return mSlots[i].second;
+    }
+
+    /// Remove the peer. Returns false if not found
+    bool erase(rist_peer *pPeer) {
+        size_t lFree = slotOf(pPeer);
+        if (lFree == kNotFound) {
+            return false;
+        }
+        // Move back the entries of the probe sequence that can no longer be reached past the freed slot
+        for (size_t i = (lFree + 1) & mMask; mSlots[i].first; i = (i + 1) & mMask) {
+            size_t lHome = home(mSlots[i].first);
+            if (((i - lHome) & mMask) >= ((i - lFree) & mMask)) {
+                mSlots[lFree] = std::move(mSlots[i]);
+                lFree = i;
+            }
+        }
+        mSlots[lFree] = Entry();
+        mSize--;
+        return true;
+    }
+
+    /// Remove all peers, the capacity is kept
+    void clear() {
+        for (auto &rSlot: mSlots) {
+            rSlot = Entry();
+        }
+        mSize = 0;
+    }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    size_t capacity() const { return mSlots.size(); }
+
+    iterator begin() { return iterator(mSlots.data(), mSlots.data() + mSlots.size()); }
+    iterator end() { return iterator(mSlots.data() + mSlots.size(), mSlots.data() + mSlots.size()); }
+    const_iterator begin() const { return const_iterator(mSlots.data(), mSlots.data() + mSlots.size()); }
+    const_iterator end() const {
+        return const_iterator(mSlots.data() + mSlots.size(), mSlots.data() + mSlots.size());
+    }
+
+private:
+    static constexpr size_t kMinCapacity = 16;
+    // At most 3/4 of the slots are used
+    static constexpr size_t kMaxLoadNumerator = 3;
+    static constexpr size_t kMaxLoadDenominator = 4;
+
+    static constexpr size_t kNotFound = SIZE_MAX;
+
+    size_t slotOf(rist_peer *pPeer) const {
+        if (!pPeer || mSlots.empty()) {
+            return kNotFound;
+        }
+        for (size_t i = home(pPeer);; i = (i + 1) & mMask) {
+            if (mSlots[i].first == pPeer) {
+                return i;
+            }
+            if (!mSlots[i].first) {
+                return kNotFound;
+            }
+        }
+    }
+
+    size_t home(rist_peer *pPeer) const {
+        // The low bits of heap pointers are mostly zero, mix all bits into the ones used
+        uint64_t lHash = (uint64_t) (uintptr_t) pPeer;
+        lHash ^= lHash >> 33;
+        lHash *= 0xff51afd7ed558ccdULL;
+        lHash ^= lHash >> 33;
+        return (size_t) lHash & mMask;
+    }
+
+    void rehash(size_t lCapacity) {
+        std::vector<Entry> lOld(lCapacity);
+        lOld.swap(mSlots);
+        mMask = lCapacity - 1;
+        for (auto &rSlot: lOld) {
+            if (rSlot.first) {
+                size_t i = home(rSlot.first);
+                while (mSlots[i].first) {
+                    i = (i + 1) & mMask;
+                }
+                mSlots[i] = std::move(rSlot);
+            }
+        }
+    }
+
+    std::vector<Entry> mSlots;
+    size_t mMask = 0;
+    size_t mSize = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETPEERTABLE_H
@@ -0,0 +1,116 @@
+//
+// Adaptive recovery window sizing used by the RIST C++ wrapper.
+//
+
+#include "RISTNetRecovery.h"
+
+#include <algorithm>
+#include <cmath>
+
+RISTNetRecoveryController::RISTNetRecoveryController(const RISTNetRecoverySettings &rSettings,
+                                                     const RISTNetRecoveryWindow &rInitial)
+        : mSettings(rSettings), mWindow(rInitial), mHistory(std::max<uint32_t>(rSettings.mHistory, 1)) {
+    mSettings.mMaxLength = std::max(mSettings.mMaxLength, mSettings.mMinLength);
+}
+
+RISTNetRecoveryWindow RISTNetRecoveryController::target() const {
+    uint32_t lRTTMin = UINT32_MAX;
+    uint32_t lRTTMax = 0;
+    double lLoss = 0;
+    uint32_t lBurst = 0;
+    size_t lCount = std::min<uint64_t>(mSamples, mHistory.size());
+    for (size_t i = 0; i < lCount; i++) {
+        lRTTMin = std::min(lRTTMin, mHistory[i].mRTT);
+        lRTTMax = std::max(lRTTMax, mHistory[i].mRTT);
+        lLoss = std::max(lLoss, mHistory[i].mLoss);
+        lBurst = std::max(lBurst, mHistory[i].mBurst);
+    }
+    if (!lCount) {
+        return mWindow;
+    }
+
+    RISTNetRecoveryWindow lTarget;
+    // Every round trip the packets still missing are lost again with the probability of the loss
+    double lRoundTrips = mSettings.mRetransmissions;
+    if (lLoss > 0 && mSettings.mResidualLoss > 0 && mSettings.mResidualLoss < 1) {
+        lRoundTrips = std::max(lRoundTrips, std::ceil(std::log(mSettings.mResidualLoss) /
+                                                      std::log(std::min(lLoss, 0.99))));
+    }
+    // The packets lost in a burst are requested again once it is over
+    double lLength = mSettings.mMargin * ((double) lBurst + lRoundTrips * lRTTMax);
+    lTarget.mLengthMax = (uint32_t) std::min<double>(std::max<double>(std::ceil(lLength), mSettings.mMinLength),
+                                                     mSettings.mMaxLength);
+    // Keep the ratio between the shortest and the longest window the application configured
+    double lRatio = mWindow.mLengthMax ? (double) mWindow.mLengthMin / mWindow.mLengthMax : 1.0;
+    lTarget.mLengthMin = std::max<uint32_t>((uint32_t) (lTarget.mLengthMax * std::min(lRatio, 1.0)),
+                                            std::min(mSettings.mMinLength, lTarget.mLengthMax));
+    // librist estimates the RTT itself within recovery_rtt_min - recovery_rtt_max
+    lTarget.mRTTMin = std::max<uint32_t>(lRTTMin, 1);
+    lTarget.mRTTMax = std::max(lTarget.mRTTMin, (uint32_t) std::ceil(mSettings.mMargin * lRTTMax));
+    lTarget.mRTTMax = std::min(lTarget.mRTTMax, lTarget.mLengthMax);
+    lTarget.mRTTMin = std::min(lTarget.mRTTMin, lTarget.mRTTMax);
+    return lTarget;
+}
+
+bool RISTNetRecoveryController::addInterval(uint32_t lRTT, uint64_t lReceived, uint64_t lMissing, uint32_t lGap) {
+    Interval &rInterval = mHistory[mNext];
+    mNext = (mNext + 1) % mHistory.size();
+    rInterval.mRTT = lRTT;
+    uint64_t lPackets = lReceived + lMissing;
+    rInterval.mLoss = lPackets ? (double) lMissing / lPackets : 0;
+    // Without loss the gap is only the packet rate
+    rInterval.mBurst = lMissing ? lGap : 0;
+    mSamples++;
+
+    if (mSamples < std::max<uint32_t>(mSettings.mMinSamples, 1)) {
+        return false;
+    }
+    RISTNetRecoveryWindow lTarget = target();
+    double lGrow = 1.0 + mSettings.mHysteresis;
+    double lShrink = 1.0 - mSettings.mHysteresis;
+    if (lTarget.mLengthMax > mWindow.mLengthMax * lGrow || lTarget.mRTTMax > mWindow.mRTTMax * lGrow) {
+        // Too short a window loses packets, grow at once. Never shrink the other value while growing
+        lTarget.mLengthMax = std::max(lTarget.mLengthMax, mWindow.mLengthMax);
+        lTarget.mLengthMin = std::max(lTarget.mLengthMin, mWindow.mLengthMin);
+        lTarget.mRTTMax = std::max(lTarget.mRTTMax, mWindow.mRTTMax);
+        lTarget.mRTTMin = std::min(lTarget.mRTTMin, lTarget.mRTTMax);
+        mWindow = lTarget;
+        mShrinkCount = 0;
+        mLastChange = mSamples;
+        return true;
+    }
+    if (lTarget.mLengthMax < mWindow.mLengthMax * lShrink) {
+        mShrinkCount++;
+        if (mShrinkCount >= mSettings.mShrinkAfter && mSamples - mLastChange >= mSettings.mMinChangeInterval) {
+            mWindow = lTarget;
+            mShrinkCount = 0;
+            mLastChange = mSamples;
+            return true;
+        }
+        return false;
+    }
+    mShrinkCount = 0;
+    return false;
+}
+
+bool RISTNetRecoveryController::addFlow(uint32_t lFlowId, uint32_t lRTT, uint64_t lReceived, uint64_t lMissing,
+                                        uint32_t lGap) {
+    bool lChanged = false;
+    if (std::find(mPeriodFlows.begin(), mPeriodFlows.end(), lFlowId) != mPeriodFlows.end()) {
+        lChanged = addInterval(mPeriodRTT, mPeriodReceived, mPeriodMissing, mPeriodBurst);
+        mPeriodFlows.clear();
+        mPeriodRTT = 0;
+        mPeriodReceived = 0;
+        mPeriodMissing = 0;
+        mPeriodBurst = 0;
+    }
+    mPeriodFlows.push_back(lFlowId);
+    mPeriodRTT = std::max(mPeriodRTT, lRTT);
+    mPeriodReceived += lReceived;
+    mPeriodMissing += lMissing;
+    // Only the gaps of flows that lost packets, another flow might just be sparse
+    if (lMissing) {
+        mPeriodBurst = std::max(mPeriodBurst, lGap);
+    }
+    return lChanged;
+}
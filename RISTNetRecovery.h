@@ -0,0 +1,116 @@
+//
+// Adaptive recovery window sizing used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETRECOVERY_H
+#define CPPRISTWRAPPER__RISTNETRECOVERY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * \class RISTNetRecoveryWindow
+ *
+ * \brief
+ *
+ * The librist recovery settings the controller adjusts, all in ms.
+ *
+ */
+struct RISTNetRecoveryWindow {
+    uint32_t mLengthMin = 0;  // recovery_length_min
+    uint32_t mLengthMax = 0;  // recovery_length_max
+    uint32_t mRTTMin = 0;     // recovery_rtt_min
+    uint32_t mRTTMax = 0;     // recovery_rtt_max
+
+    bool operator==(const RISTNetRecoveryWindow &rOther) const {
+        return mLengthMin == rOther.mLengthMin && mLengthMax == rOther.mLengthMax && mRTTMin == rOther.mRTTMin &&
+               mRTTMax == rOther.mRTTMax;
+    }
+    bool operator!=(const RISTNetRecoveryWindow &rOther) const { return !(*this == rOther); }
+};
+
+/**
+ * \class RISTNetRecoverySettings
+ *
+ * \brief
+ *
+ * Settings of the adaptive recovery window. The default values disable the controller.
+ *
+ */
+struct RISTNetRecoverySettings {
+    bool mEnabled = false;
+    uint32_t mMinLength = 100;        // The shortest window (ms)
+    uint32_t mMaxLength = 10000;      // The longest window (ms)
+    double mRetransmissions = 4;      // Round trips the window covers at least
+    double mResidualLoss = 1e-6;      // Loss left after the round trips the window covers, adds round trips at high loss
+    double mMargin = 1.25;            // Safety factor applied to the window and recovery_rtt_max
+    uint32_t mHistory = 30;           // Statistics intervals the RTT and the loss are taken from
+    uint32_t mMinSamples = 5;         // Intervals needed before the first change
+    double mHysteresis = 0.2;         // Relative change needed before the window changes
+    uint32_t mShrinkAfter = 10;       // Intervals a shorter window must be enough before shrinking
+    uint32_t mMinChangeInterval = 60; // Intervals after a change before the window shrinks
+};
+
+/**
+ * \class RISTNetRecoveryController
+ *
+ * \brief
+ *
+ * Sizes the recovery window from the RTT, the loss and the loss bursts seen in the last statistics intervals:
+ * window = margin x (longest burst + round trips x highest RTT), within mMinLength - mMaxLength. A lost packet is
+ * lost again with the probability of the loss on every round trip, the window covers mRetransmissions round trips
+ * or, at a higher loss, the round trips needed to leave mResidualLoss. The packets of a burst are only requested
+ * again after it, so the window covers the burst too. A burst is the longest gap between two received packets of
+ * an interval with missing packets. A longer window is applied at once, a shorter one when it has been enough for
+ * mShrinkAfter intervals. Not thread safe.
+ *
+ */
+class RISTNetRecoveryController {
+public:
+    RISTNetRecoveryController(const RISTNetRecoverySettings &rSettings, const RISTNetRecoveryWindow &rInitial);
+
+    /// Add a statistics interval, lGap is the longest time between two received packets (ms). Returns true if
+    /// window() changed
+    bool addInterval(uint32_t lRTT, uint64_t lReceived, uint64_t lMissing, uint32_t lGap = 0);
+
+    /// Add the statistics of one flow. The flows reported in a statistics period are summed into one interval,
+    /// which is added when a flow reports again. Returns true if window() changed
+    bool addFlow(uint32_t lFlowId, uint32_t lRTT, uint64_t lReceived, uint64_t lMissing, uint32_t lGap = 0);
+
+    /// The window in use
+    const RISTNetRecoveryWindow &window() const { return mWindow; }
+
+    /// The window the last intervals call for
+    RISTNetRecoveryWindow target() const;
+
+private:
+    struct Interval {
+        uint32_t mRTT = 0;
+        double mLoss = 0; // Missing / (received + missing)
+        uint32_t mBurst = 0; // The longest gap (ms) if packets went missing
+    };
+
+    RISTNetRecoverySettings mSettings;
+    RISTNetRecoveryWindow mWindow;
+    std::vector<Interval> mHistory;
+    size_t mNext = 0;
+    uint64_t mSamples = 0;
+    uint32_t mShrinkCount = 0;
+    uint64_t mLastChange = 0;
+
+    // The statistics period addFlow sums up
+    std::vector<uint32_t> mPeriodFlows;
+    uint32_t mPeriodRTT = 0;
+    uint64_t mPeriodReceived = 0;
+    uint64_t mPeriodMissing = 0;
+    uint32_t mPeriodBurst = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETRECOVERY_H
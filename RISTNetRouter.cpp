@@ -0,0 +1,247 @@
+//
+// Routing of received data to several outputs without copies.
+//
+
+#include "RISTNetRouter.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetRouter::Packet
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetRouter::Packet::Packet(const Packet &rOther) : mRouter(rOther.mRouter), mSlot(rOther.mSlot) {
+    if (mRouter) {
+        mRouter->mSlots[mSlot].mReferences.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+RISTNetRouter::Packet &RISTNetRouter::Packet::operator=(const Packet &rOther) {
+    if (this != &rOther) {
+        Packet lCopy(rOther);
+        *this = std::move(lCopy);
+    }
+    return *this;
+}
+
+RISTNetRouter::Packet &RISTNetRouter::Packet::operator=(Packet &&rOther) noexcept {
+    if (this != &rOther) {
+        release();
+        mRouter = rOther.mRouter;
+        mSlot = rOther.mSlot;
+        rOther.mRouter = nullptr;
+    }
+    return *this;
+}
+
+void RISTNetRouter::Packet::release() {
+    if (mRouter) {
+        if (mRouter->mSlots[mSlot].mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            mRouter->releaseSlot(mSlot);
+        }
+        mRouter = nullptr;
+    }
+}
+
+const uint8_t *RISTNetRouter::Packet::data() const {
+    return mRouter->mBuffers.data() + (size_t) mSlot * mRouter->mMaxPacketSize;
+}
+
+size_t RISTNetRouter::Packet::size() const {
+    return mRouter->mSlots[mSlot].mSize;
+}
+
+uint16_t RISTNetRouter::Packet::connectionID() const {
+    return mRouter->mSlots[mSlot].mConnectionID;
+}
+
+rist_peer *RISTNetRouter::Packet::peer() const {
+    return mRouter->mSlots[mSlot].mPeer;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetRouter
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetRouter::~RISTNetRouter() {
+    stop();
+}
+
+size_t RISTNetRouter::addOutput(const RISTNetRouterOutputSettings &rSettings, OutputFunction pFunction) {
+    auto lOutput = std::make_unique<Output>();
+    lOutput->mSettings = rSettings;
+    lOutput->mSettings.mQueueDepth = std::max<size_t>(rSettings.mQueueDepth, 1);
+    lOutput->mFunction = std::move(pFunction);
+    if (!rSettings.mConnectionIDs.empty()) {
+        lOutput->mConnectionIDs.assign(UINT16_MAX + 1, false);
+        for (uint16_t lConnectionID: rSettings.mConnectionIDs) {
+            lOutput->mConnectionIDs[lConnectionID] = true;
+        }
+    }
+    lOutput->mStatistics.mName = rSettings.mName;
+    mOutputs.push_back(std::move(lOutput));
+    return mOutputs.size() - 1;
+}
+
+bool RISTNetRouter::start(size_t lMaxPacketSize) {
+    stop();
+    if (mOutputs.empty() || !lMaxPacketSize) {
+        LOGGER(true, LOGG_ERROR, "Router: no outputs or packet size.")
+        return false;
+    }
+    // Every queue full, every output thread holding a batch and one packet being routed
+    size_t lSlots = 1;
+    for (auto &rOutput: mOutputs) {
+        lSlots += rOutput->mSettings.mQueueDepth + kOutputBatch;
+    }
+    mMaxPacketSize = lMaxPacketSize;
+    mBuffers.assign(lSlots * lMaxPacketSize, 0);
+    mSlots = std::make_unique<Slot[]>(lSlots);
+    {
+        std::lock_guard<std::mutex> lLock(mPoolMtx);
+        mFree.resize(lSlots);
+        for (size_t i = 0; i < lSlots; i++) {
+            mFree[i] = (uint32_t) (lSlots - 1 - i);
+        }
+    }
+    for (auto &rOutput: mOutputs) {
+        std::lock_guard<std::mutex> lLock(rOutput->mMtx);
+        rOutput->mQueue.resize(rOutput->mSettings.mQueueDepth);
+        rOutput->mHead = 0;
+        rOutput->mCount = 0;
+        rOutput->mRunning = true;
+        rOutput->mThread = std::thread(&RISTNetRouter::outputWorker, this, std::ref(*rOutput));
+    }
+    return true;
+}
+
+void RISTNetRouter::stop() {
+    for (auto &rOutput: mOutputs) {
+        {
+            std::lock_guard<std::mutex> lLock(rOutput->mMtx);
+            rOutput->mRunning = false;
+        }
+        rOutput->mNotEmpty.notify_all();
+        if (rOutput->mThread.joinable()) {
+            rOutput->mThread.join();
+        }
+        std::lock_guard<std::mutex> lLock(rOutput->mMtx);
+        rOutput->mStatistics.mDropped += rOutput->mCount;
+        rOutput->mQueue.clear();
+        rOutput->mCount = 0;
+    }
+}
+
+void RISTNetRouter::releaseSlot(uint32_t lSlot) {
+    std::lock_guard<std::mutex> lLock(mPoolMtx);
+    mFree.push_back(lSlot);
+}
+
+bool RISTNetRouter::route(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, rist_peer *pPeer) {
+    if (lSize > mMaxPacketSize) {
+        mOversize++;
+        return false;
+    }
+    uint32_t lSlot;
+    {
+        std::lock_guard<std::mutex> lLock(mPoolMtx);
+        if (mFree.empty()) {
+            mPoolExhausted++;
+            return false;
+        }
+        lSlot = mFree.back();
+        mFree.pop_back();
+    }
+    // The only copy of the packet
+    memcpy(mBuffers.data() + (size_t) lSlot * mMaxPacketSize, pData, lSize);
+    Slot &rSlot = mSlots[lSlot];
+    rSlot.mSize = lSize;
+    rSlot.mConnectionID = lConnectionID;
+    rSlot.mPeer = pPeer;
+    rSlot.mReferences.store(1, std::memory_order_relaxed);
+    Packet lPacket(this, lSlot);
+
+    bool lRouted = false;
+    for (auto &rOutput: mOutputs) {
+        if (!rOutput->mConnectionIDs.empty() && !rOutput->mConnectionIDs[lConnectionID]) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lLock(rOutput->mMtx);
+            if (!rOutput->mRunning) {
+                continue;
+            }
+            if (rOutput->mCount == rOutput->mQueue.size()) {
+                rOutput->mStatistics.mDropped++;
+                continue;
+            }
+            rOutput->mQueue[(rOutput->mHead + rOutput->mCount) % rOutput->mQueue.size()] = lPacket;
+            rOutput->mCount++;
+            rOutput->mStatistics.mMaxQueued = std::max(rOutput->mStatistics.mMaxQueued, rOutput->mCount);
+        }
+        rOutput->mNotEmpty.notify_one();
+        lRouted = true;
+    }
+    return lRouted;
+}
+
+void RISTNetRouter::attach(RISTNetReceiver &rReceiver) {
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &,
+                                           rist_peer *pPeer, uint16_t lConnectionID) {
+        route(pBuf, lSize, lConnectionID, pPeer);
+        return 0;
+    };
+}
+
+void RISTNetRouter::getStatistics(std::vector<RISTNetRouterOutputStatistics> &rStatistics) {
+    rStatistics.clear();
+    for (auto &rOutput: mOutputs) {
+        std::lock_guard<std::mutex> lLock(rOutput->mMtx);
+        rStatistics.push_back(rOutput->mStatistics);
+        rStatistics.back().mQueued = rOutput->mCount;
+    }
+}
+
+void RISTNetRouter::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    rThreads.clear();
+    for (auto &rOutput: mOutputs) {
+        std::lock_guard<std::mutex> lLock(rOutput->mMtx);
+        rThreads.insert(rThreads.end(), rOutput->mThreadInfo.begin(), rOutput->mThreadInfo.end());
+    }
+}
+
+void RISTNetRouter::outputWorker(Output &rOutput) {
+    if (!rOutput.mSettings.mThreadSettings.isDefault()) {
+        RISTNetThreadInfo lInfo;
+        RISTNetThreadBinder::applyToCurrentThread(rOutput.mSettings.mThreadSettings, lInfo);
+        lInfo.mRole = "router " + rOutput.mSettings.mName;
+        std::lock_guard<std::mutex> lLock(rOutput.mMtx);
+        rOutput.mThreadInfo.push_back(lInfo);
+    }
+
+    std::vector<Packet> lBatch;
+    lBatch.reserve(kOutputBatch);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lLock(rOutput.mMtx);
+            rOutput.mNotEmpty.wait(lLock, [&]() { return !rOutput.mRunning || rOutput.mCount; });
+            if (!rOutput.mRunning) {
+                break;
+            }
+            while (rOutput.mCount && lBatch.size() < kOutputBatch) {
+                lBatch.push_back(std::move(rOutput.mQueue[rOutput.mHead]));
+                rOutput.mHead = (rOutput.mHead + 1) % rOutput.mQueue.size();
+                rOutput.mCount--;
+            }
+            rOutput.mStatistics.mDelivered += lBatch.size();
+        }
+        for (auto &rPacket: lBatch) {
+            rOutput.mFunction(rPacket);
+        }
+        // Back to the pool unless the output kept a reference
+        lBatch.clear();
+    }
+}
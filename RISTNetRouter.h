@@ -0,0 +1,172 @@
+//
+// Routing of received data to several outputs without copies.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETROUTER_H
+#define CPPRISTWRAPPER__RISTNETROUTER_H
+
+#include "RISTNet.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/**
+ * \class RISTNetRouterOutputSettings
+ *
+ * \brief
+ *
+ * Settings of one output of RISTNetRouter.
+ *
+ */
+struct RISTNetRouterOutputSettings {
+    std::string mName;                       // Shown in the statistics and the thread diagnostics
+    size_t mQueueDepth = 1024;               // Packets queued for the output, more are dropped
+    std::vector<uint16_t> mConnectionIDs;    // The connection IDs the output gets, empty = all
+    RISTNetThreadSettings mThreadSettings;   // CPU placement and scheduling of the output thread
+};
+
+/**
+ * \class RISTNetRouterOutputStatistics
+ *
+ * \brief
+ *
+ * Counters of one output of RISTNetRouter.
+ *
+ */
+struct RISTNetRouterOutputStatistics {
+    std::string mName;
+    uint64_t mDelivered = 0;     // Packets handed to the output function
+    uint64_t mDropped = 0;       // Packets dropped because the queue of the output was full
+    size_t mQueued = 0;          // Packets in the queue now
+    size_t mMaxQueued = 0;       // The most packets queued
+};
+
+/**
+ * \class RISTNetRouter
+ *
+ * \brief
+ *
+ * Hands every received packet to several outputs. The packet is copied once, into a reference counted buffer
+ * from a pool allocated at start, and every output gets a reference in its own queue, served by its own thread.
+ * A slow output fills and drops from its own queue only. The pool has room for all queues, outputs keeping
+ * packets after the output function returns take them from the pool (route() then drops and counts them in
+ * poolExhausted()). The router must outlive the packets.
+ *
+ */
+class RISTNetRouter {
+public:
+    class Packet {
+    public:
+        Packet() = default;
+        Packet(const Packet &rOther);
+        Packet(Packet &&rOther) noexcept : mRouter(rOther.mRouter), mSlot(rOther.mSlot) { rOther.mRouter = nullptr; }
+        Packet &operator=(const Packet &rOther);
+        Packet &operator=(Packet &&rOther) noexcept;
+        ~Packet() { release(); }
+
+        const uint8_t *data() const;
+        size_t size() const;
+        uint16_t connectionID() const;
+        rist_peer *peer() const;
+        explicit operator bool() const { return mRouter != nullptr; }
+
+    private:
+        friend class RISTNetRouter;
+        Packet(RISTNetRouter *pRouter, uint32_t lSlot) : mRouter(pRouter), mSlot(lSlot) {}
+        void release();
+
+        RISTNetRouter *mRouter = nullptr;
+        uint32_t mSlot = 0;
+    };
+
+    using OutputFunction = std::function<void(const Packet &rPacket)>;
+
+    ~RISTNetRouter();
+
+    /// Add an output, before start(). Returns its index in the statistics
+    size_t addOutput(const RISTNetRouterOutputSettings &rSettings, OutputFunction pFunction);
+
+    /// Allocate the pool for packets of at most lMaxPacketSize bytes and start the output threads. Packets of an
+    /// earlier start must have been released
+    bool start(size_t lMaxPacketSize = RIST_MAX_PACKET_SIZE);
+
+    /// Stop the output threads, the queued packets are dropped. The outputs are kept
+    void stop();
+
+    /// Hand a packet to the outputs. Returns false if no output got it
+    bool route(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, rist_peer *pPeer = nullptr);
+
+    /// Set networkDataCallback of the receiver to route(). The receiver must not outlive the router
+    void attach(RISTNetReceiver &rReceiver);
+
+    void getStatistics(std::vector<RISTNetRouterOutputStatistics> &rStatistics);
+
+    /// Packets dropped because the pool was empty
+    uint64_t poolExhausted() const { return mPoolExhausted; }
+
+    /// Packets dropped because they were longer than lMaxPacketSize
+    uint64_t oversize() const { return mOversize; }
+
+    /// The output threads, if thread settings were given
+    void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+    RISTNetRouter() = default;
+    RISTNetRouter(RISTNetRouter const &) = delete;
+    RISTNetRouter &operator=(RISTNetRouter const &) = delete;
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> mReferences{0};
+        size_t mSize = 0;
+        uint16_t mConnectionID = 0;
+        rist_peer *mPeer = nullptr;
+    };
+
+    struct Output {
+        RISTNetRouterOutputSettings mSettings;
+        OutputFunction mFunction;
+        std::vector<bool> mConnectionIDs;   // Indexed by the connection ID, empty = all
+        std::mutex mMtx;
+        std::condition_variable mNotEmpty;
+        std::vector<Packet> mQueue;
+        size_t mHead = 0;
+        size_t mCount = 0;
+        bool mRunning = false;
+        RISTNetRouterOutputStatistics mStatistics;
+        std::vector<RISTNetThreadInfo> mThreadInfo;
+        std::thread mThread;
+    };
+
+    // Packets taken from a queue per lock
+    static constexpr size_t kOutputBatch = 64;
+
+    void outputWorker(Output &rOutput);
+    void releaseSlot(uint32_t lSlot);
+
+    std::vector<std::unique_ptr<Output>> mOutputs;
+
+    // The packet pool
+    size_t mMaxPacketSize = 0;
+    std::vector<uint8_t> mBuffers;
+    std::unique_ptr<Slot[]> mSlots;
+    std::mutex mPoolMtx;
+    std::vector<uint32_t> mFree;
+
+    std::atomic<uint64_t> mPoolExhausted{0};
+    std::atomic<uint64_t> mOversize{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETROUTER_H
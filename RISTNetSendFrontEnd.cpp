@@ -0,0 +1,168 @@
+//
+// Lock free multi producer input in front of a RISTNetSender.
+//
+
+#include "RISTNetSendFrontEnd.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    constexpr int kPollTimeout = 100; // ms
+}
+
+RISTNetSendFrontEnd::~RISTNetSendFrontEnd() {
+    stop();
+}
+
+bool RISTNetSendFrontEnd::start(RISTNetSender &rSender, const RISTNetSendFrontEndSettings &rSettings) {
+    stop();
+    if (!rSettings.mSlots || rSettings.mSlots > (1u << 30) || !rSettings.mSlotSize ||
+        rSettings.mSlotSize > UINT32_MAX || !rSettings.mBatchSize) {
+        LOGGER(true, LOGG_ERROR, "Send front end: slots, slot size or batch size not valid.")
+        return false;
+    }
+    size_t lSlotCount = 1;
+    while (lSlotCount < rSettings.mSlots) {
+        lSlotCount <<= 1;
+    }
+    mSender = &rSender;
+    mSettings = rSettings;
+    mMask = lSlotCount - 1;
+    mSlots = std::vector<Slot>(lSlotCount);
+    for (size_t i = 0; i < lSlotCount; i++) {
+        mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+    }
+    mData.assign(lSlotCount * mSettings.mSlotSize, 0);
+    mEnqueuePosition = 0;
+    mDequeuePosition = 0;
+    mWriterWaiting = false;
+    mDropped = 0;
+    mRejected = 0;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStatistics = RISTNetSendFrontEndStatistics();
+        mThreadInfo.clear();
+    }
+    mRunning.store(true, std::memory_order_release);
+    mThread = std::thread(&RISTNetSendFrontEnd::writerWorker, this);
+    return true;
+}
+
+void RISTNetSendFrontEnd::stop() {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mRunning = false;
+    }
+    mWake.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+bool RISTNetSendFrontEnd::send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID) {
+    if (!mRunning.load(std::memory_order_acquire) || lSize > mSettings.mSlotSize) {
+        mRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // Claim the next free slot, the producers only contend on the position
+    uint64_t lPosition = mEnqueuePosition.load(std::memory_order_relaxed);
+    Slot *pSlot;
+    while (true) {
+        pSlot = &mSlots[lPosition & mMask];
+        uint64_t lSequence = pSlot->mSequence.load(std::memory_order_acquire);
+        auto lDifference = (int64_t) (lSequence - lPosition);
+        if (lDifference == 0) {
+            if (mEnqueuePosition.compare_exchange_weak(lPosition, lPosition + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lDifference < 0) {
+            // The writer has not freed the slot of the previous lap
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            lPosition = mEnqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(mData.data() + (lPosition & mMask) * mSettings.mSlotSize, pData, lSize);
+    pSlot->mSize = (uint32_t) lSize;
+    pSlot->mConnectionID = lConnectionID;
+    pSlot->mSequence.store(lPosition + 1, std::memory_order_release);
+
+    // Pairs with the fence in writerWorker, either the writer sees the slot or the producer sees it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mWriterWaiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mWake.notify_one();
+    }
+    return true;
+}
+
+bool RISTNetSendFrontEnd::ready(uint64_t lPosition) const {
+    return mSlots[lPosition & mMask].mSequence.load(std::memory_order_acquire) == lPosition + 1;
+}
+
+void RISTNetSendFrontEnd::getStatistics(RISTNetSendFrontEndStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics = mStatistics;
+    rStatistics.mQueued = mEnqueuePosition.load(std::memory_order_relaxed) -
+                          mDequeuePosition.load(std::memory_order_relaxed);
+    rStatistics.mDropped = mDropped.load(std::memory_order_relaxed);
+    rStatistics.mRejected = mRejected.load(std::memory_order_relaxed);
+}
+
+void RISTNetSendFrontEnd::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rThreads = mThreadInfo;
+}
+
+void RISTNetSendFrontEnd::writerWorker() {
+    if (!mSettings.mThreadSettings.isDefault()) {
+        RISTNetThreadInfo lInfo;
+        RISTNetThreadBinder::applyToCurrentThread(mSettings.mThreadSettings, lInfo);
+        lInfo.mRole = "send front end";
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mThreadInfo.push_back(lInfo);
+    }
+
+    std::vector<RISTNetSender::DataBlock> lBlocks(mSettings.mBatchSize);
+    uint64_t lPosition = mDequeuePosition.load(std::memory_order_relaxed);
+    while (true) {
+        // The slots are passed to the sender where they are and freed after
+        size_t lCount = 0;
+        while (lCount < lBlocks.size() && ready(lPosition + lCount)) {
+            size_t lIndex = (lPosition + lCount) & mMask;
+            RISTNetSender::DataBlock &rBlock = lBlocks[lCount++];
+            rBlock.mData = mData.data() + lIndex * mSettings.mSlotSize;
+            rBlock.mSize = mSlots[lIndex].mSize;
+            rBlock.mConnectionID = mSlots[lIndex].mConnectionID;
+        }
+        if (!lCount) {
+            // Stopping passes on what is queued first
+            if (!mRunning) {
+                break;
+            }
+            mWriterWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::unique_lock<std::mutex> lLock(mMtx);
+            mWake.wait_for(lLock, std::chrono::milliseconds(kPollTimeout), [&]() {
+                return !mRunning || ready(lPosition);
+            });
+            mWriterWaiting.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        size_t lSent = mSender->sendDataBatch(lBlocks.data(), lCount);
+        for (size_t i = 0; i < lCount; i++) {
+            mSlots[(lPosition + i) & mMask].mSequence.store(lPosition + i + mMask + 1, std::memory_order_release);
+        }
+        lPosition += lCount;
+        mDequeuePosition.store(lPosition, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStatistics.mSent += lSent;
+        mStatistics.mBatches++;
+        mStatistics.mWriteErrors += lCount - lSent;
+    }
+}
@@ -0,0 +1,141 @@
+//
+// Lock free multi producer input in front of a RISTNetSender.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETSENDFRONTEND_H
+#define CPPRISTWRAPPER__RISTNETSENDFRONTEND_H
+
+#include "RISTNet.h"
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+
+/**
+ * \class RISTNetSendFrontEndSettings
+ *
+ * \brief
+ *
+ * Settings of RISTNetSendFrontEnd.
+ *
+ */
+struct RISTNetSendFrontEndSettings {
+    size_t mSlots = 4096;                // Packets queued, rounded up to a power of two
+    size_t mSlotSize = 1500;             // Longest packet
+    size_t mBatchSize = 64;              // Packets passed to sendDataBatch at a time
+    RISTNetThreadSettings mThreadSettings; // CPU placement and scheduling of the writer thread
+};
+
+/**
+ * \class RISTNetSendFrontEndStatistics
+ *
+ * \brief
+ *
+ * Counters of RISTNetSendFrontEnd.
+ *
+ */
+struct RISTNetSendFrontEndStatistics {
+    uint64_t mQueued = 0;          // Packets in the queue now
+    uint64_t mSent = 0;            // Packets the sender accepted
+    uint64_t mBatches = 0;         // sendDataBatch calls
+    uint64_t mDropped = 0;         // Packets dropped since the queue was full
+    uint64_t mRejected = 0;        // Packets longer than mSlotSize or sent while stopped
+    uint64_t mWriteErrors = 0;     // Packets the sender did not accept
+};
+
+/**
+ * \class RISTNetSendFrontEnd
+ *
+ * \brief
+ *
+ * Any number of threads send through the front end, one writer thread passes the packets to the sender, which is
+ * only ever called from that thread. send() copies the packet into a bounded queue with a compare and swap, no
+ * lock, and drops the packet if the queue is full. Packets sent by one thread reach the sender in the order they
+ * were sent, packets of different threads interleave. The writer sleeps when the queue is empty, a producer takes
+ * the lock to wake it only then.
+ *
+ * The sender must outlive the front end. An error of the sender might destroy it from the writer thread, the
+ * packets after are counted as write errors.
+ *
+ */
+class RISTNetSendFrontEnd {
+public:
+    /// Sends with a fixed connection ID, for a thread feeding one elementary stream
+    class Producer {
+    public:
+        bool send(const uint8_t *pData, size_t lSize) { return mFrontEnd->send(pData, lSize, mConnectionID); }
+        uint16_t connectionID() const { return mConnectionID; }
+
+    private:
+        friend class RISTNetSendFrontEnd;
+        Producer(RISTNetSendFrontEnd *pFrontEnd, uint16_t lConnectionID)
+                : mFrontEnd(pFrontEnd), mConnectionID(lConnectionID) {}
+
+        RISTNetSendFrontEnd *mFrontEnd;
+        uint16_t mConnectionID;
+    };
+
+    ~RISTNetSendFrontEnd();
+
+    /// Start the writer thread. Returns false, with nothing started, on failure
+    bool start(RISTNetSender &rSender, const RISTNetSendFrontEndSettings &rSettings = RISTNetSendFrontEndSettings());
+
+    /// Pass what is queued to the sender and stop. No thread may be in send() meanwhile
+    void stop();
+
+    /// Queue a packet, thread safe. Returns false if it was dropped or rejected
+    bool send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID = 0);
+
+    Producer producer(uint16_t lConnectionID) { return Producer(this, lConnectionID); }
+
+    void getStatistics(RISTNetSendFrontEndStatistics &rStatistics);
+
+    /// The writer thread, if thread settings were given
+    void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+    RISTNetSendFrontEnd() = default;
+    RISTNetSendFrontEnd(RISTNetSendFrontEnd const &) = delete;
+    RISTNetSendFrontEnd &operator=(RISTNetSendFrontEnd const &) = delete;
+
+private:
+    // mSequence is the position the slot is free for, position + 1 once it is written
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> mSequence{0};
+        uint32_t mSize = 0;
+        uint16_t mConnectionID = 0;
+    };
+
+    bool ready(uint64_t lPosition) const;
+    void writerWorker();
+
+    RISTNetSender *mSender = nullptr;
+    RISTNetSendFrontEndSettings mSettings;
+    std::vector<Slot> mSlots;
+    std::vector<uint8_t> mData;
+    size_t mMask = 0;
+
+    // Producers and the writer on separate cache lines
+    alignas(64) std::atomic<uint64_t> mEnqueuePosition{0};
+    alignas(64) std::atomic<uint64_t> mDequeuePosition{0};
+    std::atomic<bool> mWriterWaiting{false};
+    alignas(64) std::atomic<bool> mRunning{false};
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<uint64_t> mRejected{0};
+
+    std::mutex mMtx;
+    std::condition_variable mWake;
+    std::thread mThread;
+    RISTNetSendFrontEndStatistics mStatistics;
+    std::vector<RISTNetThreadInfo> mThreadInfo;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETSENDFRONTEND_H
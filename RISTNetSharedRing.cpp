@@ -0,0 +1,383 @@
+//
+// Shared memory rings to processes on the same host, feeding a RISTNetSender and fed by a RISTNetReceiver.
+//
+
+#include "RISTNetSharedRing.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    constexpr int kPollTimeout = 100; // ms
+
+    void closeFd(int &rFd) {
+        if (rFd >= 0) {
+            close(rFd);
+            rFd = -1;
+        }
+    }
+
+    // A read-only descriptor of the same memfd, the mapping it allows can not be made writable
+    int reopenReadOnly(int lFd) {
+        std::string lPath = "/proc/self/fd/" + std::to_string(lFd);
+        return open(lPath.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetSharedRing
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetSharedRing::RISTNetSharedRing() {
+    mRing.socket = mRing.data_event = mRing.space_event = -1;
+}
+
+RISTNetSharedRing::~RISTNetSharedRing() {
+    destroy();
+}
+
+bool RISTNetSharedRing::create(const RISTNetSharedRingSettings &rSettings, ristnet_ring_role lRole) {
+    destroy();
+    sockaddr_un lAddress{};
+    lAddress.sun_family = AF_UNIX;
+    if (rSettings.mSocketPath.empty() || rSettings.mSocketPath.size() >= sizeof(lAddress.sun_path) ||
+        !rSettings.mSlots || rSettings.mSlots > (1u << 30) || !rSettings.mSlotSize ||
+        rSettings.mSlotSize > UINT32_MAX - RISTNET_RING_SLOT_HEADER - RISTNET_RING_ALIGN) {
+        LOGGER(true, LOGG_ERROR, "Shared ring: socket path, slots or slot size not valid.")
+        return false;
+    }
+    mSlotCount = 1;
+    while (mSlotCount < rSettings.mSlots) {
+        mSlotCount <<= 1;
+    }
+    mSlotSize = rSettings.mSlotSize;
+    mSlotStride = (RISTNET_RING_SLOT_HEADER + mSlotSize + RISTNET_RING_ALIGN - 1) & ~(size_t) (RISTNET_RING_ALIGN - 1);
+    size_t lPageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t lRingSize = lPageSize + mSlotCount * mSlotStride;
+
+    // The size is sealed before the memory is handed out, an attached process truncating it would get the
+    // wrapper a SIGBUS
+    const int lSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+    mRingFd = memfd_create("ristnet-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    mConsumerFd = memfd_create("ristnet-ring-consumer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mRingFd < 0 || mConsumerFd < 0 || ftruncate(mRingFd, (off_t) lRingSize) ||
+        ftruncate(mConsumerFd, (off_t) lPageSize) || fcntl(mRingFd, F_ADD_SEALS, lSeals) ||
+        fcntl(mConsumerFd, F_ADD_SEALS, lSeals)) {
+        LOGGER(true, LOGG_ERROR, "Shared ring: memfd failed: " << strerror(errno))
+        destroy();
+        return false;
+    }
+    mRingReadOnlyFd = reopenReadOnly(mRingFd);
+    mConsumerReadOnlyFd = reopenReadOnly(mConsumerFd);
+    // The wrapper maps both sides writable, it resets the peer's side when a process attaches or detaches
+    void *pProducer = mmap(nullptr, lRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, mRingFd, 0);
+    void *pConsumer = mmap(nullptr, lPageSize, PROT_READ | PROT_WRITE, MAP_SHARED, mConsumerFd, 0);
+    mRing.producer = pProducer == MAP_FAILED ? nullptr : (ristnet_ring_producer_control *) pProducer;
+    mRing.consumer = pConsumer == MAP_FAILED ? nullptr : (ristnet_ring_consumer_control *) pConsumer;
+    mRing.ring_size = lRingSize;
+    mRing.consumer_size = lPageSize;
+    mRing.data_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mRing.space_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mStopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mRingReadOnlyFd < 0 || mConsumerReadOnlyFd < 0 || !mRing.producer || !mRing.consumer ||
+        mRing.data_event < 0 || mRing.space_event < 0 || mStopEvent < 0) {
+        LOGGER(true, LOGG_ERROR, "Shared ring: mapping or eventfd failed: " << strerror(errno))
+        destroy();
+        return false;
+    }
+    mRing.role = lRole;
+    mRing.socket = -1;
+    mRing.slots = (uint8_t *) mRing.producer + lPageSize;
+    mRing.position = 0;
+    ristnet_ring_producer_control &rControl = *mRing.producer;
+    rControl.magic = RISTNET_RING_MAGIC;
+    rControl.version = RISTNET_RING_VERSION;
+    rControl.slot_count = (uint32_t) mSlotCount;
+    rControl.slot_size = (uint32_t) mSlotSize;
+    rControl.slot_stride = (uint32_t) mSlotStride;
+    rControl.slots_offset = lPageSize;
+
+    memcpy(lAddress.sun_path, rSettings.mSocketPath.c_str(), rSettings.mSocketPath.size());
+    unlink(rSettings.mSocketPath.c_str());
+    mListenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (mListenSocket < 0 || bind(mListenSocket, (sockaddr *) &lAddress, sizeof(lAddress)) ||
+        listen(mListenSocket, 4)) {
+        LOGGER(true, LOGG_ERROR, "Shared ring: socket " << rSettings.mSocketPath << " failed: " << strerror(errno))
+        destroy();
+        return false;
+    }
+    mSocketPath = rSettings.mSocketPath;
+    mThread = std::thread(&RISTNetSharedRing::serveWorker, this);
+    return true;
+}
+
+void RISTNetSharedRing::destroy() {
+    if (mThread.joinable()) {
+        uint64_t lOne = 1;
+        if (write(mStopEvent, &lOne, sizeof(lOne)) < 0) {
+            LOGGER(true, LOGG_ERROR, "Shared ring: stopping failed: " << strerror(errno))
+        }
+        mThread.join();
+    }
+    if (!mSocketPath.empty()) {
+        unlink(mSocketPath.c_str());
+        mSocketPath.clear();
+    }
+    closeFd(mListenSocket);
+    closeFd(mStopEvent);
+    closeFd(mRingFd);
+    closeFd(mRingReadOnlyFd);
+    closeFd(mConsumerFd);
+    closeFd(mConsumerReadOnlyFd);
+    closeFd(mRing.data_event);
+    closeFd(mRing.space_event);
+    ristnet_ring_unmap_(&mRing);
+    mAttached = false;
+}
+
+bool RISTNetSharedRing::handOut(int lConnection) {
+    bool lPeerProduces = mRing.role == RISTNET_RING_CONSUMER;
+    // A new consumer starts at the newest packet, the wakeups meant for the last process are dropped
+    uint64_t lCount;
+    while (read(mRing.data_event, &lCount, sizeof(lCount)) > 0 || read(mRing.space_event, &lCount, sizeof(lCount)) > 0) {
+    }
+    if (lPeerProduces) {
+        __atomic_store_n(&mRing.producer->producer_waiting, 0, __ATOMIC_SEQ_CST);
+    } else {
+        __atomic_store_n(&mRing.consumer->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&mRing.consumer->tail, __atomic_load_n(&mRing.producer->head, __ATOMIC_ACQUIRE),
+                         __ATOMIC_RELEASE);
+    }
+
+    char lRole = lPeerProduces ? RISTNET_RING_PRODUCER : RISTNET_RING_CONSUMER;
+    int lFds[4] = {lPeerProduces ? mRingFd : mRingReadOnlyFd, lPeerProduces ? mConsumerReadOnlyFd : mConsumerFd,
+                   mRing.data_event, mRing.space_event};
+    iovec lVector{&lRole, 1};
+    union {
+        cmsghdr mAlign;
+        char mBuffer[CMSG_SPACE(sizeof(lFds))];
+    } lControl{};
+    msghdr lMessage{};
+    lMessage.msg_iov = &lVector;
+    lMessage.msg_iovlen = 1;
+    lMessage.msg_control = lControl.mBuffer;
+    lMessage.msg_controllen = sizeof(lControl.mBuffer);
+    cmsghdr *pHeader = CMSG_FIRSTHDR(&lMessage);
+    pHeader->cmsg_level = SOL_SOCKET;
+    pHeader->cmsg_type = SCM_RIGHTS;
+    pHeader->cmsg_len = CMSG_LEN(sizeof(lFds));
+    memcpy(CMSG_DATA(pHeader), lFds, sizeof(lFds));
+    if (sendmsg(lConnection, &lMessage, MSG_NOSIGNAL) != 1) {
+        LOGGER(true, LOGG_ERROR, "Shared ring: handing out the ring failed: " << strerror(errno))
+        return false;
+    }
+    return true;
+}
+
+void RISTNetSharedRing::serveWorker() {
+    int lConnection = -1;
+    while (true) {
+        pollfd lPoll[3] = {{mStopEvent, POLLIN, 0}, {mListenSocket, POLLIN, 0}, {lConnection, POLLIN, 0}};
+        if (poll(lPoll, lConnection >= 0 ? 3 : 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGGER(true, LOGG_ERROR, "Shared ring: poll failed: " << strerror(errno))
+            break;
+        }
+        if (lPoll[0].revents) {
+            break;
+        }
+        if (lConnection >= 0 && lPoll[2].revents) {
+            // The process detached or exited. Nothing is expected on the connection
+            char lByte;
+            if (recv(lConnection, &lByte, 1, MSG_DONTWAIT) <= 0) {
+                closeFd(lConnection);
+                mAttached = false;
+            }
+        }
+        if (lPoll[1].revents & POLLIN) {
+            int lNew = accept4(mListenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (lNew < 0) {
+                continue;
+            }
+            if (lConnection >= 0) {
+                LOGGER(true, LOGG_WARN, "Shared ring: a process is attached already, refused another.")
+                close(lNew);
+                continue;
+            }
+            if (!handOut(lNew)) {
+                close(lNew);
+                continue;
+            }
+            lConnection = lNew;
+            mAttaches++;
+            mAttached = true;
+        }
+    }
+    closeFd(lConnection);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetSharedRingIngest
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetSharedRingIngest::~RISTNetSharedRingIngest() {
+    stop();
+}
+
+bool RISTNetSharedRingIngest::start(RISTNetSender &rSender, const RISTNetSharedRingSettings &rSettings) {
+    stop();
+    if (!rSettings.mBatchSize) {
+        LOGGER(true, LOGG_ERROR, "Shared ring ingest: no batch size.")
+        return false;
+    }
+    if (!mRing.create(rSettings, RISTNET_RING_CONSUMER)) {
+        return false;
+    }
+    mSender = &rSender;
+    mSettings = rSettings;
+    mRunning = true;
+    mThread = std::thread(&RISTNetSharedRingIngest::ingestWorker, this);
+    return true;
+}
+
+void RISTNetSharedRingIngest::stop() {
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    mRing.destroy();
+}
+
+void RISTNetSharedRingIngest::getStatistics(RISTNetSharedRingStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics = mStatistics;
+    rStatistics.mAttaches = mRing.attaches();
+    rStatistics.mAttached = mRing.attached();
+}
+
+void RISTNetSharedRingIngest::getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rThreads = mThreadInfo;
+}
+
+void RISTNetSharedRingIngest::ingestWorker() {
+    if (!mSettings.mThreadSettings.isDefault()) {
+        RISTNetThreadInfo lInfo;
+        RISTNetThreadBinder::applyToCurrentThread(mSettings.mThreadSettings, lInfo);
+        lInfo.mRole = "shared ring ingest";
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mThreadInfo.push_back(lInfo);
+    }
+
+    ristnet_ring &rRing = mRing.ring();
+    std::vector<RISTNetSender::DataBlock> lBlocks(mSettings.mBatchSize);
+    while (mRunning) {
+        if (ristnet_ring_wait_data(&rRing, kPollTimeout)) {
+            continue;
+        }
+        // The slots are sent from the shared memory and given back after
+        uint64_t lReadable = std::min<uint64_t>(ristnet_ring_readable(&rRing), mSettings.mBatchSize);
+        size_t lCount = 0;
+        size_t lBytes = 0;
+        uint64_t lMalformed = 0;
+        for (uint64_t i = 0; i < lReadable; i++) {
+            const ristnet_ring_slot *pSlot = mRing.slot(rRing.position + i);
+            // Read once, the producer might change it
+            uint32_t lSize = __atomic_load_n(&pSlot->size, __ATOMIC_RELAXED);
+            if (lSize > mRing.slotSize()) {
+                lMalformed++;
+                continue;
+            }
+            RISTNetSender::DataBlock &rBlock = lBlocks[lCount++];
+            rBlock.mData = pSlot->data;
+            rBlock.mSize = lSize;
+            rBlock.mConnectionID = pSlot->flow_id;
+            lBytes += lSize;
+        }
+        size_t lSent = lCount ? mSender->sendDataBatch(lBlocks.data(), lCount) : 0;
+        ristnet_ring_release(&rRing, lReadable);
+
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mStatistics.mPackets += lReadable;
+        mStatistics.mBytes += lBytes;
+        mStatistics.mBatches++;
+        mStatistics.mMalformed += lMalformed;
+        mStatistics.mDropped += lCount - lSent;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetSharedRingEgress
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetSharedRingEgress::~RISTNetSharedRingEgress() {
+    stop();
+}
+
+bool RISTNetSharedRingEgress::start(const RISTNetSharedRingSettings &rSettings) {
+    stop();
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mRunning = mRing.create(rSettings, RISTNET_RING_PRODUCER);
+    return mRunning;
+}
+
+void RISTNetSharedRingEgress::stop() {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mRunning = false;
+    }
+    mRing.destroy();
+}
+
+bool RISTNetSharedRingEgress::send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    if (!mRunning) {
+        return false;
+    }
+    if (lSize > mRing.slotSize()) {
+        mStatistics.mMalformed++;
+        return false;
+    }
+    ristnet_ring &rRing = mRing.ring();
+    // Without a process attached nobody frees the slots
+    if (!mRing.attached() || !ristnet_ring_writable(&rRing)) {
+        mStatistics.mDropped++;
+        return false;
+    }
+    ristnet_ring_slot *pSlot = mRing.slot(rRing.position);
+    memcpy(pSlot->data, pData, lSize);
+    pSlot->size = (uint32_t) lSize;
+    pSlot->flow_id = lConnectionID;
+    ristnet_ring_publish(&rRing, 1);
+    mStatistics.mPackets++;
+    mStatistics.mBytes += lSize;
+    return true;
+}
+
+void RISTNetSharedRingEgress::attach(RISTNetReceiver &rReceiver) {
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &, rist_peer *,
+                                           uint16_t lConnectionID) {
+        send(pBuf, lSize, lConnectionID);
+        return 0;
+    };
+}
+
+void RISTNetSharedRingEgress::getStatistics(RISTNetSharedRingStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics = mStatistics;
+    rStatistics.mAttaches = mRing.attaches();
+    rStatistics.mAttached = mRing.attached();
+}
@@ -0,0 +1,200 @@
+//
+// Shared memory rings to processes on the same host, feeding a RISTNetSender and fed by a RISTNetReceiver.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETSHAREDRING_H
+#define CPPRISTWRAPPER__RISTNETSHAREDRING_H
+
+#ifndef __linux__
+#error "The shared memory rings need memfd and eventfd, they are only built on Linux"
+#endif
+
+#include "RISTNet.h"
+#include "ristnet_shm_ring.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+/**
+ * \class RISTNetSharedRingSettings
+ *
+ * \brief
+ *
+ * Settings of RISTNetSharedRingIngest and RISTNetSharedRingEgress.
+ *
+ */
+struct RISTNetSharedRingSettings {
+    std::string mSocketPath;             // UNIX socket the ring is handed out on, replaced if it exists
+    size_t mSlots = 4096;                // Packets the ring holds, rounded up to a power of two
+    size_t mSlotSize = 1500;             // Longest packet
+    size_t mBatchSize = 64;              // Ingest: packets passed to sendDataBatch at a time
+    RISTNetThreadSettings mThreadSettings; // Ingest: CPU placement and scheduling of the thread reading the ring
+};
+
+/**
+ * \class RISTNetSharedRingStatistics
+ *
+ * \brief
+ *
+ * Counters of a shared ring.
+ *
+ */
+struct RISTNetSharedRingStatistics {
+    uint64_t mPackets = 0;         // Packets read from (ingest) or written to (egress) the ring
+    uint64_t mBytes = 0;
+    uint64_t mBatches = 0;         // Ingest: sendDataBatch calls
+    uint64_t mDropped = 0;         // Ingest: packets the sender did not accept. Egress: packets the ring had no room for
+    uint64_t mMalformed = 0;       // Ingest: slots with a size beyond mSlotSize. Egress: packets longer than mSlotSize
+    uint64_t mAttaches = 0;        // Processes attached so far
+    bool mAttached = false;        // A process is attached now
+};
+
+/**
+ * \class RISTNetSharedRing
+ *
+ * \brief
+ *
+ * The memory, the eventfds and the UNIX socket of a ring created by the wrapper, see ristnet_shm_ring.h. The
+ * memory is a pair of memfds: the ring (producer control page and slots) and the consumer control page. A thread
+ * serves the socket, a connecting process gets the descriptors for the other role, with the memory of this side
+ * read-only, and stays attached until it closes the connection. Further processes are refused meanwhile.
+ *
+ */
+class RISTNetSharedRing {
+public:
+    ~RISTNetSharedRing();
+
+    /// Create the ring with the wrapper in role lRole and serve it on the socket
+    bool create(const RISTNetSharedRingSettings &rSettings, ristnet_ring_role lRole);
+
+    void destroy();
+
+    /// The wrapper's side of the ring, for the ristnet_ring functions
+    ristnet_ring &ring() { return mRing; }
+
+    /// The slot at lPosition, addressed with the wrapper's copy of the layout and not the shared one
+    ristnet_ring_slot *slot(uint64_t lPosition) {
+        return (ristnet_ring_slot *) (mRing.slots + (size_t) (lPosition & (mSlotCount - 1)) * mSlotStride);
+    }
+
+    size_t slotSize() const { return mSlotSize; }
+
+    bool attached() const { return mAttached; }
+    uint64_t attaches() const { return mAttaches; }
+
+    RISTNetSharedRing();
+    RISTNetSharedRing(RISTNetSharedRing const &) = delete;
+    RISTNetSharedRing &operator=(RISTNetSharedRing const &) = delete;
+
+private:
+    void serveWorker();
+    bool handOut(int lConnection);
+
+    std::string mSocketPath;
+    int mListenSocket = -1;
+    int mStopEvent = -1;
+    // The descriptors handed out: the ring memory and the consumer memory writable and read-only
+    int mRingFd = -1;
+    int mRingReadOnlyFd = -1;
+    int mConsumerFd = -1;
+    int mConsumerReadOnlyFd = -1;
+    ristnet_ring mRing{};
+    size_t mSlotCount = 0;
+    size_t mSlotSize = 0;
+    size_t mSlotStride = 0;
+    std::atomic<bool> mAttached{false};
+    std::atomic<uint64_t> mAttaches{0};
+    std::thread mThread;
+};
+
+/**
+ * \class RISTNetSharedRingIngest
+ *
+ * \brief
+ *
+ * A process on the same host writes packets into the ring, they are sent with a RISTNetSender. The ingest thread
+ * passes the slots to sendDataBatch where they are, a batch at a time, and frees them after. The sender must
+ * outlive the ingest.
+ *
+ */
+class RISTNetSharedRingIngest {
+public:
+    ~RISTNetSharedRingIngest();
+
+    /// Create the ring and start reading it. Returns false, with nothing started, on failure
+    bool start(RISTNetSender &rSender, const RISTNetSharedRingSettings &rSettings);
+
+    void stop();
+
+    void getStatistics(RISTNetSharedRingStatistics &rStatistics);
+
+    /// The thread reading the ring, if thread settings were given
+    void getThreadDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+    RISTNetSharedRingIngest() = default;
+    RISTNetSharedRingIngest(RISTNetSharedRingIngest const &) = delete;
+    RISTNetSharedRingIngest &operator=(RISTNetSharedRingIngest const &) = delete;
+
+private:
+    void ingestWorker();
+
+    RISTNetSender *mSender = nullptr;
+    RISTNetSharedRingSettings mSettings;
+    RISTNetSharedRing mRing;
+    std::atomic<bool> mRunning{false};
+    std::thread mThread;
+    std::mutex mMtx;
+    RISTNetSharedRingStatistics mStatistics;
+    std::vector<RISTNetThreadInfo> mThreadInfo;
+};
+
+/**
+ * \class RISTNetSharedRingEgress
+ *
+ * \brief
+ *
+ * Publishes the packets received by a RISTNetReceiver into the ring for a process on the same host, which maps it
+ * read-only. send() copies the packet into the next slot and never blocks, a full ring drops it. The consumer
+ * starts at the newest packet when it attaches.
+ *
+ */
+class RISTNetSharedRingEgress {
+public:
+    ~RISTNetSharedRingEgress();
+
+    /// Create the ring. Returns false on failure
+    bool start(const RISTNetSharedRingSettings &rSettings);
+
+    void stop();
+
+    /// Write a packet into the ring. Returns false if it was dropped
+    bool send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID);
+
+    /// Set networkDataCallback of the receiver to send(). The receiver must not outlive the egress
+    void attach(RISTNetReceiver &rReceiver);
+
+    void getStatistics(RISTNetSharedRingStatistics &rStatistics);
+
+    RISTNetSharedRingEgress() = default;
+    RISTNetSharedRingEgress(RISTNetSharedRingEgress const &) = delete;
+    RISTNetSharedRingEgress &operator=(RISTNetSharedRingEgress const &) = delete;
+
+private:
+    RISTNetSharedRing mRing;
+    // One producer, send() might be called from several threads
+    std::mutex mMtx;
+    bool mRunning = false;
+    RISTNetSharedRingStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETSHAREDRING_H
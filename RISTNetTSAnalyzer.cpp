@@ -0,0 +1,415 @@
+//
+// MPEG transport stream health analysis used by the RIST C++ wrapper.
+//
+
+#include "RISTNetTSAnalyzer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RISTNET_TS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    // The PCR counts 27 MHz ticks modulo 2^33 * 300
+    constexpr uint64_t kPCRModulo = (1ULL << 33) * 300;
+
+    int64_t pcrToNanoseconds(uint64_t lTicks) {
+        return (int64_t) (lTicks / 27 * 1000 + lTicks % 27 * 1000 / 27);
+    }
+
+    size_t findSyncScalar(const uint8_t *pData, size_t lSize) {
+        for (size_t i = 0; i < lSize; i++) {
+            if (pData[i] == RISTNetTSAnalyzer::kSyncByte) {
+                return i;
+            }
+        }
+        return lSize;
+    }
+
+#ifdef RISTNET_TS_X86
+    __attribute__((target("sse2")))
+    size_t findSyncSSE2(const uint8_t *pData, size_t lSize) {
+        const __m128i lSync = _mm_set1_epi8((char) RISTNetTSAnalyzer::kSyncByte);
+        size_t i = 0;
+        for (; i + 16 <= lSize; i += 16) {
+            __m128i lBytes = _mm_loadu_si128((const __m128i *) (pData + i));
+            int lMask = _mm_movemask_epi8(_mm_cmpeq_epi8(lBytes, lSync));
+            if (lMask) {
+                return i + __builtin_ctz((unsigned) lMask);
+            }
+        }
+        return i + findSyncScalar(pData + i, lSize - i);
+    }
+
+    __attribute__((target("avx2")))
+    size_t findSyncAVX2(const uint8_t *pData, size_t lSize) {
+        const __m256i lSync = _mm256_set1_epi8((char) RISTNetTSAnalyzer::kSyncByte);
+        size_t i = 0;
+        for (; i + 32 <= lSize; i += 32) {
+            __m256i lBytes = _mm256_loadu_si256((const __m256i *) (pData + i));
+            uint32_t lMask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(lBytes, lSync));
+            if (lMask) {
+                return i + __builtin_ctz(lMask);
+            }
+        }
+        return i + findSyncSSE2(pData + i, lSize - i);
+    }
+#endif
+
+    using FindSyncFunction = size_t (*)(const uint8_t *, size_t);
+
+    FindSyncFunction functionOf(RISTNetTSAnalyzer::Implementation lImplementation) {
+        switch (lImplementation) {
+#ifdef RISTNET_TS_X86
+            case RISTNetTSAnalyzer::Implementation::kSSE2:
+                return findSyncSSE2;
+            case RISTNetTSAnalyzer::Implementation::kAVX2:
+                return findSyncAVX2;
+#endif
+            default:
+                return findSyncScalar;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetTSAnalyzer -- sync scan
+//---------------------------------------------------------------------------------------------------------------------
+
+bool RISTNetTSAnalyzer::isSupported(Implementation lImplementation) {
+    switch (lImplementation) {
+        case Implementation::kScalar:
+            return true;
+        case Implementation::kSSE2:
+#ifdef RISTNET_TS_X86
+            return __builtin_cpu_supports("sse2");
+#else
+            return false;
+#endif
+        case Implementation::kAVX2:
+#ifdef RISTNET_TS_X86
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+RISTNetTSAnalyzer::Implementation RISTNetTSAnalyzer::selectedImplementation() {
+    static const Implementation lImplementation = isSupported(Implementation::kAVX2) ? Implementation::kAVX2 :
+                                                  isSupported(Implementation::kSSE2) ? Implementation::kSSE2 :
+                                                  Implementation::kScalar;
+    return lImplementation;
+}
+
+const char *RISTNetTSAnalyzer::implementationName(Implementation lImplementation) {
+    switch (lImplementation) {
+        case Implementation::kScalar:
+            return "scalar";
+        case Implementation::kSSE2:
+            return "sse2";
+        case Implementation::kAVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+size_t RISTNetTSAnalyzer::findSync(const uint8_t *pData, size_t lSize) {
+    static const FindSyncFunction lFunction = functionOf(selectedImplementation());
+    return lFunction(pData, lSize);
+}
+
+size_t RISTNetTSAnalyzer::findSync(const uint8_t *pData, size_t lSize, Implementation lImplementation) {
+    return functionOf(lImplementation)(pData, lSize);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetTSAnalyzer
+//---------------------------------------------------------------------------------------------------------------------
+
+int64_t RISTNetTSAnalyzer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t RISTNetTSAnalyzer::memoryUsage() {
+    return sizeof(std::array<uint16_t, 8192>) + kMaxPIDs * sizeof(PIDState);
+}
+
+RISTNetTSAnalyzer::RISTNetTSAnalyzer() : mPIDIndex(std::make_unique<std::array<uint16_t, 8192>>()),
+                                         mPIDs(kMaxPIDs) {
+    mPIDIndex->fill(0);
+}
+
+RISTNetTSAnalyzer::PIDState *RISTNetTSAnalyzer::pidState(uint16_t lPID) {
+    uint16_t &rIndex = (*mPIDIndex)[lPID];
+    if (!rIndex) {
+        if (mPIDCount == kMaxPIDs) {
+            return nullptr;
+        }
+        mPIDs[mPIDCount].mPID = lPID;
+        rIndex = (uint16_t) ++mPIDCount;
+    }
+    return &mPIDs[rIndex - 1];
+}
+
+void RISTNetTSAnalyzer::analyze(const uint8_t *pData, size_t lSize, int64_t lNow) {
+    if (!mStarted) {
+        mStarted = true;
+        mWindowStart = lNow;
+        mLastTimeoutCheck = lNow;
+        mLastPAT = lNow;
+    }
+    size_t lOffset = 0;
+    while (lOffset + kPacketSize <= lSize) {
+        if (pData[lOffset] == kSyncByte) {
+            mBadSyncs = 0;
+            if (!mInSync && ++mGoodSyncs >= kSyncAcquire) {
+                mInSync = true;
+            }
+            analyzePacket(pData + lOffset, lNow);
+            lOffset += kPacketSize;
+            continue;
+        }
+        mGoodSyncs = 0;
+        if (mInSync) {
+            mCounters.mSyncByteErrors++;
+            if (++mBadSyncs < kSyncLose) {
+                // A corrupted packet, the next one is expected in place
+                lOffset += kPacketSize;
+                continue;
+            }
+            mInSync = false;
+            mCounters.mSyncLosses++;
+        }
+        // Hunt for a sync byte followed by another one a packet later
+        while (true) {
+            lOffset += 1 + findSync(pData + lOffset + 1, lSize - lOffset - 1);
+            if (lOffset + 2 * kPacketSize > lSize || pData[lOffset + kPacketSize] == kSyncByte) {
+                break;
+            }
+        }
+    }
+    if (lNow - mLastTimeoutCheck >= kTimeoutCheck) {
+        checkTimeouts(lNow);
+    }
+    if (lNow - mWindowStart >= kBitrateWindow) {
+        closeWindow(lNow);
+    }
+}
+
+void RISTNetTSAnalyzer::analyzePacket(const uint8_t *pPacket, int64_t lNow) {
+    mCounters.mPackets++;
+    mWindowPackets++;
+    if (pPacket[1] & 0x80) {
+        mCounters.mTransportErrors++;
+    }
+    uint16_t lPID = (uint16_t) ((pPacket[1] & 0x1f) << 8 | pPacket[2]);
+    PIDState *pPID = pidState(lPID);
+    if (!pPID) {
+        mCounters.mUntrackedPackets++;
+        return;
+    }
+    pPID->mPackets++;
+    pPID->mWindowPackets++;
+    pPID->mLastSeen = lNow;
+
+    uint8_t lScrambling = pPacket[3] >> 6;
+    uint8_t lAdaptation = (pPacket[3] >> 4) & 0x3;
+    uint8_t lCC = pPacket[3] & 0xf;
+    bool lHasPayload = lAdaptation & 0x1;
+    size_t lPayload = 4;
+
+    bool lDiscontinuity = false;
+    if (lAdaptation & 0x2) {
+        uint8_t lLength = pPacket[4];
+        lPayload = 5 + lLength;
+        if (lLength && lLength <= 183) {
+            uint8_t lFlags = pPacket[5];
+            lDiscontinuity = lFlags & 0x80;
+            if ((lFlags & 0x10) && lLength >= 7) {
+                uint64_t lBase = (uint64_t) pPacket[6] << 25 | (uint64_t) pPacket[7] << 17 |
+                                 (uint64_t) pPacket[8] << 9 | (uint64_t) pPacket[9] << 1 | pPacket[10] >> 7;
+                uint64_t lExtension = (uint64_t) (pPacket[10] & 0x1) << 8 | pPacket[11];
+                if (lDiscontinuity && pPID->mHasPCR) {
+                    pPID->mPCRDiscontinuities++;
+                    pPID->mHasPCR = false;
+                }
+                analyzePCR(*pPID, lBase * 300 + lExtension, lNow);
+            }
+        }
+    }
+
+    if (lPID != kNullPID) {
+        if (pPID->mHasCC && !lDiscontinuity) {
+            bool lError;
+            if (!lHasPayload) {
+                lError = lCC != pPID->mLastCC;
+            } else if (lCC == pPID->mLastCC) {
+                // One duplicate packet is allowed
+                lError = pPID->mDuplicate;
+                pPID->mDuplicate = true;
+            } else {
+                lError = lCC != ((pPID->mLastCC + 1) & 0xf);
+                pPID->mDuplicate = false;
+            }
+            if (lError) {
+                pPID->mCCErrors++;
+                mCounters.mCCErrors++;
+            }
+        }
+        pPID->mHasCC = true;
+        pPID->mLastCC = lCC;
+    }
+
+    if (lPID == 0) {
+        mLastPAT = lNow;
+        mPATLate = false;
+        if (lScrambling) {
+            mCounters.mPATErrors++;
+        } else if ((pPacket[1] & 0x40) && lHasPayload && lPayload < kPacketSize) {
+            analyzePAT(pPacket, lPayload);
+        }
+    } else if (pPID->mPMT) {
+        pPID->mLate = false;
+        if (lScrambling) {
+            mCounters.mPMTErrors++;
+        } else if ((pPacket[1] & 0x40) && lHasPayload && lPayload < kPacketSize) {
+            size_t lTable = lPayload + 1 + pPacket[lPayload];
+            if (lTable < kPacketSize && pPacket[lTable] != 0x02) {
+                mCounters.mPMTErrors++;
+            }
+        }
+    }
+}
+
+void RISTNetTSAnalyzer::analyzePAT(const uint8_t *pPacket, size_t lPayload) {
+    size_t lTable = lPayload + 1 + pPacket[lPayload];
+    if (lTable + 8 > kPacketSize) {
+        return;
+    }
+    const uint8_t *pTable = pPacket + lTable;
+    if (pTable[0] != 0x00) {
+        mCounters.mPATErrors++;
+        return;
+    }
+    // The programs between the 8 byte header and the CRC, as far as they are in this packet
+    size_t lSectionLength = (size_t) (pTable[1] & 0x0f) << 8 | pTable[2];
+    size_t lEnd = std::min(lTable + 3 + std::max<size_t>(lSectionLength, 4) - 4, kPacketSize);
+    for (size_t i = lTable + 8; i + 4 <= lEnd; i += 4) {
+        uint16_t lProgram = (uint16_t) (pPacket[i] << 8 | pPacket[i + 1]);
+        uint16_t lPMT = (uint16_t) ((pPacket[i + 2] & 0x1f) << 8 | pPacket[i + 3]);
+        if (!lProgram) {
+            continue;  // The network PID
+        }
+        PIDState *pPMT = pidState(lPMT);
+        if (pPMT && !pPMT->mPMT) {
+            pPMT->mPMT = true;
+            pPMT->mLastSeen = mLastPAT;
+        }
+    }
+}
+
+void RISTNetTSAnalyzer::analyzePCR(PIDState &rPID, uint64_t lPCR, int64_t lNow) {
+    rPID.mPCRs++;
+    int64_t lDeviation = 0;
+    if (rPID.mHasPCR) {
+        // The arrival interval against the PCR interval since the last PCR
+        uint64_t lStep = (lPCR + kPCRModulo - rPID.mLastPCR) % kPCRModulo;
+        lDeviation = std::abs((lNow - rPID.mLastArrival) - pcrToNanoseconds(lStep));
+        if (lStep > kPCRModulo / 2 || lDeviation > kMaxPCRStep) {
+            rPID.mPCRDiscontinuities++;
+            rPID.mHasPCR = false;
+            lDeviation = 0;
+        }
+    }
+    if (!rPID.mHasPCR) {
+        rPID.mHasPCR = true;
+        rPID.mPCRReference = lPCR;
+        rPID.mArrivalReference = lNow;
+        rPID.mWindowHasPCR = false;
+        rPID.mHasDriftReference = false;
+    }
+    rPID.mLastPCR = lPCR;
+    rPID.mLastArrival = lNow;
+
+    int64_t lOffset = (lNow - rPID.mArrivalReference) -
+                      pcrToNanoseconds((lPCR + kPCRModulo - rPID.mPCRReference) % kPCRModulo);
+    if (!rPID.mWindowHasPCR || lOffset < rPID.mWindowMinOffset) {
+        rPID.mWindowMinOffset = lOffset;
+        rPID.mWindowMinArrival = lNow;
+    }
+    if (!rPID.mWindowHasPCR) {
+        rPID.mWindowHasPCR = true;
+        rPID.mWindowMaxDeviation = lDeviation;
+    } else {
+        rPID.mWindowMaxDeviation = std::max(rPID.mWindowMaxDeviation, lDeviation);
+    }
+}
+
+void RISTNetTSAnalyzer::checkTimeouts(int64_t lNow) {
+    mLastTimeoutCheck = lNow;
+    if (!mPATLate && lNow - mLastPAT > kTableTimeout) {
+        mPATLate = true;
+        mCounters.mPATErrors++;
+    }
+    for (size_t i = 0; i < mPIDCount; i++) {
+        PIDState &rPID = mPIDs[i];
+        if (rPID.mPMT && !rPID.mLate && lNow - rPID.mLastSeen > kTableTimeout) {
+            rPID.mLate = true;
+            mCounters.mPMTErrors++;
+        }
+    }
+}
+
+void RISTNetTSAnalyzer::closeWindow(int64_t lNow) {
+    int64_t lDuration = lNow - mWindowStart;
+    mWindowStart = lNow;
+    mCounters.mBitrate = (uint64_t) ((double) mWindowPackets * kPacketSize * 8 * 1e9 / (double) lDuration);
+    mWindowPackets = 0;
+    for (size_t i = 0; i < mPIDCount; i++) {
+        PIDState &rPID = mPIDs[i];
+        rPID.mBitrate = (uint64_t) ((double) rPID.mWindowPackets * kPacketSize * 8 * 1e9 / (double) lDuration);
+        rPID.mWindowPackets = 0;
+        if (!rPID.mWindowHasPCR) {
+            continue;
+        }
+        rPID.mWindowHasPCR = false;
+        rPID.mPCRJitter = rPID.mWindowMaxDeviation;
+        // The smallest offset of a window is the PCR least delayed by the network, the drift is its slope
+        if (!rPID.mHasDriftReference) {
+            rPID.mHasDriftReference = true;
+            rPID.mDriftOffset = rPID.mWindowMinOffset;
+            rPID.mDriftArrival = rPID.mWindowMinArrival;
+        } else if (rPID.mWindowMinArrival > rPID.mDriftArrival) {
+            rPID.mPCRDrift = (double) (rPID.mWindowMinOffset - rPID.mDriftOffset) * 1e6 /
+                             (double) (rPID.mWindowMinArrival - rPID.mDriftArrival);
+        }
+    }
+}
+
+void RISTNetTSAnalyzer::statistics(RISTNetTSStatistics &rStatistics) const {
+    std::vector<RISTNetTSPIDStatistics> lPIDs = std::move(rStatistics.mPIDs);
+    rStatistics = mCounters;
+    rStatistics.mInSync = mInSync;
+    lPIDs.resize(mPIDCount);
+    for (size_t i = 0; i < mPIDCount; i++) {
+        const PIDState &rPID = mPIDs[i];
+        RISTNetTSPIDStatistics &rPIDStatistics = lPIDs[i];
+        rPIDStatistics.mPID = rPID.mPID;
+        rPIDStatistics.mPackets = rPID.mPackets;
+        rPIDStatistics.mBitrate = rPID.mBitrate;
+        rPIDStatistics.mCCErrors = rPID.mCCErrors;
+        rPIDStatistics.mPCRs = rPID.mPCRs;
+        rPIDStatistics.mPCRDiscontinuities = rPID.mPCRDiscontinuities;
+        rPIDStatistics.mPCRJitter = rPID.mPCRJitter;
+        rPIDStatistics.mPCRDrift = rPID.mPCRDrift;
+    }
+    rStatistics.mPIDs = std::move(lPIDs);
+}
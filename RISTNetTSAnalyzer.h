@@ -0,0 +1,181 @@
+//
+// MPEG transport stream health analysis used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETTSANALYZER_H
+#define CPPRISTWRAPPER__RISTNETTSANALYZER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <memory>
+
+/**
+ * \class RISTNetTSPIDStatistics
+ *
+ * \brief
+ *
+ * Counters of one PID seen by RISTNetTSAnalyzer. Times are in nanoseconds.
+ *
+ */
+struct RISTNetTSPIDStatistics {
+    uint16_t mPID = 0;
+    uint64_t mPackets = 0;
+    uint64_t mBitrate = 0;              // bit/s over the last full second of data
+    uint64_t mCCErrors = 0;             // Continuity counter errors
+    uint64_t mPCRs = 0;                 // PCRs received
+    uint64_t mPCRDiscontinuities = 0;   // Signalled or detected PCR jumps, the PCR measurements restart
+    int64_t mPCRJitter = 0;             // Largest arrival interval minus PCR interval of successive PCRs over the
+                                        // last full second of PCRs
+    double mPCRDrift = 0.0;             // PCR clock against the local clock (ppm), positive = PCR clock slower
+};
+
+/**
+ * \class RISTNetTSStatistics
+ *
+ * \brief
+ *
+ * The TR 101 290 priority 1 indicators (without 1.6 PID_error) and the PIDs of a transport stream.
+ *
+ */
+struct RISTNetTSStatistics {
+    uint64_t mPackets = 0;              // 188 byte packets with a sync byte
+    uint64_t mBitrate = 0;              // bit/s over the last full second of data
+    bool mInSync = false;
+    uint64_t mSyncLosses = 0;           // 1.1 TS_sync_loss
+    uint64_t mSyncByteErrors = 0;       // 1.2 Sync_byte_error
+    uint64_t mPATErrors = 0;            // 1.3 PAT_error: PID 0 missing for 500 ms, wrong table_id or scrambled
+    uint64_t mCCErrors = 0;             // 1.4 Continuity_count_error, all PIDs
+    uint64_t mPMTErrors = 0;            // 1.5 PMT_error: a PMT PID missing for 500 ms, wrong table_id or scrambled
+    uint64_t mTransportErrors = 0;      // Packets with transport_error_indicator set (2.1)
+    uint64_t mUntrackedPackets = 0;     // Packets of PIDs beyond the size of the PID table
+    std::vector<RISTNetTSPIDStatistics> mPIDs; // In the order the PIDs were first seen
+};
+
+/**
+ * \class RISTNetTSAnalyzer
+ *
+ * \brief
+ *
+ * Analyzes the transport stream in the received data. The PID table has a fixed size and is allocated with the
+ * analyzer, analyze() does not allocate. Out of sync, the next sync byte is searched for with SSE2 or AVX2 when
+ * available. Not thread safe, the receiver calls it with the client list locked.
+ *
+ */
+class RISTNetTSAnalyzer {
+public:
+    enum class Implementation {
+        kScalar,
+        kSSE2,
+        kAVX2
+    };
+
+    static constexpr size_t kPacketSize = 188;
+    static constexpr uint8_t kSyncByte = 0x47;
+    static constexpr uint16_t kNullPID = 0x1FFF;
+    // PIDs tracked, packets of further PIDs are only counted in mUntrackedPackets
+    static constexpr size_t kMaxPIDs = 256;
+
+    /// Offset of the first sync byte in the data or lSize if there is none, using the selected implementation
+    static size_t findSync(const uint8_t *pData, size_t lSize);
+
+    /// Offset of the first sync byte using the given implementation. The implementation must be supported
+    static size_t findSync(const uint8_t *pData, size_t lSize, Implementation lImplementation);
+
+    /// The implementation used by findSync
+    static Implementation selectedImplementation();
+
+    /// true if the CPU supports the implementation
+    static bool isSupported(Implementation lImplementation);
+
+    /// The name of the implementation, e.g. "avx2"
+    static const char *implementationName(Implementation lImplementation);
+
+    /// Nanoseconds of the clock analyze() expects
+    static int64_t now();
+
+    /// Bytes allocated by an analyzer besides sizeof(RISTNetTSAnalyzer)
+    static size_t memoryUsage();
+
+    RISTNetTSAnalyzer();
+
+    /// Analyze the packets of a datagram received at lNow
+    void analyze(const uint8_t *pData, size_t lSize, int64_t lNow);
+
+    void statistics(RISTNetTSStatistics &rStatistics) const;
+
+private:
+    struct PIDState {
+        uint16_t mPID = 0;
+        uint8_t mLastCC = 0;
+        bool mHasCC = false;
+        bool mDuplicate = false;        // The last packet repeated the continuity counter
+        bool mPMT = false;              // Listed in the PAT
+        bool mLate = false;             // The PMT timeout was counted
+        int64_t mLastSeen = 0;
+        uint64_t mPackets = 0;
+        uint64_t mWindowPackets = 0;
+        uint64_t mBitrate = 0;
+        uint64_t mCCErrors = 0;
+        // PCR. The offset is the arrival time minus the PCR time, both relative to the reference PCR
+        uint64_t mPCRs = 0;
+        uint64_t mPCRDiscontinuities = 0;
+        bool mHasPCR = false;
+        uint64_t mPCRReference = 0;
+        int64_t mArrivalReference = 0;
+        uint64_t mLastPCR = 0;
+        int64_t mLastArrival = 0;
+        bool mWindowHasPCR = false;
+        int64_t mWindowMinOffset = 0;
+        int64_t mWindowMinArrival = 0;
+        int64_t mWindowMaxDeviation = 0;
+        int64_t mPCRJitter = 0;
+        bool mHasDriftReference = false;
+        int64_t mDriftOffset = 0;
+        int64_t mDriftArrival = 0;
+        double mPCRDrift = 0.0;
+    };
+
+    // The packets needed to gain and to lose sync, TR 101 290 1.1
+    static constexpr uint32_t kSyncAcquire = 5;
+    static constexpr uint32_t kSyncLose = 2;
+    // Intervals in nanoseconds
+    static constexpr int64_t kBitrateWindow = 1000000000;
+    static constexpr int64_t kTimeoutCheck = 100000000;
+    static constexpr int64_t kTableTimeout = 500000000;
+    // A PCR further off the arrival time than this is a discontinuity
+    static constexpr int64_t kMaxPCRStep = 100000000;
+
+    void analyzePacket(const uint8_t *pPacket, int64_t lNow);
+    void analyzePCR(PIDState &rPID, uint64_t lPCR, int64_t lNow);
+    void analyzePAT(const uint8_t *pPacket, size_t lPayload);
+    void checkTimeouts(int64_t lNow);
+    void closeWindow(int64_t lNow);
+    PIDState *pidState(uint16_t lPID);
+
+    // Index + 1 into mPIDs of every PID, 0 = not tracked
+    std::unique_ptr<std::array<uint16_t, 8192>> mPIDIndex;
+    std::vector<PIDState> mPIDs;
+    size_t mPIDCount = 0;
+
+    bool mInSync = false;
+    uint32_t mGoodSyncs = 0;
+    uint32_t mBadSyncs = 0;
+    bool mStarted = false;
+    int64_t mWindowStart = 0;
+    int64_t mLastTimeoutCheck = 0;
+    int64_t mLastPAT = 0;
+    bool mPATLate = false;
+    uint64_t mWindowPackets = 0;
+
+    RISTNetTSStatistics mCounters;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETTSANALYZER_H
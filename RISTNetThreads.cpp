@@ -0,0 +1,232 @@
+//
+// Thread affinity and scheduling control used by the RIST C++ wrapper.
+//
+
+#include "RISTNetThreads.h"
+#include "RISTNetInternal.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+    std::atomic<uint64_t> gTokenCounter{0};
+    thread_local uint64_t tBoundToken = 0;
+}
+
+void RISTNetThreadBinder::configure(const RISTNetThreadSettings &rSettings) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mSettings = rSettings;
+    mToken = rSettings.isDefault() ? 0 : ++gTokenCounter;
+}
+
+void RISTNetThreadBinder::bindCurrentThread(const char *pRole) {
+    uint64_t lToken = mToken.load(std::memory_order_relaxed);
+    if (!lToken || tBoundToken == lToken) {
+        return;
+    }
+    std::lock_guard<std::mutex> lLock(mMtx);
+    RISTNetThreadInfo lInfo;
+    lInfo.mRole = pRole;
+    if (!applyToCurrentThread(mSettings, lInfo)) {
+        LOGGER(true, LOGG_WARN, "Thread settings not fully applied to " << pRole << " thread: " << lInfo.mError)
+    }
+    tBoundToken = lToken;
+    mThreads.push_back(lInfo);
+}
+
+void RISTNetThreadBinder::getDiagnostics(std::vector<RISTNetThreadInfo> &rThreads) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rThreads = mThreads;
+}
+
+std::vector<int> RISTNetThreadBinder::cpusOfNUMANode(int lNode) {
+    std::vector<int> lCPUs;
+    if (lNode < 0) {
+        return lCPUs;
+    }
+    // The cpulist format is a comma separated list of CPUs and ranges, e.g. "0-15,32-47"
+    std::ifstream lFile("/sys/devices/system/node/node" + std::to_string(lNode) + "/cpulist");
+    std::string lList;
+    if (!std::getline(lFile, lList)) {
+        return lCPUs;
+    }
+    std::stringstream lStream(lList);
+    std::string lRange;
+    while (std::getline(lStream, lRange, ',')) {
+        int lFirst = 0;
+        int lLast = 0;
+        auto lDash = lRange.find('-');
+        try {
+            lFirst = std::stoi(lRange.substr(0, lDash));
+            lLast = lDash == std::string::npos ? lFirst : std::stoi(lRange.substr(lDash + 1));
+        } catch (...) {
+            continue;
+        }
+        for (int i = lFirst; i <= lLast; i++) {
+            lCPUs.push_back(i);
+        }
+    }
+    return lCPUs;
+}
+
+bool RISTNetThreadBinder::applyToCurrentThread(const RISTNetThreadSettings &rSettings, RISTNetThreadInfo &rInfo) {
+    rInfo.mSuccess = true;
+    rInfo.mPolicy = rSettings.mPolicy;
+    rInfo.mPriority = rSettings.mPriority;
+    rInfo.mNice = rSettings.mNice;
+    auto lFail = [&](const std::string &rError) {
+        rInfo.mSuccess = false;
+        rInfo.mError += rInfo.mError.empty() ? rError : "; " + rError;
+    };
+
+#ifdef __linux__
+    rInfo.mThreadId = (int64_t) syscall(SYS_gettid);
+    char lName[16] = {};
+    if (!pthread_getname_np(pthread_self(), lName, sizeof(lName))) {
+        rInfo.mName = lName;
+    }
+
+    std::vector<int> lCPUs = rSettings.mCPUs;
+    if (rSettings.mNUMANode >= 0) {
+        auto lNodeCPUs = cpusOfNUMANode(rSettings.mNUMANode);
+        if (lNodeCPUs.empty()) {
+            lFail("unknown NUMA node " + std::to_string(rSettings.mNUMANode));
+        }
+        lCPUs.insert(lCPUs.end(), lNodeCPUs.begin(), lNodeCPUs.end());
+    }
+    if (!lCPUs.empty()) {
+        cpu_set_t lSet;
+        CPU_ZERO(&lSet);
+        for (int lCPU: lCPUs) {
+            if (lCPU >= 0 && lCPU < CPU_SETSIZE) {
+                CPU_SET(lCPU, &lSet);
+            }
+        }
+        int lStatus = pthread_setaffinity_np(pthread_self(), sizeof(lSet), &lSet);
+        if (lStatus) {
+            lFail(std::string("pthread_setaffinity_np: ") + strerror(lStatus));
+        }
+    }
+
+    if (rSettings.mPolicy != RISTNetThreadSettings::Policy::kUnchanged) {
+        int lPolicy = SCHED_OTHER;
+        sched_param lParam{};
+        if (rSettings.mPolicy == RISTNetThreadSettings::Policy::kFIFO) {
+            lPolicy = SCHED_FIFO;
+            lParam.sched_priority = rSettings.mPriority;
+        } else if (rSettings.mPolicy == RISTNetThreadSettings::Policy::kRR) {
+            lPolicy = SCHED_RR;
+            lParam.sched_priority = rSettings.mPriority;
+        }
+        int lStatus = pthread_setschedparam(pthread_self(), lPolicy, &lParam);
+        if (lStatus) {
+            lFail(std::string("pthread_setschedparam: ") + strerror(lStatus));
+        }
+    }
+
+    if (rSettings.mNice) {
+        // On Linux the nice value is a per thread attribute when addressed by thread id
+        if (setpriority(PRIO_PROCESS, (id_t) rInfo.mThreadId, rSettings.mNice)) {
+            lFail(std::string("setpriority: ") + strerror(errno));
+        }
+    }
+
+    // Report what the thread actually ended up with
+    cpu_set_t lActual;
+    CPU_ZERO(&lActual);
+    if (!pthread_getaffinity_np(pthread_self(), sizeof(lActual), &lActual)) {
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &lActual)) {
+                rInfo.mCPUs.push_back(i);
+            }
+        }
+    }
+    int lActualPolicy = 0;
+    sched_param lActualParam{};
+    if (!pthread_getschedparam(pthread_self(), &lActualPolicy, &lActualParam)) {
+        rInfo.mPolicy = lActualPolicy == SCHED_FIFO ? RISTNetThreadSettings::Policy::kFIFO :
+                        lActualPolicy == SCHED_RR ? RISTNetThreadSettings::Policy::kRR :
+                        RISTNetThreadSettings::Policy::kOther;
+        rInfo.mPriority = lActualParam.sched_priority;
+    }
+    errno = 0;
+    int lNice = getpriority(PRIO_PROCESS, (id_t) rInfo.mThreadId);
+    if (!errno) {
+        rInfo.mNice = lNice;
+    }
+#else
+    lFail("thread settings are only supported on Linux");
+#endif
+    return rInfo.mSuccess;
+}
+
+RISTNetDeferredExecutor::~RISTNetDeferredExecutor() {
+    stop();
+}
+
+void RISTNetDeferredExecutor::post(std::function<void()> pTask) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mTasks.push_back(std::move(pTask));
+    if (!mThread.joinable()) {
+        mStopping = false;
+        mThread = std::thread(&RISTNetDeferredExecutor::worker, this);
+    }
+    mTaskCondition.notify_one();
+}
+
+void RISTNetDeferredExecutor::drain() {
+    std::unique_lock<std::mutex> lLock(mMtx);
+    if (std::this_thread::get_id() == mThread.get_id()) {
+        return;
+    }
+    mIdleCondition.wait(lLock, [this] { return mTasks.empty() && !mBusy; });
+}
+
+void RISTNetDeferredExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mThread.joinable()) {
+            return;
+        }
+        if (std::this_thread::get_id() == mThread.get_id()) {
+            LOGGER(true, LOGG_ERROR, "RISTNetDeferredExecutor stopped from its own thread.")
+            mStopping = true;
+            mThread.detach();
+            return;
+        }
+        mStopping = true;
+    }
+    mTaskCondition.notify_one();
+    mThread.join();
+}
+
+void RISTNetDeferredExecutor::worker() {
+    std::unique_lock<std::mutex> lLock(mMtx);
+    while (true) {
+        mTaskCondition.wait(lLock, [this] { return mStopping || !mTasks.empty(); });
+        if (mTasks.empty()) {
+            return; // Stopping and nothing left to run
+        }
+        auto lTask = std::move(mTasks.front());
+        mTasks.pop_front();
+        mBusy = true;
+        lLock.unlock();
+        lTask();
+        lLock.lock();
+        mBusy = false;
+        if (mTasks.empty()) {
+            mIdleCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,139 @@
+//
+// Thread affinity and scheduling control used by the RIST C++ wrapper.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETTHREADS_H
+#define CPPRISTWRAPPER__RISTNETTHREADS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * \class RISTNetThreadSettings
+ *
+ * \brief
+ *
+ * CPU placement and scheduling applied to the threads the wrapper creates and to the librist
+ * threads the first time they call into the wrapper. The default values leave threads untouched.
+ *
+ */
+struct RISTNetThreadSettings {
+    enum class Policy {
+        kUnchanged,
+        kOther,   // SCHED_OTHER
+        kFIFO,    // SCHED_FIFO, requires CAP_SYS_NICE
+        kRR       // SCHED_RR, requires CAP_SYS_NICE
+    };
+
+    std::vector<int> mCPUs;           // CPUs the threads may run on, empty = unchanged
+    int mNUMANode = -1;               // Add the CPUs of this NUMA node to mCPUs, -1 = unchanged
+    Policy mPolicy = Policy::kUnchanged;
+    int mPriority = 0;                // Priority for kFIFO / kRR (1 - 99)
+    int mNice = 0;                    // Nice value for the thread, 0 = unchanged
+
+    bool isDefault() const {
+        return mCPUs.empty() && mNUMANode < 0 && mPolicy == Policy::kUnchanged && mNice == 0;
+    }
+};
+
+/**
+ * \class RISTNetThreadInfo
+ *
+ * \brief
+ *
+ * Diagnostics of one thread the thread settings were applied to.
+ *
+ */
+struct RISTNetThreadInfo {
+    std::string mRole;          // What the thread is used for, e.g. "data" or "statistics"
+    std::string mName;          // The OS thread name
+    int64_t mThreadId = 0;      // The OS thread id
+    std::vector<int> mCPUs;     // The resulting affinity of the thread
+    RISTNetThreadSettings::Policy mPolicy = RISTNetThreadSettings::Policy::kUnchanged;
+    int mPriority = 0;
+    int mNice = 0;
+    bool mSuccess = true;       // false if any of the settings could not be applied
+    std::string mError;         // What failed
+};
+
+/**
+ * \class RISTNetThreadBinder
+ *
+ * \brief
+ *
+ * Applies RISTNetThreadSettings once per thread and keeps the diagnostics of every bound thread.
+ *
+ */
+class RISTNetThreadBinder {
+public:
+    /// Set the settings to apply. Threads bound earlier are not changed.
+    void configure(const RISTNetThreadSettings &rSettings);
+
+    /// Apply the settings to the calling thread unless already done. Cheap when already bound.
+    void bindCurrentThread(const char *pRole);
+
+    /// Get the diagnostics of all bound threads
+    void getDiagnostics(std::vector<RISTNetThreadInfo> &rThreads);
+
+    /// Apply the settings to the calling thread and describe the result in rInfo. Returns false on any failure.
+    static bool applyToCurrentThread(const RISTNetThreadSettings &rSettings, RISTNetThreadInfo &rInfo);
+
+    /// The CPUs of a NUMA node, empty if unknown
+    static std::vector<int> cpusOfNUMANode(int lNode);
+
+private:
+    std::mutex mMtx;
+    RISTNetThreadSettings mSettings;
+    // Unique per configure() call, 0 when there is nothing to apply. Compared to the token of the calling thread
+    std::atomic<uint64_t> mToken{0};
+    std::vector<RISTNetThreadInfo> mThreads;
+};
+
+/**
+ * \class RISTNetDeferredExecutor
+ *
+ * \brief
+ *
+ * Runs tasks in order on one worker thread, started when the first task is posted.
+ * Used to run the slow parts of tearing down peers without holding the client list lock.
+ *
+ */
+class RISTNetDeferredExecutor {
+public:
+    ~RISTNetDeferredExecutor();
+
+    /// Run the task on the worker thread
+    void post(std::function<void()> pTask);
+
+    /// Wait until all tasks posted so far have run. Returns at once when called from a task
+    void drain();
+
+    /// Run the remaining tasks and stop the worker thread
+    void stop();
+
+private:
+    void worker();
+
+    std::mutex mMtx;
+    std::condition_variable mTaskCondition;
+    std::condition_variable mIdleCondition;
+    std::deque<std::function<void()>> mTasks;
+    std::thread mThread;
+    bool mBusy = false;
+    bool mStopping = false;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETTHREADS_H
@@ -0,0 +1,51 @@
+//
+// CRC32C throughput. The CPUAt1Gbps counter is the share of one core needed to checksum 1 Gbit/s,
+// once when sending and once when receiving.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "RISTNetChecksum.h"
+
+namespace {
+    // 1 Gbit/s in bytes
+    constexpr double kGigabitBytes = 1e9 / 8;
+
+    void benchCRC32C(benchmark::State &rState, RISTNetCRC32C::Implementation lImplementation) {
+        if (!RISTNetCRC32C::isSupported(lImplementation)) {
+            rState.SkipWithError("Not supported by the CPU");
+            return;
+        }
+        std::vector<uint8_t> lPacket(rState.range(0));
+        for (size_t i = 0; i < lPacket.size(); i++) {
+            lPacket[i] = (uint8_t) i;
+        }
+        for (auto _: rState) {
+            benchmark::DoNotOptimize(RISTNetCRC32C::compute(lPacket.data(), lPacket.size(), lImplementation));
+        }
+        rState.SetBytesProcessed((int64_t) rState.iterations() * (int64_t) lPacket.size());
+        rState.SetLabel(RISTNetCRC32C::implementationName(lImplementation));
+        rState.counters["CPUAt1Gbps"] = benchmark::Counter((double) rState.iterations() * lPacket.size() / kGigabitBytes,
+                                                           benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    }
+
+    // Append on the sender and verify on the receiver, the full per packet cost of the checksum mode
+    void benchChecksumTrailer(benchmark::State &rState) {
+        std::vector<uint8_t> lPacket(rState.range(0) + RISTNetCRC32C::kTrailerSize, 0x47);
+        size_t lPayloadSize = 0;
+        for (auto _: rState) {
+            RISTNetCRC32C::writeTrailer(lPacket.data(), rState.range(0));
+            benchmark::DoNotOptimize(RISTNetCRC32C::verifyTrailer(lPacket.data(), lPacket.size(), lPayloadSize));
+        }
+        rState.SetBytesProcessed((int64_t) rState.iterations() * rState.range(0));
+        rState.SetLabel(RISTNetCRC32C::implementationName(RISTNetCRC32C::selectedImplementation()));
+    }
+}
+
+// 188 = one TS packet, 1316 = seven TS packets (the usual UDP payload), 9000 = jumbo frame
+BENCHMARK_CAPTURE(benchCRC32C, Software, RISTNetCRC32C::Implementation::kSoftware)->Arg(188)->Arg(1316)->Arg(9000);
+BENCHMARK_CAPTURE(benchCRC32C, SSE42, RISTNetCRC32C::Implementation::kSSE42)->Arg(188)->Arg(1316)->Arg(9000);
+BENCHMARK_CAPTURE(benchCRC32C, ARMv8, RISTNetCRC32C::Implementation::kARMv8)->Arg(188)->Arg(1316)->Arg(9000);
+BENCHMARK(benchChecksumTrailer)->Arg(1316);
@@ -0,0 +1,159 @@
+//
+// Per packet cost of the wrapper on top of librist, without sockets. The librist callbacks of the receiver are
+// called directly with synthetic rist_data_blocks:
+//
+//   ReceiveData       receiveData: the client list lock and lookup, the NetworkConnection shared_ptr copy and the
+//                     networkDataCallback call, with 1, 100 and 10k connected peers, from 1 and 4 threads at once.
+//                     AnyCast=1 adds the std::any_cast of the user object most callbacks do
+//   CallbackOnly      the std::function call alone, the part of ReceiveData that is not the wrapper's
+//   PreparePayload    the sender's work before rist_sender_data_write for the payload options. sendData itself
+//                     needs a librist context; without trailers it calls librist directly
+//
+
+#include <benchmark/benchmark.h>
+
+#include <any>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "RISTNet.h"
+#include "test/RISTNetTestAccess.h"
+
+namespace {
+    constexpr size_t kPayloadSize = 1316;
+    constexpr size_t kLookups = 4096;
+
+    struct Receiver {
+        explicit Receiver(size_t lPeers, bool lAnyCast) {
+            mReceiver.validateConnectionCallback = [](const std::string &, uint16_t) {
+                auto lConnection = std::make_shared<RISTNetReceiver::NetworkConnection>();
+                lConnection->mObject = std::make_shared<uint64_t>(0);
+                return lConnection;
+            };
+            if (lAnyCast) {
+                mReceiver.networkDataCallback = [](const uint8_t *pBuf, size_t lSize,
+                                                   std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                                   rist_peer *pPeer, uint16_t lConnectionID) {
+                    auto &rCounter = std::any_cast<std::shared_ptr<uint64_t> &>(rConnection->mObject);
+                    *rCounter += lSize;
+                    return 0;
+                };
+            } else {
+                mReceiver.networkDataCallback = [](const uint8_t *pBuf, size_t lSize,
+                                                   std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                                   rist_peer *pPeer, uint16_t lConnectionID) {
+                    benchmark::DoNotOptimize(pBuf);
+                    return 0;
+                };
+            }
+            // Separately allocated like the librist peers
+            for (size_t i = 0; i < lPeers; i++) {
+                mStorage.emplace_back(std::make_unique<uint64_t[]>(32));
+                mPeers.push_back((rist_peer *) mStorage.back().get());
+                RISTNetTestAccess::connect(mReceiver, mPeers.back());
+            }
+        }
+
+        ~Receiver() {
+            for (auto pPeer: mPeers) {
+                RISTNetTestAccess::disconnect(mReceiver, pPeer);
+            }
+        }
+
+        RISTNetReceiver mReceiver;
+        std::vector<std::unique_ptr<uint64_t[]>> mStorage;
+        std::vector<rist_peer *> mPeers;
+    };
+
+    // Shared by the threads of a run, created and destroyed by thread 0 outside the timed loop
+    std::unique_ptr<Receiver> gReceiver;
+
+    void benchReceiveData(benchmark::State &rState) {
+        if (rState.thread_index() == 0) {
+            gReceiver = std::make_unique<Receiver>(rState.range(0), rState.range(1) != 0);
+        }
+        std::vector<uint8_t> lPayload(kPayloadSize, 0x47);
+        // Packets arrive from the peers in no particular order, every thread has its own order
+        std::mt19937 lRandom(42 + rState.thread_index());
+        std::vector<size_t> lLookups(kLookups);
+        for (auto &rLookup: lLookups) {
+            rLookup = lRandom() % rState.range(0);
+        }
+        rist_data_block lBlock{};
+        lBlock.payload = lPayload.data();
+        lBlock.payload_len = lPayload.size();
+        size_t i = 0;
+        for (auto _: rState) {
+            lBlock.peer = gReceiver->mPeers[lLookups[i++ & (kLookups - 1)]];
+            benchmark::DoNotOptimize(RISTNetTestAccess::receiveData(gReceiver->mReceiver, &lBlock));
+        }
+        rState.SetItemsProcessed(rState.iterations());
+        if (rState.thread_index() == 0) {
+            gReceiver.reset();
+        }
+    }
+
+    void benchCallbackOnly(benchmark::State &rState) {
+        Receiver lReceiver(1, rState.range(0) != 0);
+        auto lConnection = lReceiver.mReceiver.validateConnectionCallback("10.0.0.1", 5000);
+        std::vector<uint8_t> lPayload(kPayloadSize, 0x47);
+        for (auto _: rState) {
+            benchmark::DoNotOptimize(lReceiver.mReceiver.networkDataCallback(lPayload.data(), lPayload.size(),
+                                                                             lConnection, lReceiver.mPeers[0], 0));
+        }
+        rState.SetItemsProcessed(rState.iterations());
+    }
+
+    void benchPreparePayload(benchmark::State &rState, RISTNetSender::RISTNetSenderSettings lSettings) {
+        RISTNetSender lSender;
+        if (!RISTNetTestAccess::configurePayload(lSender, lSettings)) {
+            rState.SkipWithError("Invalid settings");
+            return;
+        }
+        // 7 TS packets, 2 of them null
+        std::vector<uint8_t> lPayload(kPayloadSize);
+        std::mt19937 lRandom(42);
+        for (auto &rByte: lPayload) {
+            rByte = (uint8_t) lRandom();
+        }
+        for (size_t i = 0; i < 7; i++) {
+            uint8_t *pPacket = lPayload.data() + i * RISTNetTSAnalyzer::kPacketSize;
+            pPacket[0] = RISTNetTSAnalyzer::kSyncByte;
+            pPacket[1] = i % 3 ? 0x01 : 0x1f;
+            pPacket[2] = i % 3 ? 0x00 : 0xff;
+        }
+        const uint8_t *pPrepared = nullptr;
+        size_t lPayloadSize = 0;
+        for (auto _: rState) {
+            benchmark::DoNotOptimize(RISTNetTestAccess::preparePayload(lSender, lPayload.data(), lPayload.size(), 0,
+                                                                      pPrepared, lPayloadSize));
+        }
+        rState.SetItemsProcessed(rState.iterations());
+    }
+
+    RISTNetSender::RISTNetSenderSettings latencyProbeSettings() {
+        RISTNetSender::RISTNetSenderSettings lSettings;
+        lSettings.mLatencyProbeInterval = 100;
+        return lSettings;
+    }
+
+    RISTNetSender::RISTNetSenderSettings nullPacketSettings() {
+        RISTNetSender::RISTNetSenderSettings lSettings;
+        lSettings.mStripNullPackets = true;
+        return lSettings;
+    }
+
+    RISTNetSender::RISTNetSenderSettings compressionSettings() {
+        RISTNetSender::RISTNetSenderSettings lSettings;
+        lSettings.mCompressedFlowIds = {0};
+        return lSettings;
+    }
+}
+
+BENCHMARK(benchReceiveData)->ArgNames({"Peers", "AnyCast"})->ArgsProduct({{1, 100, 10000}, {0, 1}})
+        ->Threads(1)->Threads(4)->UseRealTime();
+BENCHMARK(benchCallbackOnly)->ArgNames({"AnyCast"})->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(benchPreparePayload, LatencyProbe, latencyProbeSettings());
+BENCHMARK_CAPTURE(benchPreparePayload, NullPackets, nullPacketSettings());
+BENCHMARK_CAPTURE(benchPreparePayload, Compression, compressionSettings());
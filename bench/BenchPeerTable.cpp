@@ -0,0 +1,82 @@
+//
+// Client table lookup, one lookup per received packet and OOB message. std::map (the former client list)
+// against RISTNetPeerTable with 10, 1k and 10k connected peers.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "RISTNetPeerTable.h"
+
+namespace {
+    struct Peers {
+        explicit Peers(size_t lCount) {
+            // Separately allocated like the librist peers
+            for (size_t i = 0; i < lCount; i++) {
+                mStorage.emplace_back(std::make_unique<uint64_t[]>(32));
+                mPeers.push_back((rist_peer *) mStorage.back().get());
+            }
+            // Packets arrive from the peers in no particular order
+            std::mt19937 lRandom(42);
+            mLookups.resize(4096);
+            for (auto &rLookup: mLookups) {
+                rLookup = mPeers[lRandom() % lCount];
+            }
+        }
+
+        std::vector<std::unique_ptr<uint64_t[]>> mStorage;
+        std::vector<rist_peer *> mPeers;
+        std::vector<rist_peer *> mLookups;
+    };
+
+    void benchMapLookup(benchmark::State &rState) {
+        Peers lPeers(rState.range(0));
+        std::map<rist_peer *, std::shared_ptr<int>> lTable;
+        for (auto pPeer: lPeers.mPeers) {
+            lTable[pPeer] = std::make_shared<int>(0);
+        }
+        size_t i = 0;
+        for (auto _: rState) {
+            auto lEntry = lTable.find(lPeers.mLookups[i++ & 4095]);
+            benchmark::DoNotOptimize(lEntry);
+        }
+        rState.SetItemsProcessed(rState.iterations());
+    }
+
+    void benchPeerTableLookup(benchmark::State &rState) {
+        Peers lPeers(rState.range(0));
+        RISTNetPeerTable<std::shared_ptr<int>> lTable(lPeers.mPeers.size());
+        for (auto pPeer: lPeers.mPeers) {
+            lTable[pPeer] = std::make_shared<int>(0);
+        }
+        size_t i = 0;
+        for (auto _: rState) {
+            auto pEntry = lTable.find(lPeers.mLookups[i++ & 4095]);
+            benchmark::DoNotOptimize(pEntry);
+        }
+        rState.SetItemsProcessed(rState.iterations());
+    }
+
+    // A peer connecting and disconnecting while the others stay connected
+    void benchPeerTableChurn(benchmark::State &rState) {
+        Peers lPeers(rState.range(0) + 1);
+        rist_peer *pChurning = lPeers.mPeers.back();
+        RISTNetPeerTable<std::shared_ptr<int>> lTable(lPeers.mPeers.size());
+        for (size_t i = 0; i + 1 < lPeers.mPeers.size(); i++) {
+            lTable[lPeers.mPeers[i]] = std::make_shared<int>(0);
+        }
+        for (auto _: rState) {
+            lTable[pChurning];
+            lTable.erase(pChurning);
+        }
+        rState.SetItemsProcessed(rState.iterations());
+    }
+}
+
+BENCHMARK(benchMapLookup)->Arg(10)->Arg(1000)->Arg(10000);
+BENCHMARK(benchPeerTableLookup)->Arg(10)->Arg(1000)->Arg(10000);
+BENCHMARK(benchPeerTableChurn)->Arg(10)->Arg(1000)->Arg(10000);
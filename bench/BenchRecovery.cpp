@@ -0,0 +1,155 @@
+//
+// Recovery under impairment. Every run sends a paced stream from a RISTNetSender through a
+// RISTNetImpairmentProxy to a RISTNetReceiver on the loopback interface and reports per recovery configuration:
+//
+//   Lost          packets that never reached the application
+//   ARQRecovered  packets librist recovered by retransmission (summed over the statistics intervals)
+//   FECRecovered  packets rebuilt from the FEC parity packets
+//   LatencyP50/P99/Max  sender to application latency (us) measured with the latency probes
+//
+// Runs in real time, one iteration per configuration.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "RISTNet.h"
+#include "RISTNetImpairment.h"
+
+namespace {
+    constexpr uint16_t kReceiverPort = 18500;
+    constexpr size_t kPackets = 2000;
+    constexpr auto kPacketInterval = std::chrono::microseconds(500); // 2000 packets/s, about 21 Mbit/s
+    constexpr size_t kPayloadSize = 1316;
+
+    struct RecoveryConfiguration {
+        uint32_t mBuffer;   // ms, the librist recovery buffer
+        uint8_t mFECColumns;
+        uint8_t mFECRows;
+    };
+
+    void benchRecovery(benchmark::State &rState, RISTNetImpairmentSettings lImpairment,
+                       RecoveryConfiguration lRecovery) {
+        for (auto _: rState) {
+            std::mutex lMtx;
+            std::set<uint32_t> lReceived;
+            std::atomic<uint64_t> lARQRecovered{0};
+
+            RISTNetReceiver lReceiver;
+            RISTNetReceiver::RISTNetReceiverSettings lReceiverSettings;
+            lReceiverSettings.mPeerConfig.recovery_length_min = lRecovery.mBuffer;
+            lReceiverSettings.mPeerConfig.recovery_length_max = lRecovery.mBuffer;
+            lReceiverSettings.mLatencyProbe = true;
+            lReceiverSettings.mFEC = lRecovery.mFECColumns != 0;
+            lReceiver.validateConnectionCallback = [](const std::string &, uint16_t) {
+                return std::make_shared<RISTNetReceiver::NetworkConnection>();
+            };
+            lReceiver.networkDataCallback = [&](const uint8_t *pData, size_t lSize,
+                                                std::shared_ptr<RISTNetReceiver::NetworkConnection> &, rist_peer *,
+                                                uint16_t) {
+                uint32_t lSequence;
+                memcpy(&lSequence, pData, sizeof(lSequence));
+                std::lock_guard<std::mutex> lLock(lMtx);
+                lReceived.insert(lSequence);
+                return 0;
+            };
+            lReceiver.statisticsCallback = [&](const rist_stats &rStatistics) {
+                if (rStatistics.stats_type == RIST_STATS_RECEIVER_FLOW) {
+                    lARQRecovered += rStatistics.stats.receiver_flow.recovered;
+                }
+            };
+            std::vector<std::string> lReceiverURLs = {"rist://@127.0.0.1:" + std::to_string(kReceiverPort)};
+            if (!lReceiver.initReceiver(lReceiverURLs, lReceiverSettings)) {
+                rState.SkipWithError("Receiver init failed");
+                return;
+            }
+
+            RISTNetImpairmentProxy lProxy;
+            if (!lProxy.start("127.0.0.1", 0, "127.0.0.1", kReceiverPort, lImpairment)) {
+                rState.SkipWithError("Proxy start failed");
+                return;
+            }
+
+            RISTNetSender lSender;
+            RISTNetSender::RISTNetSenderSettings lSenderSettings;
+            lSenderSettings.mPeerConfig.recovery_length_min = lRecovery.mBuffer;
+            lSenderSettings.mPeerConfig.recovery_length_max = lRecovery.mBuffer;
+            lSenderSettings.mLatencyProbeInterval = 1;
+            lSenderSettings.mLatencyProbeClock = RISTNetLatencyProbe::Clock::kMonotonic;
+            lSenderSettings.mFECColumns = lRecovery.mFECColumns;
+            lSenderSettings.mFECRows = lRecovery.mFECRows;
+            std::vector<std::tuple<std::string, int>> lSenderURLs = {
+                    {"rist://127.0.0.1:" + std::to_string(lProxy.listenPort()), 5}};
+            if (!lSender.initSender(lSenderURLs, lSenderSettings)) {
+                rState.SkipWithError("Sender init failed");
+                return;
+            }
+            // Let the peers connect through the proxy
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+            std::vector<uint8_t> lPayload(kPayloadSize, 0x47);
+            auto lNext = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < kPackets; i++) {
+                memcpy(lPayload.data(), &i, sizeof(i));
+                lSender.sendData(lPayload.data(), lPayload.size());
+                lNext += kPacketInterval;
+                std::this_thread::sleep_until(lNext);
+            }
+            // Time for the last retransmissions and the statistics interval
+            std::this_thread::sleep_for(std::chrono::milliseconds(lRecovery.mBuffer + 1500));
+
+            RISTNetReceiver::ConnectionStatistics lStatistics;
+            lReceiver.getActiveClients([&](std::map<rist_peer *, std::shared_ptr<RISTNetReceiver::NetworkConnection>> &rClients) {
+                if (!rClients.empty()) {
+                    lReceiver.getConnectionStatistics(rClients.begin()->first, lStatistics);
+                }
+            });
+            lSender.destroySender();
+            lProxy.stop();
+            lReceiver.destroyReceiver();
+
+            std::lock_guard<std::mutex> lLock(lMtx);
+            RISTNetImpairmentStatistics lForward;
+            RISTNetImpairmentStatistics lReturn;
+            lProxy.getStatistics(lForward, lReturn);
+            rState.counters["Lost"] = (double) (kPackets - lReceived.size());
+            rState.counters["ImpairedLoss"] = (double) lForward.mLost / std::max<uint64_t>(lForward.mPackets, 1);
+            rState.counters["ARQRecovered"] = (double) lARQRecovered;
+            rState.counters["FECRecovered"] = (double) lStatistics.mFECRecovered;
+            rState.counters["LatencyP50"] = (double) lStatistics.mLatencyP50;
+            rState.counters["LatencyP99"] = (double) lStatistics.mLatencyP99;
+            rState.counters["LatencyMax"] = (double) lStatistics.mLatencyMax;
+        }
+    }
+
+    const RecoveryConfiguration kARQ100{100, 0, 0};
+    const RecoveryConfiguration kARQ500{500, 0, 0};
+    const RecoveryConfiguration kARQ500FEC{500, 5, 5};
+
+    RISTNetImpairmentSettings delayed(RISTNetImpairmentSettings lSettings) {
+        lSettings.mDelay = 10000;
+        lSettings.mJitter = 2000;
+        return lSettings;
+    }
+}
+
+#define RECOVERY_BENCHMARK(name, impairment, recovery) \
+    BENCHMARK_CAPTURE(benchRecovery, name, delayed(impairment), recovery) \
+        ->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime()
+
+RECOVERY_BENCHMARK(Bernoulli1_ARQ100, RISTNetImpairmentSettings::bernoulli(0.01), kARQ100);
+RECOVERY_BENCHMARK(Bernoulli1_ARQ500, RISTNetImpairmentSettings::bernoulli(0.01), kARQ500);
+RECOVERY_BENCHMARK(Bernoulli1_ARQ500_FEC5x5, RISTNetImpairmentSettings::bernoulli(0.01), kARQ500FEC);
+RECOVERY_BENCHMARK(Bernoulli5_ARQ100, RISTNetImpairmentSettings::bernoulli(0.05), kARQ100);
+RECOVERY_BENCHMARK(Bernoulli5_ARQ500, RISTNetImpairmentSettings::bernoulli(0.05), kARQ500);
+RECOVERY_BENCHMARK(Bernoulli5_ARQ500_FEC5x5, RISTNetImpairmentSettings::bernoulli(0.05), kARQ500FEC);
+// 2% loss in bursts of 5 packets on average
+RECOVERY_BENCHMARK(Burst2_ARQ100, RISTNetImpairmentSettings::gilbertElliott(0.2 / 49, 0.2), kARQ100);
+RECOVERY_BENCHMARK(Burst2_ARQ500, RISTNetImpairmentSettings::gilbertElliott(0.2 / 49, 0.2), kARQ500);
+RECOVERY_BENCHMARK(Burst2_ARQ500_FEC5x5, RISTNetImpairmentSettings::gilbertElliott(0.2 / 49, 0.2), kARQ500FEC);
@@ -0,0 +1,362 @@
+/*
+ * Shared memory ring between the RIST C++ wrapper and processes on the same host (Linux). Header only, C99 with
+ * the GNU __atomic builtins (GCC, Clang), for the encoders and decoders exchanging data with a
+ * RISTNetSharedRingIngest or RISTNetSharedRingEgress.
+ *
+ * One producer and one consumer. The wrapper creates the ring and hands it out on a UNIX socket: a process
+ * attaching gets the ring memory, the consumer memory and two eventfds, and is the producer of an ingest ring or
+ * the consumer of an egress ring. One process is attached at a time, until it detaches or exits.
+ *
+ * The ring memory (producer control page, then the slots) is writable by the producer only, the consumer memory
+ * (consumer control page) by the consumer only, each side maps the other read-only. A side that waits sets its
+ * waiting flag and sleeps on its eventfd, the other side writes the eventfd only if the flag is set.
+ *
+ * Producer:                                         Consumer:
+ *   struct ristnet_ring ring;                         struct ristnet_ring ring;
+ *   ristnet_ring_attach(&ring, "/run/ingest.sock");   ristnet_ring_attach(&ring, "/run/egress.sock");
+ *   ristnet_ring_write(&ring, data, size, 0, 100);    const void *data = ristnet_ring_read_begin(&ring, &size,
+ *                                                                                                 &flow_id, 100);
+ *                                                     ...
+ *                                                     ristnet_ring_read_end(&ring);
+ *   ristnet_ring_detach(&ring);                       ristnet_ring_detach(&ring);
+ *
+ * Functions returning int return 0 or a negative errno. A wait may end early, -EAGAIN, callers loop.
+ */
+
+#ifndef RISTNET_SHM_RING_H
+#define RISTNET_SHM_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RISTNET_RING_MAGIC 0x474e495254534952ULL    /* "RISTRING" */
+#define RISTNET_RING_VERSION 1
+#define RISTNET_RING_SLOT_HEADER 8
+#define RISTNET_RING_ALIGN 64
+
+enum ristnet_ring_role {
+    RISTNET_RING_PRODUCER = 'P',
+    RISTNET_RING_CONSUMER = 'C'
+};
+
+/* At the start of the ring memory, written by the producer */
+struct ristnet_ring_producer_control {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slot_count;            /* A power of two */
+    uint32_t slot_size;             /* Data bytes a slot holds */
+    uint32_t slot_stride;           /* Bytes from slot to slot */
+    uint64_t slots_offset;          /* Offset of the first slot in the ring memory */
+    uint8_t reserved[32];
+    uint64_t head;                  /* Packets written */
+    uint32_t producer_waiting;      /* The producer sleeps until the consumer frees a slot */
+};
+
+/* The consumer memory, written by the consumer */
+struct ristnet_ring_consumer_control {
+    uint64_t tail;                  /* Packets read */
+    uint32_t consumer_waiting;      /* The consumer sleeps until the producer writes a slot */
+};
+
+struct ristnet_ring_slot {
+    uint32_t size;
+    uint16_t flow_id;
+    uint16_t reserved;
+    uint8_t data[];
+};
+
+struct ristnet_ring {
+    int role;
+    int socket;                     /* Kept open while attached */
+    int data_event;                 /* Written by the producer, the consumer sleeps on it */
+    int space_event;                /* Written by the consumer, the producer sleeps on it */
+    struct ristnet_ring_producer_control *producer;
+    struct ristnet_ring_consumer_control *consumer;
+    uint8_t *slots;
+    size_t ring_size;
+    size_t consumer_size;
+    uint64_t position;              /* This side's copy of head (producer) or tail (consumer) */
+};
+
+static inline struct ristnet_ring_slot *ristnet_ring_slot_at(const struct ristnet_ring *ring, uint64_t position) {
+    return (struct ristnet_ring_slot *) (ring->slots +
+                                         (size_t) (position & (ring->producer->slot_count - 1)) *
+                                         ring->producer->slot_stride);
+}
+
+static inline size_t ristnet_ring_slot_size(const struct ristnet_ring *ring) {
+    return ring->producer->slot_size;
+}
+
+/* Sleep on the eventfd unless the other side moved meanwhile, see ristnet_ring_wait_data / _space */
+static inline int ristnet_ring_sleep_(int event, int timeout_ms) {
+    struct pollfd poll_fd = {event, POLLIN, 0};
+    int result = poll(&poll_fd, 1, timeout_ms);
+    if (result > 0) {
+        uint64_t count;
+        if (read(event, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            return -errno;
+        }
+    }
+    return result < 0 && errno != EINTR ? -errno : 0;
+}
+
+static inline void ristnet_ring_wake_(int event) {
+    uint64_t one = 1;
+    ssize_t written = write(event, &one, sizeof(one));
+    (void) written;
+}
+
+/* Packets the consumer can read now */
+static inline uint64_t ristnet_ring_readable(const struct ristnet_ring *ring) {
+    return __atomic_load_n(&ring->producer->head, __ATOMIC_ACQUIRE) - ring->position;
+}
+
+/* Slots the producer can write now */
+static inline uint64_t ristnet_ring_writable(const struct ristnet_ring *ring) {
+    return ring->producer->slot_count - (ring->position - __atomic_load_n(&ring->consumer->tail, __ATOMIC_ACQUIRE));
+}
+
+/* Consumer: wait up to timeout_ms for a packet. 0 if one is readable */
+static inline int ristnet_ring_wait_data(struct ristnet_ring *ring, int timeout_ms) {
+    if (ristnet_ring_readable(ring)) {
+        return 0;
+    }
+    if (!timeout_ms) {
+        return -EAGAIN;
+    }
+    __atomic_store_n(&ring->consumer->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    int result = 0;
+    if (__atomic_load_n(&ring->producer->head, __ATOMIC_SEQ_CST) == ring->position) {
+        result = ristnet_ring_sleep_(ring->data_event, timeout_ms);
+    }
+    __atomic_store_n(&ring->consumer->consumer_waiting, 0, __ATOMIC_RELAXED);
+    return result ? result : (ristnet_ring_readable(ring) ? 0 : -EAGAIN);
+}
+
+/* Producer: wait up to timeout_ms for a free slot. 0 if one is writable */
+static inline int ristnet_ring_wait_space(struct ristnet_ring *ring, int timeout_ms) {
+    if (ristnet_ring_writable(ring)) {
+        return 0;
+    }
+    if (!timeout_ms) {
+        return -EAGAIN;
+    }
+    __atomic_store_n(&ring->producer->producer_waiting, 1, __ATOMIC_SEQ_CST);
+    int result = 0;
+    if (ring->position - __atomic_load_n(&ring->consumer->tail, __ATOMIC_SEQ_CST) == ring->producer->slot_count) {
+        result = ristnet_ring_sleep_(ring->space_event, timeout_ms);
+    }
+    __atomic_store_n(&ring->producer->producer_waiting, 0, __ATOMIC_RELAXED);
+    return result ? result : (ristnet_ring_writable(ring) ? 0 : -EAGAIN);
+}
+
+/* Producer: publish the next count written slots */
+static inline void ristnet_ring_publish(struct ristnet_ring *ring, uint64_t count) {
+    ring->position += count;
+    __atomic_store_n(&ring->producer->head, ring->position, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer->consumer_waiting, __ATOMIC_RELAXED)) {
+        ristnet_ring_wake_(ring->data_event);
+    }
+}
+
+/* Consumer: give the next count read slots back */
+static inline void ristnet_ring_release(struct ristnet_ring *ring, uint64_t count) {
+    ring->position += count;
+    __atomic_store_n(&ring->consumer->tail, ring->position, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->producer->producer_waiting, __ATOMIC_RELAXED)) {
+        ristnet_ring_wake_(ring->space_event);
+    }
+}
+
+/* Producer: the data buffer of the next slot, ristnet_ring_slot_size() bytes, or NULL if none is free in time */
+static inline void *ristnet_ring_write_begin(struct ristnet_ring *ring, int timeout_ms) {
+    if (ristnet_ring_wait_space(ring, timeout_ms)) {
+        return NULL;
+    }
+    return ristnet_ring_slot_at(ring, ring->position)->data;
+}
+
+static inline int ristnet_ring_write_end(struct ristnet_ring *ring, size_t size, uint16_t flow_id) {
+    if (size > ring->producer->slot_size) {
+        return -EMSGSIZE;
+    }
+    struct ristnet_ring_slot *slot = ristnet_ring_slot_at(ring, ring->position);
+    slot->size = (uint32_t) size;
+    slot->flow_id = flow_id;
+    ristnet_ring_publish(ring, 1);
+    return 0;
+}
+
+static inline int ristnet_ring_write(struct ristnet_ring *ring, const void *data, size_t size, uint16_t flow_id,
+                                     int timeout_ms) {
+    if (size > ring->producer->slot_size) {
+        return -EMSGSIZE;
+    }
+    void *buffer = ristnet_ring_write_begin(ring, timeout_ms);
+    if (!buffer) {
+        return -EAGAIN;
+    }
+    memcpy(buffer, data, size);
+    return ristnet_ring_write_end(ring, size, flow_id);
+}
+
+/* Consumer: the data of the next packet, valid until ristnet_ring_read_end, or NULL if none arrives in time */
+static inline const void *ristnet_ring_read_begin(struct ristnet_ring *ring, size_t *size, uint16_t *flow_id,
+                                                  int timeout_ms) {
+    if (ristnet_ring_wait_data(ring, timeout_ms)) {
+        return NULL;
+    }
+    const struct ristnet_ring_slot *slot = ristnet_ring_slot_at(ring, ring->position);
+    uint32_t slot_size = slot->size;
+    *size = slot_size <= ring->producer->slot_size ? slot_size : 0;
+    *flow_id = slot->flow_id;
+    return slot->data;
+}
+
+static inline void ristnet_ring_read_end(struct ristnet_ring *ring) {
+    ristnet_ring_release(ring, 1);
+}
+
+static inline void ristnet_ring_unmap_(struct ristnet_ring *ring) {
+    if (ring->producer) {
+        munmap(ring->producer, ring->ring_size);
+    }
+    if (ring->consumer) {
+        munmap(ring->consumer, ring->consumer_size);
+    }
+    ring->producer = NULL;
+    ring->consumer = NULL;
+}
+
+/* Map the ring memory and the consumer memory for the role */
+static inline int ristnet_ring_map(struct ristnet_ring *ring, int role, int ring_fd, int consumer_fd) {
+    struct stat ring_stat;
+    struct stat consumer_stat;
+    if (fstat(ring_fd, &ring_stat) || fstat(consumer_fd, &consumer_stat)) {
+        return -errno;
+    }
+    ring->role = role;
+    ring->ring_size = (size_t) ring_stat.st_size;
+    ring->consumer_size = (size_t) consumer_stat.st_size;
+    if (ring->ring_size < sizeof(struct ristnet_ring_producer_control) ||
+        ring->consumer_size < sizeof(struct ristnet_ring_consumer_control)) {
+        return -EINVAL;
+    }
+    void *producer = mmap(NULL, ring->ring_size, PROT_READ | (role == RISTNET_RING_PRODUCER ? PROT_WRITE : 0),
+                          MAP_SHARED, ring_fd, 0);
+    void *consumer = mmap(NULL, ring->consumer_size, PROT_READ | (role == RISTNET_RING_CONSUMER ? PROT_WRITE : 0),
+                          MAP_SHARED, consumer_fd, 0);
+    ring->producer = producer == MAP_FAILED ? NULL : (struct ristnet_ring_producer_control *) producer;
+    ring->consumer = consumer == MAP_FAILED ? NULL : (struct ristnet_ring_consumer_control *) consumer;
+    if (!ring->producer || !ring->consumer) {
+        int error = -errno;
+        ristnet_ring_unmap_(ring);
+        return error;
+    }
+    const struct ristnet_ring_producer_control *control = ring->producer;
+    if (control->magic != RISTNET_RING_MAGIC || control->version != RISTNET_RING_VERSION ||
+        !control->slot_count || (control->slot_count & (control->slot_count - 1)) ||
+        control->slot_stride < RISTNET_RING_SLOT_HEADER + control->slot_size ||
+        control->slots_offset + (uint64_t) control->slot_count * control->slot_stride > ring->ring_size) {
+        ristnet_ring_unmap_(ring);
+        return -EPROTO;
+    }
+    ring->slots = (uint8_t *) ring->producer + control->slots_offset;
+    ring->position = role == RISTNET_RING_PRODUCER ? __atomic_load_n(&control->head, __ATOMIC_ACQUIRE) :
+                     __atomic_load_n(&ring->consumer->tail, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+/* Attach to the ring served on the UNIX socket. The role is given by the ring */
+static inline int ristnet_ring_attach(struct ristnet_ring *ring, const char *socket_path) {
+    memset(ring, 0, sizeof(*ring));
+    ring->socket = ring->data_event = ring->space_event = -1;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        return -ENAMETOOLONG;
+    }
+    strcpy(address.sun_path, socket_path);
+    ring->socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ring->socket < 0 || connect(ring->socket, (struct sockaddr *) &address, sizeof(address))) {
+        int error = -errno;
+        if (ring->socket >= 0) {
+            close(ring->socket);
+        }
+        ring->socket = -1;
+        return error;
+    }
+
+    /* The role, then the ring memory, the consumer memory, the data and the space eventfd */
+    char role = 0;
+    struct iovec vector = {&role, 1};
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(4 * sizeof(int))];
+    } control;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    ssize_t received = recvmsg(ring->socket, &message, MSG_CMSG_CLOEXEC);
+    struct cmsghdr *header = received == 1 ? CMSG_FIRSTHDR(&message) : NULL;
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(4 * sizeof(int))) {
+        /* Refused, another process is attached */
+        close(ring->socket);
+        ring->socket = -1;
+        return received < 0 ? -errno : -EBUSY;
+    }
+    int fds[4];
+    memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    int result = ristnet_ring_map(ring, role, fds[0], fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+    ring->data_event = fds[2];
+    ring->space_event = fds[3];
+    if (result) {
+        close(ring->data_event);
+        close(ring->space_event);
+        close(ring->socket);
+        ring->socket = ring->data_event = ring->space_event = -1;
+    }
+    return result;
+}
+
+static inline void ristnet_ring_detach(struct ristnet_ring *ring) {
+    ristnet_ring_unmap_(ring);
+    if (ring->data_event >= 0) {
+        close(ring->data_event);
+    }
+    if (ring->space_event >= 0) {
+        close(ring->space_event);
+    }
+    if (ring->socket >= 0) {
+        close(ring->socket);
+    }
+    ring->socket = ring->data_event = ring->space_event = -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RISTNET_SHM_RING_H */
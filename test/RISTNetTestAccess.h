@@ -0,0 +1,75 @@
+//
+// Access to the librist callbacks and the payload preparation of the wrapper, for the benchmarks and the tests
+// driving them without sockets.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETTESTACCESS_H
+#define CPPRISTWRAPPER__RISTNETTESTACCESS_H
+
+#include "RISTNet.h"
+
+/**
+ * \class RISTNetTestAccess
+ *
+ * \brief
+ *
+ * Calls the static librist callbacks of RISTNetReceiver and RISTNetSender as librist would. Peers are any unique
+ * pointers, librist is never told about them.
+ *
+ */
+class RISTNetTestAccess {
+public:
+    static int connect(RISTNetReceiver &rReceiver, rist_peer *pPeer) {
+        return RISTNetReceiver::clientConnect(&rReceiver, "10.0.0.1", 5000, "0.0.0.0", 8000, pPeer);
+    }
+
+    static int disconnect(RISTNetReceiver &rReceiver, rist_peer *pPeer) {
+        return RISTNetReceiver::clientDisconnect(&rReceiver, pPeer);
+    }
+
+    static int receiveData(RISTNetReceiver &rReceiver, rist_data_block *pDataBlock) {
+        return RISTNetReceiver::receiveData(&rReceiver, pDataBlock);
+    }
+
+    static int receiveOOBData(RISTNetReceiver &rReceiver, const rist_oob_block *pOOBBlock) {
+        return RISTNetReceiver::receiveOOBData(&rReceiver, pOOBBlock);
+    }
+
+    /// Take a packet from the packet queue without awaiting it
+    static bool tryPop(RISTNetReceiver &rReceiver, RISTNetReceiver::Packet &rPacket) {
+        return rReceiver.mPacketQueue && rReceiver.mPacketQueue->tryPop(rPacket);
+    }
+
+    static int connect(RISTNetSender &rSender, rist_peer *pPeer) {
+        return RISTNetSender::clientConnect(&rSender, "10.0.0.1", 5000, "0.0.0.0", 8000, pPeer);
+    }
+
+    static int disconnect(RISTNetSender &rSender, rist_peer *pPeer) {
+        return RISTNetSender::clientDisconnect(&rSender, pPeer);
+    }
+
+    static int receiveOOBData(RISTNetSender &rSender, const rist_oob_block *pOOBBlock) {
+        return RISTNetSender::receiveOOBData(&rSender, pOOBBlock);
+    }
+
+    /// Apply the payload options of the settings without creating a librist context
+    static bool configurePayload(RISTNetSender &rSender, const RISTNetSender::RISTNetSenderSettings &rSettings) {
+        return rSender.configurePayload(rSettings);
+    }
+
+    /// The payload sendData would write for the data, in the send buffer of the sender
+    static bool preparePayload(RISTNetSender &rSender, const uint8_t *pData, size_t lSize, uint16_t lConnectionID,
+                               const uint8_t *&rPayload, size_t &rPayloadSize) {
+        rPayload = rSender.mSendBuffer.data();
+        return rSender.preparePayload(pData, lSize, lConnectionID, rSender.mSendBuffer.data(),
+                                      rSender.mSendBuffer.size(), rPayloadSize);
+    }
+};
+
+#endif //CPPRISTWRAPPER__RISTNETTESTACCESS_H
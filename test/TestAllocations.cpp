@@ -0,0 +1,463 @@
+//
+// Heap allocations of the steady state data path. The global operator new and, with glibc, malloc are replaced
+// to count the allocations of the calling thread, so these tests are built as their own executable. A failing
+// test prints the call stacks of the first allocations.
+//
+
+#include <any>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cxxabi.h>
+#include <execinfo.h>
+
+#include <gtest/gtest.h>
+
+#include "RISTNet.h"
+#include "RISTNetTestAccess.h"
+
+#if defined(__GLIBC__)
+#define RISTNET_COUNT_MALLOC
+extern "C" {
+void *__libc_malloc(size_t lSize);
+void *__libc_calloc(size_t lCount, size_t lSize);
+void *__libc_realloc(void *pMemory, size_t lSize);
+void *__libc_memalign(size_t lAlignment, size_t lSize);
+void __libc_free(void *pMemory);
+}
+#endif
+
+namespace {
+    constexpr int kMaxSites = 8;
+    constexpr int kMaxFrames = 24;
+
+    struct AllocationSite {
+        void *mFrames[kMaxFrames];
+        int mFrameCount;
+        size_t mSize;
+    };
+
+    // Plain data only, an allocation can happen before the thread_locals of the thread are constructed
+    thread_local bool tCounting = false;
+    thread_local bool tInHook = false;
+    thread_local uint64_t tAllocations = 0;
+    thread_local int tSiteCount = 0;
+    thread_local AllocationSite tSites[kMaxSites];
+
+    void countAllocation(size_t lSize) {
+        if (!tCounting || tInHook) {
+            return;
+        }
+        tInHook = true;
+        tAllocations++;
+        if (tSiteCount < kMaxSites) {
+            AllocationSite &rSite = tSites[tSiteCount++];
+            rSite.mFrameCount = backtrace(rSite.mFrames, kMaxFrames);
+            rSite.mSize = lSize;
+        }
+        tInHook = false;
+    }
+
+    void *allocate(size_t lSize) {
+        countAllocation(lSize);
+#if defined(RISTNET_COUNT_MALLOC)
+        return __libc_malloc(lSize ? lSize : 1);
+#else
+        return std::malloc(lSize ? lSize : 1);
+#endif
+    }
+
+    void *allocateAligned(size_t lSize, size_t lAlignment) {
+        countAllocation(lSize);
+#if defined(RISTNET_COUNT_MALLOC)
+        return __libc_memalign(lAlignment, lSize ? lSize : 1);
+#else
+        return std::aligned_alloc(lAlignment, (lSize + lAlignment - 1) / lAlignment * lAlignment);
+#endif
+    }
+
+    // Not inlined into the operator delete replacements, GCC would see free() on memory from operator new
+    // and warn (-Wmismatched-new-delete)
+    __attribute__((noinline)) void deallocate(void *pMemory) {
+#if defined(RISTNET_COUNT_MALLOC)
+        __libc_free(pMemory);
+#else
+        std::free(pMemory);
+#endif
+    }
+
+    void startCounting() {
+        tAllocations = 0;
+        tSiteCount = 0;
+        tCounting = true;
+    }
+
+    uint64_t stopCounting() {
+        tCounting = false;
+        return tAllocations;
+    }
+
+    // The call stacks recorded by the last count, the frames of the hook skipped
+    std::string allocationSites() {
+        std::ostringstream lReport;
+        for (int i = 0; i < tSiteCount; i++) {
+            const AllocationSite &rSite = tSites[i];
+            lReport << "Allocation of " << rSite.mSize << " bytes:\n";
+            char **pSymbols = backtrace_symbols(rSite.mFrames, rSite.mFrameCount);
+            for (int lFrame = 2; pSymbols && lFrame < rSite.mFrameCount; lFrame++) {
+                // binary(mangled+offset) [address]
+                std::string lSymbol(pSymbols[lFrame]);
+                size_t lBegin = lSymbol.find('(');
+                size_t lEnd = lSymbol.find('+', lBegin);
+                if (lBegin != std::string::npos && lEnd != std::string::npos && lEnd > lBegin + 1) {
+                    int lStatus = 0;
+                    char *pName = abi::__cxa_demangle(lSymbol.substr(lBegin + 1, lEnd - lBegin - 1).c_str(),
+                                                      nullptr, nullptr, &lStatus);
+                    if (lStatus == 0 && pName) {
+                        lSymbol = pName;
+                    }
+                    std::free(pName);
+                }
+                lReport << "    " << lSymbol << "\n";
+            }
+            std::free(pSymbols);
+        }
+        return lReport.str();
+    }
+
+    constexpr size_t kWarmupPackets = 200;
+    constexpr size_t kPackets = 2000;
+
+    // Call lPacket for kWarmupPackets and then kPackets packets, expecting no allocations in the latter
+    template<typename Packet>
+    void expectNoAllocations(const std::string &rPath, Packet &&rPacket) {
+        // backtrace loads the unwinder on first use
+        void *pFrame[1];
+        backtrace(pFrame, 1);
+        for (size_t i = 0; i < kWarmupPackets; i++) {
+            rPacket(i);
+        }
+        startCounting();
+        for (size_t i = 0; i < kPackets; i++) {
+            rPacket(kWarmupPackets + i);
+        }
+        uint64_t lAllocations = stopCounting();
+        EXPECT_EQ(lAllocations, 0) << lAllocations << " allocations in " << kPackets << " packets of " << rPath
+                                   << "\n" << allocationSites();
+    }
+
+    constexpr size_t kTSPackets = 7;
+    constexpr size_t kPayloadSize = kTSPackets * RISTNetTSAnalyzer::kPacketSize;
+
+    // A datagram of 7 TS packets of PID 0x100, packets 2 and 5 null, continuing the continuity counter
+    std::vector<uint8_t> tsPayload(size_t lIndex) {
+        std::vector<uint8_t> lPayload(kPayloadSize, 0);
+        for (size_t i = 0; i < kTSPackets; i++) {
+            uint8_t *pPacket = lPayload.data() + i * RISTNetTSAnalyzer::kPacketSize;
+            pPacket[0] = RISTNetTSAnalyzer::kSyncByte;
+            if (i == 2 || i == 5) {
+                pPacket[1] = 0x1f;
+                pPacket[2] = 0xff;
+                pPacket[3] = 0x10;
+                std::fill(pPacket + 4, pPacket + RISTNetTSAnalyzer::kPacketSize, 0xff);
+            } else {
+                pPacket[1] = 0x01;
+                pPacket[2] = 0x00;
+                pPacket[3] = (uint8_t) (0x10 | ((lIndex * 5 + i - (i > 2) - (i > 5)) & 0x0f));
+                pPacket[4 + i] = (uint8_t) lIndex;
+            }
+        }
+        return lPayload;
+    }
+
+    decltype(RISTNetReceiver::networkDataCallback) countingDataCallback() {
+        return [](const uint8_t *pBuf, size_t lSize, std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                  rist_peer *pPeer, uint16_t lConnectionID) {
+            auto &rBytes = std::any_cast<std::shared_ptr<uint64_t> &>(rConnection->mObject);
+            *rBytes += lSize;
+            return 0;
+        };
+    }
+
+    template<typename Connection>
+    std::shared_ptr<Connection> countingConnection() {
+        auto lConnection = std::make_shared<Connection>();
+        lConnection->mObject = std::make_shared<uint64_t>(0);
+        return lConnection;
+    }
+}
+
+void *operator new(size_t lSize) {
+    void *pMemory = allocate(lSize);
+    if (!pMemory) {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+void *operator new[](size_t lSize) {
+    return operator new(lSize);
+}
+
+void *operator new(size_t lSize, const std::nothrow_t &) noexcept {
+    return allocate(lSize);
+}
+
+void *operator new[](size_t lSize, const std::nothrow_t &) noexcept {
+    return allocate(lSize);
+}
+
+void *operator new(size_t lSize, std::align_val_t lAlignment) {
+    void *pMemory = allocateAligned(lSize, (size_t) lAlignment);
+    if (!pMemory) {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+void *operator new[](size_t lSize, std::align_val_t lAlignment) {
+    return operator new(lSize, lAlignment);
+}
+
+void operator delete(void *pMemory) noexcept {
+    deallocate(pMemory);
+}
+
+void operator delete[](void *pMemory) noexcept {
+    deallocate(pMemory);
+}
+
+void operator delete(void *pMemory, size_t) noexcept {
+    deallocate(pMemory);
+}
+
+void operator delete[](void *pMemory, size_t) noexcept {
+    deallocate(pMemory);
+}
+
+void operator delete(void *pMemory, std::align_val_t) noexcept {
+    deallocate(pMemory);
+}
+
+void operator delete[](void *pMemory, std::align_val_t) noexcept {
+    deallocate(pMemory);
+}
+
+#if defined(RISTNET_COUNT_MALLOC)
+extern "C" {
+void *malloc(size_t lSize) {
+    countAllocation(lSize);
+    return __libc_malloc(lSize);
+}
+
+void *calloc(size_t lCount, size_t lSize) {
+    countAllocation(lCount * lSize);
+    return __libc_calloc(lCount, lSize);
+}
+
+void *realloc(void *pMemory, size_t lSize) {
+    countAllocation(lSize);
+    return __libc_realloc(pMemory, lSize);
+}
+
+void *aligned_alloc(size_t lAlignment, size_t lSize) {
+    countAllocation(lSize);
+    return __libc_memalign(lAlignment, lSize);
+}
+
+int posix_memalign(void **pMemory, size_t lAlignment, size_t lSize) {
+    countAllocation(lSize);
+    *pMemory = __libc_memalign(lAlignment, lSize);
+    return *pMemory ? 0 : ENOMEM;
+}
+}
+#endif
+
+TEST(TestAllocations, Harness) {
+    // The counting itself must see both kinds of allocation, or the other tests prove nothing
+    startCounting();
+    auto pVector = std::make_unique<std::vector<uint8_t>>(100);
+    uint64_t lAllocations = stopCounting();
+    EXPECT_EQ(lAllocations, 2);
+    EXPECT_NE(allocationSites().find("Allocation of 100 bytes"), std::string::npos);
+#if defined(RISTNET_COUNT_MALLOC)
+    startCounting();
+    void *pMemory = malloc(64);
+    lAllocations = stopCounting();
+    free(pMemory);
+    EXPECT_EQ(lAllocations, 1);
+#endif
+}
+
+TEST(TestAllocations, ReceiveData) {
+    // The payloads as a sender with the trailers the receiver removes writes them
+    RISTNetSender lSender;
+    RISTNetSender::RISTNetSenderSettings lSenderSettings;
+    lSenderSettings.mLatencyProbeInterval = 1;
+    lSenderSettings.mLatencyProbeClock = RISTNetLatencyProbe::Clock::kMonotonic;
+    lSenderSettings.mStripNullPackets = true;
+    lSenderSettings.mCompressedFlowIds = {0};
+    ASSERT_TRUE(RISTNetTestAccess::configurePayload(lSender, lSenderSettings));
+    std::vector<std::vector<uint8_t>> lPayloads;
+    for (size_t i = 0; i < 64; i++) {
+        std::vector<uint8_t> lData = tsPayload(i);
+        const uint8_t *pPayload = nullptr;
+        size_t lPayloadSize = 0;
+        ASSERT_TRUE(RISTNetTestAccess::preparePayload(lSender, lData.data(), lData.size(), 0, pPayload,
+                                                      lPayloadSize));
+        lPayloads.emplace_back(pPayload, pPayload + lPayloadSize);
+    }
+
+    for (size_t lQueueDepth: {0, 64}) {
+        RISTNetReceiver lReceiver;
+        lReceiver.validateConnectionCallback = [](const std::string &rIP, uint16_t lPort) {
+            return countingConnection<RISTNetReceiver::NetworkConnection>();
+        };
+        lReceiver.networkDataCallback = countingDataCallback();
+        std::vector<std::string> lInterfaces{"rist://@0.0.0.0:8000"};
+        RISTNetReceiver::RISTNetReceiverSettings lSettings;
+        lSettings.mLatencyProbe = true;
+        lSettings.mCompression = true;
+        lSettings.mNullPackets = true;
+        lSettings.mTSAnalyzer = true;
+        lSettings.mReceiveQueueDepth = lQueueDepth;
+        ASSERT_TRUE(lReceiver.initReceiver(lInterfaces, lSettings));
+
+        std::vector<uint64_t> lPeers(4);
+        for (auto &rPeer: lPeers) {
+            ASSERT_EQ(RISTNetTestAccess::connect(lReceiver, (rist_peer *) &rPeer), 0);
+        }
+        RISTNetReceiver::Packet lPacket;
+        expectNoAllocations(lQueueDepth ? "receiveData with a packet queue" : "receiveData",
+                            [&](size_t i) {
+            const std::vector<uint8_t> &rPayload = lPayloads[i % lPayloads.size()];
+            rist_data_block lBlock{};
+            lBlock.payload = rPayload.data();
+            lBlock.payload_len = rPayload.size();
+            lBlock.peer = (rist_peer *) &lPeers[i % lPeers.size()];
+            EXPECT_EQ(RISTNetTestAccess::receiveData(lReceiver, &lBlock), 0);
+            if (lQueueDepth) {
+                EXPECT_TRUE(RISTNetTestAccess::tryPop(lReceiver, lPacket));
+            }
+        });
+
+        for (auto &rPeer: lPeers) {
+            RISTNetReceiver::ConnectionStatistics lStatistics;
+            ASSERT_TRUE(lReceiver.getConnectionStatistics((rist_peer *) &rPeer, lStatistics));
+            EXPECT_EQ(lStatistics.mNullPacketsRestored, (kWarmupPackets + kPackets) / lPeers.size() * 2);
+            EXPECT_EQ(lStatistics.mLatencySamples, (kWarmupPackets + kPackets) / lPeers.size());
+            RISTNetTestAccess::disconnect(lReceiver, (rist_peer *) &rPeer);
+        }
+    }
+}
+
+TEST(TestAllocations, FECDecoder) {
+    // Losses in every row and column, so parity packets are kept and retried as well as used at once
+    RISTNetFECEncoder lEncoder;
+    ASSERT_TRUE(lEncoder.configure(4, 3, true, 1500));
+    RISTNetFECDecoder lDecoder(1500);
+    std::vector<uint8_t> lData(1316);
+    size_t lRecovered = 0;
+    expectNoAllocations("the FEC decoder", [&](size_t i) {
+        lData[0] = (uint8_t) i;
+        uint16_t lSequence = lEncoder.addPacket(lData.data(), lData.size(), 0);
+        if (i % 5 != 0) {
+            lDecoder.addMedia(lData.data(), lData.size(), 0, lSequence);
+        }
+        for (size_t j = 0; j < lEncoder.readyParityCount(); j++) {
+            EXPECT_TRUE(lDecoder.addParity(lEncoder.readyParityData(j), lEncoder.readyParitySize(j)));
+            lRecovered += lDecoder.recoveredCount();
+        }
+    });
+    EXPECT_GT(lRecovered, 0);
+    EXPECT_EQ(lDecoder.memoryUsage(), RISTNetFECDecoder::maxMemoryUsage(1500));
+}
+
+TEST(TestAllocations, OOBData) {
+    uint8_t lMessage[] = "OOB";
+    uint64_t lPeer = 0;
+    rist_oob_block lBlock{};
+    lBlock.payload = lMessage;
+    lBlock.payload_len = sizeof(lMessage);
+    lBlock.peer = (rist_peer *) &lPeer;
+
+    RISTNetReceiver lReceiver;
+    size_t lReceiverBlocks = 0;
+    lReceiver.validateConnectionCallback = [](const std::string &rIP, uint16_t lPort) {
+        return countingConnection<RISTNetReceiver::NetworkConnection>();
+    };
+    lReceiver.networkOOBDataCallback = [&](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                           rist_peer *pPeer) {
+        lReceiverBlocks++;
+    };
+    expectNoAllocations("receiver OOB without clients", [&](size_t i) {
+        RISTNetTestAccess::receiveOOBData(lReceiver, &lBlock);
+    });
+    ASSERT_EQ(RISTNetTestAccess::connect(lReceiver, lBlock.peer), 0);
+    expectNoAllocations("receiver OOB", [&](size_t i) {
+        RISTNetTestAccess::receiveOOBData(lReceiver, &lBlock);
+    });
+    EXPECT_EQ(lReceiverBlocks, 2 * (kWarmupPackets + kPackets));
+    RISTNetTestAccess::disconnect(lReceiver, lBlock.peer);
+
+    RISTNetSender lSender;
+    size_t lSenderBlocks = 0;
+    lSender.validateConnectionCallback = [](const std::string &rIP, uint16_t lPort) {
+        return countingConnection<RISTNetSender::NetworkConnection>();
+    };
+    lSender.networkOOBDataCallback = [&](const uint8_t *pBuf, size_t lSize,
+                                         std::shared_ptr<RISTNetSender::NetworkConnection> &rConnection,
+                                         rist_peer *pPeer) {
+        lSenderBlocks++;
+    };
+    expectNoAllocations("sender OOB without clients", [&](size_t i) {
+        RISTNetTestAccess::receiveOOBData(lSender, &lBlock);
+    });
+    ASSERT_EQ(RISTNetTestAccess::connect(lSender, lBlock.peer), 0);
+    expectNoAllocations("sender OOB", [&](size_t i) {
+        RISTNetTestAccess::receiveOOBData(lSender, &lBlock);
+    });
+    EXPECT_EQ(lSenderBlocks, 2 * (kWarmupPackets + kPackets));
+    RISTNetTestAccess::disconnect(lSender, lBlock.peer);
+}
+
+TEST(TestAllocations, SendData) {
+    // Without a send queue sendData calls rist_sender_data_write on the calling thread, and librist allocates per
+    // packet. The wrapper's part of it is preparePayload
+    RISTNetSender::RISTNetSenderSettings lPayloadSettings;
+    lPayloadSettings.mLatencyProbeInterval = 1;
+    lPayloadSettings.mStripNullPackets = true;
+    lPayloadSettings.mCompressedFlowIds = {0};
+    lPayloadSettings.mChecksum = true;
+    RISTNetSender lUnconnected;
+    ASSERT_TRUE(RISTNetTestAccess::configurePayload(lUnconnected, lPayloadSettings));
+    std::vector<std::vector<uint8_t>> lData;
+    for (size_t i = 0; i < 64; i++) {
+        lData.push_back(tsPayload(i));
+    }
+    expectNoAllocations("sendData payload preparation", [&](size_t i) {
+        const uint8_t *pPayload = nullptr;
+        size_t lPayloadSize = 0;
+        const std::vector<uint8_t> &rData = lData[i % lData.size()];
+        EXPECT_TRUE(RISTNetTestAccess::preparePayload(lUnconnected, rData.data(), rData.size(), 0, pPayload,
+                                                      lPayloadSize));
+    });
+
+    // With a send queue the calling thread only copies into the queue
+    RISTNetSender lSender;
+    std::vector<std::tuple<std::string, int>> lInterfaces{std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings lSettings;
+    lSettings.mLatencyProbeInterval = 1;
+    lSettings.mStripNullPackets = true;
+    lSettings.mCompressedFlowIds = {0};
+    lSettings.mSendQueueDepth = kWarmupPackets + kPackets;
+    ASSERT_TRUE(lSender.initSender(lInterfaces, lSettings));
+    expectNoAllocations("sendData with a send queue", [&](size_t i) {
+        const std::vector<uint8_t> &rData = lData[i % lData.size()];
+        EXPECT_TRUE(lSender.sendData(rData.data(), rData.size()));
+    });
+}
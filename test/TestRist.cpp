@@ -1,9 +1,28 @@
 #include <condition_variable>
+#include <coroutine>
+#include <future>
+#include <map>
+#include <numeric>
+#include <set>
 #include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
 #include "RISTNet.h"
+#include "RISTNetImpairment.h"
+#include "RISTNetIngest.h"
+#include "RISTNetEgress.h"
+#include "RISTNetRouter.h"
+#include "RISTNetMessaging.h"
+#ifdef __linux__
+#include "RISTNetSharedRing.h"
+#endif
+#include "RISTNetSendFrontEnd.h"
+#include "RISTNetTestAccess.h"
 
 const std::string kValidPsk = "Th1$_is_4n_0pt10N4L_P$k";
 const std::string kInvalidPsk = "Th1$_is_4_F4k3_P$k";
@@ -119,6 +138,225 @@ TEST(TestRist, BuildRistUrl) {
     EXPECT_FALSE(RISTNetTools::buildRISTURL("0.0.0.0", "65536", url, true));
 }
 
+TEST(TestRist, BuildParseRistUrl) {
+    RISTNetURL parts;
+    parts.mHost = "239.1.1.1";
+    parts.mPort = 5000;
+    parts.mListen = true;
+    parts.mMulticastInterface = "eth0";
+    parts.mMulticastTTL = 8;
+    parts.mBufferMin = 100;
+    parts.mBufferMax = 1000;
+    parts.mCNAME = "encoder1";
+    std::string url;
+    EXPECT_TRUE(RISTNetTools::buildRISTURL(parts, url));
+    EXPECT_EQ(url, "rist://@239.1.1.1:5000?ttl=8&buffer-min=100&buffer-max=1000&miface=eth0&cname=encoder1");
+
+    RISTNetURL parsed;
+    EXPECT_TRUE(RISTNetTools::parseRISTURL(url, parsed));
+    EXPECT_TRUE(parsed.isMulticast());
+    EXPECT_TRUE(parsed.mListen);
+    EXPECT_EQ(parsed.mHost, parts.mHost);
+    EXPECT_EQ(parsed.mPort, parts.mPort);
+    EXPECT_EQ(parsed.mMulticastInterface, "eth0");
+    EXPECT_EQ(parsed.mMulticastTTL, 8u);
+    EXPECT_EQ(parsed.mBufferMax, 1000u);
+    EXPECT_EQ(parsed.mCNAME, "encoder1");
+
+    EXPECT_TRUE(RISTNetTools::parseRISTURL("rist6://[ff02::1]:9000?miface=eth1&secret=s3cret&aes-type=256", parsed));
+    EXPECT_TRUE(parsed.isMulticast());
+    EXPECT_FALSE(parsed.mListen);
+    EXPECT_EQ(parsed.mAESType, 256u);
+    EXPECT_TRUE(RISTNetTools::buildRISTURL(parsed, url));
+    EXPECT_EQ(url, "rist6://[ff02::1]:9000?aes-type=256&miface=eth1&secret=s3cret");
+
+    // Invalid combinations
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:5000?miface=eth0", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://239.1.1.1:5000?ttl=0", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://239.1.1.1:5000?ttl=256", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:5000?buffer-min=500&buffer-max=100", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:5000?buffer=500&buffer-max=1000", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:5000?aes-type=128", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:5000?no-such-param=1", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:5000?ttl=abc", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("rist://10.0.0.1:70000", parsed));
+    EXPECT_FALSE(RISTNetTools::parseRISTURL("udp://10.0.0.1:5000", parsed));
+    parts.mHost = "10.0.0.1";
+    EXPECT_FALSE(RISTNetTools::buildRISTURL(parts, url));
+}
+
+TEST(TestRist, LatencyHistogram) {
+    RISTNetLatencyHistogram histogram;
+    EXPECT_EQ(histogram.valueAtPercentile(50.0), 0);
+    for (uint64_t i = 1; i <= 1000; i++) {
+        histogram.recordValue(i * 100);
+    }
+    EXPECT_EQ(histogram.totalCount(), 1000);
+    EXPECT_EQ(histogram.minValue(), 100);
+    EXPECT_EQ(histogram.maxValue(), 100000);
+    EXPECT_NEAR(histogram.valueAtPercentile(50.0), 50000, 50000 / 100);
+    EXPECT_NEAR(histogram.valueAtPercentile(99.0), 99000, 99000 / 100);
+    EXPECT_NEAR(histogram.valueAtPercentile(99.9), 99900, 99900 / 100);
+    EXPECT_EQ(histogram.valueAtPercentile(100.0), 100000);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.totalCount(), 0);
+    histogram.recordValue(UINT64_MAX);
+    EXPECT_EQ(histogram.maxValue(), RISTNetLatencyHistogram::kMaxValue);
+}
+
+TEST(TestRist, LatencyProbeTrailer) {
+    uint8_t buffer[16 + RISTNetLatencyProbe::kMaxTrailerSize] = {};
+    size_t payloadSize = 0;
+    RISTNetLatencyProbe::Clock clock;
+    uint64_t timestamp = 0;
+
+    size_t size = 16 + RISTNetLatencyProbe::writeTrailer(&buffer[16], RISTNetLatencyProbe::Clock::kNone);
+    ASSERT_TRUE(RISTNetLatencyProbe::readTrailer(buffer, size, payloadSize, clock, timestamp));
+    EXPECT_EQ(payloadSize, 16);
+    EXPECT_EQ(clock, RISTNetLatencyProbe::Clock::kNone);
+
+    uint64_t before = RISTNetLatencyProbe::now(RISTNetLatencyProbe::Clock::kMonotonic);
+    size = 16 + RISTNetLatencyProbe::writeTrailer(&buffer[16], RISTNetLatencyProbe::Clock::kMonotonic);
+    ASSERT_TRUE(RISTNetLatencyProbe::readTrailer(buffer, size, payloadSize, clock, timestamp));
+    EXPECT_EQ(payloadSize, 16);
+    EXPECT_EQ(clock, RISTNetLatencyProbe::Clock::kMonotonic);
+    EXPECT_GE(timestamp, before);
+
+    buffer[size - 1] = 0x7f;
+    EXPECT_FALSE(RISTNetLatencyProbe::readTrailer(buffer, size, payloadSize, clock, timestamp));
+    EXPECT_FALSE(RISTNetLatencyProbe::readTrailer(buffer, 0, payloadSize, clock, timestamp));
+}
+
+TEST(TestRist, ThreadBinder) {
+    RISTNetThreadBinder binder;
+    std::vector<RISTNetThreadInfo> threads;
+
+    // Default settings leave the threads untouched
+    binder.bindCurrentThread("test");
+    binder.getDiagnostics(threads);
+    EXPECT_TRUE(threads.empty());
+
+    RISTNetThreadSettings settings;
+    settings.mCPUs = {0};
+    binder.configure(settings);
+    std::thread worker([&]() {
+        binder.bindCurrentThread("worker");
+        binder.bindCurrentThread("worker");
+    });
+    worker.join();
+
+    binder.getDiagnostics(threads);
+    ASSERT_EQ(threads.size(), 1);
+    EXPECT_EQ(threads[0].mRole, "worker");
+#ifdef __linux__
+    EXPECT_TRUE(threads[0].mSuccess) << threads[0].mError;
+    EXPECT_EQ(threads[0].mCPUs, std::vector<int>{0});
+#endif
+}
+
+// Fire and forget coroutine used to drive the awaitable interface
+struct TestTask {
+    struct promise_type {
+        TestTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+TEST(TestRist, PacketQueue) {
+    struct Peer {};
+    struct Connection {};
+    using Queue = RISTNetPacketQueue<Peer, Connection>;
+    auto queue = std::make_shared<Queue>(2, 16);
+    const uint8_t data[4] = {1, 2, 3, 4};
+
+    EXPECT_TRUE(queue->push(data, sizeof(data), 1, nullptr, nullptr));
+    EXPECT_TRUE(queue->push(data, sizeof(data), 2, nullptr, nullptr));
+    EXPECT_FALSE(queue->push(data, sizeof(data), 3, nullptr, nullptr));
+    EXPECT_FALSE(queue->push(data, 17, 3, nullptr, nullptr)) << "Expected packets larger than the buffers to be dropped";
+    EXPECT_EQ(queue->dropped(), 2);
+
+    Queue::Packet packet;
+    ASSERT_TRUE(queue->tryPop(packet));
+    EXPECT_EQ(packet.flowId(), 1);
+    EXPECT_EQ(packet.size(), sizeof(data));
+    EXPECT_EQ(memcmp(packet.data(), data, sizeof(data)), 0);
+    EXPECT_FALSE(queue->push(data, sizeof(data), 3, nullptr, nullptr)) << "Expected held packets to count against the capacity";
+
+    packet = Queue::Packet();
+    EXPECT_TRUE(queue->push(data, sizeof(data), 3, nullptr, nullptr));
+    ASSERT_TRUE(queue->tryPop(packet));
+    EXPECT_EQ(packet.flowId(), 2);
+}
+
+TEST(TestRist, AwaitableInterface) {
+    const size_t kSentPackets = 5;
+    const size_t kBufferSize = 1000;
+    auto executor = std::make_shared<RISTNetExecutor>();
+
+    RISTNetReceiver receiver;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mReceiveQueueDepth = 8;
+    receiverSettings.mExecutor = executor;
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    size_t nReceivedPackets = 0;
+    bool receiverDone = false;
+    auto consumer = [&]() -> TestTask {
+        auto event = co_await receiver.nextConnection();
+        EXPECT_TRUE(event.mConnected);
+        EXPECT_NE(event.mConnection, nullptr);
+        while (nReceivedPackets < kSentPackets) {
+            auto packet = co_await receiver.nextPacket();
+            if (!packet) {
+                break;
+            }
+            EXPECT_EQ(packet.size(), kBufferSize);
+            EXPECT_EQ(packet.peer(), event.mPeer);
+            EXPECT_EQ(*packet.data(), nReceivedPackets);
+            ++nReceivedPackets;
+        }
+        receiverDone = true;
+    };
+    consumer();
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mExecutor = executor;
+    RISTNetSender sender;
+    bool senderDone = false;
+    auto producer = [&]() -> TestTask {
+        std::vector<uint8_t> sendBuffer(kBufferSize);
+        for (size_t i = 0; i < kSentPackets; i++) {
+            EXPECT_TRUE(co_await sender.writable());
+            std::fill(sendBuffer.begin(), sendBuffer.end(), i);
+            EXPECT_TRUE(sender.sendData(sendBuffer.data(), sendBuffer.size()));
+        }
+        senderDone = true;
+    };
+    producer();
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    while (!(receiverDone && senderDone) && std::chrono::steady_clock::now() < deadline) {
+        if (!executor->poll()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    EXPECT_TRUE(senderDone);
+    EXPECT_TRUE(receiverDone);
+    EXPECT_EQ(nReceivedPackets, kSentPackets);
+    EXPECT_EQ(receiver.getQueueDropped(), 0);
+}
+
 TEST(TestRist, Init) {
     RISTNetReceiver receiver;
     std::vector<std::string> receiverInterfaces;
@@ -159,8 +397,7 @@ TEST_F(TestFixture, StartStop) {
     EXPECT_TRUE(checkSenderDisconnecting()) << "Timeout waiting for sender disconnect";
 }
 
-// TODO Enable test when STAR-255 is fixed
-TEST_F(TestFixture, DISABLED_ReceiverCloseConnections) {
+TEST_F(TestFixture, ReceiverCloseConnections) {
     rist_peer* client = nullptr;
     mReceiver->getActiveClients(
         [&](std::map<rist_peer*, std::shared_ptr<RISTNetReceiver::NetworkConnection>>& activeClients) {
@@ -278,6 +515,2039 @@ TEST_F(TestFixture, LargeMessage) {
     EXPECT_FALSE(mSender->sendData((const uint8_t*)largeBuffer.data(), largeBuffer.size()));
 }
 
+TEST(TestRist, LatencyProbe) {
+    const size_t kSentPackets = 20;
+    const size_t kBufferSize = 1000;
+
+    RISTNetReceiver receiver;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mLatencyProbe = true;
+
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    size_t nReceivedPackets = 0;
+    rist_peer* client = nullptr;
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                       rist_peer* peer, uint16_t connectionId) {
+        EXPECT_EQ(size, kBufferSize);
+        {
+            std::lock_guard<std::mutex> lock(receiverMutex);
+            client = peer;
+            ++nReceivedPackets;
+        }
+        receiverCondition.notify_one();
+        return 0;
+    };
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mLatencyProbeInterval = 2;
+    senderSettings.mLatencyProbeClock = RISTNetLatencyProbe::Clock::kMonotonic;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    std::vector<uint8_t> sendBuffer(kBufferSize, 1);
+    for (size_t i = 0; i < kSentPackets; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        EXPECT_TRUE(sender.sendData(sendBuffer.data(), sendBuffer.size()));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(receiverMutex);
+        ASSERT_TRUE(receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return nReceivedPackets == kSentPackets; }));
+    }
+
+    RISTNetReceiver::ConnectionStatistics statistics;
+    ASSERT_TRUE(receiver.getConnectionStatistics(client, statistics));
+    EXPECT_EQ(statistics.mLatencySamples, kSentPackets / 2);
+    EXPECT_EQ(statistics.mNegativeTransits, 0);
+    EXPECT_LE(statistics.mLatencyP50, statistics.mLatencyP99);
+    EXPECT_LE(statistics.mLatencyP99, statistics.mLatencyP999);
+    EXPECT_LE(statistics.mLatencyP999, statistics.mLatencyMax);
+}
+
+TEST(TestRist, FECXorKernels) {
+    std::vector<uint8_t> source(1000);
+    std::vector<uint8_t> initial(source.size());
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = (uint8_t) (i * 7 + 3);
+        initial[i] = (uint8_t) (i * 13 + 5);
+    }
+    for (auto kernel: {RISTNetXOR::Kernel::kScalar, RISTNetXOR::Kernel::kAVX2, RISTNetXOR::Kernel::kNEON}) {
+        if (!RISTNetXOR::isSupported(kernel)) {
+            continue;
+        }
+        // Odd sizes and offsets exercise the unaligned heads and the scalar tails
+        for (size_t size: {0, 1, 31, 33, 64, 100, 999}) {
+            std::vector<uint8_t> destination = initial;
+            RISTNetXOR::xorInto(destination.data() + 1, source.data(), size, kernel);
+            for (size_t i = 0; i < destination.size(); i++) {
+                uint8_t expected = (i >= 1 && i <= size) ? initial[i] ^ source[i - 1] : initial[i];
+                ASSERT_EQ(destination[i], expected) << RISTNetXOR::kernelName(kernel) << " size " << size;
+            }
+        }
+    }
+}
+
+TEST(TestRist, FECRecovery) {
+    const uint8_t kColumns = 4;
+    const uint8_t kRows = 3;
+    RISTNetFECEncoder encoder;
+    EXPECT_FALSE(encoder.configure(21, 4, true, 1500));
+    EXPECT_FALSE(encoder.configure(20, 6, true, 1500));
+    ASSERT_TRUE(encoder.configure(kColumns, kRows, true, 1500));
+
+    struct Sent {
+        std::vector<uint8_t> mData;
+        uint16_t mFlowId;
+        uint16_t mSequence;
+    };
+    std::vector<Sent> media;
+    std::vector<std::vector<uint8_t>> parity;
+    for (size_t i = 0; i < 2 * kColumns * kRows; i++) {
+        Sent sent;
+        sent.mData.assign(100 + i * 3, (uint8_t) i);
+        sent.mFlowId = (uint16_t) (i % 3);
+        sent.mSequence = encoder.addPacket(sent.mData.data(), sent.mData.size(), sent.mFlowId);
+        media.push_back(sent);
+        for (size_t j = 0; j < encoder.readyParityCount(); j++) {
+            parity.emplace_back(encoder.readyParityData(j), encoder.readyParityData(j) + encoder.readyParitySize(j));
+        }
+    }
+    EXPECT_EQ(parity.size(), 2 * (kColumns + kRows));
+
+    // In the first matrix row 1 and column 0 both miss two packets, rebuilding one of them lets the
+    // other parity rebuild the second. In the second matrix a single packet is lost
+    auto isLost = [&](size_t i) { return i == 4 || i == 5 || i == 8 || i == 17; };
+    RISTNetFECDecoder decoder(1500);
+    EXPECT_EQ(decoder.memoryUsage(), RISTNetFECDecoder::maxMemoryUsage(1500));
+    std::map<uint16_t, Sent> recovered;
+    auto takeRecovered = [&]() {
+        for (size_t i = 0; i < decoder.recoveredCount(); i++) {
+            const uint8_t* data = decoder.recoveredData(i);
+            Sent sent{std::vector<uint8_t>(data, data + decoder.recoveredSize(i)), decoder.recoveredFlowId(i), 0};
+            recovered[(uint16_t) (data[0])] = sent;
+        }
+    };
+    for (size_t i = 0; i < media.size(); i++) {
+        if (!isLost(i)) {
+            EXPECT_TRUE(decoder.addMedia(media[i].mData.data(), media[i].mData.size(), media[i].mFlowId, media[i].mSequence));
+        }
+    }
+    for (auto& packet: parity) {
+        EXPECT_TRUE(decoder.addParity(packet.data(), packet.size()));
+        takeRecovered();
+    }
+    EXPECT_EQ(decoder.recoveredPackets(), 4);
+    ASSERT_EQ(recovered.size(), 4);
+    for (size_t i = 0; i < media.size(); i++) {
+        if (isLost(i)) {
+            auto& rebuilt = recovered[(uint16_t) i];
+            EXPECT_EQ(rebuilt.mData, media[i].mData) << "packet " << i;
+            EXPECT_EQ(rebuilt.mFlowId, media[i].mFlowId) << "packet " << i;
+        }
+    }
+
+    // A packet arriving after it was rebuilt is a duplicate
+    EXPECT_FALSE(decoder.addMedia(media[17].mData.data(), media[17].mData.size(), media[17].mFlowId, media[17].mSequence));
+    EXPECT_EQ(decoder.duplicatePackets(), 1);
+    const uint8_t malformed[4] = {};
+    EXPECT_FALSE(decoder.addParity(malformed, sizeof(malformed)));
+    EXPECT_EQ(decoder.recoveredCount(), 0);
+    EXPECT_EQ(decoder.memoryUsage(), RISTNetFECDecoder::maxMemoryUsage(1500));
+}
+
+TEST(TestRist, FECRecoveryOrder) {
+    const uint8_t kColumns = 4;
+    const uint8_t kRows = 3;
+    RISTNetFECEncoder encoder;
+    ASSERT_TRUE(encoder.configure(kColumns, kRows, true, 1500));
+    RISTNetFECDecoder decoder(1500);
+
+    // Packets and parity in the order they are sent. Packet 5 is lost, its row parity follows packet 7
+    std::vector<uint8_t> delivered;
+    for (size_t i = 0; i < kColumns * kRows; i++) {
+        std::vector<uint8_t> data(64, (uint8_t) i);
+        uint16_t sequence = encoder.addPacket(data.data(), data.size(), 1);
+        if (i != 5) {
+            ASSERT_TRUE(decoder.addMedia(data.data(), data.size(), 1, sequence));
+            delivered.push_back((uint8_t) i);
+        }
+        for (size_t j = 0; j < encoder.readyParityCount(); j++) {
+            ASSERT_TRUE(decoder.addParity(encoder.readyParityData(j), encoder.readyParitySize(j)));
+            for (size_t k = 0; k < decoder.recoveredCount(); k++) {
+                ASSERT_EQ(decoder.recoveredSize(k), data.size());
+                delivered.push_back(decoder.recoveredData(k)[0]);
+            }
+        }
+    }
+
+    // The rebuilt packet comes after the media following it in its row
+    std::vector<uint8_t> expected = {0, 1, 2, 3, 4, 6, 7, 5, 8, 9, 10, 11};
+    EXPECT_EQ(delivered, expected);
+    EXPECT_EQ(decoder.recoveredPackets(), 1);
+}
+
+TEST(TestRist, FEC) {
+    const uint8_t kColumns = 4;
+    const uint8_t kRows = 4;
+    const size_t kSentPackets = 2 * kColumns * kRows;
+
+    RISTNetReceiver receiver;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mFEC = true;
+
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    std::vector<size_t> receivedSizes;
+    rist_peer* client = nullptr;
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                       rist_peer* peer, uint16_t connectionId) {
+        EXPECT_EQ(connectionId, 1);
+        {
+            std::lock_guard<std::mutex> lock(receiverMutex);
+            client = peer;
+            receivedSizes.push_back(size);
+        }
+        receiverCondition.notify_one();
+        return 0;
+    };
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mFECColumns = kColumns;
+    senderSettings.mFECRows = kRows;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    std::vector<uint8_t> sendBuffer(RIST_MAX_PACKET_SIZE, 1);
+    EXPECT_FALSE(sender.sendData(sendBuffer.data(), 1000, RISTNetFEC::kDefaultFlowId));
+    // The parity packet protecting it would not fit in a packet
+    EXPECT_FALSE(sender.sendData(sendBuffer.data(), RIST_MAX_PACKET_SIZE - RISTNetFEC::kParityHeaderSize + 1, 1));
+    for (size_t i = 0; i < kSentPackets; i++) {
+        EXPECT_TRUE(sender.sendData(sendBuffer.data(), 100 + i, 1));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(receiverMutex);
+        ASSERT_TRUE(receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return receivedSizes.size() == kSentPackets; }));
+        for (size_t i = 0; i < kSentPackets; i++) {
+            EXPECT_EQ(receivedSizes[i], 100 + i);
+        }
+    }
+
+    RISTNetReceiver::ConnectionStatistics statistics;
+    ASSERT_TRUE(receiver.getConnectionStatistics(client, statistics));
+    EXPECT_EQ(statistics.mFECParityPackets, 2 * (kColumns + kRows));
+    EXPECT_EQ(statistics.mFECRecovered, 0);
+    RISTNetSender::FECStatistics fecStatistics;
+    sender.getFECStatistics(fecStatistics);
+    EXPECT_EQ(fecStatistics.mParityPackets, 2 * (kColumns + kRows));
+    EXPECT_EQ(fecStatistics.mParityWriteErrors, 0);
+}
+
+TEST(TestRist, ChecksumCRC32C) {
+    const std::string kCheck = "123456789";
+    std::vector<uint8_t> buffer(1500);
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = (uint8_t) (i * 31 + 7);
+    }
+    for (auto implementation: {RISTNetCRC32C::Implementation::kSoftware, RISTNetCRC32C::Implementation::kSSE42,
+                               RISTNetCRC32C::Implementation::kARMv8}) {
+        if (!RISTNetCRC32C::isSupported(implementation)) {
+            continue;
+        }
+        EXPECT_EQ(RISTNetCRC32C::compute((const uint8_t*) kCheck.data(), kCheck.size(), implementation), 0xE3069283)
+                << RISTNetCRC32C::implementationName(implementation);
+        for (size_t size: {0, 1, 7, 9, 1316, 1499}) {
+            EXPECT_EQ(RISTNetCRC32C::compute(buffer.data() + 1, size, implementation),
+                      RISTNetCRC32C::compute(buffer.data() + 1, size, RISTNetCRC32C::Implementation::kSoftware))
+                    << RISTNetCRC32C::implementationName(implementation) << " size " << size;
+        }
+    }
+
+    std::vector<uint8_t> packet(100 + RISTNetCRC32C::kTrailerSize, 0x47);
+    EXPECT_EQ(RISTNetCRC32C::writeTrailer(packet.data(), 100), RISTNetCRC32C::kTrailerSize);
+    size_t payloadSize = 0;
+    EXPECT_TRUE(RISTNetCRC32C::verifyTrailer(packet.data(), packet.size(), payloadSize));
+    EXPECT_EQ(payloadSize, 100);
+    packet[50] ^= 0x10;
+    EXPECT_FALSE(RISTNetCRC32C::verifyTrailer(packet.data(), packet.size(), payloadSize));
+    EXPECT_FALSE(RISTNetCRC32C::verifyTrailer(packet.data(), 3, payloadSize));
+}
+
+TEST(TestRist, Checksum) {
+    const size_t kSentPackets = 10;
+
+    // The second sender does not add the checksum, its packets look corrupted
+    for (bool senderChecksum: {true, false}) {
+        RISTNetReceiver receiver;
+        std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+        RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+        receiverSettings.mChecksum = true;
+        receiverSettings.mFEC = true;
+
+        std::mutex receiverMutex;
+        size_t nReceivedPackets = 0;
+        rist_peer* client = nullptr;
+        receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+            return std::make_shared<RISTNetReceiver::NetworkConnection>();
+        };
+        receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                           rist_peer* peer, uint16_t connectionId) {
+            EXPECT_EQ(size, 1000);
+            std::lock_guard<std::mutex> lock(receiverMutex);
+            ++nReceivedPackets;
+            return 0;
+        };
+        ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+        std::vector<std::tuple<std::string, int>> senderInterfaces{
+            std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+        RISTNetSender::RISTNetSenderSettings senderSettings;
+        senderSettings.mChecksum = senderChecksum;
+        senderSettings.mFECColumns = 5;
+        senderSettings.mFECRows = 2;
+        RISTNetSender sender;
+        ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+        std::vector<uint8_t> sendBuffer(1000, 1);
+        for (size_t i = 0; i < kSentPackets; i++) {
+            EXPECT_TRUE(sender.sendData(sendBuffer.data(), sendBuffer.size()));
+        }
+
+        RISTNetReceiver::ConnectionStatistics statistics;
+        auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+        do {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            receiver.getActiveClients([&](std::map<rist_peer*, std::shared_ptr<RISTNetReceiver::NetworkConnection>>& clients) {
+                client = clients.empty() ? nullptr : clients.begin()->first;
+            });
+            if (!client || !receiver.getConnectionStatistics(client, statistics)) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(receiverMutex);
+            if (nReceivedPackets + statistics.mChecksumErrors >= kSentPackets + (senderChecksum ? 0 : 7)) {
+                break;
+            }
+        } while (std::chrono::steady_clock::now() < deadline);
+        ASSERT_NE(client, nullptr);
+        std::lock_guard<std::mutex> lock(receiverMutex);
+        if (senderChecksum) {
+            EXPECT_EQ(nReceivedPackets, kSentPackets);
+            EXPECT_EQ(statistics.mChecksumErrors, 0);
+            EXPECT_EQ(statistics.mFECParityPackets, 7);
+        } else {
+            EXPECT_EQ(nReceivedPackets, 0);
+            EXPECT_EQ(statistics.mChecksumErrors, kSentPackets + 7);
+        }
+    }
+}
+
+TEST(TestRist, PeerTable) {
+    // Fake peer pointers, spaced like heap allocations
+    std::vector<uint64_t> storage(4096 * 8);
+    auto peer = [&](size_t i) { return (rist_peer*) &storage[i * 8]; };
+
+    RISTNetPeerTable<int> table(100);
+    size_t capacity = table.capacity();
+    for (int i = 0; i < 100; i++) {
+        table[peer(i)] = i;
+    }
+    EXPECT_EQ(table.capacity(), capacity) << "Reserved capacity must not rehash";
+    for (int i = 0; i < 4096; i++) {
+        table[peer(i)] = i;
+    }
+    EXPECT_EQ(table.size(), 4096);
+    EXPECT_EQ(table.find(nullptr), nullptr);
+
+    // Erasing moves entries back, all others must still be found
+    for (int i = 0; i < 4096; i += 2) {
+        EXPECT_TRUE(table.erase(peer(i)));
+    }
+    EXPECT_FALSE(table.erase(peer(0)));
+    EXPECT_EQ(table.size(), 2048);
+    for (int i = 0; i < 4096; i++) {
+        int* entry = table.find(peer(i));
+        if (i % 2) {
+            ASSERT_NE(entry, nullptr);
+            EXPECT_EQ(*entry, i);
+        } else {
+            EXPECT_EQ(entry, nullptr);
+        }
+    }
+    size_t iterated = 0;
+    for (auto& entry : table) {
+        EXPECT_EQ(entry.first, peer(entry.second));
+        iterated++;
+    }
+    EXPECT_EQ(iterated, 2048);
+
+    table.clear();
+    EXPECT_TRUE(table.empty());
+    EXPECT_EQ(table.begin(), table.end());
+}
+
+TEST(TestRist, Admission) {
+    using Decision = RISTNetAdmission::Decision;
+    std::vector<uint64_t> storage(64);
+    auto peer = [&](size_t i) { return (rist_peer*) &storage[i * 8]; };
+    std::shared_ptr<void> object;
+
+    // Rate limit: a burst of 2, then one per 100 ms
+    RISTNetAdmission admission;
+    RISTNetAdmissionSettings settings;
+    settings.mConnectRate = 10;
+    settings.mConnectBurst = 2;
+    settings.mMaxConnectionsPerIP = 2;
+    ASSERT_TRUE(admission.configure(settings, nullptr));
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kValidate);
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kValidate);
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kReject);
+    EXPECT_EQ(admission.admit("10.0.0.2", 1000, object), Decision::kValidate) << "Other IPs are not limited";
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kValidate);
+    EXPECT_EQ(admission.statistics().mRejectedRate, 1);
+
+    // Connections per IP
+    admission.connected(peer(0), "10.0.0.1");
+    admission.connected(peer(1), "10.0.0.1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kReject);
+    EXPECT_EQ(admission.statistics().mRejectedLimit, 1);
+    admission.disconnected(peer(0));
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kValidate);
+    EXPECT_EQ(admission.statistics().mConnections, 1);
+
+    // Cached results
+    settings = RISTNetAdmissionSettings();
+    settings.mCacheTime = 10000;
+    ASSERT_TRUE(admission.configure(settings, nullptr));
+    auto accepted = std::make_shared<RISTNetReceiver::NetworkConnection>();
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kValidate);
+    admission.validated("10.0.0.1", accepted);
+    EXPECT_EQ(admission.admit("10.0.0.1", 1001, object), Decision::kAccept);
+    EXPECT_EQ(object, accepted);
+    EXPECT_EQ(admission.admit("10.0.0.2", 1000, object), Decision::kValidate);
+    admission.validated("10.0.0.2", nullptr);
+    EXPECT_EQ(admission.admit("10.0.0.2", 1000, object), Decision::kReject);
+    EXPECT_EQ(admission.statistics().mRejectedCached, 1);
+
+    // Validation threads, the first attempt is deferred and the reconnect admitted from the cache
+    settings.mValidationThreads = 2;
+    std::atomic<int> validations = 0;
+    ASSERT_TRUE(admission.configure(settings, [&](const std::string& ip, uint16_t port) -> std::shared_ptr<void> {
+        validations++;
+        return ip == "10.0.0.1" ? accepted : nullptr;
+    }));
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kReject);
+    EXPECT_EQ(admission.admit("10.0.0.1", 1000, object), Decision::kReject);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    Decision decision;
+    while ((decision = admission.admit("10.0.0.1", 1000, object)) == Decision::kReject &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(decision, Decision::kAccept);
+    EXPECT_EQ(object, accepted);
+    EXPECT_EQ(validations, 1) << "One validation per IP at a time";
+
+    settings.mCacheTime = 0;
+    EXPECT_FALSE(admission.configure(settings, nullptr)) << "Validation threads require the cache";
+}
+
+TEST(TestRist, MemoryBudget) {
+    // 10 Mbit/s for one second
+    size_t recoveryBuffer = RISTNetMemory::recoveryBufferSize(10000, 1000);
+    EXPECT_GE(recoveryBuffer, 1250000);
+    EXPECT_LT(recoveryBuffer, 1250000 * 11 / 10);
+    EXPECT_EQ(RISTNetMemory::recoveryLengthFitting(10000, recoveryBuffer), 1000);
+    EXPECT_EQ(RISTNetMemory::recoveryLengthFitting(10000, recoveryBuffer - 1), 999);
+
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mPeerConfig.recovery_maxbitrate = 10000;
+    receiverSettings.mPeerConfig.recovery_length_min = 100;
+    receiverSettings.mPeerConfig.recovery_length_max = 1000;
+    auto estimate = RISTNetReceiver::estimateMemory(receiverSettings, 10);
+    EXPECT_EQ(estimate.mRecoveryBuffers, 10 * recoveryBuffer) << "One recovery buffer per connection";
+    EXPECT_GT(estimate.mConnections, 0);
+
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mPeerConfig.recovery_maxbitrate = 10000;
+    senderSettings.mPeerConfig.recovery_length_min = 100;
+    senderSettings.mPeerConfig.recovery_length_max = 1000;
+    senderSettings.mSendQueueDepth = 100;
+    EXPECT_EQ(RISTNetSender::estimateMemory(senderSettings, 10).mRecoveryBuffers, recoveryBuffer)
+        << "One recovery buffer per sender";
+    EXPECT_GT(RISTNetSender::estimateMemory(senderSettings, 10).mQueues, 100 * RIST_MAX_PACKET_SIZE);
+
+    size_t baseline = RISTNetMemory::used();
+    size_t senderQueues = RISTNetSender::estimateMemory(senderSettings, 0).mQueues;
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+
+    // Rejected
+    RISTNetMemory::setLimit(baseline + senderQueues + recoveryBuffer / 2, RISTNetMemory::Policy::kReject);
+    {
+        RISTNetSender sender;
+        EXPECT_FALSE(sender.initSender(senderInterfaces, senderSettings));
+    }
+    EXPECT_EQ(RISTNetMemory::used(), baseline) << "Nothing is held after a failed init";
+
+    // Clamped to the budget
+    RISTNetMemory::setLimit(baseline + senderQueues + recoveryBuffer / 2, RISTNetMemory::Policy::kClamp);
+    {
+        RISTNetSender sender;
+        ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+        auto usage = sender.getMemoryUsage();
+        EXPECT_GT(usage.mRecoveryBuffers, recoveryBuffer / 4);
+        EXPECT_LE(usage.mRecoveryBuffers, recoveryBuffer / 2);
+        EXPECT_GE(usage.mQueues, 100 * RIST_MAX_PACKET_SIZE);
+        EXPECT_LE(RISTNetMemory::used(), RISTNetMemory::limit());
+        sender.destroySender();
+        EXPECT_EQ(RISTNetMemory::used(), baseline);
+    }
+
+    // Room for the receiver but not for a connection
+    RISTNetMemory::setLimit(baseline + recoveryBuffer + 1000, RISTNetMemory::Policy::kReject);
+    RISTNetReceiver receiver;
+    std::atomic<int> validated = 0;
+    receiver.validateConnectionCallback = [&](const std::string &, uint16_t) {
+        validated++;
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+    // The sender fits, its connection to the receiver does not
+    RISTNetMemory::setLimit(RISTNetMemory::used() + senderQueues + recoveryBuffer + 1000,
+                            RISTNetMemory::Policy::kReject);
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!validated && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    size_t clients = 0;
+    receiver.getActiveClients([&](std::map<rist_peer *, std::shared_ptr<RISTNetReceiver::NetworkConnection>> &rClients) {
+        clients = rClients.size();
+    });
+    EXPECT_EQ(clients, 0) << "The connection exceeds the budget";
+    EXPECT_EQ(receiver.getMemoryUsage().mRecoveryBuffers, 0);
+
+    // With a budget the client is accepted and accounted
+    RISTNetMemory::setLimit(0);
+    sender.destroySender();
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!clients && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        receiver.getActiveClients([&](std::map<rist_peer *, std::shared_ptr<RISTNetReceiver::NetworkConnection>> &rClients) {
+            clients = rClients.size();
+        });
+    }
+    ASSERT_EQ(clients, 1);
+    auto usage = receiver.getMemoryUsage();
+    EXPECT_EQ(usage.mRecoveryBuffers, recoveryBuffer);
+    EXPECT_GT(usage.mConnections, RISTNetLatencyHistogram::kMemoryUsage);
+    sender.destroySender();
+    receiver.destroyReceiver();
+    EXPECT_EQ(RISTNetMemory::used(), baseline);
+}
+
+TEST(TestRist, RecoveryController) {
+    RISTNetRecoverySettings settings;
+    settings.mEnabled = true;
+    settings.mMinLength = 50;
+    settings.mMaxLength = 5000;
+    settings.mRetransmissions = 4;
+    settings.mMargin = 1.25;
+    settings.mHistory = 10;
+    settings.mMinSamples = 3;
+    settings.mShrinkAfter = 3;
+    settings.mMinChangeInterval = 5;
+    RISTNetRecoveryWindow initial{1000, 1000, 50, 500};
+    RISTNetRecoveryController controller(settings, initial);
+
+    // 20 ms RTT without loss calls for 1.25 x 4 x 20 = 100 ms, shrinking waits for mMinChangeInterval
+    for (int i = 0; i < 4; i++) {
+        EXPECT_FALSE(controller.addInterval(20, 1000, 0));
+        EXPECT_EQ(controller.window(), initial);
+    }
+    EXPECT_TRUE(controller.addInterval(20, 1000, 0));
+    EXPECT_EQ(controller.window().mLengthMax, 100);
+    EXPECT_EQ(controller.window().mLengthMin, 100);
+    EXPECT_EQ(controller.window().mRTTMin, 20);
+    EXPECT_EQ(controller.window().mRTTMax, 25);
+
+    // 10% loss needs 6 round trips to leave 1e-6, the window grows at once to 1.25 x 6 x 20
+    EXPECT_TRUE(controller.addInterval(20, 900, 100));
+    EXPECT_EQ(controller.window().mLengthMax, 150);
+    // Small changes are ignored
+    EXPECT_FALSE(controller.addInterval(22, 1000, 0));
+    EXPECT_EQ(controller.window().mLengthMax, 150);
+
+    // An RTT spike grows the window and recovery_rtt_max
+    EXPECT_TRUE(controller.addInterval(200, 1000, 0));
+    EXPECT_EQ(controller.window().mLengthMax, 1500);
+    EXPECT_EQ(controller.window().mRTTMax, 250);
+    EXPECT_TRUE(controller.addInterval(5000, 1000, 0));
+    EXPECT_EQ(controller.window().mLengthMax, 5000) << "Clamped to mMaxLength";
+    EXPECT_LE(controller.window().mRTTMax, controller.window().mLengthMax);
+
+    // Back to 100 ms once the spike and the loss have left the history
+    bool shrunk = false;
+    for (int i = 0; i < 30 && !shrunk; i++) {
+        shrunk = controller.addInterval(20, 1000, 0);
+    }
+    EXPECT_TRUE(shrunk);
+    EXPECT_EQ(controller.window().mLengthMax, 100);
+    EXPECT_EQ(controller.target(), controller.window());
+}
+
+TEST(TestRist, RecoveryControllerFlows) {
+    RISTNetRecoverySettings settings;
+    settings.mEnabled = true;
+    settings.mMinLength = 50;
+    settings.mMinSamples = 3;
+    settings.mShrinkAfter = 1;
+    settings.mMinChangeInterval = 0;
+    RISTNetRecoveryWindow initial{1000, 1000, 50, 500};
+
+    // Three flows reporting every second are one interval per second, not three
+    RISTNetRecoveryController controller(settings, initial);
+    for (int i = 0; i < 3; i++) {
+        for (uint32_t flow = 1; flow <= 3; flow++) {
+            EXPECT_FALSE(controller.addFlow(flow, 20, 1000, 0));
+        }
+    }
+    // The third period closes when flow 1 reports again, the highest RTT of the flows counts
+    EXPECT_TRUE(controller.addFlow(1, 20, 1000, 0));
+    EXPECT_EQ(controller.window().mLengthMax, 100);
+    EXPECT_FALSE(controller.addFlow(2, 80, 1000, 0));
+    EXPECT_FALSE(controller.addFlow(3, 20, 1000, 0));
+    EXPECT_TRUE(controller.addFlow(1, 20, 1000, 0));
+    EXPECT_EQ(controller.window().mLengthMax, 400);
+
+    // The loss is summed over the flows, 100 of 3000 packets missing
+    RISTNetRecoveryController summed(settings, initial);
+    for (int i = 0; i < 4; i++) {
+        summed.addFlow(1, 20, 900, 100);
+        summed.addFlow(2, 20, 1000, 0);
+        summed.addFlow(3, 20, 1000, 0);
+    }
+    RISTNetRecoveryController single(settings, initial);
+    for (int i = 0; i < 3; i++) {
+        single.addInterval(20, 2900, 100);
+    }
+    EXPECT_EQ(summed.window(), single.window());
+}
+
+TEST(TestRist, RecoveryControllerBursts) {
+    RISTNetRecoverySettings settings;
+    settings.mEnabled = true;
+    settings.mMinLength = 50;
+    settings.mMinSamples = 3;
+    RISTNetRecoveryWindow initial{1000, 1000, 50, 500};
+
+    // 3% loss at 20 ms RTT needs 4 round trips. Spread out the gaps stay short: 1.25 x (5 + 4 x 20)
+    RISTNetRecoveryController uniform(settings, initial);
+    // The same loss in a 300 ms outage is only requested again after it: 1.25 x (300 + 4 x 20)
+    RISTNetRecoveryController burst(settings, initial);
+    // A long gap without loss is a sparse stream, not a burst
+    RISTNetRecoveryController sparse(settings, initial);
+    for (int i = 0; i < 3; i++) {
+        uniform.addInterval(20, 970, 30, 5);
+        burst.addInterval(20, 970, 30, 300);
+        sparse.addInterval(20, 1000, 0, 300);
+    }
+    EXPECT_EQ(uniform.target().mLengthMax, 107);
+    EXPECT_EQ(burst.target().mLengthMax, 475);
+    EXPECT_EQ(sparse.target().mLengthMax, 100);
+    EXPECT_EQ(burst.target().mRTTMax, 25) << "recovery_rtt_max follows the RTT only";
+
+    // Summed over the flows, only the gaps of a flow that lost packets count
+    RISTNetRecoveryController flows(settings, initial);
+    for (int i = 0; i < 4; i++) {
+        flows.addFlow(1, 20, 970, 30, 300);
+        flows.addFlow(2, 20, 10, 0, 900);
+    }
+    EXPECT_EQ(flows.target().mLengthMax, 475);
+}
+
+TEST(TestRist, ImpairmentModel) {
+    const size_t kPackets = 100000;
+    auto now = RISTNetImpairment::Clock::now();
+    RISTNetImpairment::Clock::time_point delivery[RISTNetImpairment::kMaxCopies];
+
+    RISTNetImpairment bernoulli(RISTNetImpairmentSettings::bernoulli(0.05));
+    for (size_t i = 0; i < kPackets; i++) {
+        bernoulli.process(1316, now, delivery);
+    }
+    EXPECT_NEAR((double) bernoulli.statistics().mLost / kPackets, 0.05, 0.005);
+
+    // 2% loss in bursts of 5 packets on average
+    RISTNetImpairment burst(RISTNetImpairmentSettings::gilbertElliott(0.2 / 49, 0.2));
+    size_t bursts = 0;
+    bool previousLost = false;
+    for (size_t i = 0; i < kPackets; i++) {
+        bool lost = burst.process(1316, now, delivery) == 0;
+        bursts += lost && !previousLost;
+        previousLost = lost;
+    }
+    EXPECT_NEAR((double) burst.statistics().mLost / kPackets, 0.02, 0.005);
+    EXPECT_NEAR((double) burst.statistics().mLost / bursts, 5.0, 1.0);
+
+    RISTNetImpairmentSettings settings;
+    settings.mDelay = 10000;
+    settings.mJitter = 2000;
+    settings.mDuplicate = 0.1;
+    RISTNetImpairment delayed(settings);
+    size_t copies = 0;
+    for (size_t i = 0; i < 10000; i++) {
+        size_t n = delayed.process(1316, now, delivery);
+        for (size_t j = 0; j < n; j++) {
+            auto wait = std::chrono::duration_cast<std::chrono::microseconds>(delivery[j] - now).count();
+            EXPECT_GE(wait, 8000);
+            EXPECT_LE(wait, 12000);
+        }
+        copies += n;
+    }
+    EXPECT_EQ(copies, 10000 + delayed.statistics().mDuplicated);
+    EXPECT_NEAR(delayed.statistics().mDuplicated, 1000, 150);
+
+    // 1316 bytes at 10.528 Mbit/s take 1 ms, the link queue holds 5 ms
+    settings = RISTNetImpairmentSettings();
+    settings.mBandwidth = 10528000;
+    settings.mMaxQueueDelay = 5000;
+    RISTNetImpairment limited(settings);
+    for (size_t i = 0; i < 10; i++) {
+        limited.process(1316, now, delivery);
+    }
+    EXPECT_EQ(limited.statistics().mForwarded, 6);
+    EXPECT_EQ(limited.statistics().mQueueDrops, 4);
+}
+
+TEST(TestRist, ImpairmentProxy) {
+    // target <- proxy <- client, and back
+    int target = socket(AF_INET, SOCK_DGRAM, 0);
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(target, (sockaddr*) &address, sizeof(address)), 0);
+    socklen_t length = sizeof(address);
+    getsockname(target, (sockaddr*) &address, &length);
+    timeval timeout{1, 0};
+    setsockopt(target, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    RISTNetImpairmentProxy proxy;
+    RISTNetImpairmentSettings forward;
+    forward.mDelay = 2000;
+    ASSERT_TRUE(proxy.start("127.0.0.1", 0, "127.0.0.1", ntohs(address.sin_port), forward));
+    ASSERT_NE(proxy.listenPort(), 0);
+
+    sockaddr_in proxyAddress = address;
+    proxyAddress.sin_port = htons(proxy.listenPort());
+    auto sent = std::chrono::steady_clock::now();
+    for (uint8_t i = 0; i < 10; i++) {
+        sendto(client, &i, 1, 0, (sockaddr*) &proxyAddress, sizeof(proxyAddress));
+    }
+    sockaddr_in from{};
+    socklen_t fromLength = sizeof(from);
+    for (uint8_t i = 0; i < 10; i++) {
+        uint8_t received = 0xff;
+        ASSERT_EQ(recvfrom(target, &received, 1, 0, (sockaddr*) &from, &fromLength), 1);
+        EXPECT_EQ(received, i);
+    }
+    EXPECT_GE(std::chrono::steady_clock::now() - sent, std::chrono::microseconds(2000));
+
+    // The return traffic goes to the client
+    uint8_t reply = 42;
+    sendto(target, &reply, 1, 0, (sockaddr*) &from, fromLength);
+    uint8_t received = 0;
+    ASSERT_EQ(recv(client, &received, 1, 0), 1);
+    EXPECT_EQ(received, reply);
+
+    RISTNetImpairmentStatistics forwardStatistics;
+    RISTNetImpairmentStatistics returnStatistics;
+    proxy.getStatistics(forwardStatistics, returnStatistics);
+    EXPECT_EQ(forwardStatistics.mForwarded, 10);
+    EXPECT_EQ(returnStatistics.mForwarded, 1);
+
+    proxy.stop();
+    close(target);
+    close(client);
+}
+
+TEST(TestRist, CompressionLZ4) {
+    std::string telemetry;
+    for (int i = 0; i < 20; i++) {
+        telemetry += "{\"sensor\":\"temperature\",\"value\":" + std::to_string(20 + i) + "}";
+    }
+    const uint8_t* source = (const uint8_t*) telemetry.data();
+    std::vector<uint8_t> compressed(telemetry.size() + RISTNetLZ4::kTrailerSize);
+    std::vector<uint8_t> decompressed(telemetry.size());
+
+    RISTNetLZ4 lz4;
+    size_t size = lz4.compress(source, telemetry.size(), compressed.data(), compressed.size(), true);
+    ASSERT_GT(size, 0);
+    EXPECT_LT(size, telemetry.size() / 2);
+    RISTNetLZ4::Format format;
+    size_t payloadSize = 0;
+    ASSERT_TRUE(RISTNetLZ4::readTrailer(compressed.data(), size, format, payloadSize));
+    EXPECT_EQ(format, RISTNetLZ4::Format::kLZ4);
+    ASSERT_EQ(lz4.decompress(compressed.data(), payloadSize, format, decompressed.data(), decompressed.size()),
+              (int) telemetry.size());
+    EXPECT_EQ(memcmp(decompressed.data(), source, telemetry.size()), 0);
+
+    // A small message only compresses with a dictionary of similar messages
+    const std::string message = "{\"sensor\":\"humidity\",\"value\":45}";
+    const uint8_t* messageData = (const uint8_t*) message.data();
+    size = lz4.compress(messageData, message.size(), compressed.data(), compressed.size(), true);
+    ASSERT_TRUE(RISTNetLZ4::readTrailer(compressed.data(), size, format, payloadSize));
+    EXPECT_EQ(format, RISTNetLZ4::Format::kRaw);
+    EXPECT_EQ(payloadSize, message.size());
+
+    RISTNetLZ4 receiver;
+    EXPECT_EQ(receiver.decompress(compressed.data(), 1, RISTNetLZ4::Format::kLZ4Dictionary, decompressed.data(),
+                                  decompressed.size()), -1) << "Expected an error without dictionary";
+    std::vector<uint8_t> dictionary(telemetry.begin(), telemetry.end());
+    lz4.setDictionary(dictionary);
+    receiver.setDictionary(dictionary);
+    size = lz4.compress(messageData, message.size(), compressed.data(), compressed.size(), true);
+    ASSERT_TRUE(RISTNetLZ4::readTrailer(compressed.data(), size, format, payloadSize));
+    EXPECT_EQ(format, RISTNetLZ4::Format::kLZ4Dictionary);
+    EXPECT_LT(payloadSize, message.size());
+    ASSERT_EQ(receiver.decompress(compressed.data(), payloadSize, format, decompressed.data(), decompressed.size()),
+              (int) message.size());
+    EXPECT_EQ(memcmp(decompressed.data(), messageData, message.size()), 0);
+
+    size = lz4.compress(messageData, message.size(), compressed.data(), compressed.size(), false);
+    ASSERT_TRUE(RISTNetLZ4::readTrailer(compressed.data(), size, format, payloadSize));
+    EXPECT_EQ(format, RISTNetLZ4::Format::kRaw);
+    const uint8_t malformed[2] = {0, 7};
+    EXPECT_FALSE(RISTNetLZ4::readTrailer(malformed, sizeof(malformed), format, payloadSize));
+
+    RISTNetBufferPool pool(64);
+    uint8_t* first;
+    {
+        auto buffer = pool.acquire();
+        ASSERT_EQ(buffer.size(), 64);
+        first = buffer.data();
+    }
+    EXPECT_EQ(pool.acquire().data(), first) << "Expected the buffer to be reused";
+}
+
+TEST(TestRist, Compression) {
+    const uint16_t kCompressedFlow = 2;
+    std::string telemetry;
+    for (int i = 0; i < 20; i++) {
+        telemetry += "{\"sensor\":\"temperature\",\"value\":" + std::to_string(20 + i) + "}";
+    }
+
+    RISTNetReceiver receiver;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mCompression = true;
+    receiverSettings.mCompressionDictionary.assign(telemetry.begin(), telemetry.end());
+    receiverSettings.mLatencyProbe = true;
+
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    std::vector<std::pair<std::string, uint16_t>> received;
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                       rist_peer* peer, uint16_t connectionId) {
+        {
+            std::lock_guard<std::mutex> lock(receiverMutex);
+            received.emplace_back(std::string((const char*) buf, size), connectionId);
+        }
+        receiverCondition.notify_one();
+        return 0;
+    };
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mCompressedFlowIds = {kCompressedFlow};
+    senderSettings.mCompressionDictionary.assign(telemetry.begin(), telemetry.end());
+    senderSettings.mLatencyProbeInterval = 1;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    EXPECT_TRUE(sender.sendData((const uint8_t*) telemetry.data(), telemetry.size(), kCompressedFlow));
+    EXPECT_TRUE(sender.sendData((const uint8_t*) telemetry.data(), telemetry.size(), 1));
+    EXPECT_TRUE(sender.sendData((const uint8_t*) telemetry.data(), 10, kCompressedFlow));
+
+    std::unique_lock<std::mutex> lock(receiverMutex);
+    ASSERT_TRUE(receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return received.size() == 3; }));
+    EXPECT_EQ(received[0], std::make_pair(telemetry, kCompressedFlow));
+    EXPECT_EQ(received[1], std::make_pair(telemetry, (uint16_t) 1));
+    EXPECT_EQ(received[2], std::make_pair(telemetry.substr(0, 10), kCompressedFlow));
+}
+
+// Sends 6 packets through a send queue of depth 4 while the receiver is stalled, returns the received packets
+static std::vector<uint8_t> runSendQueue(RISTNetSender::QueuePolicy policy, RISTNetSender::SendQueueStatistics& statistics,
+                                         std::vector<bool>& watermarkEvents) {
+    RISTNetReceiver receiver;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    bool stalled = true;
+    bool receiving = false;
+    std::vector<uint8_t> received;
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                       rist_peer* peer, uint16_t connectionId) {
+        std::unique_lock<std::mutex> lock(receiverMutex);
+        received.push_back(*buf);
+        receiving = true;
+        receiverCondition.notify_all();
+        receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return !stalled; });
+        return 0;
+    };
+    EXPECT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mSendQueueDepth = 4;
+    senderSettings.mSendQueuePolicy = policy;
+    senderSettings.mSendQueueHighWatermark = 3;
+    senderSettings.mSendQueueLowWatermark = 1;
+    RISTNetSender sender;
+    sender.sendQueueWatermarkCallback = [&](bool high, size_t queued) {
+        std::lock_guard<std::mutex> lock(receiverMutex);
+        watermarkEvents.push_back(high);
+    };
+    EXPECT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    // The first packet stalls the sender thread inside librist
+    uint8_t packet = 0;
+    EXPECT_TRUE(sender.sendData(&packet, 1));
+    {
+        std::unique_lock<std::mutex> lock(receiverMutex);
+        EXPECT_TRUE(receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return receiving; }));
+    }
+    for (packet = 1; packet <= 5; packet++) {
+        bool queued = sender.sendData(&packet, 1);
+        EXPECT_EQ(queued, packet <= 4 || policy != RISTNetSender::QueuePolicy::kDropNewest);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(receiverMutex);
+        stalled = false;
+    }
+    receiverCondition.notify_all();
+    auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        sender.getSendQueueStatistics(statistics);
+    } while (statistics.mQueued && std::chrono::steady_clock::now() < deadline);
+
+    std::lock_guard<std::mutex> lock(receiverMutex);
+    return received;
+}
+
+TEST(TestRist, SendQueue) {
+    RISTNetSender::SendQueueStatistics statistics;
+    std::vector<bool> watermarkEvents;
+    auto received = runSendQueue(RISTNetSender::QueuePolicy::kDropNewest, statistics, watermarkEvents);
+    EXPECT_EQ(received, std::vector<uint8_t>({0, 1, 2, 3, 4}));
+    EXPECT_EQ(statistics.mDropped, 1);
+    EXPECT_EQ(statistics.mMaxQueued, 4);
+    EXPECT_EQ(statistics.mHighWatermarkEvents, 1);
+    EXPECT_EQ(statistics.mWriteErrors, 0);
+    EXPECT_EQ(watermarkEvents, std::vector<bool>({true, false}));
+
+    watermarkEvents.clear();
+    received = runSendQueue(RISTNetSender::QueuePolicy::kDropOldest, statistics, watermarkEvents);
+    EXPECT_EQ(received, std::vector<uint8_t>({0, 2, 3, 4, 5}));
+    EXPECT_EQ(statistics.mDropped, 1);
+    EXPECT_EQ(watermarkEvents, std::vector<bool>({true, false}));
+}
+
+// recvmmsg is Linux only
+#ifdef __linux__
+TEST(TestRist, UDPIngest) {
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver receiver;
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    std::vector<uint32_t> received;
+    receiver.validateConnectionCallback = [&](const std::string &, uint16_t) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t *buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection> &connection,
+                                       rist_peer *peer, uint16_t connectionId) {
+        EXPECT_EQ(size, 1316);
+        EXPECT_EQ(connectionId, 7);
+        uint32_t sequence;
+        memcpy(&sequence, buf, sizeof(sequence));
+        std::lock_guard<std::mutex> lock(receiverMutex);
+        received.push_back(sequence);
+        receiverCondition.notify_one();
+        return 0;
+    };
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mSendQueueDepth = 1024;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    RISTNetUDPIngestSettings ingestSettings;
+    RISTNetUDPSource source;
+    source.mAddress = "127.0.0.1";
+    source.mConnectionID = 7;
+    ingestSettings.mSources.push_back(source);
+    ingestSettings.mBatchSize = 16;
+    RISTNetUDPIngest ingest;
+    ASSERT_TRUE(ingest.start(sender, ingestSettings));
+    ASSERT_NE(ingest.port(0), 0);
+
+    int encoder = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(encoder, 0);
+    sockaddr_in target{};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(ingest.port(0));
+    inet_pton(AF_INET, "127.0.0.1", &target.sin_addr);
+    const uint32_t kDatagrams = 500;
+    std::vector<uint8_t> datagram(1316);
+    for (uint32_t i = 0; i < kDatagrams; i++) {
+        memcpy(datagram.data(), &i, sizeof(i));
+        sendto(encoder, datagram.data(), datagram.size(), 0, (sockaddr *) &target, sizeof(target));
+    }
+    // Longer than mMaxDatagramSize
+    std::vector<uint8_t> jumbo(2000);
+    sendto(encoder, jumbo.data(), jumbo.size(), 0, (sockaddr *) &target, sizeof(target));
+    close(encoder);
+
+    {
+        std::unique_lock<std::mutex> lock(receiverMutex);
+        receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return received.size() >= kDatagrams; });
+        ASSERT_EQ(received.size(), kDatagrams);
+        for (uint32_t i = 0; i < kDatagrams; i++) {
+            EXPECT_EQ(received[i], i);
+        }
+    }
+    RISTNetUDPIngestStatistics statistics;
+    auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        ASSERT_TRUE(ingest.getStatistics(0, statistics));
+    } while (statistics.mTruncated == 0 && std::chrono::steady_clock::now() < deadline);
+    EXPECT_EQ(statistics.mDatagrams, kDatagrams + 1);
+    EXPECT_EQ(statistics.mTruncated, 1);
+    EXPECT_EQ(statistics.mForwardDrops, 0);
+    EXPECT_EQ(statistics.mSocketDrops, 0);
+    EXPECT_LE(statistics.mBatches, statistics.mDatagrams);
+    EXPECT_FALSE(ingest.getStatistics(1, statistics));
+    ingest.stop();
+}
+
+TEST(TestRist, UDPIngestSources) {
+    // Two sources feeding a sender without a send queue, compressing and adding probes to every packet
+    const size_t kSources = 2;
+    const uint32_t kDatagrams = 10000;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver receiver;
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    std::vector<std::vector<uint32_t>> received(kSources);
+    size_t corrupted = 0;
+    receiver.validateConnectionCallback = [&](const std::string &, uint16_t) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t *buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection> &connection,
+                                       rist_peer *peer, uint16_t connectionId) {
+        std::lock_guard<std::mutex> lock(receiverMutex);
+        size_t source = connectionId - 7;
+        uint32_t sequence = 0;
+        if (source >= kSources || size != 1316) {
+            corrupted++;
+            return 0;
+        }
+        memcpy(&sequence, buf, sizeof(sequence));
+        for (size_t i = sizeof(sequence); i < size; i++) {
+            if (buf[i] != (uint8_t) (sequence + source)) {
+                corrupted++;
+                return 0;
+            }
+        }
+        received[source].push_back(sequence);
+        receiverCondition.notify_one();
+        return 0;
+    };
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mCompression = true;
+    receiverSettings.mLatencyProbe = true;
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mCompressedFlowIds = {7, 8};
+    senderSettings.mLatencyProbeInterval = 1;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    RISTNetUDPIngestSettings ingestSettings;
+    for (size_t i = 0; i < kSources; i++) {
+        RISTNetUDPSource source;
+        source.mAddress = "127.0.0.1";
+        source.mConnectionID = (uint16_t) (7 + i);
+        ingestSettings.mSources.push_back(source);
+    }
+    ingestSettings.mBatchSize = 8;
+    RISTNetUDPIngest ingest;
+    ASSERT_TRUE(ingest.start(sender, ingestSettings));
+
+    std::vector<std::thread> encoders;
+    for (size_t source = 0; source < kSources; source++) {
+        encoders.emplace_back([&, source]() {
+            int encoder = socket(AF_INET, SOCK_DGRAM, 0);
+            sockaddr_in target{};
+            target.sin_family = AF_INET;
+            target.sin_port = htons(ingest.port(source));
+            inet_pton(AF_INET, "127.0.0.1", &target.sin_addr);
+            std::vector<uint8_t> datagram(1316);
+            for (uint32_t i = 0; i < kDatagrams; i++) {
+                memset(datagram.data(), (uint8_t) (i + source), datagram.size());
+                memcpy(datagram.data(), &i, sizeof(i));
+                sendto(encoder, datagram.data(), datagram.size(), 0, (sockaddr *) &target, sizeof(target));
+                // Paced so the socket buffers do not overflow
+                if (i % 1000 == 999) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            close(encoder);
+        });
+    }
+    for (auto &encoder: encoders) {
+        encoder.join();
+    }
+
+    std::unique_lock<std::mutex> lock(receiverMutex);
+    receiverCondition.wait_for(lock, kReceiveTimeout, [&]() {
+        return received[0].size() + received[1].size() + corrupted >= kSources * kDatagrams;
+    });
+    EXPECT_EQ(corrupted, 0);
+    for (size_t source = 0; source < kSources; source++) {
+        ASSERT_EQ(received[source].size(), kDatagrams);
+        for (uint32_t i = 0; i < kDatagrams; i++) {
+            EXPECT_EQ(received[source][i], i);
+        }
+    }
+    lock.unlock();
+    ingest.stop();
+}
+#endif
+
+TEST(TestRist, UDPEgress) {
+    // Two decoders for connection ID 3, one for 4
+    int decoders[3];
+    uint16_t ports[3];
+    for (int i = 0; i < 3; i++) {
+        decoders[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        ASSERT_GE(decoders[i], 0);
+        int bufferSize = 4 * 1024 * 1024;
+        setsockopt(decoders[i], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        timeval timeout{0, 200000};
+        setsockopt(decoders[i], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+        ASSERT_EQ(bind(decoders[i], (sockaddr *) &address, sizeof(address)), 0);
+        socklen_t length = sizeof(address);
+        getsockname(decoders[i], (sockaddr *) &address, &length);
+        ports[i] = ntohs(address.sin_port);
+    }
+    RISTNetUDPEgressSettings egressSettings;
+    const uint16_t connectionIDs[3] = {3, 3, 4};
+    for (int i = 0; i < 3; i++) {
+        RISTNetUDPDestination destination;
+        destination.mAddress = "127.0.0.1";
+        destination.mPort = ports[i];
+        destination.mConnectionID = connectionIDs[i];
+        egressSettings.mDestinations.push_back(destination);
+    }
+    RISTNetUDPEgress egress;
+    ASSERT_TRUE(egress.start(egressSettings));
+
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [&](const std::string &, uint16_t) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    egress.attach(receiver);
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    const uint32_t kPackets = 300;
+    std::vector<uint8_t> packet(1316);
+    for (uint32_t i = 0; i < kPackets; i++) {
+        memcpy(packet.data(), &i, sizeof(i));
+        // Every 10th packet is shorter, ending a GSO run
+        size_t size = i % 10 == 9 ? 1000 : packet.size();
+        ASSERT_TRUE(sender.sendData(packet.data(), size, 3));
+    }
+    ASSERT_TRUE(sender.sendData(packet.data(), 500, 4));
+    ASSERT_TRUE(sender.sendData(packet.data(), 500, 5));
+
+    std::vector<uint8_t> datagram(2000);
+    for (int i = 0; i < 2; i++) {
+        for (uint32_t expected = 0; expected < kPackets; expected++) {
+            ssize_t size = recv(decoders[i], datagram.data(), datagram.size(), 0);
+            ASSERT_EQ(size, expected % 10 == 9 ? 1000 : 1316) << "Decoder " << i << " packet " << expected;
+            uint32_t sequence;
+            memcpy(&sequence, datagram.data(), sizeof(sequence));
+            EXPECT_EQ(sequence, expected);
+        }
+    }
+    EXPECT_EQ(recv(decoders[2], datagram.data(), datagram.size(), 0), 500);
+    EXPECT_EQ(recv(decoders[2], datagram.data(), datagram.size(), 0), -1) << "Only connection ID 4";
+
+    RISTNetUDPEgressStatistics statistics;
+    egress.getStatistics(statistics);
+    EXPECT_EQ(statistics.mQueued, kPackets + 1);
+    EXPECT_EQ(statistics.mUnrouted, 1);
+    EXPECT_EQ(statistics.mDropped, 0);
+    ASSERT_EQ(statistics.mDestinations.size(), 3);
+    EXPECT_EQ(statistics.mDestinations[0].mDatagrams, kPackets);
+    EXPECT_EQ(statistics.mDestinations[1].mDatagrams, kPackets);
+    EXPECT_EQ(statistics.mDestinations[2].mDatagrams, 1);
+    EXPECT_EQ(statistics.mDestinations[0].mErrors, 0);
+    EXPECT_LE(statistics.mDestinations[0].mSyscalls, kPackets);
+
+    sender.destroySender();
+    receiver.destroyReceiver();
+    egress.stop();
+    for (int decoder: decoders) {
+        close(decoder);
+    }
+}
+
+TEST(TestRist, Router) {
+    RISTNetRouter router;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<uint32_t> fast;
+    std::vector<uint32_t> filtered;
+    std::set<const uint8_t *> buffers;
+    bool stalled = true;
+    RISTNetRouter::Packet kept;
+
+    RISTNetRouterOutputSettings fastSettings;
+    fastSettings.mName = "fast";
+    router.addOutput(fastSettings, [&](const RISTNetRouter::Packet &packet) {
+        uint32_t sequence;
+        memcpy(&sequence, packet.data(), sizeof(sequence));
+        std::lock_guard<std::mutex> lock(mutex);
+        fast.push_back(sequence);
+        if (sequence == 0) {
+            kept = packet;
+        }
+        condition.notify_all();
+    });
+    RISTNetRouterOutputSettings slowSettings;
+    slowSettings.mName = "slow";
+    slowSettings.mQueueDepth = 4;
+    router.addOutput(slowSettings, [&](const RISTNetRouter::Packet &packet) {
+        std::unique_lock<std::mutex> lock(mutex);
+        buffers.insert(packet.data());
+        condition.wait(lock, [&]() { return !stalled; });
+    });
+    RISTNetRouterOutputSettings filteredSettings;
+    filteredSettings.mName = "filtered";
+    filteredSettings.mConnectionIDs = {2};
+    router.addOutput(filteredSettings, [&](const RISTNetRouter::Packet &packet) {
+        EXPECT_EQ(packet.connectionID(), 2);
+        std::lock_guard<std::mutex> lock(mutex);
+        filtered.push_back(packet.connectionID());
+        buffers.insert(packet.data());
+    });
+    ASSERT_TRUE(router.start(1500));
+
+    const uint32_t kPackets = 200;
+    std::vector<uint8_t> packet(1316);
+    for (uint32_t i = 0; i < kPackets; i++) {
+        memcpy(packet.data(), &i, sizeof(i));
+        EXPECT_TRUE(router.route(packet.data(), packet.size(), i < 10 ? 2 : 1));
+    }
+    EXPECT_FALSE(router.route(packet.data(), 1501, 1)) << "Longer than the pool buffers";
+    EXPECT_EQ(router.oversize(), 1);
+    {
+        // The stalled output does not hold up the others
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(condition.wait_for(lock, kReceiveTimeout, [&]() { return fast.size() == kPackets; }));
+        std::vector<uint32_t> expected(kPackets);
+        std::iota(expected.begin(), expected.end(), 0);
+        EXPECT_EQ(fast, expected);
+        EXPECT_EQ(filtered.size(), 10);
+        stalled = false;
+    }
+    condition.notify_all();
+
+    std::vector<RISTNetRouterOutputStatistics> statistics;
+    auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        router.getStatistics(statistics);
+    } while (statistics[1].mQueued && std::chrono::steady_clock::now() < deadline);
+    ASSERT_EQ(statistics.size(), 3);
+    EXPECT_EQ(statistics[0].mName, "fast");
+    EXPECT_EQ(statistics[0].mDelivered, kPackets);
+    EXPECT_EQ(statistics[0].mDropped, 0);
+    EXPECT_EQ(statistics[1].mDelivered + statistics[1].mDropped, kPackets);
+    EXPECT_GE(statistics[1].mDropped, kPackets - 2 * 4) << "The queued packets and one batch are delivered";
+    EXPECT_EQ(statistics[1].mMaxQueued, 4);
+    EXPECT_EQ(statistics[2].mDelivered, 10);
+    EXPECT_EQ(router.poolExhausted(), 0);
+
+    // Outputs see the same buffer, a kept reference stays valid
+    uint32_t sequence;
+    ASSERT_TRUE(kept);
+    memcpy(&sequence, kept.data(), sizeof(sequence));
+    EXPECT_EQ(sequence, 0);
+    EXPECT_EQ(kept.size(), 1316);
+    EXPECT_TRUE(buffers.count(kept.data()));
+    kept = RISTNetRouter::Packet();
+    router.stop();
+}
+
+TEST(TestRist, TSAnalyzer) {
+    std::vector<uint8_t> buffer(1000, 0);
+    for (auto implementation: {RISTNetTSAnalyzer::Implementation::kScalar, RISTNetTSAnalyzer::Implementation::kSSE2,
+                               RISTNetTSAnalyzer::Implementation::kAVX2}) {
+        if (!RISTNetTSAnalyzer::isSupported(implementation)) {
+            continue;
+        }
+        for (size_t position: {0, 1, 15, 16, 31, 32, 33, 500, 999}) {
+            buffer[position] = RISTNetTSAnalyzer::kSyncByte;
+            EXPECT_EQ(RISTNetTSAnalyzer::findSync(buffer.data(), buffer.size(), implementation), position)
+                    << RISTNetTSAnalyzer::implementationName(implementation);
+            EXPECT_EQ(RISTNetTSAnalyzer::findSync(buffer.data(), position, implementation), position);
+            buffer[position] = 0;
+        }
+    }
+
+    // 7 packets per ms: a PAT and a PMT every 100 ms, the rest video with a PCR every 40 ms. The PCR clock runs
+    // 100 ppm slow
+    const int64_t kMillisecond = 1000000;
+    const uint16_t kPMT = 0x100;
+    const uint16_t kVideo = 0x101;
+    std::map<uint16_t, uint8_t> counters;
+    auto writePacket = [&](uint8_t *packet, uint16_t pid, int64_t time, bool pcr) {
+        memset(packet, 0xff, RISTNetTSAnalyzer::kPacketSize);
+        packet[0] = RISTNetTSAnalyzer::kSyncByte;
+        packet[1] = (uint8_t) ((pid == 0 || pid == kPMT ? 0x40 : 0) | pid >> 8);
+        packet[2] = (uint8_t) pid;
+        packet[3] = (uint8_t) ((pcr ? 0x30 : 0x10) | (counters[pid]++ & 0xf));
+        if (pcr) {
+            uint64_t ticks = (uint64_t) ((double) time * 0.027 * (1.0 - 100e-6));
+            uint64_t base = ticks / 300;
+            packet[4] = 7;
+            packet[5] = 0x10;
+            packet[6] = (uint8_t) (base >> 25);
+            packet[7] = (uint8_t) (base >> 17);
+            packet[8] = (uint8_t) (base >> 9);
+            packet[9] = (uint8_t) (base >> 1);
+            packet[10] = (uint8_t) ((base & 1) << 7 | (ticks % 300) >> 8);
+            packet[11] = (uint8_t) (ticks % 300);
+        } else if (pid == 0) {
+            // Pointer field, table 0 and program 1 on the PMT PID
+            const uint8_t pat[] = {0x00, 0x00, 0xb0, 0x0d, 0x00, 0x01, 0xc1, 0x00, 0x00,
+                                   0x00, 0x01, (uint8_t) (0xe0 | kPMT >> 8), (uint8_t) kPMT};
+            memcpy(packet + 4, pat, sizeof(pat));
+        } else if (pid == kPMT) {
+            packet[4] = 0x00;
+            packet[5] = 0x02;
+        }
+    };
+    std::vector<uint8_t> datagram(7 * RISTNetTSAnalyzer::kPacketSize);
+    auto writeDatagram = [&](int64_t ms, bool pat) {
+        for (size_t i = 0; i < 7; i++) {
+            uint16_t pid = pat && ms % 100 == 0 && i < 2 ? (i == 0 ? 0 : kPMT) : kVideo;
+            writePacket(datagram.data() + i * RISTNetTSAnalyzer::kPacketSize, pid, ms * kMillisecond,
+                        pid == kVideo && ms % 40 == 0 && i == 2);
+        }
+    };
+
+    RISTNetTSAnalyzer analyzer;
+    RISTNetTSStatistics statistics;
+    int64_t ms = 0;
+    for (; ms < 3000; ms++) {
+        writeDatagram(ms, true);
+        analyzer.analyze(datagram.data(), datagram.size(), ms * kMillisecond);
+    }
+    analyzer.statistics(statistics);
+    EXPECT_TRUE(statistics.mInSync);
+    EXPECT_EQ(statistics.mPackets, 7 * 3000);
+    EXPECT_NEAR((double) statistics.mBitrate, 7 * 188 * 8 * 1000.0, 7 * 188 * 8 * 10.0);
+    EXPECT_EQ(statistics.mSyncLosses + statistics.mSyncByteErrors + statistics.mPATErrors + statistics.mCCErrors +
+              statistics.mPMTErrors + statistics.mUntrackedPackets, 0);
+    ASSERT_EQ(statistics.mPIDs.size(), 3);
+    EXPECT_EQ(statistics.mPIDs[0].mPID, 0);
+    EXPECT_EQ(statistics.mPIDs[1].mPID, kPMT);
+    EXPECT_EQ(statistics.mPIDs[2].mPID, kVideo);
+    EXPECT_EQ(statistics.mPIDs[2].mPCRs, 3000 / 40);
+    EXPECT_EQ(statistics.mPIDs[2].mPCRDiscontinuities, 0);
+    EXPECT_LE(statistics.mPIDs[2].mPCRJitter, 5000) << "Only the drift over a PCR interval, 4 us";
+    EXPECT_NEAR(statistics.mPIDs[2].mPCRDrift, 100.0, 1.0);
+
+    // A lost packet, three corrupted sync bytes and no PAT and PMT for a second
+    counters[kVideo]++;
+    writeDatagram(ms, false);
+    analyzer.analyze(datagram.data(), datagram.size(), ms++ * kMillisecond);
+    analyzer.statistics(statistics);
+    EXPECT_EQ(statistics.mCCErrors, 1);
+    EXPECT_EQ(statistics.mPIDs[2].mCCErrors, 1);
+    writeDatagram(ms, false);
+    datagram[0] = 0x48;
+    datagram[RISTNetTSAnalyzer::kPacketSize] = 0x48;
+    datagram[2 * RISTNetTSAnalyzer::kPacketSize] = 0x48;
+    analyzer.analyze(datagram.data(), datagram.size(), ms++ * kMillisecond);
+    analyzer.statistics(statistics);
+    EXPECT_EQ(statistics.mCCErrors, 2) << "The packets with a corrupted sync byte are lost";
+    EXPECT_EQ(statistics.mSyncByteErrors, 2);
+    EXPECT_EQ(statistics.mSyncLosses, 1);
+    EXPECT_FALSE(statistics.mInSync) << "4 packets are left, 5 are needed to regain sync";
+    for (; ms < 4000; ms++) {
+        writeDatagram(ms, false);
+        analyzer.analyze(datagram.data(), datagram.size(), ms * kMillisecond);
+    }
+    analyzer.statistics(statistics);
+    EXPECT_TRUE(statistics.mInSync);
+    EXPECT_EQ(statistics.mPATErrors, 1);
+    EXPECT_EQ(statistics.mPMTErrors, 1);
+    EXPECT_EQ(statistics.mCCErrors, 2);
+
+    // Through a receiver
+    RISTNetReceiver receiver;
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mTSAnalyzer = true;
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                       rist_peer* peer, uint16_t connectionId) {
+        return 0;
+    };
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+    counters.clear();
+    const size_t kSentDatagrams = 10;
+    for (ms = 0; ms < (int64_t) kSentDatagrams; ms++) {
+        writeDatagram(ms, true);
+        EXPECT_TRUE(sender.sendData(datagram.data(), datagram.size()));
+    }
+
+    RISTNetReceiver::ConnectionStatistics connectionStatistics;
+    rist_peer* client = nullptr;
+    auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        receiver.getActiveClients([&](std::map<rist_peer*, std::shared_ptr<RISTNetReceiver::NetworkConnection>>& clients) {
+            client = clients.empty() ? nullptr : clients.begin()->first;
+        });
+    } while ((!client || !receiver.getConnectionStatistics(client, connectionStatistics) ||
+              connectionStatistics.mTS.mPackets < 7 * kSentDatagrams) &&
+             std::chrono::steady_clock::now() < deadline);
+    EXPECT_EQ(connectionStatistics.mTS.mPackets, 7 * kSentDatagrams);
+    EXPECT_TRUE(connectionStatistics.mTS.mInSync);
+    EXPECT_EQ(connectionStatistics.mTS.mCCErrors, 0);
+    EXPECT_EQ(connectionStatistics.mTS.mPIDs.size(), 3);
+}
+
+TEST(TestRist, NullPackets) {
+    const size_t kPacketSize = RISTNetTSAnalyzer::kPacketSize;
+    // 7 packets, 0, 3 and 4 null. The null packets are in the form they are put back in
+    auto makePayload = [&](const std::vector<bool>& nulls) {
+        std::vector<uint8_t> payload(nulls.size() * kPacketSize);
+        for (size_t i = 0; i < nulls.size(); i++) {
+            uint8_t* packet = payload.data() + i * kPacketSize;
+            for (size_t j = 0; j < kPacketSize; j++) {
+                packet[j] = (uint8_t) (i * 7 + j);
+            }
+            packet[0] = RISTNetTSAnalyzer::kSyncByte;
+            packet[1] = nulls[i] ? 0x1f : 0x01;
+            packet[2] = nulls[i] ? 0xff : 0x00;
+            if (nulls[i]) {
+                packet[3] = 0x10;
+                memset(packet + 4, 0xff, kPacketSize - 4);
+            }
+        }
+        return payload;
+    };
+    std::vector<uint8_t> payload = makePayload({true, false, false, true, true, false, false});
+    std::vector<uint8_t> stripped(payload.size() + RISTNetNullPackets::trailerSize(payload.size()));
+    std::vector<uint8_t> restored(payload.size());
+    size_t nullPackets = 0;
+    size_t strippedSize = RISTNetNullPackets::strip(payload.data(), payload.size(), stripped.data(), stripped.size(),
+                                                    nullPackets);
+    EXPECT_EQ(nullPackets, 3);
+    EXPECT_EQ(strippedSize, 4 * kPacketSize + 2);
+    size_t payloadSize = 0;
+    EXPECT_TRUE(RISTNetNullPackets::readTrailer(stripped.data(), strippedSize, payloadSize, nullPackets));
+    EXPECT_EQ(payloadSize, 4 * kPacketSize);
+    EXPECT_EQ(nullPackets, 3);
+    ASSERT_EQ(RISTNetNullPackets::restore(stripped.data(), strippedSize, restored.data(), restored.size()),
+              payload.size());
+    EXPECT_EQ(restored, payload);
+    stripped[strippedSize - 2] ^= 0x02;
+    EXPECT_FALSE(RISTNetNullPackets::readTrailer(stripped.data(), strippedSize, payloadSize, nullPackets))
+            << "The bitmap does not match the size";
+    EXPECT_EQ(RISTNetNullPackets::restore(stripped.data(), strippedSize, restored.data(), restored.size()), 0);
+
+    // Not whole TS packets, sent as they are
+    strippedSize = RISTNetNullPackets::strip(payload.data(), 100, stripped.data(), stripped.size(), nullPackets);
+    EXPECT_EQ(nullPackets, 0);
+    EXPECT_EQ(strippedSize, 101);
+    EXPECT_TRUE(RISTNetNullPackets::readTrailer(stripped.data(), strippedSize, payloadSize, nullPackets));
+    EXPECT_EQ(payloadSize, 100);
+
+    // Through a sender and a receiver, with and without compression
+    for (bool compression: {false, true}) {
+        RISTNetReceiver receiver;
+        std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+        RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+        receiverSettings.mNullPackets = true;
+        receiverSettings.mCompression = compression;
+        receiverSettings.mTSAnalyzer = true;
+
+        std::mutex receiverMutex;
+        std::condition_variable receiverCondition;
+        std::vector<std::vector<uint8_t>> received;
+        receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) {
+            return std::make_shared<RISTNetReceiver::NetworkConnection>();
+        };
+        receiver.networkDataCallback = [&](const uint8_t* buf, size_t size,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                           rist_peer* peer, uint16_t connectionId) {
+            {
+                std::lock_guard<std::mutex> lock(receiverMutex);
+                received.emplace_back(buf, buf + size);
+            }
+            receiverCondition.notify_one();
+            return 0;
+        };
+        ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+
+        std::vector<std::tuple<std::string, int>> senderInterfaces{
+            std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+        RISTNetSender::RISTNetSenderSettings senderSettings;
+        senderSettings.mStripNullPackets = true;
+        if (compression) {
+            senderSettings.mCompressedFlowIds = {0};
+        }
+        RISTNetSender sender;
+        ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+        std::vector<uint8_t> allNull = makePayload(std::vector<bool>(7, true));
+        std::vector<uint8_t> noNull = makePayload(std::vector<bool>(7, false));
+        EXPECT_TRUE(sender.sendData(payload.data(), payload.size()));
+        EXPECT_TRUE(sender.sendData(allNull.data(), allNull.size()));
+        EXPECT_TRUE(sender.sendData(noNull.data(), noNull.size()));
+        EXPECT_TRUE(sender.sendData(payload.data(), 100));
+
+        RISTNetSender::NullPacketStatistics senderStatistics;
+        sender.getNullPacketStatistics(senderStatistics);
+        EXPECT_EQ(senderStatistics.mNullPackets, 10);
+        EXPECT_EQ(senderStatistics.mBytesSaved, 10 * kPacketSize);
+        EXPECT_EQ(senderStatistics.mTrailerBytes, 3 * 2 + 1);
+
+        {
+            std::unique_lock<std::mutex> lock(receiverMutex);
+            ASSERT_TRUE(receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return received.size() == 4; }));
+            EXPECT_EQ(received[0], payload);
+            EXPECT_EQ(received[1], allNull);
+            EXPECT_EQ(received[2], noNull);
+            EXPECT_EQ(received[3], std::vector<uint8_t>(payload.begin(), payload.begin() + 100));
+        }
+        rist_peer* client = nullptr;
+        receiver.getActiveClients([&](std::map<rist_peer*, std::shared_ptr<RISTNetReceiver::NetworkConnection>>& clients) {
+            client = clients.empty() ? nullptr : clients.begin()->first;
+        });
+        RISTNetReceiver::ConnectionStatistics statistics;
+        ASSERT_TRUE(receiver.getConnectionStatistics(client, statistics));
+        EXPECT_EQ(statistics.mNullPacketsRestored, 10);
+        EXPECT_EQ(statistics.mNullPacketErrors, 0);
+        EXPECT_EQ(statistics.mTS.mPackets, 21) << "The analyzer sees the null packets put back";
+    }
+}
+
+TEST(TestRist, Messaging) {
+    // Two messengers wired to each other, a and b stand for their peers
+    uint64_t a = 0;
+    uint64_t b = 0;
+    RISTNetMessenger first;
+    RISTNetMessenger second;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<size_t> blocks;                  // Messages per block received by second
+    std::vector<std::string> received;
+    first.setSendFunction([&](rist_peer *peer, const uint8_t *data, size_t size) {
+        EXPECT_EQ(peer, (rist_peer *) &b);
+        second.receive((rist_peer *) &a, data, size);
+        return true;
+    });
+    second.setSendFunction([&](rist_peer *peer, const uint8_t *data, size_t size) {
+        EXPECT_EQ(peer, (rist_peer *) &a);
+        first.receive((rist_peer *) &b, data, size);
+        return true;
+    });
+    second.messageCallback = [&](const RISTNetMessage *messages, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const RISTNetMessage &message = messages[i];
+            EXPECT_EQ(message.mPeer, (rist_peer *) &a);
+            if (message.mType == 7) {
+                // Echo requests of type 7 reversed
+                std::vector<uint8_t> response(message.mData, message.mData + message.mSize);
+                std::reverse(response.begin(), response.end());
+                EXPECT_TRUE(second.respond(message, 8, response.data(), response.size()));
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.push_back(count);
+        for (size_t i = 0; i < count; i++) {
+            received.emplace_back((const char *) messages[i].mData, messages[i].mSize);
+        }
+        condition.notify_all();
+    };
+
+    RISTNetMessengerSettings settings;
+    settings.mMaxBlockSize = 200;
+    settings.mBatchWindow = std::chrono::milliseconds(50);
+    EXPECT_FALSE(first.send((rist_peer *) &b, 1, (const uint8_t *) "x", 1)); // Not started
+    ASSERT_TRUE(first.start(settings));
+    RISTNetMessengerSettings immediate;
+    immediate.mBatchWindow = std::chrono::microseconds(0);
+    ASSERT_TRUE(second.start(immediate));
+
+    // Small messages within the window are one block, in order
+    for (int i = 0; i < 10; i++) {
+        std::string message = "tally " + std::to_string(i);
+        ASSERT_TRUE(first.send((rist_peer *) &b, 1, (const uint8_t *) message.data(), message.size()));
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(condition.wait_for(lock, kReceiveTimeout, [&]() { return !blocks.empty(); }));
+        EXPECT_EQ(blocks, std::vector<size_t>{10});
+        for (int i = 0; i < 10; i++) {
+            EXPECT_EQ(received[i], "tally " + std::to_string(i));
+        }
+        blocks.clear();
+        received.clear();
+    }
+
+    // A block holds at most mMaxBlockSize bytes, 3 messages of 50 bytes here
+    std::vector<uint8_t> fifty(50, 'f');
+    for (int i = 0; i < 7; i++) {
+        ASSERT_TRUE(first.send((rist_peer *) &b, 2, fifty.data(), fifty.size()));
+    }
+    std::vector<uint8_t> large(200 - RISTNetMessenger::kBlockHeaderSize - RISTNetMessenger::kMessageHeaderSize + 1);
+    EXPECT_FALSE(first.send((rist_peer *) &b, 2, large.data(), large.size()));
+    first.flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(blocks, (std::vector<size_t>{3, 3, 1}));
+        blocks.clear();
+    }
+
+    // Request and response
+    std::promise<std::pair<RISTNetMessenger::Status, std::string>> answered;
+    ASSERT_TRUE(first.request((rist_peer *) &b, 7, (const uint8_t *) "ping", 4, std::chrono::seconds(2),
+                              [&](RISTNetMessenger::Status status, const RISTNetMessage *response) {
+        EXPECT_EQ(response->mType, 8);
+        answered.set_value({status, std::string((const char *) response->mData, response->mSize)});
+    }));
+    auto answer = answered.get_future();
+    ASSERT_EQ(answer.wait_for(kReceiveTimeout), std::future_status::ready);
+    EXPECT_EQ(answer.get(), std::make_pair(RISTNetMessenger::Status::kResponse, std::string("gnip")));
+
+    // Not answered, times out. Stopping fails the requests still open
+    std::promise<RISTNetMessenger::Status> timedOut;
+    std::promise<RISTNetMessenger::Status> stopped;
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(first.request((rist_peer *) &b, 9, nullptr, 0, std::chrono::milliseconds(100),
+                              [&](RISTNetMessenger::Status status, const RISTNetMessage *response) {
+        EXPECT_EQ(response, nullptr);
+        timedOut.set_value(status);
+    }));
+    ASSERT_TRUE(first.request((rist_peer *) &b, 9, nullptr, 0, std::chrono::seconds(60),
+                              [&](RISTNetMessenger::Status status, const RISTNetMessage *response) {
+        stopped.set_value(status);
+    }));
+    auto timeout = timedOut.get_future();
+    ASSERT_EQ(timeout.wait_for(kReceiveTimeout), std::future_status::ready);
+    EXPECT_EQ(timeout.get(), RISTNetMessenger::Status::kTimeout);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+    // Not a messenger block, and a truncated one
+    const uint8_t garbage[] = {0x47, 0x00, 0x11};
+    second.receive((rist_peer *) &a, garbage, sizeof(garbage));
+    const uint8_t truncated[] = {'M', 1, 0, 0, 1, 0, 0, 0, 0, 0, 5, 'a'};
+    second.receive((rist_peer *) &a, truncated, sizeof(truncated));
+
+    // A response with the ID of the open request but from another peer is not taken
+    const uint8_t stranger[] = {'M', 1, 2, 0, 8, 0, 0, 0, 3, 0, 0};
+    first.receive((rist_peer *) &a, stranger, sizeof(stranger));
+
+    first.stop();
+    auto stop = stopped.get_future();
+    ASSERT_EQ(stop.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(stop.get(), RISTNetMessenger::Status::kStopped);
+
+    RISTNetMessengerStatistics statistics;
+    first.getStatistics(statistics);
+    EXPECT_EQ(statistics.mMessagesSent, 10 + 7 + 3);
+    EXPECT_EQ(statistics.mBlocksSent, 1 + 3 + 1 + 1);
+    EXPECT_EQ(statistics.mOversize, 1);
+    EXPECT_EQ(statistics.mTimeouts, 1);
+    EXPECT_EQ(statistics.mMessagesReceived, 2);
+    EXPECT_EQ(statistics.mUnmatchedResponses, 1);
+    second.getStatistics(statistics);
+    EXPECT_EQ(statistics.mMalformedBlocks, 2);
+    EXPECT_EQ(statistics.mMessagesReceived, 10 + 7 + 3);
+    EXPECT_EQ(statistics.mMessagesSent, 1);
+
+    // Attached to a receiver, the blocks come through its OOB callback
+    RISTNetReceiver receiver;
+    RISTNetMessenger attached;
+    attached.attach(receiver);
+    std::vector<std::string> attachedReceived;
+    attached.messageCallback = [&](const RISTNetMessage *messages, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            attachedReceived.emplace_back((const char *) messages[i].mData, messages[i].mSize);
+        }
+    };
+    std::vector<uint8_t> block;
+    RISTNetMessenger source;
+    source.setSendFunction([&](rist_peer *peer, const uint8_t *data, size_t size) {
+        block.assign(data, data + size);
+        return true;
+    });
+    ASSERT_TRUE(source.start(settings));
+    source.send(nullptr, 1, (const uint8_t *) "one", 3);
+    source.send(nullptr, 1, (const uint8_t *) "two", 3);
+    source.flush();
+    rist_oob_block oobBlock{};
+    oobBlock.peer = (rist_peer *) &a;
+    oobBlock.payload = block.data();
+    oobBlock.payload_len = block.size();
+    RISTNetTestAccess::receiveOOBData(receiver, &oobBlock);
+    EXPECT_EQ(attachedReceived, (std::vector<std::string>{"one", "two"}));
+}
+
+TEST(TestRist, OOBDataWithoutClients) {
+    // The connection handed out while no client is connected stays the callback's if it keeps it
+    uint8_t message[] = "OOB";
+    rist_oob_block oobBlock{};
+    oobBlock.payload = message;
+    oobBlock.payload_len = sizeof(message);
+    RISTNetReceiver receiver;
+    std::vector<std::shared_ptr<RISTNetReceiver::NetworkConnection>> kept;
+    receiver.networkOOBDataCallback = [&](const uint8_t *buf, size_t size,
+                                          std::shared_ptr<RISTNetReceiver::NetworkConnection> &connection,
+                                          rist_peer *peer) {
+        EXPECT_FALSE(connection->mObject.has_value());
+        connection->mObject = (int) kept.size();
+        kept.push_back(connection);
+    };
+    RISTNetTestAccess::receiveOOBData(receiver, &oobBlock);
+    RISTNetTestAccess::receiveOOBData(receiver, &oobBlock);
+    ASSERT_EQ(kept.size(), 2);
+    EXPECT_NE(kept[0], kept[1]);
+    EXPECT_EQ(std::any_cast<int>(kept[0]->mObject), 0);
+    EXPECT_EQ(std::any_cast<int>(kept[1]->mObject), 1);
+
+    RISTNetSender sender;
+    std::shared_ptr<RISTNetSender::NetworkConnection> senderKept;
+    size_t senderBlocks = 0;
+    sender.networkOOBDataCallback = [&](const uint8_t *buf, size_t size,
+                                        std::shared_ptr<RISTNetSender::NetworkConnection> &connection,
+                                        rist_peer *peer) {
+        EXPECT_FALSE(connection->mObject.has_value());
+        if (!senderBlocks++) {
+            connection->mObject = std::string("first");
+            senderKept = connection;
+        }
+    };
+    RISTNetTestAccess::receiveOOBData(sender, &oobBlock);
+    RISTNetTestAccess::receiveOOBData(sender, &oobBlock);
+    EXPECT_EQ(senderBlocks, 2);
+    EXPECT_EQ(std::any_cast<std::string>(senderKept->mObject), "first");
+}
+
+// memfd and eventfd are Linux only
+#ifdef __linux__
+TEST(TestRist, SharedRing) {
+    // Encoder process -> ingest ring -> sender -> receiver -> egress ring -> decoder process
+    std::string suffix = std::to_string(getpid()) + ".sock";
+    RISTNetSharedRingSettings egressSettings;
+    egressSettings.mSocketPath = "/tmp/ristnet-test-egress-" + suffix;
+    egressSettings.mSlots = 500;
+    RISTNetSharedRingEgress egress;
+    ASSERT_TRUE(egress.start(egressSettings));
+    // The memory handed out is sealed, an attached process can not resize it
+    size_t sealed = 0;
+    for (int fd = 0; fd < 1024; fd++) {
+        char link[64] = {};
+        std::string path = "/proc/self/fd/" + std::to_string(fd);
+        if (readlink(path.c_str(), link, sizeof(link) - 1) > 0 && !strncmp(link, "/memfd:ristnet-ring", 19)) {
+            EXPECT_EQ(fcntl(fd, F_GET_SEALS), F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) << link;
+            sealed++;
+        }
+    }
+    EXPECT_GE(sealed, 2);
+    ristnet_ring decoder;
+    ASSERT_EQ(ristnet_ring_attach(&decoder, egressSettings.mSocketPath.c_str()), 0);
+    EXPECT_EQ(decoder.role, RISTNET_RING_CONSUMER);
+
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [&](const std::string &, uint16_t) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    egress.attach(receiver);
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mSendQueueDepth = 1024;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    RISTNetSharedRingSettings ingestSettings;
+    ingestSettings.mSocketPath = "/tmp/ristnet-test-ingest-" + suffix;
+    ingestSettings.mBatchSize = 16;
+    RISTNetSharedRingIngest ingest;
+    ASSERT_TRUE(ingest.start(sender, ingestSettings));
+    ristnet_ring encoder;
+    ASSERT_EQ(ristnet_ring_attach(&encoder, ingestSettings.mSocketPath.c_str()), 0);
+    EXPECT_EQ(encoder.role, RISTNET_RING_PRODUCER);
+    ristnet_ring refused;
+    EXPECT_EQ(ristnet_ring_attach(&refused, ingestSettings.mSocketPath.c_str()), -EBUSY);
+
+    const uint32_t kPackets = 300;
+    std::vector<uint8_t> packet(1316);
+    for (uint32_t i = 0; i < kPackets; i++) {
+        memcpy(packet.data(), &i, sizeof(i));
+        ASSERT_EQ(ristnet_ring_write(&encoder, packet.data(), packet.size(), 7, 1000), 0);
+    }
+    std::vector<uint8_t> jumbo(2000);
+    EXPECT_EQ(ristnet_ring_write(&encoder, jumbo.data(), jumbo.size(), 7, 1000), -EMSGSIZE);
+    // A slot claiming more than it holds is not sent
+    ASSERT_NE(ristnet_ring_write_begin(&encoder, 1000), nullptr);
+    ristnet_ring_slot_at(&encoder, encoder.position)->size = 5000;
+    ristnet_ring_publish(&encoder, 1);
+
+    for (uint32_t expected = 0; expected < kPackets; expected++) {
+        size_t size = 0;
+        uint16_t flowID = 0;
+        const void *data = ristnet_ring_read_begin(&decoder, &size, &flowID, 5000);
+        ASSERT_NE(data, nullptr) << "Packet " << expected;
+        ASSERT_EQ(size, packet.size());
+        EXPECT_EQ(flowID, 7);
+        uint32_t sequence;
+        memcpy(&sequence, data, sizeof(sequence));
+        EXPECT_EQ(sequence, expected);
+        ristnet_ring_read_end(&decoder);
+    }
+    ristnet_ring_detach(&encoder);
+
+    RISTNetSharedRingStatistics statistics;
+    auto deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        ingest.getStatistics(statistics);
+    } while ((statistics.mMalformed == 0 || statistics.mAttached) && std::chrono::steady_clock::now() < deadline);
+    EXPECT_EQ(statistics.mPackets, kPackets + 1);
+    EXPECT_EQ(statistics.mBytes, kPackets * packet.size());
+    EXPECT_EQ(statistics.mMalformed, 1);
+    EXPECT_EQ(statistics.mDropped, 0);
+    EXPECT_EQ(statistics.mAttaches, 1);
+    EXPECT_FALSE(statistics.mAttached);
+    EXPECT_LE(statistics.mBatches, kPackets + 1);
+    sender.destroySender();
+    receiver.destroyReceiver();
+    ingest.stop();
+
+    // 512 slots, the egress drops when they are all taken and never blocks
+    egress.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, kPackets);
+    EXPECT_EQ(statistics.mDropped, 0);
+    for (uint32_t i = 0; i < 512; i++) {
+        EXPECT_TRUE(egress.send(packet.data(), 100, 1));
+    }
+    EXPECT_FALSE(egress.send(packet.data(), 100, 1));
+    EXPECT_FALSE(egress.send(jumbo.data(), jumbo.size(), 1));
+    EXPECT_EQ(ristnet_ring_readable(&decoder), 512);
+    ristnet_ring_detach(&decoder);
+    deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        egress.getStatistics(statistics);
+    } while (statistics.mAttached && std::chrono::steady_clock::now() < deadline);
+    EXPECT_FALSE(egress.send(packet.data(), 100, 1));
+
+    // A decoder attaching again starts at the newest packet
+    ASSERT_EQ(ristnet_ring_attach(&decoder, egressSettings.mSocketPath.c_str()), 0);
+    EXPECT_EQ(ristnet_ring_readable(&decoder), 0);
+    deadline = std::chrono::steady_clock::now() + kReceiveTimeout;
+    do {
+        egress.getStatistics(statistics);
+    } while (!statistics.mAttached && std::chrono::steady_clock::now() < deadline);
+    EXPECT_TRUE(egress.send(packet.data(), 100, 2));
+    size_t size = 0;
+    uint16_t flowID = 0;
+    EXPECT_NE(ristnet_ring_read_begin(&decoder, &size, &flowID, 1000), nullptr);
+    EXPECT_EQ(size, 100);
+    EXPECT_EQ(flowID, 2);
+    ristnet_ring_detach(&decoder);
+
+    egress.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, kPackets + 512 + 1);
+    EXPECT_EQ(statistics.mDropped, 2);
+    EXPECT_EQ(statistics.mMalformed, 1);
+    EXPECT_EQ(statistics.mAttaches, 2);
+    egress.stop();
+    EXPECT_NE(access(egressSettings.mSocketPath.c_str(), F_OK), 0) << "The socket is removed";
+}
+#endif
+
+TEST(TestRist, SendFrontEnd) {
+    std::vector<std::string> receiverInterfaces{"rist://@0.0.0.0:8000"};
+    RISTNetReceiver receiver;
+    std::mutex receiverMutex;
+    std::condition_variable receiverCondition;
+    std::map<uint16_t, std::vector<uint32_t>> received;
+    size_t receivedCount = 0;
+    receiver.validateConnectionCallback = [&](const std::string &, uint16_t) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.networkDataCallback = [&](const uint8_t *buf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection> &connection,
+                                       rist_peer *peer, uint16_t connectionId) {
+        uint32_t sequence;
+        memcpy(&sequence, buf, sizeof(sequence));
+        std::lock_guard<std::mutex> lock(receiverMutex);
+        received[connectionId].push_back(sequence);
+        receivedCount++;
+        receiverCondition.notify_one();
+        return 0;
+    };
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+    std::vector<std::tuple<std::string, int>> senderInterfaces{
+        std::tuple<std::string, int>("rist://127.0.0.1:8000", 0)};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    RISTNetSender sender;
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    RISTNetSendFrontEndSettings frontEndSettings;
+    frontEndSettings.mSlots = 3000;
+    RISTNetSendFrontEnd frontEnd;
+    ASSERT_TRUE(frontEnd.start(sender, frontEndSettings));
+
+    // Each thread sends its own elementary stream, in order per thread
+    const uint16_t kProducers = 4;
+    const uint32_t kPackets = 500;
+    std::vector<std::thread> producers;
+    for (uint16_t p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p]() {
+            RISTNetSendFrontEnd::Producer producer = frontEnd.producer(p + 1);
+            std::vector<uint8_t> packet(1316);
+            for (uint32_t i = 0; i < kPackets; i++) {
+                memcpy(packet.data(), &i, sizeof(i));
+                EXPECT_TRUE(producer.send(packet.data(), packet.size()));
+            }
+        });
+    }
+    for (auto &producer: producers) {
+        producer.join();
+    }
+    std::vector<uint8_t> jumbo(2000);
+    EXPECT_FALSE(frontEnd.send(jumbo.data(), jumbo.size(), 1));
+
+    {
+        std::unique_lock<std::mutex> lock(receiverMutex);
+        receiverCondition.wait_for(lock, kReceiveTimeout, [&]() { return receivedCount >= kProducers * kPackets; });
+        ASSERT_EQ(received.size(), kProducers);
+        for (uint16_t p = 0; p < kProducers; p++) {
+            ASSERT_EQ(received[p + 1].size(), kPackets) << "Connection ID " << p + 1;
+            for (uint32_t i = 0; i < kPackets; i++) {
+                EXPECT_EQ(received[p + 1][i], i);
+            }
+        }
+    }
+    frontEnd.stop();
+    EXPECT_FALSE(frontEnd.send(jumbo.data(), 10, 1)) << "Stopped";
+    RISTNetSendFrontEndStatistics statistics;
+    frontEnd.getStatistics(statistics);
+    EXPECT_EQ(statistics.mQueued, 0);
+    EXPECT_EQ(statistics.mSent, kProducers * kPackets);
+    EXPECT_EQ(statistics.mDropped, 0);
+    EXPECT_EQ(statistics.mRejected, 2);
+    EXPECT_EQ(statistics.mWriteErrors, 0);
+    EXPECT_GE(statistics.mBatches, kProducers * kPackets / frontEndSettings.mBatchSize);
+    sender.destroySender();
+    receiver.destroyReceiver();
+
+    // Stopping passes on what is queued, a sender not running counts them as write errors
+    RISTNetSender idle;
+    ASSERT_TRUE(frontEnd.start(idle, frontEndSettings));
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(frontEnd.send(jumbo.data(), 100, 1));
+    }
+    frontEnd.stop();
+    frontEnd.getStatistics(statistics);
+    EXPECT_EQ(statistics.mSent, 0);
+    EXPECT_EQ(statistics.mWriteErrors, 10);
+}
+
 // TODO Enable test when STAR-260 is fixed
 TEST_F(TestFixtureReceiver, DISABLED_RejectConnection) {
     mReceiverCtx = nullptr;
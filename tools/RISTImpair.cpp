@@ -0,0 +1,135 @@
+//
+// UDP proxy injecting loss, delay, jitter, reordering, duplication and a bandwidth limit
+// between a RIST sender and receiver.
+//
+// rist_impair -l 127.0.0.1:9000 -t 127.0.0.1:8000 --loss 0.02 --delay 20 --jitter 5
+//
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <csignal>
+#include <atomic>
+#include "RISTNetImpairment.h"
+
+namespace {
+    std::atomic<bool> gRunning{true};
+
+    void usage() {
+        std::cout << "Usage: rist_impair -l <listen ip:port> -t <target ip:port> [options]\n"
+                     "  The options apply to the listen -> target direction, --both applies them to the return too\n"
+                     "  --loss <p>                Bernoulli loss probability\n"
+                     "  --burst-loss <p> <r>      Gilbert-Elliott loss, p = good -> bad, r = bad -> good\n"
+                     "  --delay <ms>              Fixed delay\n"
+                     "  --jitter <ms>             Uniform +- delay\n"
+                     "  --reorder <p> <ms>        Hold back a share of the packets\n"
+                     "  --duplicate <p>           Send a share of the packets twice\n"
+                     "  --bandwidth <bit/s>       Link rate\n"
+                     "  --queue <ms>              Longest wait for the link before dropping (default 100)\n"
+                     "  --seed <n>                Random seed\n"
+                     "  --both                    Impair the return direction as well\n";
+    }
+
+    bool splitAddress(const std::string &rAddress, std::string &rIP, uint16_t &rPort) {
+        auto lColon = rAddress.rfind(':');
+        if (lColon == std::string::npos) {
+            return false;
+        }
+        rIP = rAddress.substr(0, lColon);
+        if (rIP.size() > 2 && rIP.front() == '[' && rIP.back() == ']') {
+            rIP = rIP.substr(1, rIP.size() - 2);
+        }
+        rPort = (uint16_t) std::stoul(rAddress.substr(lColon + 1));
+        return true;
+    }
+
+    void printStatistics(const char *pDirection, const RISTNetImpairmentStatistics &rStatistics) {
+        std::cout << pDirection << " packets: " << rStatistics.mPackets << " lost: " << rStatistics.mLost
+                  << " queue drops: " << rStatistics.mQueueDrops << " duplicated: " << rStatistics.mDuplicated
+                  << " reordered: " << rStatistics.mReordered << " forwarded: " << rStatistics.mForwarded << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string lListenIP;
+    std::string lTargetIP;
+    uint16_t lListenPort = 0;
+    uint16_t lTargetPort = 0;
+    RISTNetImpairmentSettings lSettings;
+    bool lBoth = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string lOption = argv[i];
+            auto lNext = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(lOption + " needs a value");
+                }
+                return argv[++i];
+            };
+            if (lOption == "-l") {
+                if (!splitAddress(lNext(), lListenIP, lListenPort)) {
+                    throw std::invalid_argument("Listen address not valid");
+                }
+            } else if (lOption == "-t") {
+                if (!splitAddress(lNext(), lTargetIP, lTargetPort)) {
+                    throw std::invalid_argument("Target address not valid");
+                }
+            } else if (lOption == "--loss") {
+                lSettings.mLossModel = RISTNetImpairmentSettings::LossModel::kBernoulli;
+                lSettings.mLoss = std::stod(lNext());
+            } else if (lOption == "--burst-loss") {
+                lSettings.mLossModel = RISTNetImpairmentSettings::LossModel::kGilbertElliott;
+                lSettings.mGoodToBad = std::stod(lNext());
+                lSettings.mBadToGood = std::stod(lNext());
+            } else if (lOption == "--delay") {
+                lSettings.mDelay = (uint32_t) (std::stod(lNext()) * 1000);
+            } else if (lOption == "--jitter") {
+                lSettings.mJitter = (uint32_t) (std::stod(lNext()) * 1000);
+            } else if (lOption == "--reorder") {
+                lSettings.mReorder = std::stod(lNext());
+                lSettings.mReorderDelay = (uint32_t) (std::stod(lNext()) * 1000);
+            } else if (lOption == "--duplicate") {
+                lSettings.mDuplicate = std::stod(lNext());
+            } else if (lOption == "--bandwidth") {
+                lSettings.mBandwidth = std::stoull(lNext());
+            } else if (lOption == "--queue") {
+                lSettings.mMaxQueueDelay = (uint32_t) (std::stod(lNext()) * 1000);
+            } else if (lOption == "--seed") {
+                lSettings.mSeed = (uint32_t) std::stoul(lNext());
+            } else if (lOption == "--both") {
+                lBoth = true;
+            } else {
+                throw std::invalid_argument("Unknown option " + lOption);
+            }
+        }
+    } catch (const std::exception &rError) {
+        std::cout << rError.what() << std::endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (lListenIP.empty() || lTargetIP.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    RISTNetImpairmentProxy lProxy;
+    RISTNetImpairmentSettings lReturnSettings = lBoth ? lSettings : RISTNetImpairmentSettings();
+    lReturnSettings.mSeed = lSettings.mSeed + 1;
+    if (!lProxy.start(lListenIP, lListenPort, lTargetIP, lTargetPort, lSettings, lReturnSettings)) {
+        return EXIT_FAILURE;
+    }
+    std::signal(SIGINT, [](int) { gRunning = false; });
+    std::signal(SIGTERM, [](int) { gRunning = false; });
+
+    RISTNetImpairmentStatistics lForward;
+    RISTNetImpairmentStatistics lReturn;
+    while (gRunning) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        lProxy.getStatistics(lForward, lReturn);
+        printStatistics("forward", lForward);
+        printStatistics("return ", lReturn);
+    }
+    lProxy.stop();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+//
+// Network impairment emulation used to test the RIST C++ wrapper under loss.
+//
+
+#include "RISTNetImpairment.h"
+#include "RISTNetInternal.h"
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // Packets read from one socket before the other one and the scheduled packets get a turn
+    constexpr int kMaxReadsPerWakeup = 64;
+    // Longest poll wait, bounds the time stop() waits for the proxy thread
+    constexpr std::chrono::milliseconds kMaxPollWait(100);
+
+    bool toAddress(const std::string &rIP, uint16_t lPort, sockaddr_storage &rAddress, socklen_t &rLength) {
+        memset(&rAddress, 0, sizeof(rAddress));
+        auto *pV4 = (sockaddr_in *) &rAddress;
+        if (inet_pton(AF_INET, rIP.c_str(), &pV4->sin_addr) == 1) {
+            pV4->sin_family = AF_INET;
+            pV4->sin_port = htons(lPort);
+            rLength = sizeof(sockaddr_in);
+            return true;
+        }
+        auto *pV6 = (sockaddr_in6 *) &rAddress;
+        if (inet_pton(AF_INET6, rIP.c_str(), &pV6->sin6_addr) == 1) {
+            pV6->sin6_family = AF_INET6;
+            pV6->sin6_port = htons(lPort);
+            rLength = sizeof(sockaddr_in6);
+            return true;
+        }
+        return false;
+    }
+
+    int openSocket(int lFamily) {
+        int lSocket = socket(lFamily, SOCK_DGRAM, 0);
+        if (lSocket < 0) {
+            return -1;
+        }
+        int lFlags = fcntl(lSocket, F_GETFL, 0);
+        fcntl(lSocket, F_SETFL, lFlags | O_NONBLOCK);
+        // Bursts released by the delay line must not be dropped by the socket
+        int lBufferSize = 4 * 1024 * 1024;
+        setsockopt(lSocket, SOL_SOCKET, SO_RCVBUF, &lBufferSize, sizeof(lBufferSize));
+        setsockopt(lSocket, SOL_SOCKET, SO_SNDBUF, &lBufferSize, sizeof(lBufferSize));
+        return lSocket;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetImpairment
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetImpairment::RISTNetImpairment(const RISTNetImpairmentSettings &rSettings) : mSettings(rSettings),
+                                                                                    mRandom(rSettings.mSeed) {
+}
+
+size_t RISTNetImpairment::process(size_t lSize, Clock::time_point lNow, Clock::time_point pDelivery[kMaxCopies]) {
+    mStatistics.mPackets++;
+    if (lost()) {
+        mStatistics.mLost++;
+        return 0;
+    }
+
+    Clock::time_point lSent = lNow;
+    if (mSettings.mBandwidth) {
+        mLinkFree = std::max(mLinkFree, lNow);
+        if (mLinkFree - lNow > std::chrono::microseconds(mSettings.mMaxQueueDelay)) {
+            mStatistics.mQueueDrops++;
+            return 0;
+        }
+        mLinkFree += std::chrono::nanoseconds(lSize * 8 * 1000000000ULL / mSettings.mBandwidth);
+        lSent = mLinkFree;
+    }
+
+    size_t lCopies = 1;
+    if (mSettings.mDuplicate > 0 && mUniform(mRandom) < mSettings.mDuplicate) {
+        mStatistics.mDuplicated++;
+        lCopies = 2;
+    }
+    for (size_t i = 0; i < lCopies; i++) {
+        pDelivery[i] = lSent + delay();
+    }
+    mStatistics.mForwarded += lCopies;
+    return lCopies;
+}
+
+bool RISTNetImpairment::lost() {
+    switch (mSettings.mLossModel) {
+        case RISTNetImpairmentSettings::LossModel::kNone:
+            return false;
+        case RISTNetImpairmentSettings::LossModel::kBernoulli:
+            return mUniform(mRandom) < mSettings.mLoss;
+        case RISTNetImpairmentSettings::LossModel::kGilbertElliott:
+            if (mBadState) {
+                mBadState = mUniform(mRandom) >= mSettings.mBadToGood;
+            } else {
+                mBadState = mUniform(mRandom) < mSettings.mGoodToBad;
+            }
+            return mUniform(mRandom) < (mBadState ? mSettings.mLossBad : mSettings.mLossGood);
+    }
+    return false;
+}
+
+RISTNetImpairment::Clock::duration RISTNetImpairment::delay() {
+    int64_t lDelay = mSettings.mDelay;
+    if (mSettings.mJitter) {
+        lDelay += (int64_t) ((mUniform(mRandom) * 2.0 - 1.0) * mSettings.mJitter);
+    }
+    if (mSettings.mReorder > 0 && mUniform(mRandom) < mSettings.mReorder) {
+        mStatistics.mReordered++;
+        lDelay += mSettings.mReorderDelay;
+    }
+    return std::chrono::microseconds(std::max<int64_t>(lDelay, 0));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetImpairmentProxy
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetImpairmentProxy::~RISTNetImpairmentProxy() {
+    stop();
+}
+
+bool RISTNetImpairmentProxy::start(const std::string &rListenIP, uint16_t lListenPort, const std::string &rTargetIP,
+                                   uint16_t lTargetPort, const RISTNetImpairmentSettings &rForward,
+                                   const RISTNetImpairmentSettings &rReturn) {
+    stop();
+    sockaddr_storage lListen{};
+    sockaddr_storage lTarget{};
+    socklen_t lListenLength;
+    socklen_t lTargetLength;
+    if (!toAddress(rListenIP, lListenPort, lListen, lListenLength) ||
+        !toAddress(rTargetIP, lTargetPort, lTarget, lTargetLength)) {
+        LOGGER(true, LOGG_ERROR, "Impairment proxy address not valid: " << rListenIP << " -> " << rTargetIP)
+        return false;
+    }
+
+    mClientSocket = openSocket(lListen.ss_family);
+    mTargetSocket = openSocket(lTarget.ss_family);
+    if (mClientSocket < 0 || mTargetSocket < 0 ||
+        bind(mClientSocket, (sockaddr *) &lListen, lListenLength) ||
+        connect(mTargetSocket, (sockaddr *) &lTarget, lTargetLength)) {
+        LOGGER(true, LOGG_ERROR, "Impairment proxy socket setup failed: " << strerror(errno))
+        stop();
+        return false;
+    }
+    sockaddr_storage lBound{};
+    socklen_t lBoundLength = sizeof(lBound);
+    getsockname(mClientSocket, (sockaddr *) &lBound, &lBoundLength);
+    mListenPort = ntohs(lBound.ss_family == AF_INET ? ((sockaddr_in *) &lBound)->sin_port :
+                        ((sockaddr_in6 *) &lBound)->sin6_port);
+
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mForward = RISTNetImpairment(rForward);
+        mReturn = RISTNetImpairment(rReturn);
+        mScheduled = {};
+        mClientAddress.clear();
+    }
+    mRunning = true;
+    mThread = std::thread(&RISTNetImpairmentProxy::proxyWorker, this);
+    return true;
+}
+
+void RISTNetImpairmentProxy::stop() {
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    if (mClientSocket >= 0) {
+        close(mClientSocket);
+        mClientSocket = -1;
+    }
+    if (mTargetSocket >= 0) {
+        close(mTargetSocket);
+        mTargetSocket = -1;
+    }
+}
+
+void RISTNetImpairmentProxy::getStatistics(RISTNetImpairmentStatistics &rForward,
+                                           RISTNetImpairmentStatistics &rReturn) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rForward = mForward.statistics();
+    rReturn = mReturn.statistics();
+}
+
+void RISTNetImpairmentProxy::proxyWorker() {
+    pollfd lSockets[2] = {{mClientSocket, POLLIN, 0},
+                          {mTargetSocket, POLLIN, 0}};
+    while (mRunning) {
+        RISTNetImpairment::Clock::duration lWait = kMaxPollWait;
+        {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            if (!mScheduled.empty()) {
+                lWait = std::clamp<RISTNetImpairment::Clock::duration>(
+                        mScheduled.top().mDelivery - RISTNetImpairment::Clock::now(),
+                        RISTNetImpairment::Clock::duration::zero(), lWait);
+            }
+        }
+        // Rounded up to poll's milliseconds, a packet is sent at most a millisecond late
+        auto lTimeout = std::chrono::ceil<std::chrono::milliseconds>(lWait).count();
+        if (poll(lSockets, 2, (int) lTimeout) > 0) {
+            if (lSockets[0].revents & POLLIN) {
+                receiveFrom(mClientSocket, true);
+            }
+            if (lSockets[1].revents & POLLIN) {
+                receiveFrom(mTargetSocket, false);
+            }
+        }
+        sendDue(RISTNetImpairment::Clock::now());
+    }
+}
+
+void RISTNetImpairmentProxy::receiveFrom(int lSocket, bool lForward) {
+    uint8_t lBuffer[65536];
+    for (int i = 0; i < kMaxReadsPerWakeup; i++) {
+        sockaddr_storage lFrom{};
+        socklen_t lFromLength = sizeof(lFrom);
+        ssize_t lSize = recvfrom(lSocket, lBuffer, sizeof(lBuffer), 0, (sockaddr *) &lFrom, &lFromLength);
+        if (lSize < 0) {
+            return;
+        }
+        auto lNow = RISTNetImpairment::Clock::now();
+        RISTNetImpairment::Clock::time_point lDelivery[RISTNetImpairment::kMaxCopies];
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (lForward) {
+            mClientAddress.assign((uint8_t *) &lFrom, (uint8_t *) &lFrom + lFromLength);
+        }
+        RISTNetImpairment &rImpairment = lForward ? mForward : mReturn;
+        size_t lCopies = rImpairment.process(lSize, lNow, lDelivery);
+        for (size_t j = 0; j < lCopies; j++) {
+            mScheduled.push({lDelivery[j], mOrder++, lForward, std::vector<uint8_t>(lBuffer, lBuffer + lSize)});
+        }
+    }
+}
+
+void RISTNetImpairmentProxy::sendDue(RISTNetImpairment::Clock::time_point lNow) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    while (!mScheduled.empty() && mScheduled.top().mDelivery <= lNow) {
+        const Scheduled &rPacket = mScheduled.top();
+        if (rPacket.mForward) {
+            send(mTargetSocket, rPacket.mData.data(), rPacket.mData.size(), 0);
+        } else if (!mClientAddress.empty()) {
+            sendto(mClientSocket, rPacket.mData.data(), rPacket.mData.size(), 0,
+                   (const sockaddr *) mClientAddress.data(), (socklen_t) mClientAddress.size());
+        }
+        mScheduled.pop();
+    }
+}
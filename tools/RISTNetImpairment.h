@@ -0,0 +1,188 @@
+//
+// Network impairment emulation used to test the RIST C++ wrapper under loss.
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETIMPAIRMENT_H
+#define CPPRISTWRAPPER__RISTNETIMPAIRMENT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+/**
+ * \class RISTNetImpairmentSettings
+ *
+ * \brief
+ *
+ * What happens to the packets in one direction. The default values pass the packets unchanged.
+ *
+ */
+struct RISTNetImpairmentSettings {
+    enum class LossModel {
+        kNone,
+        kBernoulli,      // Every packet is lost with mLoss
+        kGilbertElliott  // Two state Markov chain, bursts of loss in the bad state
+    };
+
+    LossModel mLossModel = LossModel::kNone;
+    double mLoss = 0;               // kBernoulli loss probability
+    double mGoodToBad = 0;          // kGilbertElliott probability per packet to enter the bad state
+    double mBadToGood = 1;          // kGilbertElliott probability per packet to leave the bad state
+    double mLossGood = 0;           // kGilbertElliott loss probability in the good state
+    double mLossBad = 1;            // kGilbertElliott loss probability in the bad state
+    uint32_t mDelay = 0;            // Fixed delay (us)
+    uint32_t mJitter = 0;           // Uniformly distributed +- delay (us), might reorder packets
+    double mReorder = 0;            // Probability a packet is held back by mReorderDelay and overtaken
+    uint32_t mReorderDelay = 0;     // (us)
+    double mDuplicate = 0;          // Probability a packet is sent twice
+    uint64_t mBandwidth = 0;        // Link rate (bit/s), 0 = unlimited
+    uint32_t mMaxQueueDelay = 100000; // Packets that would wait longer for the link are dropped (us)
+    uint32_t mSeed = 1;             // Same seed, same impairment sequence
+
+    /// Bernoulli loss
+    static RISTNetImpairmentSettings bernoulli(double lLoss) {
+        RISTNetImpairmentSettings lSettings;
+        lSettings.mLossModel = LossModel::kBernoulli;
+        lSettings.mLoss = lLoss;
+        return lSettings;
+    }
+
+    /// Gilbert-Elliott loss losing every packet in the bad state. The mean loss is
+    /// lGoodToBad / (lGoodToBad + lBadToGood) and the mean burst length 1 / lBadToGood
+    static RISTNetImpairmentSettings gilbertElliott(double lGoodToBad, double lBadToGood) {
+        RISTNetImpairmentSettings lSettings;
+        lSettings.mLossModel = LossModel::kGilbertElliott;
+        lSettings.mGoodToBad = lGoodToBad;
+        lSettings.mBadToGood = lBadToGood;
+        return lSettings;
+    }
+};
+
+/**
+ * \class RISTNetImpairmentStatistics
+ *
+ * \brief
+ *
+ * What the impairment did to the packets of one direction.
+ *
+ */
+struct RISTNetImpairmentStatistics {
+    uint64_t mPackets = 0;      // Packets received
+    uint64_t mLost = 0;         // Dropped by the loss model
+    uint64_t mQueueDrops = 0;   // Dropped because the link was busy for longer than mMaxQueueDelay
+    uint64_t mDuplicated = 0;   // Sent twice
+    uint64_t mReordered = 0;    // Held back by mReorderDelay
+    uint64_t mForwarded = 0;    // Packets sent (including the duplicates)
+};
+
+/**
+ * \class RISTNetImpairment
+ *
+ * \brief
+ *
+ * The impairment model of one direction. Decides the fate of every packet, the proxy does the sending.
+ * Not thread safe.
+ *
+ */
+class RISTNetImpairment {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kMaxCopies = 2;
+
+    explicit RISTNetImpairment(const RISTNetImpairmentSettings &rSettings = RISTNetImpairmentSettings());
+
+    /// Decide about a packet of lSize bytes received at lNow. Returns the number of copies to send (0 = dropped),
+    /// pDelivery gets the time each copy is sent
+    size_t process(size_t lSize, Clock::time_point lNow, Clock::time_point pDelivery[kMaxCopies]);
+
+    const RISTNetImpairmentStatistics &statistics() const { return mStatistics; }
+
+private:
+    bool lost();
+    Clock::duration delay();
+
+    RISTNetImpairmentSettings mSettings;
+    RISTNetImpairmentStatistics mStatistics;
+    std::mt19937_64 mRandom;
+    std::uniform_real_distribution<double> mUniform{0.0, 1.0};
+    bool mBadState = false;
+    Clock::time_point mLinkFree;
+};
+
+/**
+ * \class RISTNetImpairmentProxy
+ *
+ * \brief
+ *
+ * A UDP proxy applying a RISTNetImpairment to each direction. Point the sender at the proxy and the proxy at
+ * the receiver (or the other way around in listen mode). Handles one client, the return traffic goes to the
+ * address the last packet came from. The main profile uses one UDP port, the simple profile needs a second
+ * proxy for the RTCP port (port + 1).
+ *
+ */
+class RISTNetImpairmentProxy {
+public:
+    ~RISTNetImpairmentProxy();
+
+    /// Listen on rListenIP:lListenPort (port 0 = any free port) and forward to rTargetIP:lTargetPort
+    bool start(const std::string &rListenIP, uint16_t lListenPort, const std::string &rTargetIP, uint16_t lTargetPort,
+               const RISTNetImpairmentSettings &rForward,
+               const RISTNetImpairmentSettings &rReturn = RISTNetImpairmentSettings());
+
+    void stop();
+
+    /// The port the proxy listens on
+    uint16_t listenPort() const { return mListenPort; }
+
+    /// Statistics of the client to target (forward) and target to client (return) direction
+    void getStatistics(RISTNetImpairmentStatistics &rForward, RISTNetImpairmentStatistics &rReturn);
+
+    RISTNetImpairmentProxy() = default;
+    RISTNetImpairmentProxy(RISTNetImpairmentProxy const &) = delete;
+    RISTNetImpairmentProxy &operator=(RISTNetImpairmentProxy const &) = delete;
+
+private:
+    struct Scheduled {
+        RISTNetImpairment::Clock::time_point mDelivery;
+        uint64_t mOrder;        // Keeps packets with the same delivery time in order
+        bool mForward;
+        std::vector<uint8_t> mData;
+        bool operator>(const Scheduled &rOther) const {
+            return mDelivery != rOther.mDelivery ? mDelivery > rOther.mDelivery : mOrder > rOther.mOrder;
+        }
+    };
+
+    void proxyWorker();
+    void receiveFrom(int lSocket, bool lForward);
+    void sendDue(RISTNetImpairment::Clock::time_point lNow);
+
+    int mClientSocket = -1;
+    int mTargetSocket = -1;
+    uint16_t mListenPort = 0;
+    // sockaddr_storage of the client, the address the return traffic is sent to
+    std::vector<uint8_t> mClientAddress;
+    std::atomic<bool> mRunning{false};
+    std::thread mThread;
+
+    std::mutex mMtx;
+    RISTNetImpairment mForward;
+    RISTNetImpairment mReturn;
+    std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> mScheduled;
+    uint64_t mOrder = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETIMPAIRMENT_H
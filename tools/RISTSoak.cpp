@@ -0,0 +1,473 @@
+//
+// Many to one soak test. Runs N senders against M listening receivers on ephemeral loopback ports for a
+// while and reports throughput, loss, connect and disconnect latency, delivery latency outliers, RSS and
+// the thread count.
+//
+// rist_soak --senders 500 --receivers 4 --duration 300 --rate 100
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <csignal>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "RISTNet.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<bool> gRunning{true};
+
+    struct SoakSettings {
+        uint32_t mSenders = 100;
+        uint32_t mReceivers = 1;
+        uint32_t mDuration = 60;        // s
+        uint32_t mRate = 100;           // Packets per second per sender
+        uint32_t mSize = 1316;          // Payload bytes
+        uint32_t mSendThreads = std::max<uint32_t>(std::thread::hardware_concurrency() / 2, 1);
+        double mChurn = 0;              // Senders replaced per second
+        uint32_t mReportInterval = 5;   // s
+        uint32_t mOutlier = 50;         // Delivery latency reported as an outlier (ms)
+        uint32_t mDrainTime = 15;       // Wait for the disconnections after the run (s)
+    };
+
+    // Written at the start of every payload
+    struct PacketHeader {
+        uint32_t mSender;
+        uint32_t mGeneration;   // Incremented when the sender is replaced, the sequence restarts
+        uint64_t mSequence;
+        int64_t mSent;          // Clock ns
+    };
+
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void usage() {
+        std::cout << "Usage: rist_soak [options]\n"
+                     "  --senders <n>         Senders (default 100), raise the open file limit for 1000+\n"
+                     "  --receivers <n>       Listening receivers, the senders are spread over them (default 1)\n"
+                     "  --duration <s>        Time sending (default 60)\n"
+                     "  --rate <pps>          Packets per second per sender (default 100)\n"
+                     "  --size <bytes>        Payload size (default 1316)\n"
+                     "  --send-threads <n>    Threads pacing the senders\n"
+                     "  --churn <n/s>         Senders replaced per second, measures connect and disconnect latency\n"
+                     "  --report <s>          Report interval (default 5)\n"
+                     "  --outlier <ms>        Delivery latency counted as an outlier (default 50)\n"
+                     "  --drain <s>           Wait for the disconnections at the end (default 15)\n";
+    }
+
+    /// A free UDP port on the loopback interface
+    uint16_t ephemeralPort() {
+        int lSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (lSocket < 0) {
+            return 0;
+        }
+        sockaddr_in lAddress{};
+        lAddress.sin_family = AF_INET;
+        lAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t lLength = sizeof(lAddress);
+        uint16_t lPort = 0;
+        if (!bind(lSocket, (sockaddr *) &lAddress, sizeof(lAddress)) &&
+            !getsockname(lSocket, (sockaddr *) &lAddress, &lLength)) {
+            lPort = ntohs(lAddress.sin_port);
+        }
+        close(lSocket);
+        return lPort;
+    }
+
+    /// A field of /proc/self/status, 0 if not found
+    uint64_t processStatus(const std::string &rField) {
+        std::ifstream lStatus("/proc/self/status");
+        std::string lLine;
+        while (std::getline(lStatus, lLine)) {
+            if (lLine.compare(0, rField.size(), rField) == 0 && lLine[rField.size()] == ':') {
+                return std::stoull(lLine.substr(rField.size() + 1));
+            }
+        }
+        return 0;
+    }
+
+    /// Latency histogram shared by the receiver threads
+    struct SharedHistogram {
+        void record(uint64_t lValue) {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            mHistogram.recordValue(lValue);
+        }
+
+        std::string summary() {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            std::ostringstream lSummary;
+            lSummary << "n " << mHistogram.totalCount() << " p50 " << mHistogram.valueAtPercentile(50.0)
+                     << " p99 " << mHistogram.valueAtPercentile(99.0) << " p99.9 "
+                     << mHistogram.valueAtPercentile(99.9) << " max " << mHistogram.maxValue() << " us";
+            return lSummary.str();
+        }
+
+        std::mutex mMtx;
+        RISTNetLatencyHistogram mHistogram;
+    };
+
+    struct SenderSlot {
+        std::mutex mMtx;                        // Protects mSender against the churn
+        std::unique_ptr<RISTNetSender> mSender;
+        uint32_t mGeneration = 0;
+        uint64_t mSequence = 0;
+        std::atomic<int64_t> mStarted{0};       // initSender called (ns)
+        std::atomic<int64_t> mDestroyed{0};     // destroySender called (ns), for the disconnect latency
+
+        // Receiver side, only touched by the thread of the receiver the sender is connected to
+        uint32_t mSeenGeneration = UINT32_MAX;
+        uint64_t mNextSequence = 0;
+    };
+
+    class Soak {
+    public:
+        explicit Soak(const SoakSettings &rSettings) : mSettings(rSettings), mSlots(rSettings.mSenders) {
+        }
+
+        bool run();
+
+    private:
+        bool startReceivers();
+        bool startSender(uint32_t lSender);
+        void stopSender(uint32_t lSender);
+        void sendWorker(uint32_t lFirst, uint32_t lLast);
+        void churnWorker();
+        void onData(const uint8_t *pData, size_t lSize, rist_peer *pPeer);
+        void onDisconnected(const rist_peer &rPeer);
+        void report(double lElapsed, double lInterval);
+
+        SoakSettings mSettings;
+        std::vector<SenderSlot> mSlots;
+        std::vector<std::unique_ptr<RISTNetReceiver>> mReceivers;
+        std::vector<uint16_t> mPorts;
+        std::atomic<bool> mSending{true};
+
+        // Peer to sender, to find the sender of a disconnecting peer
+        std::mutex mPeerMtx;
+        RISTNetPeerTable<uint32_t> mPeerSenders;
+
+        std::atomic<uint64_t> mPackets{0};
+        std::atomic<uint64_t> mBytes{0};
+        std::atomic<uint64_t> mLost{0};
+        std::atomic<uint64_t> mOutliers{0};
+        std::atomic<uint64_t> mSendFailures{0};
+        std::atomic<uint64_t> mConnects{0};
+        std::atomic<uint64_t> mDisconnects{0};
+        std::atomic<uint64_t> mReplaced{0};
+        SharedHistogram mDeliveryLatency;   // Sent to networkDataCallback
+        SharedHistogram mConnectLatency;    // initSender to the first packet received
+        SharedHistogram mDisconnectLatency; // destroySender to clientDisconnectedCallback
+        SharedHistogram mDestroyTime;       // Time spent in destroySender
+
+        uint64_t mStartRSS = 0;
+        uint64_t mLastPackets = 0;
+        uint64_t mLastBytes = 0;
+    };
+
+    bool Soak::run() {
+        mStartRSS = processStatus("VmRSS");
+        std::cout << "start rss " << mStartRSS << " kB threads " << processStatus("Threads") << std::endl;
+        if (!startReceivers()) {
+            return false;
+        }
+        for (uint32_t i = 0; i < mSettings.mSenders; i++) {
+            if (!startSender(i)) {
+                std::cout << "Sender " << i << " failed to start" << std::endl;
+                return false;
+            }
+        }
+        std::cout << "started " << mSettings.mSenders << " senders, rss " << processStatus("VmRSS")
+                  << " kB threads " << processStatus("Threads") << std::endl;
+
+        std::vector<std::thread> lThreads;
+        uint32_t lThreadCount = std::min(mSettings.mSendThreads, mSettings.mSenders);
+        for (uint32_t i = 0; i < lThreadCount; i++) {
+            lThreads.emplace_back(&Soak::sendWorker, this, mSettings.mSenders * i / lThreadCount,
+                                  mSettings.mSenders * (i + 1) / lThreadCount);
+        }
+        if (mSettings.mChurn > 0) {
+            lThreads.emplace_back(&Soak::churnWorker, this);
+        }
+
+        auto lStart = Clock::now();
+        auto lLastReport = lStart;
+        while (gRunning && Clock::now() - lStart < std::chrono::seconds(mSettings.mDuration)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            auto lNow = Clock::now();
+            if (lNow - lLastReport >= std::chrono::seconds(mSettings.mReportInterval)) {
+                report(std::chrono::duration<double>(lNow - lStart).count(),
+                       std::chrono::duration<double>(lNow - lLastReport).count());
+                lLastReport = lNow;
+            }
+        }
+        mSending = false;
+        for (auto &rThread: lThreads) {
+            rThread.join();
+        }
+        report(std::chrono::duration<double>(Clock::now() - lStart).count(),
+               std::chrono::duration<double>(Clock::now() - lLastReport).count());
+
+        uint64_t lExpected = mConnects;
+        for (uint32_t i = 0; i < mSettings.mSenders; i++) {
+            stopSender(i);
+        }
+        auto lDrainEnd = Clock::now() + std::chrono::seconds(mSettings.mDrainTime);
+        while (mDisconnects < lExpected && Clock::now() < lDrainEnd) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        for (auto &rReceiver: mReceivers) {
+            rReceiver->destroyReceiver();
+        }
+
+        std::cout << "\nsenders " << mSettings.mSenders << " replaced " << mReplaced << " connected "
+                  << mConnects << " disconnected " << mDisconnects << "\n"
+                  << "delivery latency   " << mDeliveryLatency.summary() << ", outliers > " << mSettings.mOutlier
+                  << " ms: " << mOutliers << "\n"
+                  << "connect latency    " << mConnectLatency.summary() << "\n"
+                  << "disconnect latency " << mDisconnectLatency.summary() << "\n"
+                  << "destroySender      " << mDestroyTime.summary() << "\n"
+                  << "packets " << mPackets << " lost " << mLost << " send failures " << mSendFailures << "\n"
+                  << "rss " << processStatus("VmRSS") << " kB (start " << mStartRSS << " kB) threads "
+                  << processStatus("Threads") << std::endl;
+        return true;
+    }
+
+    bool Soak::startReceivers() {
+        for (uint32_t i = 0; i < mSettings.mReceivers; i++) {
+            auto lReceiver = std::make_unique<RISTNetReceiver>();
+            lReceiver->validateConnectionCallback = [](const std::string &, uint16_t) {
+                return std::make_shared<RISTNetReceiver::NetworkConnection>();
+            };
+            lReceiver->networkDataCallback = [this](const uint8_t *pData, size_t lSize,
+                                                    std::shared_ptr<RISTNetReceiver::NetworkConnection> &,
+                                                    rist_peer *pPeer, uint16_t) {
+                onData(pData, lSize, pPeer);
+                return 0;
+            };
+            lReceiver->clientDisconnectedCallback = [this](const std::shared_ptr<RISTNetReceiver::NetworkConnection> &,
+                                                           const rist_peer &rPeer) {
+                onDisconnected(rPeer);
+            };
+            RISTNetReceiver::RISTNetReceiverSettings lSettings;
+            lSettings.mExpectedClients = mSettings.mSenders / mSettings.mReceivers + 1;
+            uint16_t lPort = ephemeralPort();
+            std::vector<std::string> lURLs = {"rist://@127.0.0.1:" + std::to_string(lPort)};
+            if (!lPort || !lReceiver->initReceiver(lURLs, lSettings)) {
+                std::cout << "Receiver " << i << " failed to start" << std::endl;
+                return false;
+            }
+            mPorts.push_back(lPort);
+            mReceivers.push_back(std::move(lReceiver));
+        }
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        mPeerSenders.reserve(mSettings.mSenders);
+        return true;
+    }
+
+    bool Soak::startSender(uint32_t lSender) {
+        SenderSlot &rSlot = mSlots[lSender];
+        auto lNewSender = std::make_unique<RISTNetSender>();
+        RISTNetSender::RISTNetSenderSettings lSettings;
+        std::vector<std::tuple<std::string, int>> lURLs = {
+                {"rist://127.0.0.1:" + std::to_string(mPorts[lSender % mPorts.size()]), 5}};
+        std::lock_guard<std::mutex> lLock(rSlot.mMtx);
+        rSlot.mStarted = nowNs();
+        if (!lNewSender->initSender(lURLs, lSettings)) {
+            return false;
+        }
+        rSlot.mSender = std::move(lNewSender);
+        rSlot.mGeneration++;
+        rSlot.mSequence = 0;
+        return true;
+    }
+
+    void Soak::stopSender(uint32_t lSender) {
+        SenderSlot &rSlot = mSlots[lSender];
+        std::unique_ptr<RISTNetSender> lStopping;
+        {
+            std::lock_guard<std::mutex> lLock(rSlot.mMtx);
+            lStopping = std::move(rSlot.mSender);
+        }
+        if (!lStopping) {
+            return;
+        }
+        auto lStart = Clock::now();
+        rSlot.mDestroyed = nowNs();
+        lStopping->destroySender();
+        lStopping.reset();
+        mDestroyTime.record(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - lStart).count());
+    }
+
+    void Soak::sendWorker(uint32_t lFirst, uint32_t lLast) {
+        std::vector<uint8_t> lPayload(std::max<size_t>(mSettings.mSize, sizeof(PacketHeader)), 0x47);
+        auto lInterval = std::chrono::nanoseconds(1000000000 / std::max<uint32_t>(mSettings.mRate, 1));
+        auto lNext = Clock::now();
+        while (mSending) {
+            for (uint32_t i = lFirst; i < lLast; i++) {
+                SenderSlot &rSlot = mSlots[i];
+                std::lock_guard<std::mutex> lLock(rSlot.mMtx);
+                if (!rSlot.mSender) {
+                    continue;
+                }
+                PacketHeader lHeader{i, rSlot.mGeneration, rSlot.mSequence++, nowNs()};
+                memcpy(lPayload.data(), &lHeader, sizeof(lHeader));
+                if (!rSlot.mSender->sendData(lPayload.data(), lPayload.size())) {
+                    mSendFailures++;
+                }
+            }
+            lNext += lInterval;
+            std::this_thread::sleep_until(lNext);
+        }
+    }
+
+    void Soak::churnWorker() {
+        std::mt19937 lRandom(1);
+        std::uniform_int_distribution<uint32_t> lPick(0, mSettings.mSenders - 1);
+        auto lInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / mSettings.mChurn));
+        auto lNext = Clock::now() + lInterval;
+        while (mSending) {
+            std::this_thread::sleep_until(lNext);
+            lNext += lInterval;
+            uint32_t lSender = lPick(lRandom);
+            stopSender(lSender);
+            if (!startSender(lSender)) {
+                std::cout << "Sender " << lSender << " failed to restart" << std::endl;
+                continue;
+            }
+            mReplaced++;
+        }
+    }
+
+    void Soak::onData(const uint8_t *pData, size_t lSize, rist_peer *pPeer) {
+        int64_t lNow = nowNs();
+        if (lSize < sizeof(PacketHeader)) {
+            return;
+        }
+        PacketHeader lHeader;
+        memcpy(&lHeader, pData, sizeof(lHeader));
+        if (lHeader.mSender >= mSlots.size()) {
+            return;
+        }
+        mPackets++;
+        mBytes += lSize;
+        uint64_t lLatency = std::max<int64_t>(lNow - lHeader.mSent, 0) / 1000;
+        mDeliveryLatency.record(lLatency);
+        if (lLatency > (uint64_t) mSettings.mOutlier * 1000) {
+            mOutliers++;
+        }
+
+        SenderSlot &rSlot = mSlots[lHeader.mSender];
+        if (rSlot.mSeenGeneration != lHeader.mGeneration) {
+            // First packet of this sender instance
+            rSlot.mSeenGeneration = lHeader.mGeneration;
+            rSlot.mNextSequence = 0;
+            mConnects++;
+            mConnectLatency.record(std::max<int64_t>(lNow - rSlot.mStarted, 0) / 1000);
+            std::lock_guard<std::mutex> lLock(mPeerMtx);
+            mPeerSenders[pPeer] = lHeader.mSender;
+        }
+        if (lHeader.mSequence > rSlot.mNextSequence) {
+            mLost += lHeader.mSequence - rSlot.mNextSequence;
+        }
+        rSlot.mNextSequence = std::max(rSlot.mNextSequence, lHeader.mSequence + 1);
+    }
+
+    void Soak::onDisconnected(const rist_peer &rPeer) {
+        int64_t lNow = nowNs();
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        auto *pSender = mPeerSenders.find(const_cast<rist_peer *>(&rPeer));
+        if (!pSender) {
+            return;
+        }
+        mDisconnects++;
+        int64_t lDestroyed = mSlots[*pSender].mDestroyed;
+        if (lDestroyed) {
+            mDisconnectLatency.record(std::max<int64_t>(lNow - lDestroyed, 0) / 1000);
+        }
+        mPeerSenders.erase(const_cast<rist_peer *>(&rPeer));
+    }
+
+    void Soak::report(double lElapsed, double lInterval) {
+        uint64_t lPackets = mPackets;
+        uint64_t lBytes = mBytes;
+        double lSeconds = std::max(lInterval, 0.001);
+        uint64_t lRSS = processStatus("VmRSS");
+        std::cout << std::fixed << std::setprecision(1) << "t " << lElapsed << " s  "
+                  << (double) (lBytes - mLastBytes) * 8 / lSeconds / 1e6 << " Mbit/s  "
+                  << (double) (lPackets - mLastPackets) / lSeconds << " pps  lost " << mLost << "  outliers "
+                  << mOutliers << "  connected " << mConnects - mDisconnects << "  rss " << lRSS << " kB (+"
+                  << (int64_t) lRSS - (int64_t) mStartRSS << ")  threads " << processStatus("Threads") << std::endl;
+        mLastPackets = lPackets;
+        mLastBytes = lBytes;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    SoakSettings lSettings;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string lOption = argv[i];
+            auto lNext = [&]() -> uint32_t {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(lOption + " needs a value");
+                }
+                return (uint32_t) std::stoul(argv[++i]);
+            };
+            if (lOption == "--senders") {
+                lSettings.mSenders = lNext();
+            } else if (lOption == "--receivers") {
+                lSettings.mReceivers = lNext();
+            } else if (lOption == "--duration") {
+                lSettings.mDuration = lNext();
+            } else if (lOption == "--rate") {
+                lSettings.mRate = lNext();
+            } else if (lOption == "--size") {
+                lSettings.mSize = lNext();
+            } else if (lOption == "--send-threads") {
+                lSettings.mSendThreads = lNext();
+            } else if (lOption == "--churn") {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(lOption + " needs a value");
+                }
+                lSettings.mChurn = std::stod(argv[++i]);
+            } else if (lOption == "--report") {
+                lSettings.mReportInterval = lNext();
+            } else if (lOption == "--outlier") {
+                lSettings.mOutlier = lNext();
+            } else if (lOption == "--drain") {
+                lSettings.mDrainTime = lNext();
+            } else {
+                throw std::invalid_argument("Unknown option " + lOption);
+            }
+        }
+        if (!lSettings.mSenders || !lSettings.mReceivers || !lSettings.mSendThreads) {
+            throw std::invalid_argument("--senders, --receivers and --send-threads must be at least 1");
+        }
+    } catch (const std::exception &rError) {
+        std::cout << rError.what() << std::endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::signal(SIGINT, [](int) { gRunning = false; });
+    std::signal(SIGTERM, [](int) { gRunning = false; });
+    Soak lSoak(lSettings);
+    return lSoak.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}